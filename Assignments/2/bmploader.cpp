@@ -93,47 +93,70 @@ extern "C" void LoadBMPFile(uchar4 **dst, int *width, int *height, const char *n
         exit(0);
     }
 
-    fread(&hdr, sizeof(hdr), 1, fd);
-    if(hdr.type != 0x4D42){
+    if(fread(&hdr, sizeof(hdr), 1, fd) != 1 || hdr.type != 0x4D42 ||
+       fread(&infoHdr, sizeof(infoHdr), 1, fd) != 1){
         printf("***BMP load error: bad file format***\n");
+        fclose(fd);
         exit(0);
     }
-    fread(&infoHdr, sizeof(infoHdr), 1, fd);
 
-    if(infoHdr.bitsPerPixel != 24){
+    int bytesPerPixel = infoHdr.bitsPerPixel / 8;
+    if(infoHdr.bitsPerPixel != 24 && infoHdr.bitsPerPixel != 32){
         printf("***BMP load error: invalid color depth***\n");
+        fclose(fd);
         exit(0);
     }
 
     if(infoHdr.compression){
         printf("***BMP load error: compressed image***\n");
+        fclose(fd);
         exit(0);
     }
 
+    //Negative height means top-down rows, they are flipped to bottom-up
+    int topDown = infoHdr.height < 0;
     *width  = infoHdr.width;
-    *height = infoHdr.height;
-    *dst    = (uchar4 *)malloc(*width * *height * 4);
+    *height = topDown ? -infoHdr.height : infoHdr.height;
+    if(*width <= 0 || *height <= 0){
+        printf("***BMP load error: bad image size***\n");
+        fclose(fd);
+        exit(0);
+    }
+    //Whole padded rows are read at once instead of byte by byte
+    size_t pitch = ((size_t)infoHdr.bitsPerPixel * *width + 31) / 32 * 4;
+    unsigned char *row = (unsigned char *)malloc(pitch);
+    *dst    = (uchar4 *)malloc((size_t)*width * *height * 4);
+    if(!row || !*dst){
+        printf("***BMP load error: out of memory***\n");
+        free(row);
+        free(*dst);
+        fclose(fd);
+        exit(0);
+    }
 
-    printf("BMP width: %u\n", infoHdr.width);
-    printf("BMP height: %u\n", infoHdr.height);
+    printf("BMP width: %u\n", *width);
+    printf("BMP height: %u\n", *height);
 
     fseek(fd, hdr.offset - sizeof(hdr) - sizeof(infoHdr), SEEK_CUR);
 
-    for(y = 0; y < infoHdr.height; y++){
-        for(x = 0; x < infoHdr.width; x++){
-            (*dst)[(y * infoHdr.width + x)].z = fgetc(fd);
-            (*dst)[(y * infoHdr.width + x)].y = fgetc(fd);
-            (*dst)[(y * infoHdr.width + x)].x = fgetc(fd);
-        }
+    for(y = 0; y < *height; y++){
+        if(fread(row, pitch, 1, fd) != 1)
+            break;
 
-        for(x = 0; x < (4 - (3 * infoHdr.width) % 4) % 4; x++)
-            fgetc(fd);
+        uchar4 *out = *dst + (size_t)(topDown ? *height - 1 - y : y) * *width;
+        for(x = 0; x < *width; x++){
+            out[x].z = row[x * bytesPerPixel + 0];
+            out[x].y = row[x * bytesPerPixel + 1];
+            out[x].x = row[x * bytesPerPixel + 2];
+        }
     }
 
+    free(row);
 
-    if(ferror(fd)){
+    if(y < *height){
         printf("***Unknown BMP load error.***\n");
         free(*dst);
+        fclose(fd);
         exit(0);
     }else
         printf("BMP file loaded successfully!\n");
@@ -0,0 +1,213 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HostFilters.h"
+
+// Cells of zeros around the grid, so that the blur kernel
+// and trilinear lookups never leave it.
+#define GRID_PAD 2
+
+// The number of floats blurred together in each line of the grid.
+#define GRID_CHUNK 256
+
+// Intensity of RGBA pixel, which the range distance is measured in.
+static inline int Luma(const unsigned char * p)
+{
+    return (77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8;
+}
+
+// Blur the grid of outer x n x inner floats along n by the kernel
+// [1 4 6 4 1] / 16 of unit variance, zeros beyond the ends. Each line
+// goes through the buffer of n + 4 samples with zeros at the ends,
+// by chunks of inner floats, so that each tap is the SIMD multiply-add.
+// The short block of n x inner floats is contiguous, and it is blurred
+// at once as the flat line with taps inner floats apart. Buffers are
+// allocated once per thread; if any allocation fails, all threads skip
+// the blur, and false is returned.
+static bool BlurAxis(float * pGrid, int outer, int n, size_t inner)
+{
+    int cw = (int) (inner < GRID_CHUNK ? inner : GRID_CHUNK);
+    int nchunks = (int) ((inner + cw - 1) / cw);
+
+    bool ok = true;
+    #pragma omp parallel
+    {
+        float * pLine = (float *) calloc((size_t) (n + 4) * cw, sizeof(float));
+        if (!pLine)
+        {
+            #pragma omp atomic write
+            ok = false;
+        }
+        #pragma omp barrier
+
+        bool run;
+        #pragma omp atomic read
+        run = ok;
+
+        if (run)
+        {
+            #pragma omp for collapse(2)
+            for (int o = 0; o < outer; o++)
+                for (int c = 0; c < nchunks; c++)
+                {
+                    size_t i0 = (size_t) c * cw;
+                    int len = (int) (inner - i0 < (size_t) cw ? inner - i0 : cw);
+                    float * pBase = pGrid + (size_t) o * n * inner + i0;
+                    const float * l = pLine;
+
+                    if (len == (int) inner)
+                    {
+                        memcpy(pLine + 2 * cw, pBase, (size_t) n * cw * sizeof(float));
+                        #pragma omp simd
+                        for (int j = 0; j < n * cw; j++)
+                            pBase[j] = (l[j] + l[j + 4 * cw] + 4.0f * (l[j + cw] + l[j + 3 * cw]) +
+                                        6.0f * l[j + 2 * cw]) * (1.0f / 16.0f);
+                        continue;
+                    }
+
+                    for (int i = 0; i < n; i++)
+                        memcpy(pLine + (size_t) (i + 2) * cw, pBase + i * inner, len * sizeof(float));
+                    for (int i = 0; i < n; i++, l += cw)
+                    {
+                        float * pOut = pBase + i * inner;
+                        #pragma omp simd
+                        for (int j = 0; j < len; j++)
+                            pOut[j] = (l[j] + l[j + 4 * cw] + 4.0f * (l[j + cw] + l[j + 3 * cw]) +
+                                       6.0f * l[j + 2 * cw]) * (1.0f / 16.0f);
+                    }
+                }
+        }
+
+        free(pLine);
+    }
+
+    return ok;
+}
+
+extern "C"
+{
+    int BilateralGridRadius(float sigmaSpatial)
+    {
+        // The pixel is sliced from cells of 2 nearest rows, they are blurred
+        // by cells 2 rows apart, which gather pixels half a cell apart.
+        return (int) ceilf(3.5f * sigmaSpatial) + 1;
+    }
+
+    bool Host_BilateralGridRows(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int y0,
+                                float sigmaSpatial, float sigmaRange)
+    {
+        if (w <= 0 || h <= 0 || y0 < 0 || sigmaSpatial <= 0.0f || sigmaRange <= 0.0f)
+            return false;
+
+        // Cells are sigma apart in each dimension, the grid is laid out
+        // as [y][x][intensity] of homogeneous (R, G, B, weight) values.
+        // Rows of cells are counted from image row 0, the grid holds
+        // the ones from cell row y0 falls into.
+        float ss = 1.0f / sigmaSpatial, sr = 1.0f / sigmaRange;
+        int base = (int) (y0 * ss);
+        int gw = (int) ((w - 1) * ss) + 1 + 2 * GRID_PAD;
+        int gh = (int) ((y0 + h - 1) * ss) - base + 1 + 2 * GRID_PAD;
+        int gd = (int) (255 * sr) + 1 + 2 * GRID_PAD;
+        size_t depth = (size_t) gd * 4, stride = gw * depth;
+
+        float * pGrid = (float *) calloc(gh * stride, sizeof(float));
+        int * pRows = (int *) malloc((gh + 1) * sizeof(int));
+        if (!pGrid || !pRows)
+        {
+            free(pGrid);
+            free(pRows);
+            return false;
+        }
+
+        // Splat: each pixel is added to the nearest cell. Image rows of
+        // each grid row are found first, so that grid rows are filled
+        // in parallel without conflicts.
+        for (int j = 0, y = 0; j <= gh; j++)
+        {
+            while (y < h && (int) ((y0 + y) * ss + 0.5f) - base + GRID_PAD < j)
+                y++;
+            pRows[j] = y;
+        }
+
+        #pragma omp parallel for
+        for (int j = 0; j < gh; j++)
+            for (int y = pRows[j]; y < pRows[j + 1]; y++)
+            {
+                const unsigned char * pIn = pSrc + (size_t) y * w * 4;
+                float * pPlane = pGrid + j * stride;
+                for (int x = 0; x < w; x++)
+                {
+                    const unsigned char * p = pIn + 4 * x;
+                    int gx = (int) (x * ss + 0.5f) + GRID_PAD;
+                    int gz = (int) (Luma(p) * sr + 0.5f) + GRID_PAD;
+                    float * pCell = pPlane + gx * depth + 4 * gz;
+                    pCell[0] += p[0];
+                    pCell[1] += p[1];
+                    pCell[2] += p[2];
+                    pCell[3] += 1.0f;
+                }
+            }
+        free(pRows);
+
+        // Blur along intensity, x and y.
+        if (!BlurAxis(pGrid, gh * gw, gd, 4) ||
+            !BlurAxis(pGrid, gh, gw, depth) ||
+            !BlurAxis(pGrid, 1, gh, stride))
+        {
+            free(pGrid);
+            return false;
+        }
+
+        // Slice: trilinear interpolation of the grid at each pixel,
+        // color is the sum of values over the sum of weights.
+        #pragma omp parallel for
+        for (int y = 0; y < h; y++)
+        {
+            const unsigned char * pIn = pSrc + (size_t) y * w * 4;
+            unsigned char * pOut = pDst + (size_t) y * w * 4;
+            float fy = (y0 + y) * ss;
+            int gy = (int) fy;
+            float dy = fy - gy;
+            gy += GRID_PAD - base;
+            for (int x = 0; x < w; x++)
+            {
+                float fx = x * ss + GRID_PAD;
+                float fz = Luma(pIn + 4 * x) * sr + GRID_PAD;
+                int gx = (int) fx, gz = (int) fz;
+                float dx = fx - gx, dz = fz - gz;
+
+                // Cells of both intensities are adjacent, 8 floats
+                // of each of 4 corners in x, y are read at once.
+                const float * q00 = pGrid + gy * stride + gx * depth + 4 * gz;
+                const float * q01 = q00 + depth, * q10 = q00 + stride, * q11 = q10 + depth;
+                float w00 = (1.0f - dx) * (1.0f - dy), w01 = dx * (1.0f - dy);
+                float w10 = (1.0f - dx) * dy, w11 = dx * dy;
+                float acc[4];
+                #pragma omp simd
+                for (int k = 0; k < 4; k++)
+                    acc[k] = (1.0f - dz) * (w00 * q00[k] + w01 * q01[k] + w10 * q10[k] + w11 * q11[k]) +
+                             dz * (w00 * q00[k + 4] + w01 * q01[k + 4] + w10 * q10[k + 4] + w11 * q11[k + 4]);
+
+                // The weight is never zero near the pixel's own cell.
+                float scale = acc[3] > 0.0f ? 1.0f / acc[3] : 0.0f;
+                for (int k = 0; k < 3; k++)
+                {
+                    float v = acc[k] * scale + 0.5f;
+                    pOut[4 * x + k] = (unsigned char) (v > 255.0f ? 255.0f : v);
+                }
+                pOut[4 * x + 3] = 255;
+            }
+        }
+
+        free(pGrid);
+
+        return true;
+    }
+
+    bool Host_BilateralGrid(const unsigned char * pSrc, unsigned char * pDst, int w, int h,
+                            float sigmaSpatial, float sigmaRange)
+    {
+        return Host_BilateralGridRows(pSrc, pDst, w, h, 0, sigmaSpatial, sigmaRange);
+    }
+};
@@ -1,50 +1,86 @@
 #include "Convolution.h"
+#include "HostFilters.h"
 
 #include "glew.h"
 
 #include <cuda_runtime.h>
 #include <cuda_gl_interop.h>
 
+#include <stdlib.h>
+
+// The largest radius, which weights fit into constant memory;
+// weights of larger radii are read from global memory.
+#define MAX_RADIUS 128
+
 texture<uchar4, 2, cudaReadModeNormalizedFloat> texRGBA;
 
+// Normalized Gaussian weights, computed once per radius.
+__constant__ float c_Weights[2 * MAX_RADIUS + 1];
+
 uchar4    *g_pOutRGBA = NULL;
+float4    *g_pTmpRGBA = NULL;
 cudaArray *g_pInRGBA = NULL;
 unsigned   int g_pbo = 0;
 
 static unsigned int g_W = 0;
 static unsigned int g_H = 0;
+static int g_WeightsRadius = -1;
 
-#define SQR(x) ((x) * (x))
+// Weights of radius above MAX_RADIUS and their capacity.
+static float * g_pWeights = NULL;
+static int g_WeightsSize = 0;
+
+// Weight i from constant memory, or from pWeights if it is not NULL.
+__device__ inline float Weight(const float * pWeights, int i)
+{
+    return pWeights ? pWeights[i] : c_Weights[i];
+}
 
-__global__ void GaussianBlur(uchar4 * pOut, int w, int h, int r, float sigma)
+// Horizontal pass: 2r+1 taps along the row (edges are clamped by texture).
+__global__ void GaussianBlurRows(float4 * pOut, int w, int h, int r, const float * pWeights)
 {
     int idx = threadIdx.x + blockIdx.x * blockDim.x;
     int idy = threadIdx.y + blockIdx.y * blockDim.y;
 
     if (idx < w && idy < h)
     {
-        // float4 colorSum  = {0.0f, 0.0f, 0.0f, 0.0f}; // uncomment to perform bluring over alpha 
-        float4 colorSum  = {0.0f, 0.0f, 0.0f, 1.0f};
+        float4 colorSum = {0.0f, 0.0f, 0.0f, 1.0f};
 
-        float  weightSum = 0.0f;
+        for (int i = -r; i <= r; i++)
+        {
+            float  weight = Weight(pWeights, i + r);
+            float4 ic = tex2D( texRGBA, (float) (idx + i), (float) idy );
 
-        for (float ix = -r; ix <= r; ix++)
-            for (float iy = -r; iy <= r; iy++)
-            {
-                float weight = exp( -(SQR(ix)+SQR(iy)) / SQR(sigma) );
-                float4 ic = tex2D( texRGBA, (float) idx + ix, float (idy) + iy );
+            colorSum.x += ic.x * weight;
+            colorSum.y += ic.y * weight;
+            colorSum.z += ic.z * weight;
+            // bluring alpha makes no sense
+        }
 
-                colorSum.x += ic.x * weight;
-                colorSum.y += ic.y * weight;
-                colorSum.z += ic.z * weight;
-                // colorSum.w += ic.w * weight; // bluring alpha makes no sense
+        pOut[ idx + idy * w ] = colorSum;
+    }
+}
 
-                weightSum += weight;
-            }
-        colorSum.x /= weightSum;
-        colorSum.y /= weightSum;
-        colorSum.z /= weightSum;
-        // colorSum.w /= weightSum; // bluring alpha makes no sense
+// Vertical pass: 2r+1 taps along the column of the horizontal pass result.
+__global__ void GaussianBlurColumns(uchar4 * pOut, const float4 * pIn, int w, int h, int r, const float * pWeights)
+{
+    int idx = threadIdx.x + blockIdx.x * blockDim.x;
+    int idy = threadIdx.y + blockIdx.y * blockDim.y;
+
+    if (idx < w && idy < h)
+    {
+        float4 colorSum = {0.0f, 0.0f, 0.0f, 1.0f};
+
+        for (int i = -r; i <= r; i++)
+        {
+            int    y = min(max(idy + i, 0), h - 1);
+            float  weight = Weight(pWeights, i + r);
+            float4 ic = pIn[ idx + y * w ];
+
+            colorSum.x += ic.x * weight;
+            colorSum.y += ic.y * weight;
+            colorSum.z += ic.z * weight;
+        }
 
         pOut[ idx + idy * w ] = make_uchar4(colorSum.x*255, 
                                             colorSum.y*255, 
@@ -60,6 +96,7 @@ extern "C"
         cudaChannelFormatDesc desc = cudaCreateChannelDesc<uchar4>();
 
         cudaMalloc( (void **) &g_pOutRGBA, w * h * sizeof(uchar4));
+        cudaMalloc( (void **) &g_pTmpRGBA, w * h * sizeof(float4));
         cudaMallocArray( &g_pInRGBA, &desc, w, h);
 
         cudaMemcpyToArray( g_pInRGBA, 0, 0, pRGBA, w * h * sizeof(uchar4), cudaMemcpyHostToDevice);
@@ -79,6 +116,11 @@ extern "C"
     bool Wrapper_Convolution_Release()
     {
         cudaFree(g_pOutRGBA);
+        cudaFree(g_pTmpRGBA);
+        cudaFree(g_pWeights);
+        g_pWeights = NULL;
+        g_WeightsSize = 0;
+        g_WeightsRadius = -1;
 
         cudaFreeArray(g_pInRGBA);
 
@@ -91,6 +133,43 @@ extern "C"
 
     bool Wrapper_Convolution_Run(int radius)
     {
+        if (radius < 0)
+            return false;
+
+        // Weights are uploaded only when radius changes: to constant
+        // memory, or to global memory if they do not fit.
+        int n = 2 * radius + 1;
+        if (radius != g_WeightsRadius)
+        {
+            float * pHostWeights = (float *)malloc(n * sizeof(float));
+            if (!pHostWeights)
+                return false;
+            GaussianWeights(radius, GAUSSIAN_SIGMA(radius), pHostWeights);
+
+            if (radius <= MAX_RADIUS)
+                cudaMemcpyToSymbol(c_Weights, pHostWeights, n * sizeof(float));
+            else
+            {
+                if (n > g_WeightsSize)
+                {
+                    cudaFree(g_pWeights);
+                    g_WeightsSize = 0;
+                    if (cudaMalloc( (void **) &g_pWeights, n * sizeof(float)) != cudaSuccess)
+                    {
+                        g_pWeights = NULL;
+                        g_WeightsRadius = -1;
+                        free(pHostWeights);
+                        return false;
+                    }
+                    g_WeightsSize = n;
+                }
+                cudaMemcpy(g_pWeights, pHostWeights, n * sizeof(float), cudaMemcpyHostToDevice);
+            }
+            free(pHostWeights);
+            g_WeightsRadius = radius;
+        }
+        const float * pWeights = radius <= MAX_RADIUS ? NULL : g_pWeights;
+
         uchar4 * pPBO = NULL;
 
         cudaGLMapBufferObject( (void **) &pPBO, g_pbo );
@@ -98,11 +177,12 @@ extern "C"
         cudaBindTextureToArray(texRGBA, g_pInRGBA);
 
         dim3 threads(8, 8);
-        dim3 blocks((g_W + g_W%threads.x) / threads.x, 
-                    (g_H + g_H%threads.y) / threads.y);
+        dim3 blocks((g_W + threads.x - 1) / threads.x, 
+                    (g_H + threads.y - 1) / threads.y);
 
 
-        GaussianBlur<<<blocks, threads>>>(pPBO, g_W, g_H, radius, (radius - 1.0f) * 0.5f);
+        GaussianBlurRows<<<blocks, threads>>>(g_pTmpRGBA, g_W, g_H, radius, pWeights);
+        GaussianBlurColumns<<<blocks, threads>>>(pPBO, g_pTmpRGBA, g_W, g_H, radius, pWeights);
         cudaThreadSynchronize();
         
         cudaGLUnmapBufferObject( g_pbo );
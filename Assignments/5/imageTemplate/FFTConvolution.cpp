@@ -0,0 +1,851 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#include "HostFilters.h"
+
+// Transform sizes are powers of 2 in this range.
+#define FFT_MIN_LOG 4
+#define FFT_MAX_LOG 12
+
+// Rows transformed together in the row pass, they are SIMD lanes
+// of the butterflies along the row.
+#define FFT_BLOCK 16
+
+// Columns transformed together in the column pass.
+#define FFT_CHUNK 64
+
+// Costs of the cost model in units of one tap of direct convolution
+// of the pixel: widening of the source row for each kernel row, FFT
+// tile per point and stage, including gathering and accumulation,
+// and the overhead per tile. Transforms of more points do not fit
+// the cache, and their stages cost more.
+#define DIRECT_ROW_COST   5.0f
+#define FFT_POINT_COST    2.6f
+#define FFT_TILE_COST     40000.0f
+#define FFT_CACHE_POINTS  (1 << 18)
+#define FFT_CACHE_PENALTY 1.5f
+
+// The number of cached kernel spectra.
+#define SPECTRUM_CACHE_SIZE 8
+
+#define PI 3.14159265358979323846
+
+static inline int Clamp(int x, int n)
+{
+    return x < 0 ? 0 : (x >= n ? n - 1 : x);
+}
+
+static inline int Log2(int n)
+{
+    int l = 0;
+    while ((1 << l) < n)
+        l++;
+    return l;
+}
+
+// Twiddles and bit reversal of 2D transform of nx x ny real values,
+// its spectrum is ny rows of nc = nx / 2 + 1 complex values.
+typedef struct
+{
+    int     nx, ny, m, nc;  // m = nx / 2 is the size of complex row transform
+    float * pRowRe;         // cos, sin of 2 pi k / m, k < m / 2
+    float * pRowIm;
+    float * pColRe;         // cos, sin of 2 pi k / ny, k < ny / 2
+    float * pColIm;
+    float * pHalfRe;        // cos, sin of 2 pi k / nx, k <= m
+    float * pHalfIm;
+    int *   pRowRev;        // bit reversal of m
+    int *   pColRev;        // bit reversal of ny
+} FFTPlan;
+
+// Complex spectrum in separate planes of real and imaginary parts.
+typedef struct
+{
+    float * pRe;
+    float * pIm;
+} Spectrum;
+
+static void Twiddles(int n, float * pRe, float * pIm, int count)
+{
+    for (int k = 0; k < count; k++)
+    {
+        double a = 2.0 * PI * k / n;
+        pRe[k] = (float) cos(a);
+        pIm[k] = (float) sin(a);
+    }
+}
+
+static void BitReversal(int n, int * pRev)
+{
+    int l = Log2(n);
+    for (int i = 0; i < n; i++)
+    {
+        int r = 0;
+        for (int b = 0; b < l; b++)
+            r |= ((i >> b) & 1) << (l - 1 - b);
+        pRev[i] = r;
+    }
+}
+
+static bool InitPlan(FFTPlan * p, int nx, int ny)
+{
+    p->nx = nx;
+    p->ny = ny;
+    p->m = nx / 2;
+    p->nc = p->m + 1;
+    p->pRowRe = (float *) malloc((p->m + ny + 2 * p->nc) * sizeof(float));
+    p->pRowRev = (int *) malloc((p->m + ny) * sizeof(int));
+    if (!p->pRowRe || !p->pRowRev)
+    {
+        free(p->pRowRe);
+        free(p->pRowRev);
+        return false;
+    }
+    p->pRowIm = p->pRowRe + p->m / 2;
+    p->pColRe = p->pRowIm + p->m / 2;
+    p->pColIm = p->pColRe + ny / 2;
+    p->pHalfRe = p->pColIm + ny / 2;
+    p->pHalfIm = p->pHalfRe + p->nc;
+    p->pColRev = p->pRowRev + p->m;
+
+    Twiddles(p->m, p->pRowRe, p->pRowIm, p->m / 2);
+    Twiddles(ny, p->pColRe, p->pColIm, ny / 2);
+    Twiddles(nx, p->pHalfRe, p->pHalfIm, p->nc);
+    BitReversal(p->m, p->pRowRev);
+    BitReversal(ny, p->pColRev);
+    return true;
+}
+
+static void ReleasePlan(FFTPlan * p)
+{
+    free(p->pRowRe);
+    free(p->pRowRev);
+}
+
+// Transforms of len sequences at once: element k of all of them
+// is the vector of len values at re, im + k * stride, so that each
+// butterfly is the SIMD loop over vectors. Elements are in bit-reversed
+// order, unless pRev is given to put them there. Twiddles are
+// exp(sign * 2 pi i k / n): sign is -1 for forward transform,
+// +1 for inverse one, which is not scaled.
+static void FFTVectors(float * re, float * im, int n, size_t stride, int len,
+                       const float * pTwRe, const float * pTwIm, float sign, const int * pRev)
+{
+    if (pRev)
+        for (int i = 0; i < n; i++)
+        {
+            int j = pRev[i];
+            if (i >= j)
+                continue;
+            float * ar = re + i * stride, * ai = im + i * stride;
+            float * br = re + j * stride, * bi = im + j * stride;
+            #pragma omp simd
+            for (int l = 0; l < len; l++)
+            {
+                float tr = ar[l], ti = ai[l];
+                ar[l] = br[l];
+                ai[l] = bi[l];
+                br[l] = tr;
+                bi[l] = ti;
+            }
+        }
+
+    // A radix-2 stage, when the number of stages is odd.
+    int half = 1;
+    if (Log2(n) & 1)
+    {
+        for (int start = 0; start < n; start += 2)
+        {
+            float * ar = re + start * stride, * ai = im + start * stride;
+            float * br = ar + stride, * bi = ai + stride;
+            #pragma omp simd
+            for (int l = 0; l < len; l++)
+            {
+                float tr = br[l], ti = bi[l];
+                br[l] = ar[l] - tr;
+                bi[l] = ai[l] - ti;
+                ar[l] += tr;
+                ai[l] += ti;
+            }
+        }
+        half = 2;
+    }
+
+    // Radix-4 passes do stages of half and 2 * half at once: a0 .. a3 are
+    // half apart, the first stage pairs a0, a1 and a2, a3 by twiddle w1,
+    // the second one pairs results by w2 and w3 = w2 * exp(sign * pi i / 2).
+    for (; half < n; half *= 4)
+    {
+        int step = n / (4 * half);
+        for (int start = 0; start < n; start += 4 * half)
+            for (int k = 0; k < half; k++)
+            {
+                float w1r = pTwRe[2 * k * step], w1i = sign * pTwIm[2 * k * step];
+                float w2r = pTwRe[k * step], w2i = sign * pTwIm[k * step];
+                float w3r = -sign * w2i, w3i = sign * w2r;
+                float * a0r = re + (start + k) * stride, * a0i = im + (start + k) * stride;
+                float * a1r = a0r + half * stride, * a1i = a0i + half * stride;
+                float * a2r = a1r + half * stride, * a2i = a1i + half * stride;
+                float * a3r = a2r + half * stride, * a3i = a2i + half * stride;
+                #pragma omp simd
+                for (int l = 0; l < len; l++)
+                {
+                    float t1r = a1r[l] * w1r - a1i[l] * w1i, t1i = a1r[l] * w1i + a1i[l] * w1r;
+                    float t3r = a3r[l] * w1r - a3i[l] * w1i, t3i = a3r[l] * w1i + a3i[l] * w1r;
+                    float b0r = a0r[l] + t1r, b0i = a0i[l] + t1i;
+                    float b1r = a0r[l] - t1r, b1i = a0i[l] - t1i;
+                    float b2r = a2r[l] + t3r, b2i = a2i[l] + t3i;
+                    float b3r = a2r[l] - t3r, b3i = a2i[l] - t3i;
+                    float u2r = b2r * w2r - b2i * w2i, u2i = b2r * w2i + b2i * w2r;
+                    float u3r = b3r * w3r - b3i * w3i, u3i = b3r * w3i + b3i * w3r;
+                    a0r[l] = b0r + u2r;
+                    a0i[l] = b0i + u2i;
+                    a2r[l] = b0r - u2r;
+                    a2i[l] = b0i - u2i;
+                    a1r[l] = b1r + u3r;
+                    a1i[l] = b1i + u3i;
+                    a3r[l] = b1r - u3r;
+                    a3i[l] = b1i - u3i;
+                }
+            }
+    }
+}
+
+// Forward transform of rows x nx real values, rows beyond are zero.
+// Each block of rows goes through the scratch, transposed, as the
+// complex sequence z[k] = x[2k] + i x[2k + 1] of length m. Its transform
+// Z gives the spectrum of the real row X[k] = E[k] + W^k O[k],
+// W = exp(-2 pi i / nx), of the even part E[k] = (Z[k] + conj Z[m - k]) / 2
+// and the odd one O[k] = (Z[k] - conj Z[m - k]) / 2i. Returns false,
+// if the scratch of some thread could not be allocated.
+static bool ForwardFFT(const FFTPlan * p, const float * pReal, int rows, Spectrum * s)
+{
+    int m = p->m, nc = p->nc;
+
+    bool ok = true;
+    #pragma omp parallel
+    {
+        float * zr = (float *) malloc(2 * m * FFT_BLOCK * sizeof(float));
+        if (!zr)
+        {
+            #pragma omp atomic write
+            ok = false;
+        }
+        #pragma omp barrier
+
+        bool run;
+        #pragma omp atomic read
+        run = ok;
+
+        if (run)
+        {
+            float * zi = zr + m * FFT_BLOCK;
+
+            #pragma omp for
+            for (int r0 = 0; r0 < rows; r0 += FFT_BLOCK)
+            {
+                int len = rows - r0 < FFT_BLOCK ? rows - r0 : FFT_BLOCK;
+                const float * pIn = pReal + (size_t) r0 * p->nx;
+                for (int k = 0; k < m; k++)
+                {
+                    int i = p->pRowRev[k] * FFT_BLOCK;
+                    for (int r = 0; r < len; r++)
+                    {
+                        zr[i + r] = pIn[r * p->nx + 2 * k];
+                        zi[i + r] = pIn[r * p->nx + 2 * k + 1];
+                    }
+                }
+                FFTVectors(zr, zi, m, FFT_BLOCK, len, p->pRowRe, p->pRowIm, -1.0f, NULL);
+
+                for (int k = 0; k <= m; k++)
+                {
+                    const float * ar = zr + (k % m) * FFT_BLOCK, * ai = zi + (k % m) * FFT_BLOCK;
+                    const float * br = zr + ((m - k) % m) * FFT_BLOCK, * bi = zi + ((m - k) % m) * FFT_BLOCK;
+                    float wr = p->pHalfRe[k], wi = -p->pHalfIm[k];
+                    float * xr = s->pRe + (size_t) r0 * nc + k, * xi = s->pIm + (size_t) r0 * nc + k;
+                    for (int r = 0; r < len; r++)
+                    {
+                        float er = 0.5f * (ar[r] + br[r]), ei = 0.5f * (ai[r] - bi[r]);
+                        float dr = 0.5f * (ar[r] - br[r]), di = 0.5f * (ai[r] + bi[r]);
+                        xr[r * nc] = er + wr * di + wi * dr;
+                        xi[r * nc] = ei + wi * di - wr * dr;
+                    }
+                }
+            }
+
+            #pragma omp for
+            for (int r = rows; r < p->ny; r++)
+            {
+                memset(s->pRe + (size_t) r * nc, 0, nc * sizeof(float));
+                memset(s->pIm + (size_t) r * nc, 0, nc * sizeof(float));
+            }
+
+            // Columns are transformed by chunks of adjacent ones.
+            #pragma omp for
+            for (int c0 = 0; c0 < nc; c0 += FFT_CHUNK)
+                FFTVectors(s->pRe + c0, s->pIm + c0, p->ny, nc, nc - c0 < FFT_CHUNK ? nc - c0 : FFT_CHUNK,
+                           p->pColRe, p->pColIm, -1.0f, p->pColRev);
+        }
+
+        free(zr);
+    }
+    return ok;
+}
+
+// Inverse transform of the spectrum (overwritten) into rows x nx real
+// values, scaled by nx * ny. The row pass undoes the forward one: Z[k] is
+// E[k] + i O[k] of E[k] = X[k] + conj X[m - k], O[k] = (X[k] - conj X[m - k]) W^-k.
+// Returns false, if the scratch of some thread could not be allocated.
+static bool InverseFFT(const FFTPlan * p, Spectrum * s, int rows, float * pReal)
+{
+    int m = p->m, nc = p->nc;
+
+    bool ok = true;
+    #pragma omp parallel
+    {
+        float * zr = (float *) malloc(2 * m * FFT_BLOCK * sizeof(float));
+        if (!zr)
+        {
+            #pragma omp atomic write
+            ok = false;
+        }
+        #pragma omp barrier
+
+        bool run;
+        #pragma omp atomic read
+        run = ok;
+
+        if (run)
+        {
+            float * zi = zr + m * FFT_BLOCK;
+
+            #pragma omp for
+            for (int c0 = 0; c0 < nc; c0 += FFT_CHUNK)
+                FFTVectors(s->pRe + c0, s->pIm + c0, p->ny, nc, nc - c0 < FFT_CHUNK ? nc - c0 : FFT_CHUNK,
+                           p->pColRe, p->pColIm, 1.0f, p->pColRev);
+
+            #pragma omp for
+            for (int r0 = 0; r0 < rows; r0 += FFT_BLOCK)
+            {
+                int len = rows - r0 < FFT_BLOCK ? rows - r0 : FFT_BLOCK;
+                for (int k = 0; k < m; k++)
+                {
+                    const float * ar = s->pRe + (size_t) r0 * nc + k, * ai = s->pIm + (size_t) r0 * nc + k;
+                    const float * br = ar + m - 2 * k, * bi = ai + m - 2 * k;
+                    float wr = p->pHalfRe[k], wi = p->pHalfIm[k];
+                    int i = p->pRowRev[k] * FFT_BLOCK;
+                    for (int r = 0; r < len; r++)
+                    {
+                        float er = ar[r * nc] + br[r * nc], ei = ai[r * nc] - bi[r * nc];
+                        float dr = ar[r * nc] - br[r * nc], di = ai[r * nc] + bi[r * nc];
+                        float or_ = dr * wr - di * wi, oi = dr * wi + di * wr;
+                        zr[i + r] = er - oi;
+                        zi[i + r] = ei + or_;
+                    }
+                }
+                FFTVectors(zr, zi, m, FFT_BLOCK, len, p->pRowRe, p->pRowIm, 1.0f, NULL);
+
+                float * pOut = pReal + (size_t) r0 * p->nx;
+                for (int k = 0; k < m; k++)
+                    for (int r = 0; r < len; r++)
+                    {
+                        pOut[r * p->nx + 2 * k] = zr[k * FFT_BLOCK + r];
+                        pOut[r * p->nx + 2 * k + 1] = zi[k * FFT_BLOCK + r];
+                    }
+            }
+        }
+
+        free(zr);
+    }
+    return ok;
+}
+
+// Spectrum of the kernel for transforms of the plan's size, it is shared
+// by calls, while referenced.
+typedef struct
+{
+    unsigned int hash;
+    int          kw, kh, nx, ny;
+    float *      pKernel;
+    Spectrum     spectrum;      // scaled by 1 / (nx * ny) of the inverse transform
+    int          refs;          // -1 for the spectrum not in cache
+    unsigned int used;
+} KernelSpectrum;
+
+static KernelSpectrum * g_pSpectra[SPECTRUM_CACHE_SIZE];
+static unsigned int     g_SpectraClock = 0;
+
+// FNV-1a hash of the kernel size and weights.
+static unsigned int KernelHash(const float * pKernel, int kw, int kh)
+{
+    unsigned int hash = 2166136261u;
+    int size[2] = { kw, kh };
+    const unsigned char * bytes[2] = { (const unsigned char *) size, (const unsigned char *) pKernel };
+    size_t counts[2] = { sizeof(size), (size_t) kw * kh * sizeof(float) };
+    for (int j = 0; j < 2; j++)
+        for (size_t i = 0; i < counts[j]; i++)
+            hash = (hash ^ bytes[j][i]) * 16777619u;
+    return hash;
+}
+
+static void FreeSpectrum(KernelSpectrum * pEntry)
+{
+    free(pEntry->pKernel);
+    free(pEntry->spectrum.pRe);
+    free(pEntry);
+}
+
+// Find the spectrum in cache and reference it, call inside KernelSpectra.
+static KernelSpectrum * FindSpectrum(unsigned int hash, const float * pKernel, int kw, int kh, int nx, int ny)
+{
+    for (int i = 0; i < SPECTRUM_CACHE_SIZE; i++)
+    {
+        KernelSpectrum * e = g_pSpectra[i];
+        if (e && e->hash == hash && e->kw == kw && e->kh == kh && e->nx == nx && e->ny == ny &&
+            !memcmp(e->pKernel, pKernel, (size_t) kw * kh * sizeof(float)))
+        {
+            e->refs++;
+            e->used = ++g_SpectraClock;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// Take the spectrum from cache, or compute it and put it in place of
+// the least recently used one, which is not referenced.
+static KernelSpectrum * AcquireSpectrum(const FFTPlan * p, const float * pKernel, int kw, int kh)
+{
+    unsigned int hash = KernelHash(pKernel, kw, kh);
+    KernelSpectrum * pEntry;
+    #pragma omp critical (KernelSpectra)
+    pEntry = FindSpectrum(hash, pKernel, kw, kh, p->nx, p->ny);
+    if (pEntry)
+        return pEntry;
+
+    pEntry = (KernelSpectrum *) calloc(1, sizeof(KernelSpectrum));
+    float * pReal = (float *) calloc((size_t) kh * p->nx, sizeof(float));
+    if (pEntry)
+    {
+        pEntry->pKernel = (float *) malloc((size_t) kw * kh * sizeof(float));
+        pEntry->spectrum.pRe = (float *) malloc((size_t) 2 * p->ny * p->nc * sizeof(float));
+    }
+    if (!pEntry || !pReal || !pEntry->pKernel || !pEntry->spectrum.pRe)
+    {
+        if (pEntry)
+            FreeSpectrum(pEntry);
+        free(pReal);
+        return NULL;
+    }
+    pEntry->hash = hash;
+    pEntry->kw = kw;
+    pEntry->kh = kh;
+    pEntry->nx = p->nx;
+    pEntry->ny = p->ny;
+    memcpy(pEntry->pKernel, pKernel, (size_t) kw * kh * sizeof(float));
+    pEntry->spectrum.pIm = pEntry->spectrum.pRe + (size_t) p->ny * p->nc;
+
+    float scale = 1.0f / ((float) p->nx * p->ny);
+    for (int j = 0; j < kh; j++)
+        for (int i = 0; i < kw; i++)
+            pReal[(size_t) j * p->nx + i] = pKernel[j * kw + i] * scale;
+    bool ok = ForwardFFT(p, pReal, kh, &pEntry->spectrum);
+    free(pReal);
+    if (!ok)
+    {
+        FreeSpectrum(pEntry);
+        return NULL;
+    }
+
+    // Another thread may have put the same spectrum meanwhile.
+    KernelSpectrum * pFound;
+    #pragma omp critical (KernelSpectra)
+    {
+        pFound = FindSpectrum(hash, pKernel, kw, kh, p->nx, p->ny);
+        if (!pFound)
+        {
+            int slot = -1;
+            for (int i = 0; i < SPECTRUM_CACHE_SIZE; i++)
+            {
+                KernelSpectrum * e = g_pSpectra[i];
+                if (!e)
+                {
+                    slot = i;
+                    break;
+                }
+                if (!e->refs && (slot < 0 || e->used < g_pSpectra[slot]->used))
+                    slot = i;
+            }
+            pEntry->refs = slot < 0 ? -1 : 1;
+            pEntry->used = ++g_SpectraClock;
+            if (slot >= 0)
+            {
+                if (g_pSpectra[slot])
+                    FreeSpectrum(g_pSpectra[slot]);
+                g_pSpectra[slot] = pEntry;
+            }
+        }
+    }
+    if (pFound)
+    {
+        FreeSpectrum(pEntry);
+        return pFound;
+    }
+    return pEntry;
+}
+
+static void ReleaseSpectrum(KernelSpectrum * pEntry)
+{
+    bool cached;
+    #pragma omp critical (KernelSpectra)
+    {
+        cached = pEntry->refs > 0;
+        if (cached)
+            pEntry->refs--;
+    }
+    if (!cached)
+        FreeSpectrum(pEntry);
+}
+
+// Overlap-add tiling of the image padded by clamped edges: tiles of
+// tx x ty pixels, each transformed at nx x ny with the kernel.
+typedef struct
+{
+    int nx, ny;
+    int tx, ty;
+    int tilesX, tilesY;
+} Tiling;
+
+// Choose the transform size of the least cost, returns the cost in units
+// of one tap of direct convolution, or -1 when the kernel is too large.
+static float ChooseTiling(int w, int h, int kw, int kh, Tiling * t)
+{
+    int lw = w + kw - 1, lh = h + kh - 1;
+    float best = -1.0f;
+    for (int lx = Log2(kw) > FFT_MIN_LOG ? Log2(kw) : FFT_MIN_LOG; lx <= FFT_MAX_LOG; lx++)
+    {
+        int nx = 1 << lx, tx = nx - kw + 1, tilesX = (lw + tx - 1) / tx;
+        for (int ly = Log2(kh) > FFT_MIN_LOG ? Log2(kh) : FFT_MIN_LOG; ly <= FFT_MAX_LOG; ly++)
+        {
+            int ny = 1 << ly, ty = ny - kh + 1, tilesY = (lh + ty - 1) / ty;
+            float stage = nx * ny > FFT_CACHE_POINTS ? FFT_POINT_COST * FFT_CACHE_PENALTY : FFT_POINT_COST;
+            float cost = (float) tilesX * tilesY * ((float) nx * ny * (lx + ly) * stage + FFT_TILE_COST);
+            if (best < 0.0f || cost < best)
+            {
+                best = cost;
+                t->nx = nx;
+                t->ny = ny;
+                t->tx = tx;
+                t->ty = ty;
+                t->tilesX = tilesX;
+                t->tilesY = tilesY;
+            }
+            if (tilesY == 1)
+                break;
+        }
+        if (tilesX == 1)
+            break;
+    }
+    return best;
+}
+
+// The output pixel of the kernel centered at (cx, cy) = (kw / 2, kh / 2)
+// is the full convolution of the padded image P(u, v) = I(u - px, v - py),
+// px = kw - 1 - cx, py = kh - 1 - cy, at (x + kw - 1, y + kh - 1). Tiles
+// of P are convolved by FFT, and the results, kernel size - 1 wider,
+// are added up in the band of rows, which is written out, when all
+// tiles touching it are done.
+static bool ConvolveFFT(const unsigned char * pSrc, unsigned char * pDst, int w, int h,
+                        const float * pKernel, int kw, int kh, const Tiling * t)
+{
+    FFTPlan plan;
+    if (!InitPlan(&plan, t->nx, t->ny))
+        return false;
+    KernelSpectrum * pEntry = AcquireSpectrum(&plan, pKernel, kw, kh);
+
+    int px = kw - 1 - kw / 2, py = kh - 1 - kh / 2;
+    int lw = w + kw - 1, lh = h + kh - 1, bandRows = t->ty + kh - 1;
+    size_t plane = (size_t) t->ny * plan.nc, band = (size_t) bandRows * w;
+    float * pReal = (float *) malloc((size_t) t->ny * t->nx * sizeof(float));
+    float * pWork = (float *) malloc(2 * plane * sizeof(float));
+    float * pBand = (float *) calloc(3 * band, sizeof(float));
+    int * pCols = (int *) malloc(t->tx * sizeof(int));
+    bool ok = pEntry && pReal && pWork && pBand && pCols;
+
+    Spectrum work = { pWork, pWork + plane };
+    for (int ty = 0; ok && ty < t->tilesY; ty++)
+    {
+        int v0 = ty * t->ty, rows = lh - v0 < t->ty ? lh - v0 : t->ty;
+        for (int tx = 0; ok && tx < t->tilesX; tx++)
+        {
+            int u0 = tx * t->tx, cols = lw - u0 < t->tx ? lw - u0 : t->tx;
+            for (int j = 0; j < cols; j++)
+                pCols[j] = Clamp(u0 + j - px, w) * 4;
+
+            // Output columns of the tile, which fall into the image.
+            int j0 = kw - 1 - u0 > 0 ? kw - 1 - u0 : 0;
+            int j1 = w + kw - 1 - u0 < cols + kw - 1 ? w + kw - 1 - u0 : cols + kw - 1;
+
+            for (int c = 0; ok && c < 3; c++)
+            {
+                #pragma omp parallel for
+                for (int r = 0; r < rows; r++)
+                {
+                    const unsigned char * pIn = pSrc + (size_t) Clamp(v0 + r - py, h) * w * 4 + c;
+                    float * q = pReal + (size_t) r * t->nx;
+                    for (int j = 0; j < cols; j++)
+                        q[j] = pIn[pCols[j]];
+                    memset(q + cols, 0, (t->nx - cols) * sizeof(float));
+                }
+
+                if (!ForwardFFT(&plan, pReal, rows, &work))
+                {
+                    ok = false;
+                    break;
+                }
+
+                const float * kr = pEntry->spectrum.pRe, * ki = pEntry->spectrum.pIm;
+                #pragma omp parallel for
+                for (int r = 0; r < t->ny; r++)
+                {
+                    float * sr = work.pRe + (size_t) r * plan.nc, * si = work.pIm + (size_t) r * plan.nc;
+                    const float * ar = kr + (size_t) r * plan.nc, * ai = ki + (size_t) r * plan.nc;
+                    #pragma omp simd
+                    for (int k = 0; k < plan.nc; k++)
+                    {
+                        float re = sr[k] * ar[k] - si[k] * ai[k];
+                        si[k] = sr[k] * ai[k] + si[k] * ar[k];
+                        sr[k] = re;
+                    }
+                }
+
+                if (!InverseFFT(&plan, &work, rows + kh - 1, pReal))
+                {
+                    ok = false;
+                    break;
+                }
+
+                #pragma omp parallel for
+                for (int r = 0; r < rows + kh - 1; r++)
+                {
+                    float * b = pBand + c * band + (size_t) r * w;
+                    const float * q = pReal + (size_t) r * t->nx;
+                    #pragma omp simd
+                    for (int j = j0; j < j1; j++)
+                        b[u0 + j - (kw - 1)] += q[j];
+                }
+            }
+        }
+
+        if (!ok)
+            break;
+
+        // Rows of the band above the next one are complete.
+        #pragma omp parallel for
+        for (int r = 0; r < t->ty; r++)
+        {
+            int y = v0 + r - (kh - 1);
+            if (y < 0 || y >= h)
+                continue;
+            unsigned char * pOut = pDst + (size_t) y * w * 4;
+            for (int x = 0; x < w; x++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    float v = pBand[c * band + (size_t) r * w + x] + 0.5f;
+                    pOut[4 * x + c] = (unsigned char) (v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v));
+                }
+                pOut[4 * x + 3] = 255;
+            }
+        }
+        for (int c = 0; c < 3; c++)
+        {
+            float * b = pBand + c * band;
+            memmove(b, b + (size_t) t->ty * w, (size_t) (kh - 1) * w * sizeof(float));
+            memset(b + (size_t) (kh - 1) * w, 0, (size_t) t->ty * w * sizeof(float));
+        }
+    }
+
+    if (pEntry)
+        ReleaseSpectrum(pEntry);
+    ReleasePlan(&plan);
+    free(pReal);
+    free(pWork);
+    free(pBand);
+    free(pCols);
+    return ok;
+}
+
+// Direct convolution: each source row is widened to floats with clamped
+// margins, then every nonzero tap is the contiguous multiply-add over
+// all channels of the row. Returns false, if the row buffers of some
+// thread could not be allocated.
+static bool ConvolveDirect(const unsigned char * pSrc, unsigned char * pDst, int w, int h,
+                           const float * pKernel, int kw, int kh)
+{
+    int px = kw - 1 - kw / 2, py = kh - 1 - kh / 2;
+    int n = 4 * w;
+
+    bool ok = true;
+    #pragma omp parallel
+    {
+        float * pRow = (float *) malloc((size_t) (w + kw - 1) * 4 * sizeof(float));
+        float * pAcc = (float *) malloc((size_t) n * sizeof(float));
+        if (!pRow || !pAcc)
+        {
+            #pragma omp atomic write
+            ok = false;
+        }
+        #pragma omp barrier
+
+        bool run;
+        #pragma omp atomic read
+        run = ok;
+
+        if (run)
+        {
+            #pragma omp for
+            for (int y = 0; y < h; y++)
+            {
+                memset(pAcc, 0, n * sizeof(float));
+                for (int j = 0; j < kh; j++)
+                {
+                    const float * k = pKernel + j * kw;
+                    int i0 = 0;
+                    while (i0 < kw && k[i0] == 0.0f)
+                        i0++;
+                    if (i0 == kw)
+                        continue;
+
+                    const unsigned char * pIn = pSrc + (size_t) Clamp(y + kh - 1 - j - py, h) * n;
+                    for (int u = 0; u < w + kw - 1; u++)
+                        for (int c = 0; c < 4; c++)
+                            pRow[4 * u + c] = pIn[4 * Clamp(u - px, w) + c];
+
+                    for (int i = i0; i < kw; i++)
+                    {
+                        if (k[i] == 0.0f)
+                            continue;
+                        const float * q = pRow + 4 * (kw - 1 - i);
+                        float weight = k[i];
+                        #pragma omp simd
+                        for (int t = 0; t < n; t++)
+                            pAcc[t] += weight * q[t];
+                    }
+                }
+
+                unsigned char * pOut = pDst + (size_t) y * n;
+                for (int t = 0; t < n; t++)
+                {
+                    float v = pAcc[t] + 0.5f;
+                    pOut[t] = (unsigned char) (v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v));
+                }
+                for (int x = 0; x < w; x++)
+                    pOut[4 * x + 3] = 255;
+            }
+        }
+
+        free(pRow);
+        free(pAcc);
+    }
+    return ok;
+}
+
+extern "C"
+{
+    bool Host_Convolve(const unsigned char * pSrc, unsigned char * pDst, int w, int h,
+                       const float * pKernel, int kw, int kh, int method)
+    {
+        if (w <= 0 || h <= 0 || kw <= 0 || kh <= 0 ||
+            method < CONVOLVE_AUTO || method > CONVOLVE_FFT)
+            return false;
+
+        // Direct convolution costs a tap per nonzero weight,
+        // and widening of a row per nonzero row of weights.
+        float taps = 0.0f;
+        for (int j = 0; j < kh; j++)
+        {
+            int nonzero = 0;
+            for (int i = 0; i < kw; i++)
+                nonzero += pKernel[j * kw + i] != 0.0f;
+            taps += nonzero + (nonzero ? DIRECT_ROW_COST : 0.0f);
+        }
+
+        Tiling tiling;
+        float cost = ChooseTiling(w, h, kw, kh, &tiling);
+        if (method == CONVOLVE_FFT && cost < 0.0f)
+            return false;
+        if (method == CONVOLVE_FFT ||
+            (method == CONVOLVE_AUTO && cost >= 0.0f && cost < taps * w * h))
+            return ConvolveFFT(pSrc, pDst, w, h, pKernel, kw, kh, &tiling);
+
+        return ConvolveDirect(pSrc, pDst, w, h, pKernel, kw, kh);
+    }
+
+    int MotionBlurKernel(float length, float angle, float * pKernel)
+    {
+        int n = 2 * (int) ceilf(0.5f * length) + 1;
+        if (!pKernel)
+            return n;
+
+        // Points 1/4 pixel apart along the segment through the center
+        // are splatted by bilinear weights.
+        memset(pKernel, 0, (size_t) n * n * sizeof(float));
+        float a = angle * (float) (PI / 180.0), dx = cosf(a), dy = sinf(a);
+        int samples = (int) ceilf(4.0f * length) + 1;
+        for (int s = 0; s < samples; s++)
+        {
+            float d = samples > 1 ? length * ((float) s / (samples - 1) - 0.5f) : 0.0f;
+            float x = n / 2 + d * dx, y = n / 2 + d * dy;
+            int x0 = (int) floorf(x), y0 = (int) floorf(y);
+            float fx = x - x0, fy = y - y0;
+            for (int j = 0; j < 2; j++)
+                for (int i = 0; i < 2; i++)
+                    if (x0 + i < n && y0 + j < n)
+                        pKernel[(y0 + j) * n + x0 + i] += (i ? fx : 1.0f - fx) * (j ? fy : 1.0f - fy);
+        }
+        float sum = 0.0f;
+        for (int i = 0; i < n * n; i++)
+            sum += pKernel[i];
+        for (int i = 0; i < n * n; i++)
+            pKernel[i] /= sum;
+        return n;
+    }
+
+    int DiskKernel(float radius, float * pKernel)
+    {
+        int n = 2 * (int) ceilf(radius) + 1;
+        if (!pKernel)
+            return n;
+
+        // The area of each pixel inside the disk, by 4 x 4 samples.
+        float sum = 0.0f;
+        for (int y = 0; y < n; y++)
+            for (int x = 0; x < n; x++)
+            {
+                int inside = 0;
+                for (int j = 0; j < 4; j++)
+                    for (int i = 0; i < 4; i++)
+                    {
+                        float dx = x - n / 2 + (i + 0.5f) / 4 - 0.5f;
+                        float dy = y - n / 2 + (j + 0.5f) / 4 - 0.5f;
+                        inside += dx * dx + dy * dy <= radius * radius;
+                    }
+                pKernel[y * n + x] = (float) inside;
+                sum += inside;
+            }
+
+        // The disk smaller than samples degenerates to the identity.
+        if (sum == 0.0f)
+        {
+            pKernel[n / 2 * n + n / 2] = 1.0f;
+            sum = 1.0f;
+        }
+        for (int i = 0; i < n * n; i++)
+            pKernel[i] /= sum;
+        return n;
+    }
+};
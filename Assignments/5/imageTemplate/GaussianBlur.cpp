@@ -0,0 +1,150 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HostFilters.h"
+
+// Convert the blurred row of 4 * w floats into RGBA bytes.
+static void StoreRow(const float * pAcc, unsigned char * pDst, int w)
+{
+    #pragma omp simd
+    for (int i = 0; i < 4 * w; i++)
+    {
+        float c = pAcc[i] + 0.5f;
+        c = c < 0.0f ? 0.0f : (c > 255.0f ? 255.0f : c);
+        pDst[i] = (unsigned char) c;
+    }
+    for (int x = 0; x < w; x++)
+        pDst[4 * x + 3] = 255;
+}
+
+extern "C"
+{
+    int GaussianWeights(int radius, float sigma, float * pWeights)
+    {
+        int n = 2 * radius + 1;
+
+        // Zero sigma degenerates to the identity.
+        if (sigma <= 0.0f)
+        {
+            for (int i = 0; i < n; i++)
+                pWeights[i] = (i == radius) ? 1.0f : 0.0f;
+            return n;
+        }
+
+        float sum = 0.0f;
+        for (int i = 0; i < n; i++)
+        {
+            float x = (float) (i - radius);
+            pWeights[i] = expf(-x * x / (sigma * sigma));
+            sum += pWeights[i];
+        }
+        for (int i = 0; i < n; i++)
+            pWeights[i] /= sum;
+
+        return n;
+    }
+
+    bool Host_GaussianBlur(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int radius)
+    {
+        if (w <= 0 || h <= 0 || radius < 0)
+            return false;
+
+        if (radius > GAUSSIAN_IIR_RADIUS)
+            return Host_RecursiveGaussianBlur(pSrc, pDst, w, h, GAUSSIAN_SIGMA(radius));
+
+        return Host_SeparableGaussianBlur(pSrc, pDst, w, h, radius, GAUSSIAN_SIGMA(radius));
+    }
+
+    bool Host_SeparableGaussianBlur(const unsigned char * pSrc, unsigned char * pDst, int w, int h,
+                                    int radius, float sigma)
+    {
+        if (w <= 0 || h <= 0 || radius < 0)
+            return false;
+
+        int n = 2 * radius + 1;
+        float * pWeights = (float *) malloc(n * sizeof(float));
+        float * pTmp = (float *) malloc((size_t) w * h * 4 * sizeof(float));
+        if (!pWeights || !pTmp)
+        {
+            free(pWeights);
+            free(pTmp);
+            return false;
+        }
+        GaussianWeights(radius, sigma, pWeights);
+
+        // Row and accumulator buffers are allocated once per thread;
+        // if any allocation fails, all threads skip both passes.
+        bool ok = true;
+        #pragma omp parallel
+        {
+            float * pRow = (float *) malloc((size_t) (w + 2 * radius) * 4 * sizeof(float));
+            float * pAcc = (float *) malloc((size_t) w * 4 * sizeof(float));
+            if (!pRow || !pAcc)
+            {
+                #pragma omp atomic write
+                ok = false;
+            }
+            #pragma omp barrier
+
+            bool run;
+            #pragma omp atomic read
+            run = ok;
+
+            // Horizontal pass: each row is widened to floats with clamped
+            // margins, then every tap is the contiguous multiply-add
+            // over all channels of the row.
+            if (run)
+            {
+                #pragma omp for
+                for (int y = 0; y < h; y++)
+                {
+                    const unsigned char * pIn = pSrc + (size_t) y * w * 4;
+                    for (int x = -radius; x < w + radius; x++)
+                    {
+                        const unsigned char * p = pIn + 4 * (x < 0 ? 0 : (x >= w ? w - 1 : x));
+                        float * q = pRow + 4 * (x + radius);
+                        q[0] = p[0]; q[1] = p[1]; q[2] = p[2]; q[3] = p[3];
+                    }
+
+                    float * pOut = pTmp + (size_t) y * w * 4;
+                    memset(pOut, 0, (size_t) w * 4 * sizeof(float));
+                    for (int k = 0; k < n; k++)
+                    {
+                        const float * pTap = pRow + 4 * k;
+                        float weight = pWeights[k];
+                        #pragma omp simd
+                        for (int i = 0; i < 4 * w; i++)
+                            pOut[i] += weight * pTap[i];
+                    }
+                }
+
+                // Vertical pass: the sum of weighted rows, clamped at edges.
+                #pragma omp for
+                for (int y = 0; y < h; y++)
+                {
+                    memset(pAcc, 0, (size_t) w * 4 * sizeof(float));
+                    for (int k = 0; k < n; k++)
+                    {
+                        int yy = y + k - radius;
+                        yy = yy < 0 ? 0 : (yy >= h ? h - 1 : yy);
+                        const float * pTap = pTmp + (size_t) yy * w * 4;
+                        float weight = pWeights[k];
+                        #pragma omp simd
+                        for (int i = 0; i < 4 * w; i++)
+                            pAcc[i] += weight * pTap[i];
+                    }
+                    StoreRow(pAcc, pDst + (size_t) y * w * 4, w);
+                }
+            }
+
+            free(pRow);
+            free(pAcc);
+        }
+
+        free(pWeights);
+        free(pTmp);
+
+        return ok;
+    }
+};
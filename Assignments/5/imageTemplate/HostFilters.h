@@ -0,0 +1,114 @@
+#ifndef _HOST_FILTERS_H_
+#define _HOST_FILTERS_H_
+
+// Gaussian sigma used for the given blur radius.
+#define GAUSSIAN_SIGMA(radius) (((radius) - 1.0f) * 0.5f)
+
+// The radius, above which the recursive filter is used.
+#define GAUSSIAN_IIR_RADIUS 16
+
+// The smallest sigma of the recursive filter, below it the recursive
+// Gaussian is computed by the separable one of GAUSSIAN_FIR_RADIUS.
+#define GAUSSIAN_IIR_MIN_SIGMA 6.0f
+
+// The radius of separable Gaussian of sigma, beyond which weights
+// are below 1e-4 of the peak.
+#define GAUSSIAN_FIR_RADIUS(sigma) ((int) ceilf(3.0f * (sigma)))
+
+// Rows, beyond which the recursive filter of sigma is negligible,
+// its impulse response is about 1e-4 of the peak there.
+#define GAUSSIAN_IIR_HALO(sigma) ((int) ceilf(3.0f * (sigma)) + 3)
+
+// The number of box blurs approximating Gaussian.
+#define BOX_GAUSSIAN_PASSES 3
+
+// The largest radius of median filter: counts of its window fit 16 bits.
+#define MEDIAN_MAX_RADIUS 127
+
+// Methods of Host_Convolve.
+#define CONVOLVE_AUTO   0       // the cheaper one by the cost model
+#define CONVOLVE_DIRECT 1
+#define CONVOLVE_FFT    2
+
+extern "C"
+{
+    // Fill 2 * radius + 1 weights exp(-x^2 / sigma^2), x = -radius .. radius,
+    // normalized to the unit sum. Returns the number of weights.
+    int GaussianWeights(int radius, float sigma, float * pWeights);
+
+    // Blur w x h RGBA image by separable Gaussian of the given radius,
+    // horizontal pass, then vertical one, with edges clamped.
+    // Radius above GAUSSIAN_IIR_RADIUS is handled by the recursive filter.
+    // Alpha is set to 255, like in the CUDA version.
+    bool Host_GaussianBlur(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int radius);
+
+    // The same by separable Gaussian of the given radius and sigma.
+    bool Host_SeparableGaussianBlur(const unsigned char * pSrc, unsigned char * pDst, int w, int h,
+                                    int radius, float sigma);
+
+    // Blur w x h RGBA image by recursive Gaussian of the given sigma
+    // (in terms of GaussianWeights), at the cost independent of sigma.
+    // Sigma below GAUSSIAN_IIR_MIN_SIGMA is handled by the separable filter.
+    bool Host_RecursiveGaussianBlur(const unsigned char * pSrc, unsigned char * pDst, int w, int h, float sigma);
+
+    // Compute summed-area table of w x h RGBA image: (w + 1) x (h + 1)
+    // sums of 4 channels, the first row and column are zero. The sum over
+    // [x0, x1) x [y0, y1) is S(x1, y1) - S(x1, y0) - S(x0, y1) + S(x0, y0)
+    // in unsigned arithmetic, correct while it fits 32 bits.
+    bool Host_IntegralImage(const unsigned char * pSrc, int w, int h, unsigned int * pSAT);
+
+    // Average the square window of the given radius around each pixel,
+    // cropped by image edges, at the cost independent of radius.
+    bool Host_BoxBlur(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int radius);
+
+    // Approximate Gaussian blur of the given sigma by 3 box blurs.
+    bool Host_BoxGaussianBlur(const unsigned char * pSrc, unsigned char * pDst, int w, int h, float sigma);
+
+    // Fill BOX_GAUSSIAN_PASSES odd widths of box blurs approximating
+    // Gaussian of sigma.
+    void BoxGaussianWidths(float sigma, int * pWidths);
+
+    // The total radius of box blurs approximating Gaussian of sigma.
+    int BoxGaussianRadius(float sigma);
+
+    // Edge-preserving blur by the bilateral grid (Chen, Paris, Durand, 2007):
+    // Gaussians of standard deviations sigmaSpatial in pixels and sigmaRange
+    // in levels of intensity. The image is splatted into the grid of cells
+    // sigma apart, blurred there and sliced back, so the cost per pixel
+    // does not depend on sigma.
+    bool Host_BilateralGrid(const unsigned char * pSrc, unsigned char * pDst, int w, int h,
+                            float sigmaSpatial, float sigmaRange);
+
+    // The same for w x h strip of image rows y0 .. y0 + h - 1: cells are
+    // aligned to image row 0, so rows of the strip, which have
+    // BilateralGridRadius rows of the strip around them, match the ones
+    // of the whole image.
+    bool Host_BilateralGridRows(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int y0,
+                                float sigmaSpatial, float sigmaRange);
+
+    // Rows around the output row, which the bilateral grid reads.
+    int BilateralGridRadius(float sigmaSpatial);
+
+    // Median of each channel over the square window of the given radius,
+    // with edges clamped. Radius 1 is done by the sorting network, larger
+    // ones by sliding histograms at the cost independent of radius.
+    bool Host_MedianFilter(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int radius);
+
+    // Convolve w x h RGBA image with kw x kh weights, rows bottom-up like
+    // in the image, the kernel is centered at (kw / 2, kh / 2), edges are
+    // clamped. Direct convolution costs a multiply-add per nonzero weight
+    // and pixel, FFT one of overlapping tiles about log(tile size), spectra
+    // of recent kernels are cached for the same tiling of equal images.
+    bool Host_Convolve(const unsigned char * pSrc, unsigned char * pDst, int w, int h,
+                       const float * pKernel, int kw, int kh, int method);
+
+    // Point spread function of the linear motion by length pixels at angle
+    // in degrees counterclockwise. Returns the kernel size n, and fills
+    // n x n weights of unit sum, unless pKernel is NULL.
+    int MotionBlurKernel(float length, float angle, float * pKernel);
+
+    // Point spread function of defocus: the disk of radius, as above.
+    int DiskKernel(float radius, float * pKernel);
+}
+
+#endif
@@ -0,0 +1,351 @@
+#ifndef _HOST_FILTERS_TEST_H_
+#define _HOST_FILTERS_TEST_H_
+
+// Self-check of host filters on random images: convolution by FFT is
+// compared to the direct one, and direct convolution, box blur, median
+// filter and Gaussian blur to brute force sums over their windows,
+// recursive Gaussian to the exact one, and the bilateral grid to the
+// direct bilateral filter and to itself by strips of rows. Each case
+// prints the maximum difference in levels, which must not exceed the
+// tolerance (rounding of float sums, exact for median and strips).
+
+#include "HostFilters.h"
+
+// The maximum difference of filters computed in float.
+#define FILTER_TEST_TOLERANCE 1
+
+// The maximum difference of the recursive Gaussian from the exact one.
+#define FILTER_TEST_IIR_TOLERANCE 2
+
+// The maximum difference of the bilateral grid from the direct bilateral
+// filter on the noisy step.
+#define FILTER_TEST_BILATERAL_TOLERANCE 8
+
+static inline int TestClamp(int x, int n)
+{
+    return x < 0 ? 0 : (x >= n ? n - 1 : x);
+}
+
+static inline unsigned char TestRound(double v)
+{
+    v = floor(v + 0.5);
+    return (unsigned char) (v < 0.0 ? 0.0 : (v > 255.0 ? 255.0 : v));
+}
+
+// Convolution with kw x kh weights centered at (kw / 2, kh / 2),
+// with edges clamped, as Host_Convolve does it.
+static void TestConvolve(const unsigned char * pSrc, unsigned char * pDst, int w, int h,
+                         const float * pKernel, int kw, int kh)
+{
+    int cx = kw / 2, cy = kh / 2;
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                double sum = 0;
+                for (int j = 0; j < kh; j++)
+                    for (int i = 0; i < kw; i++)
+                        sum += pKernel[j * kw + i] *
+                            pSrc[4 * ((size_t) TestClamp(y + cy - j, h) * w + TestClamp(x + cx - i, w)) + c];
+                pDst[4 * ((size_t) y * w + x) + c] = TestRound(sum);
+            }
+            pDst[4 * ((size_t) y * w + x) + 3] = 255;
+        }
+}
+
+// Average of the window, cropped by image edges.
+static void TestBox(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int radius)
+{
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            int ya = y - radius < 0 ? 0 : y - radius, yb = y + radius >= h ? h - 1 : y + radius;
+            int xa = x - radius < 0 ? 0 : x - radius, xb = x + radius >= w ? w - 1 : x + radius;
+            for (int c = 0; c < 3; c++)
+            {
+                double sum = 0;
+                for (int yy = ya; yy <= yb; yy++)
+                    for (int xx = xa; xx <= xb; xx++)
+                        sum += pSrc[4 * ((size_t) yy * w + xx) + c];
+                pDst[4 * ((size_t) y * w + x) + c] = TestRound(sum / ((xb - xa + 1) * (yb - ya + 1)));
+            }
+            pDst[4 * ((size_t) y * w + x) + 3] = 255;
+        }
+}
+
+// Box blurs of BoxGaussianWidths in turn, each one rounded to levels.
+static void TestBoxGaussian(const unsigned char * pSrc, unsigned char * pDst, unsigned char * pTmp,
+                            int w, int h, float sigma)
+{
+    int widths[BOX_GAUSSIAN_PASSES];
+    BoxGaussianWidths(sigma, widths);
+    const unsigned char * pIn = pSrc;
+    for (int i = 0; i < BOX_GAUSSIAN_PASSES; i++)
+    {
+        unsigned char * pOut = (i % 2 == 0) ? pDst : pTmp;
+        TestBox(pIn, pOut, w, h, (widths[i] - 1) / 2);
+        pIn = pOut;
+    }
+}
+
+// Median of the window by counting, with edges clamped.
+static void TestMedian(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int radius)
+{
+    int half = (2 * radius + 1) * (2 * radius + 1) / 2;
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                int counts[256] = { 0 };
+                for (int j = -radius; j <= radius; j++)
+                    for (int i = -radius; i <= radius; i++)
+                        counts[pSrc[4 * ((size_t) TestClamp(y + j, h) * w + TestClamp(x + i, w)) + c]]++;
+                int v = 0;
+                for (int sum = counts[0]; sum <= half; sum += counts[++v]);
+                pDst[4 * ((size_t) y * w + x) + c] = (unsigned char) v;
+            }
+            pDst[4 * ((size_t) y * w + x) + 3] = 255;
+        }
+}
+
+// Gaussian of GaussianWeights of radius and sigma, rows, then columns
+// summed in double, with edges clamped.
+static void TestGaussian(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int radius, float sigma)
+{
+    float * pWeights = (float *) malloc((2 * radius + 1) * sizeof(float));
+    double * pRows = (double *) malloc((size_t) w * h * 3 * sizeof(double));
+    GaussianWeights(radius, sigma, pWeights);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            for (int c = 0; c < 3; c++)
+            {
+                double sum = 0;
+                for (int i = -radius; i <= radius; i++)
+                    sum += pWeights[i + radius] * pSrc[4 * ((size_t) y * w + TestClamp(x + i, w)) + c];
+                pRows[3 * ((size_t) y * w + x) + c] = sum;
+            }
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                double sum = 0;
+                for (int j = -radius; j <= radius; j++)
+                    sum += pWeights[j + radius] * pRows[3 * ((size_t) TestClamp(y + j, h) * w + x) + c];
+                pDst[4 * ((size_t) y * w + x) + c] = TestRound(sum);
+            }
+            pDst[4 * ((size_t) y * w + x) + 3] = 255;
+        }
+    free(pWeights);
+    free(pRows);
+}
+
+static inline int TestLuma(const unsigned char * p)
+{
+    return (77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8;
+}
+
+// Direct bilateral filter: Gaussian weights of the distance and of the
+// difference of intensities, over the window of 3 sigma cropped by edges.
+static void TestBilateral(const unsigned char * pSrc, unsigned char * pDst, int w, int h,
+                          float sigmaSpatial, float sigmaRange)
+{
+    int radius = (int) ceilf(3.0f * sigmaSpatial);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            const unsigned char * pCenter = pSrc + 4 * ((size_t) y * w + x);
+            double sum[4] = { 0, 0, 0, 0 };
+            for (int j = -radius; j <= radius; j++)
+                for (int i = -radius; i <= radius; i++)
+                {
+                    if (y + j < 0 || y + j >= h || x + i < 0 || x + i >= w)
+                        continue;
+                    const unsigned char * p = pSrc + 4 * ((size_t) (y + j) * w + x + i);
+                    double d = TestLuma(p) - TestLuma(pCenter);
+                    double weight = exp(-(i * i + j * j) / (2.0 * sigmaSpatial * sigmaSpatial) -
+                                        d * d / (2.0 * sigmaRange * sigmaRange));
+                    for (int c = 0; c < 3; c++)
+                        sum[c] += weight * p[c];
+                    sum[3] += weight;
+                }
+            for (int c = 0; c < 3; c++)
+                pDst[4 * ((size_t) y * w + x) + c] = TestRound(sum[c] / sum[3]);
+            pDst[4 * ((size_t) y * w + x) + 3] = 255;
+        }
+}
+
+// Bilateral grid of the image by strips of rows: each one is filtered
+// with BilateralGridRadius rows around it, as in strip mode.
+static bool TestBilateralStrips(const unsigned char * pSrc, unsigned char * pDst, unsigned char * pTmp,
+                                int w, int h, int rows, float sigmaSpatial, float sigmaRange)
+{
+    int halo = BilateralGridRadius(sigmaSpatial);
+    for (int a = 0; a < h; a += rows)
+    {
+        int b = a + rows < h ? a + rows : h;
+        int ya = a - halo < 0 ? 0 : a - halo, yb = b + halo > h ? h : b + halo;
+        if (!Host_BilateralGridRows(pSrc + (size_t) ya * w * 4, pTmp, w, yb - ya, ya, sigmaSpatial, sigmaRange))
+            return false;
+        memcpy(pDst + (size_t) a * w * 4, pTmp + (size_t) (a - ya) * w * 4, (size_t) (b - a) * w * 4);
+    }
+    return true;
+}
+
+// Print the case and its maximum difference, returns 1 if it failed.
+static int TestReport(const char * name, int w, int h, const char * param,
+                      bool ok, const unsigned char * pOut, const unsigned char * pRef, int tolerance)
+{
+    int diff = 0;
+    for (size_t i = 0; ok && i < (size_t) w * h * 4; i++)
+    {
+        int d = abs(pOut[i] - pRef[i]);
+        if (d > diff)
+            diff = d;
+    }
+    bool passed = ok && diff <= tolerance;
+    printf("%s\t%dx%d\t%s\t%s\t%d\n", name, w, h, param, passed ? "PASSED" : "FAILED", diff);
+    fflush(stdout);
+    return !passed;
+}
+
+// Run all cases, returns EXIT_SUCCESS if all of them passed.
+static int HostFilters_Test(void)
+{
+    static const int sizes[][2] = { { 1, 1 }, { 37, 61 }, { 130, 45 } };
+    static const int kernels[][2] = { { 1, 1 }, { 3, 5 }, { 8, 8 }, { 33, 17 } };
+    static const int radii[] = { 1, 2, 5, 16 };
+    static const float sigmas[] = { 0.5f, 1.0f, 2.0f, 7.0f };
+    static const float iirSigmas[] = { 1.0f, 5.0f, GAUSSIAN_IIR_MIN_SIGMA, 12.0f, 30.0f };
+    static const float bilateralSigmas[][2] = { { 2.0f, 20.0f }, { 4.0f, 40.0f }, { 8.0f, 30.0f } };
+    const int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    const int nkernels = sizeof(kernels) / sizeof(kernels[0]);
+    const int nradii = sizeof(radii) / sizeof(radii[0]);
+    const int nsigmas = sizeof(sigmas) / sizeof(sigmas[0]);
+    const int niirSigmas = sizeof(iirSigmas) / sizeof(iirSigmas[0]);
+    const int nbilateralSigmas = sizeof(bilateralSigmas) / sizeof(bilateralSigmas[0]);
+
+    srand(1);
+    int nfailed = 0;
+    char param[32];
+    printf("filter\tsize\tparam\ttest\tmaxdiff\n");
+    for (int s = 0; s < nsizes; s++)
+    {
+        int w = sizes[s][0], h = sizes[s][1];
+        size_t size = (size_t) w * h * 4;
+        unsigned char * pSrc = (unsigned char *) malloc(size);
+        unsigned char * pOut = (unsigned char *) malloc(size);
+        unsigned char * pRef = (unsigned char *) malloc(size);
+        unsigned char * pFFT = (unsigned char *) malloc(size);
+        unsigned char * pStep = (unsigned char *) malloc(size);
+        if (!pSrc || !pOut || !pRef || !pFFT || !pStep)
+        {
+            fprintf(stderr, "Cannot allocate test images\n");
+            free(pSrc);
+            free(pOut);
+            free(pRef);
+            free(pFFT);
+            free(pStep);
+            return EXIT_FAILURE;
+        }
+        for (size_t i = 0; i < size; i++)
+            pSrc[i] = (i & 3) == 3 ? 255 : (unsigned char) rand();
+
+        // The vertical step of levels 40 and 200 with noise of +-30.
+        for (size_t i = 0; i < size; i++)
+            pStep[i] = (i & 3) == 3 ? 255 :
+                (unsigned char) ((i / 4 % w < (size_t) w / 2 ? 40 : 200) + rand() % 61 - 30);
+
+        // Kernels of unit sum with negative and zero weights.
+        for (int k = 0; k < nkernels; k++)
+        {
+            int kw = kernels[k][0], kh = kernels[k][1];
+            float * pKernel = (float *) malloc((size_t) kw * kh * sizeof(float));
+            double sum = 0;
+            for (int i = 0; i < kw * kh; i++)
+            {
+                pKernel[i] = (rand() % 100) / 100.0f - 0.2f;
+                sum += pKernel[i];
+            }
+            for (int i = 0; i < kw * kh; i++)
+                pKernel[i] /= (float) sum;
+
+            snprintf(param, sizeof(param), "%dx%d", kw, kh);
+            bool ok = Host_Convolve(pSrc, pOut, w, h, pKernel, kw, kh, CONVOLVE_DIRECT);
+            TestConvolve(pSrc, pRef, w, h, pKernel, kw, kh);
+            nfailed += TestReport("direct", w, h, param, ok, pOut, pRef, FILTER_TEST_TOLERANCE);
+            ok = ok && Host_Convolve(pSrc, pFFT, w, h, pKernel, kw, kh, CONVOLVE_FFT);
+            nfailed += TestReport("fft", w, h, param, ok, pFFT, pOut, FILTER_TEST_TOLERANCE);
+            free(pKernel);
+        }
+
+        for (int r = 0; r < nradii; r++)
+        {
+            int radius = radii[r];
+            snprintf(param, sizeof(param), "%d", radius);
+
+            bool ok = Host_BoxBlur(pSrc, pOut, w, h, radius);
+            TestBox(pSrc, pRef, w, h, radius);
+            nfailed += TestReport("box", w, h, param, ok, pOut, pRef, FILTER_TEST_TOLERANCE);
+
+            ok = Host_MedianFilter(pSrc, pOut, w, h, radius);
+            TestMedian(pSrc, pRef, w, h, radius);
+            nfailed += TestReport("median", w, h, param, ok, pOut, pRef, 0);
+
+            // Radii up to GAUSSIAN_IIR_RADIUS are exact sums of weights.
+            ok = Host_GaussianBlur(pSrc, pOut, w, h, radius);
+            TestGaussian(pSrc, pRef, w, h, radius, GAUSSIAN_SIGMA(radius));
+            nfailed += TestReport("gauss", w, h, param, ok, pOut, pRef, FILTER_TEST_TOLERANCE);
+        }
+
+        // Box of radius 0 is the copy, and so are boxes of small sigma.
+        bool ok = Host_BoxBlur(pSrc, pOut, w, h, 0);
+        TestBox(pSrc, pRef, w, h, 0);
+        nfailed += TestReport("box", w, h, "0", ok, pOut, pRef, 0);
+        for (int i = 0; i < nsigmas; i++)
+        {
+            snprintf(param, sizeof(param), "%g", sigmas[i]);
+            ok = Host_BoxGaussianBlur(pSrc, pOut, w, h, sigmas[i]);
+            TestBoxGaussian(pSrc, pRef, pFFT, w, h, sigmas[i]);
+            nfailed += TestReport("boxgauss", w, h, param, ok, pOut, pRef, FILTER_TEST_TOLERANCE);
+        }
+
+        // Recursive Gaussian against the exact one, which weights
+        // are negligible beyond 4 sigma.
+        for (int i = 0; i < niirSigmas; i++)
+        {
+            float sigma = iirSigmas[i];
+            snprintf(param, sizeof(param), "%g", sigma);
+            ok = Host_RecursiveGaussianBlur(pSrc, pOut, w, h, sigma);
+            TestGaussian(pSrc, pRef, w, h, (int) ceilf(4.0f * sigma) + 1, sigma);
+            nfailed += TestReport("iir", w, h, param, ok, pOut, pRef,
+                sigma < GAUSSIAN_IIR_MIN_SIGMA ? FILTER_TEST_TOLERANCE : FILTER_TEST_IIR_TOLERANCE);
+        }
+
+        // Bilateral grid against the direct filter, and by strips of 7 rows
+        // against the whole image, which must match exactly.
+        for (int i = 0; i < nbilateralSigmas; i++)
+        {
+            float sigmaSpatial = bilateralSigmas[i][0], sigmaRange = bilateralSigmas[i][1];
+            snprintf(param, sizeof(param), "%g:%g", sigmaSpatial, sigmaRange);
+            ok = Host_BilateralGrid(pStep, pOut, w, h, sigmaSpatial, sigmaRange);
+            TestBilateral(pStep, pRef, w, h, sigmaSpatial, sigmaRange);
+            nfailed += TestReport("bilateral", w, h, param, ok, pOut, pRef, FILTER_TEST_BILATERAL_TOLERANCE);
+            ok = ok && TestBilateralStrips(pStep, pRef, pFFT, w, h, 7, sigmaSpatial, sigmaRange);
+            nfailed += TestReport("bilstrip", w, h, param, ok, pRef, pOut, 0);
+        }
+
+        free(pSrc);
+        free(pOut);
+        free(pRef);
+        free(pFFT);
+        free(pStep);
+    }
+
+    printf("%d cases failed\n", nfailed);
+    return nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
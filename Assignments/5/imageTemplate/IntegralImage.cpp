@@ -0,0 +1,206 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#include "HostFilters.h"
+
+// The number of rows scanned by each thread in the first pass.
+static int RowBlock(int h)
+{
+    int nthreads = omp_get_max_threads();
+    return (h + nthreads - 1) / nthreads;
+}
+
+// Average the window of radius r around each pixel of the rows
+// y0 .. y1 - 1, cropped by image edges, by four lookups into SAT.
+static void BoxRows(const unsigned int * pSAT, unsigned char * pDst, int w, int h, int r, int y0, int y1)
+{
+    size_t stride = (size_t) (w + 1) * 4;
+    for (int y = y0; y < y1; y++)
+    {
+        int ya = y - r < 0 ? 0 : y - r;
+        int yb = y + r + 1 > h ? h : y + r + 1;
+        const unsigned int * pA = pSAT + ya * stride;
+        const unsigned int * pB = pSAT + yb * stride;
+        unsigned char * pOut = pDst + (size_t) y * w * 4;
+
+        // Windows of the inner columns have the same area, and their
+        // lookups are contiguous, so all channels go in SIMD lanes.
+        int x0 = r < w ? r : w, x1 = w - r > x0 ? w - r : x0;
+        float scale = 1.0f / ((2 * r + 1) * (yb - ya));
+        const unsigned int * pA0 = pA - 4 * r, * pA1 = pA + 4 * (r + 1);
+        const unsigned int * pB0 = pB - 4 * r, * pB1 = pB + 4 * (r + 1);
+        #pragma omp simd
+        for (int i = 4 * x0; i < 4 * x1; i++)
+        {
+            // Wrapped sums are fine: only their differences are used.
+            unsigned int sum = pB1[i] - pA1[i] - pB0[i] + pA0[i];
+            pOut[i] = (unsigned char) (sum * scale + 0.5f);
+        }
+
+        for (int x = 0; x < w; x++)
+        {
+            // Skip the inner columns, done above, all of them for radius 0.
+            if (x == x0 && x1 > x0)
+            {
+                if (x1 == w)
+                    break;
+                x = x1;
+            }
+            int xa = x - r < 0 ? 0 : x - r;
+            int xb = x + r + 1 > w ? w : x + r + 1;
+            float scale = 1.0f / ((xb - xa) * (yb - ya));
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int sum = pB[4 * xb + k] - pA[4 * xb + k] - pB[4 * xa + k] + pA[4 * xa + k];
+                pOut[4 * x + k] = (unsigned char) (sum * scale + 0.5f);
+            }
+        }
+        for (int x = 0; x < w; x++)
+            pOut[4 * x + 3] = 255;
+    }
+}
+
+extern "C"
+{
+    // Widths of boxes, which variances sum to the one of Gaussian,
+    // that is sigma^2 / 2 in terms of GaussianWeights: m boxes of
+    // odd width wl and n - m of wl + 2 (Kovesi, 2010).
+    void BoxGaussianWidths(float sigma, int * pWidths)
+    {
+        const int n = BOX_GAUSSIAN_PASSES;
+        float var = sigma * sigma * 0.5f;
+        int wl = (int) floorf(sqrtf(12.0f * var / n + 1.0f));
+        if (wl % 2 == 0)
+            wl--;
+        int m = (int) floorf((12.0f * var - n * wl * wl - 4.0f * n * wl - 3.0f * n) / (-4.0f * wl - 4.0f) + 0.5f);
+        for (int i = 0; i < n; i++)
+            pWidths[i] = i < m ? wl : wl + 2;
+    }
+
+    int BoxGaussianRadius(float sigma)
+    {
+        int widths[BOX_GAUSSIAN_PASSES];
+        BoxGaussianWidths(sigma, widths);
+
+        int radius = 0;
+        for (int i = 0; i < BOX_GAUSSIAN_PASSES; i++)
+            radius += (widths[i] - 1) / 2;
+        return radius;
+    }
+
+    bool Host_IntegralImage(const unsigned char * pSrc, int w, int h, unsigned int * pSAT)
+    {
+        if (w <= 0 || h <= 0)
+            return false;
+
+        size_t stride = (size_t) (w + 1) * 4;
+        memset(pSAT, 0, stride * sizeof(unsigned int));
+
+        // First pass: each block of rows is scanned along rows,
+        // then down columns, as if it was the whole image.
+        int rows = RowBlock(h);
+        #pragma omp parallel for
+        for (int y0 = 0; y0 < h; y0 += rows)
+        {
+            int y1 = y0 + rows < h ? y0 + rows : h;
+            for (int y = y0; y < y1; y++)
+            {
+                const unsigned char * pIn = pSrc + (size_t) y * w * 4;
+                unsigned int * pOut = pSAT + (y + 1) * stride;
+                unsigned int s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+                pOut[0] = pOut[1] = pOut[2] = pOut[3] = 0;
+                for (int x = 0; x < w; x++)
+                {
+                    s0 += pIn[4 * x + 0]; pOut[4 * x + 4] = s0;
+                    s1 += pIn[4 * x + 1]; pOut[4 * x + 5] = s1;
+                    s2 += pIn[4 * x + 2]; pOut[4 * x + 6] = s2;
+                    s3 += pIn[4 * x + 3]; pOut[4 * x + 7] = s3;
+                }
+                if (y > y0)
+                {
+                    const unsigned int * pUp = pOut - stride;
+                    #pragma omp simd
+                    for (size_t i = 0; i < stride; i++)
+                        pOut[i] += pUp[i];
+                }
+            }
+        }
+
+        // Second pass: the last rows of blocks are summed in order,
+        // and each one is added to all rows of the next block.
+        for (int y0 = rows; y0 < h; y0 += rows)
+        {
+            const unsigned int * pCarry = pSAT + y0 * stride;
+            unsigned int * pLast = pSAT + ((y0 + rows < h ? y0 + rows : h)) * stride;
+            #pragma omp simd
+            for (size_t i = 0; i < stride; i++)
+                pLast[i] += pCarry[i];
+        }
+        #pragma omp parallel for
+        for (int y = rows; y < h; y++)
+        {
+            // The last row of block is done above.
+            if ((y + 1) % rows == 0 || y == h - 1)
+                continue;
+            const unsigned int * pCarry = pSAT + (y / rows) * rows * stride;
+            unsigned int * pOut = pSAT + (y + 1) * stride;
+            #pragma omp simd
+            for (size_t i = 0; i < stride; i++)
+                pOut[i] += pCarry[i];
+        }
+
+        return true;
+    }
+
+    bool Host_BoxBlur(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int radius)
+    {
+        if (w <= 0 || h <= 0 || radius < 0)
+            return false;
+
+        unsigned int * pSAT = (unsigned int *) malloc((size_t) (w + 1) * (h + 1) * 4 * sizeof(unsigned int));
+        if (!pSAT)
+            return false;
+
+        Host_IntegralImage(pSrc, w, h, pSAT);
+
+        int rows = RowBlock(h);
+        #pragma omp parallel for
+        for (int y0 = 0; y0 < h; y0 += rows)
+            BoxRows(pSAT, pDst, w, h, radius, y0, y0 + rows < h ? y0 + rows : h);
+
+        free(pSAT);
+
+        return true;
+    }
+
+    bool Host_BoxGaussianBlur(const unsigned char * pSrc, unsigned char * pDst, int w, int h, float sigma)
+    {
+        if (w <= 0 || h <= 0 || sigma < 0.0f)
+            return false;
+
+        int widths[BOX_GAUSSIAN_PASSES];
+        BoxGaussianWidths(sigma, widths);
+
+        unsigned char * pTmp = (unsigned char *) malloc((size_t) w * h * 4);
+        if (!pTmp)
+            return false;
+
+        // Passes alternate between the output and temporary image,
+        // so that the last one lands in the output.
+        const unsigned char * pIn = pSrc;
+        bool ok = true;
+        for (int i = 0; ok && i < BOX_GAUSSIAN_PASSES; i++)
+        {
+            unsigned char * pOut = (i % 2 == 0) ? pDst : pTmp;
+            ok = Host_BoxBlur(pIn, pOut, w, h, (widths[i] - 1) / 2);
+            pIn = pOut;
+        }
+
+        free(pTmp);
+
+        return ok;
+    }
+};
@@ -0,0 +1,349 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#   include <emmintrin.h>
+#   define HAVE_SSE2
+#endif
+
+#include "HostFilters.h"
+
+// Histograms of 8-bit values: 16 coarse bins of the high 4 bits
+// and 256 fine bins, in 16 segments of the coarse ones.
+#define COARSE_BINS 16
+#define FINE_BINS 256
+
+typedef unsigned short Bin;
+
+static inline int Clamp(int x, int n)
+{
+    return x < 0 ? 0 : (x >= n ? n - 1 : x);
+}
+
+static inline unsigned char Min(unsigned char a, unsigned char b)
+{
+    return a < b ? a : b;
+}
+
+static inline unsigned char Max(unsigned char a, unsigned char b)
+{
+    return a > b ? a : b;
+}
+
+// 3 x 3 median by the sorting network: each column of 3 rows is sorted,
+// the median is the middle one of the largest low, the middle middle and
+// the smallest high value of 3 columns (Paeth, 1990). All bytes of RGBA
+// rows go in SIMD lanes, the neighbour column is 4 bytes apart, and the
+// column sorts of each row are shared by 3 output pixels. Buffers are
+// allocated once per thread; if any allocation fails, all threads skip
+// the filter, and false is returned.
+static bool Median3x3(const unsigned char * pSrc, unsigned char * pDst, int w, int h)
+{
+    int n = 4 * w;
+
+    bool ok = true;
+    #pragma omp parallel
+    {
+        // Sorted columns with one replicated pixel at each end.
+        unsigned char * pLo = (unsigned char *) malloc(3 * (n + 8));
+        if (!pLo)
+        {
+            #pragma omp atomic write
+            ok = false;
+        }
+        #pragma omp barrier
+
+        bool run;
+        #pragma omp atomic read
+        run = ok;
+
+        if (run)
+        {
+            unsigned char * pMid = pLo + n + 8, * pHi = pMid + n + 8;
+
+            #pragma omp for
+            for (int y = 0; y < h; y++)
+            {
+                const unsigned char * a = pSrc + (size_t) Clamp(y - 1, h) * n;
+                const unsigned char * b = pSrc + (size_t) y * n;
+                const unsigned char * c = pSrc + (size_t) Clamp(y + 1, h) * n;
+                unsigned char * lo = pLo + 4, * mid = pMid + 4, * hi = pHi + 4;
+                #pragma omp simd
+                for (int i = 0; i < n; i++)
+                {
+                    unsigned char l = Min(a[i], b[i]), u = Max(a[i], b[i]);
+                    lo[i] = Min(l, c[i]);
+                    hi[i] = Max(u, c[i]);
+                    mid[i] = Max(l, Min(u, c[i]));
+                }
+                memcpy(lo - 4, lo, 4); memcpy(lo + n, lo + n - 4, 4);
+                memcpy(mid - 4, mid, 4); memcpy(mid + n, mid + n - 4, 4);
+                memcpy(hi - 4, hi, 4); memcpy(hi + n, hi + n - 4, 4);
+
+                unsigned char * pOut = pDst + (size_t) y * n;
+                #pragma omp simd
+                for (int i = 0; i < n; i++)
+                {
+                    unsigned char l = Max(Max(lo[i - 4], lo[i]), lo[i + 4]);
+                    unsigned char u = Min(Min(hi[i - 4], hi[i]), hi[i + 4]);
+                    unsigned char m0 = Min(mid[i - 4], mid[i]), m1 = Max(mid[i - 4], mid[i]);
+                    unsigned char m = Max(m0, Min(m1, mid[i + 4]));
+                    unsigned char p = Min(l, u), q = Max(l, u);
+                    pOut[i] = Max(p, Min(q, m));
+                }
+                for (int x = 0; x < w; x++)
+                    pOut[4 * x + 3] = 255;
+            }
+        }
+
+        free(pLo);
+    }
+
+    return ok;
+}
+
+// Histograms of one channel: columns of the current window of rows,
+// and the kernel window, which fine segments are brought up to date
+// only when the median falls into them (Perreault, Hebert, 2007).
+// Column fine bins are grouped by segments, so that a segment
+// of successive columns is contiguous.
+typedef struct
+{
+    Bin * pColCoarse;               // w x COARSE_BINS
+    Bin * pColFine;                 // COARSE_BINS segments of w x COARSE_BINS
+    Bin   coarse[COARSE_BINS];
+    Bin   fine[FINE_BINS];
+    int   last[COARSE_BINS];        // x, at which the fine segment was updated
+} Histograms;
+
+#ifdef HAVE_SSE2
+
+// 16 bins are 2 SIMD registers.
+static inline __m128i LoadBins(const Bin * p, int i)
+{
+    return _mm_loadu_si128((const __m128i *) (p + i));
+}
+
+static inline void AddBins(Bin * pDst, const Bin * pSrc)
+{
+    for (int i = 0; i < COARSE_BINS; i += 8)
+        _mm_storeu_si128((__m128i *) (pDst + i), _mm_add_epi16(LoadBins(pDst, i), LoadBins(pSrc, i)));
+}
+
+// Add one histogram segment and subtract another.
+static inline void SlideBins(Bin * pDst, const Bin * pAdd, const Bin * pSub)
+{
+    for (int i = 0; i < COARSE_BINS; i += 8)
+    {
+        __m128i v = _mm_add_epi16(LoadBins(pDst, i), LoadBins(pAdd, i));
+        _mm_storeu_si128((__m128i *) (pDst + i), _mm_sub_epi16(v, LoadBins(pSub, i)));
+    }
+}
+
+static inline __m128i PrefixSum(__m128i v)
+{
+    v = _mm_add_epi16(v, _mm_slli_si128(v, 2));
+    v = _mm_add_epi16(v, _mm_slli_si128(v, 4));
+    return _mm_add_epi16(v, _mm_slli_si128(v, 8));
+}
+
+// The number of leading bins, which sum with *pSum to at most half,
+// *pSum is increased by them. Prefix sums of all bins are compared
+// at once, instead of the scalar loop of unpredictable length.
+static inline int Search(const Bin * pBins, int half, int * pSum)
+{
+    __m128i lo = _mm_add_epi16(PrefixSum(LoadBins(pBins, 0)), _mm_set1_epi16((short) *pSum));
+    __m128i hi = PrefixSum(LoadBins(pBins, 8)), t = _mm_shufflehi_epi16(lo, 0xFF);
+    hi = _mm_add_epi16(hi, _mm_unpackhi_epi64(t, t));
+
+    // Sums are unsigned, a sum is at most half when it saturates to zero.
+    __m128i h = _mm_set1_epi16((short) half), z = _mm_setzero_si128();
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(lo, h), z)) |
+               _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(hi, h), z)) << 16;
+    int k = __builtin_popcount(mask) >> 1;
+
+    Bin sums[COARSE_BINS];
+    _mm_storeu_si128((__m128i *) sums, lo);
+    _mm_storeu_si128((__m128i *) (sums + 8), hi);
+    if (k)
+        *pSum = sums[k - 1];
+    return k;
+}
+
+#else
+
+static inline void AddBins(Bin * pDst, const Bin * pSrc)
+{
+    #pragma omp simd
+    for (int i = 0; i < COARSE_BINS; i++)
+        pDst[i] += pSrc[i];
+}
+
+// Add one histogram segment and subtract another.
+static inline void SlideBins(Bin * pDst, const Bin * pAdd, const Bin * pSub)
+{
+    #pragma omp simd
+    for (int i = 0; i < COARSE_BINS; i++)
+        pDst[i] += pAdd[i] - pSub[i];
+}
+
+// The number of leading bins, which sum with *pSum to at most half,
+// *pSum is increased by them.
+static inline int Search(const Bin * pBins, int half, int * pSum)
+{
+    int k = 0;
+    while (*pSum + pBins[k] <= half)
+        *pSum += pBins[k++];
+    return k;
+}
+
+#endif
+
+// Bring the fine segment k of the kernel at column x up to date.
+static void UpdateSegment(Histograms * p, int k, int x, int w, int r)
+{
+    Bin * pSeg = p->fine + k * COARSE_BINS;
+    const Bin * pCols = p->pColFine + (size_t) k * w * COARSE_BINS;
+    int last = p->last[k];
+    if (x - last > 2 * r + 1)
+    {
+        memset(pSeg, 0, COARSE_BINS * sizeof(Bin));
+        for (int i = x - r; i <= x + r; i++)
+            AddBins(pSeg, pCols + Clamp(i, w) * COARSE_BINS);
+    }
+    else
+        for (int t = last + 1; t <= x; t++)
+            SlideBins(pSeg, pCols + Clamp(t + r, w) * COARSE_BINS,
+                      pCols + Clamp(t - r - 1, w) * COARSE_BINS);
+    p->last[k] = x;
+}
+
+// Median of rows y0 .. y1 - 1 by sliding histograms, the window of
+// radius r is clamped at edges, each channel has its histograms.
+static void MedianRows(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int r,
+                       int y0, int y1, Histograms * pHist)
+{
+    size_t n = (size_t) w * 4;
+    int half = (2 * r + 1) * (2 * r + 1) / 2;
+
+    // Columns start with rows y0 - r .. y0 + r.
+    for (int c = 0; c < 3; c++)
+    {
+        memset(pHist[c].pColCoarse, 0, (size_t) w * COARSE_BINS * sizeof(Bin));
+        memset(pHist[c].pColFine, 0, (size_t) w * FINE_BINS * sizeof(Bin));
+    }
+    for (int i = y0 - r; i <= y0 + r; i++)
+    {
+        const unsigned char * pIn = pSrc + Clamp(i, h) * n;
+        for (int x = 0; x < w; x++)
+            for (int c = 0; c < 3; c++)
+            {
+                int v = pIn[4 * x + c];
+                pHist[c].pColCoarse[x * COARSE_BINS + (v >> 4)]++;
+                pHist[c].pColFine[((size_t) (v >> 4) * w + x) * COARSE_BINS + (v & 15)]++;
+            }
+    }
+
+    for (int y = y0; y < y1; y++)
+    {
+        // Slide columns down by one row.
+        if (y > y0)
+        {
+            const unsigned char * pOld = pSrc + Clamp(y - r - 1, h) * n;
+            const unsigned char * pNew = pSrc + Clamp(y + r, h) * n;
+            for (int x = 0; x < w; x++)
+                for (int c = 0; c < 3; c++)
+                {
+                    int u = pOld[4 * x + c], v = pNew[4 * x + c];
+                    pHist[c].pColCoarse[x * COARSE_BINS + (u >> 4)]--;
+                    pHist[c].pColFine[((size_t) (u >> 4) * w + x) * COARSE_BINS + (u & 15)]--;
+                    pHist[c].pColCoarse[x * COARSE_BINS + (v >> 4)]++;
+                    pHist[c].pColFine[((size_t) (v >> 4) * w + x) * COARSE_BINS + (v & 15)]++;
+                }
+        }
+
+        // The kernel starts at column 0 with the left edge replicated,
+        // all fine segments are out of date.
+        for (int c = 0; c < 3; c++)
+        {
+            Histograms * p = &pHist[c];
+            memset(p->coarse, 0, sizeof(p->coarse));
+            for (int i = -r; i <= r; i++)
+                AddBins(p->coarse, p->pColCoarse + Clamp(i, w) * COARSE_BINS);
+            for (int k = 0; k < COARSE_BINS; k++)
+                p->last[k] = -2 * r - 2;
+        }
+
+        unsigned char * pOut = pDst + y * n;
+        for (int x = 0; x < w; x++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                Histograms * p = &pHist[c];
+                if (x > 0)
+                    SlideBins(p->coarse, p->pColCoarse + Clamp(x + r, w) * COARSE_BINS,
+                              p->pColCoarse + Clamp(x - r - 1, w) * COARSE_BINS);
+
+                // Find the coarse bin of the median, then its fine bin.
+                int sum = 0;
+                int k = Search(p->coarse, half, &sum);
+                UpdateSegment(p, k, x, w, r);
+                int b = Search(p->fine + k * COARSE_BINS, half, &sum);
+                pOut[4 * x + c] = (unsigned char) (k * COARSE_BINS + b);
+            }
+            pOut[4 * x + 3] = 255;
+        }
+    }
+}
+
+extern "C"
+{
+    bool Host_MedianFilter(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int radius)
+    {
+        if (w <= 0 || h <= 0 || radius < 0 || radius > MEDIAN_MAX_RADIUS)
+            return false;
+
+        if (radius == 0)
+        {
+            memcpy(pDst, pSrc, (size_t) w * h * 4);
+            for (size_t i = 3; i < (size_t) w * h * 4; i += 4)
+                pDst[i] = 255;
+            return true;
+        }
+        if (radius == 1)
+            return Median3x3(pSrc, pDst, w, h);
+
+        // Each thread takes the strip of rows, its column histograms
+        // are filled once at the top of the strip.
+        bool ok = true;
+        #pragma omp parallel
+        {
+            int nthreads = omp_get_num_threads();
+            int rows = (h + nthreads - 1) / nthreads;
+            int y0 = omp_get_thread_num() * rows;
+            int y1 = y0 + rows < h ? y0 + rows : h;
+
+            Histograms pHist[3];
+            Bin * pCols = (Bin *) malloc((size_t) 3 * w * (COARSE_BINS + FINE_BINS) * sizeof(Bin));
+            if (!pCols)
+            {
+                #pragma omp atomic write
+                ok = false;
+            }
+            else if (y0 < y1)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    pHist[c].pColCoarse = pCols + (size_t) c * w * (COARSE_BINS + FINE_BINS);
+                    pHist[c].pColFine = pHist[c].pColCoarse + (size_t) w * COARSE_BINS;
+                }
+                MedianRows(pSrc, pDst, w, h, radius, y0, y1, pHist);
+            }
+            free(pCols);
+        }
+
+        return ok;
+    }
+};
@@ -0,0 +1,209 @@
+#include <stdlib.h>
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "Pipeline.h"
+
+// Bounded FIFO of items between two stages.
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t  notEmpty;
+    pthread_cond_t  notFull;
+    void **         ppItems;
+    int             capacity;
+    int             head;
+    int             count;
+    int             producers;  // stages writing into queue, it is closed at zero
+} Queue;
+
+typedef struct
+{
+    PipelineStage * pStage;
+    Queue *         pIn;
+    Queue *         pOut;
+    PipelineDone    done;
+    void *          pDoneArg;
+    pthread_mutex_t * pStats;
+    int *           pCompleted;
+} Worker;
+
+static double WallTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static bool QueueInit(Queue * q, int capacity, int producers)
+{
+    q->ppItems = (void **) malloc(capacity * sizeof(void *));
+    if (!q->ppItems)
+        return false;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->notEmpty, NULL);
+    pthread_cond_init(&q->notFull, NULL);
+    q->capacity = capacity;
+    q->head = 0;
+    q->count = 0;
+    q->producers = producers;
+    return true;
+}
+
+static void QueueRelease(Queue * q)
+{
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->notEmpty);
+    pthread_cond_destroy(&q->notFull);
+    free(q->ppItems);
+}
+
+// Wait for the free slot and append item.
+static void QueuePush(Queue * q, void * pItem)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->capacity)
+        pthread_cond_wait(&q->notFull, &q->lock);
+    q->ppItems[(q->head + q->count) % q->capacity] = pItem;
+    q->count++;
+    pthread_cond_signal(&q->notEmpty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// Wait for the item and take it, returns NULL when the queue
+// is empty and all its producers have finished.
+static void * QueuePop(Queue * q)
+{
+    pthread_mutex_lock(&q->lock);
+    while (!q->count && q->producers)
+        pthread_cond_wait(&q->notEmpty, &q->lock);
+    void * pItem = NULL;
+    if (q->count)
+    {
+        pItem = q->ppItems[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+        pthread_cond_signal(&q->notFull);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return pItem;
+}
+
+// Unregister one producer, wake up consumers when it was the last.
+static void QueueClose(Queue * q)
+{
+    pthread_mutex_lock(&q->lock);
+    if (!--q->producers)
+        pthread_cond_broadcast(&q->notEmpty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void * WorkerThread(void * pArg)
+{
+    Worker * w = (Worker *) pArg;
+    double busy = 0.0;
+    int completed = 0;
+
+    void * pItem;
+    while ((pItem = QueuePop(w->pIn)) != NULL)
+    {
+        double start = WallTime();
+        bool ok = w->pStage->func(pItem, w->pStage->pArg);
+        busy += WallTime() - start;
+
+        if (ok && w->pOut)
+            QueuePush(w->pOut, pItem);
+        else
+        {
+            w->done(pItem, ok, w->pDoneArg);
+            completed += ok;
+        }
+    }
+    if (w->pOut)
+        QueueClose(w->pOut);
+
+    pthread_mutex_lock(w->pStats);
+    w->pStage->busy += busy;
+    *w->pCompleted += completed;
+    pthread_mutex_unlock(w->pStats);
+
+    return NULL;
+}
+
+int RunPipeline(PipelineStage * pStages, int nstages, void ** ppItems, int nitems,
+                int depth, PipelineDone done, void * pDoneArg)
+{
+    int nworkers = 0;
+    for (int i = 0; i < nstages; i++)
+        nworkers += pStages[i].threads;
+
+    // Queue i feeds stage i, it is written by all threads of stage i - 1.
+    Queue * pQueues = (Queue *) malloc(nstages * sizeof(Queue));
+    Worker * pWorkers = (Worker *) malloc(nworkers * sizeof(Worker));
+    pthread_t * pThreads = (pthread_t *) malloc(nworkers * sizeof(pthread_t));
+    int nqueues = 0;
+    while (pQueues && nqueues < nstages &&
+           QueueInit(&pQueues[nqueues], depth, nqueues ? pStages[nqueues - 1].threads : 1))
+        nqueues++;
+    if (nqueues < nstages || !pWorkers || !pThreads)
+    {
+        for (int i = 0; i < nqueues; i++)
+            QueueRelease(&pQueues[i]);
+        free(pQueues);
+        free(pWorkers);
+        free(pThreads);
+        return -1;
+    }
+
+    pthread_mutex_t stats;
+    pthread_mutex_init(&stats, NULL);
+    int completed = 0;
+
+    // If the thread fails to start, the started threads of its stage are
+    // the only producers of the next queue, and later stages get none.
+    // No queue is closed yet, so they may be recounted without the lock.
+    int nthreads = 0;
+    bool started = true;
+    for (int i = 0; started && i < nstages; i++)
+    {
+        pStages[i].busy = 0.0;
+        for (int j = 0; started && j < pStages[i].threads; j++)
+        {
+            Worker * w = &pWorkers[nthreads];
+            w->pStage = &pStages[i];
+            w->pIn = &pQueues[i];
+            w->pOut = i < nstages - 1 ? &pQueues[i + 1] : NULL;
+            w->done = done;
+            w->pDoneArg = pDoneArg;
+            w->pStats = &stats;
+            w->pCompleted = &completed;
+            if (pthread_create(&pThreads[nthreads], NULL, WorkerThread, w))
+            {
+                started = false;
+                if (i < nstages - 1)
+                    pQueues[i + 1].producers = j;
+            }
+            else
+                nthreads++;
+        }
+    }
+
+    // The calling thread feeds the first stage, blocking when it is full.
+    // Without all threads nothing is fed, and the started ones finish.
+    for (int i = 0; started && i < nitems; i++)
+        QueuePush(&pQueues[0], ppItems[i]);
+    QueueClose(&pQueues[0]);
+
+    for (int k = 0; k < nthreads; k++)
+        pthread_join(pThreads[k], NULL);
+
+    for (int i = 0; i < nstages; i++)
+        QueueRelease(&pQueues[i]);
+    pthread_mutex_destroy(&stats);
+    free(pQueues);
+    free(pWorkers);
+    free(pThreads);
+
+    return started ? completed : -1;
+}
@@ -0,0 +1,28 @@
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+// Process the item, returns false if it must be dropped.
+typedef bool (*PipelineFunc)(void * pItem, void * pArg);
+
+// Called once for each item after the last stage or after the failed one.
+typedef void (*PipelineDone)(void * pItem, bool ok, void * pArg);
+
+typedef struct
+{
+    const char * name;
+    PipelineFunc func;
+    void *       pArg;
+    int          threads;   // the number of worker threads of the stage
+    double       busy;      // total time spent in func, filled by RunPipeline
+} PipelineStage;
+
+// Pass items through stages in order, each stage run by its own pool
+// of threads. Stages are connected by queues of the given depth, so that
+// the fast stage blocks, when the next one does not keep up, and the
+// number of items in flight stays bounded. Items may complete out of order.
+// Returns the number of items completed successfully, or -1 if queues
+// or threads cannot be created, then no item is processed.
+int RunPipeline(PipelineStage * pStages, int nstages, void ** ppItems, int nitems,
+                int depth, PipelineDone done, void * pDoneArg);
+
+#endif
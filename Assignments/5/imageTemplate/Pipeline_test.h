@@ -0,0 +1,105 @@
+#ifndef _PIPELINE_TEST_H_
+#define _PIPELINE_TEST_H_
+
+// Self-check of the pipeline: numbered items go through 3 stages, each
+// one adds its number to the item, the second one drops every 5th item.
+// All items must come to the done callback exactly once, the completed
+// ones with the sum of all stages, the dropped ones after the second.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include "Pipeline.h"
+
+#define PIPELINE_TEST_ITEMS 100
+
+typedef struct
+{
+    int index;
+    int value;
+} TestItem;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    int             calls[PIPELINE_TEST_ITEMS];
+    bool            wrong;
+} TestDone;
+
+static bool TestStage(void * pItem, void * pArg)
+{
+    TestItem * item = (TestItem *) pItem;
+    int stage = *(int *) pArg;
+    item->value += stage;
+    return stage != 2 || item->index % 5;
+}
+
+static void TestItemDone(void * pItem, bool ok, void * pArg)
+{
+    TestItem * item = (TestItem *) pItem;
+    TestDone * d = (TestDone *) pArg;
+    pthread_mutex_lock(&d->lock);
+    d->calls[item->index]++;
+    if (ok != (item->index % 5 != 0) || item->value != (ok ? 1 + 2 + 3 : 1 + 2))
+        d->wrong = true;
+    pthread_mutex_unlock(&d->lock);
+}
+
+// Run all cases, returns EXIT_SUCCESS if all of them passed.
+static int Pipeline_Test(void)
+{
+    static const int threads[][3] = { { 1, 1, 1 }, { 1, 3, 2 }, { 4, 4, 4 } };
+    static const int depths[] = { 1, 2, 8 };
+    const int nthreads = sizeof(threads) / sizeof(threads[0]);
+    const int ndepths = sizeof(depths) / sizeof(depths[0]);
+    static int numbers[3] = { 1, 2, 3 };
+
+    int nfailed = 0;
+    printf("pipeline\tthreads\tdepth\ttest\tcompleted\n");
+    for (int t = 0; t < nthreads; t++)
+        for (int d = 0; d < ndepths; d++)
+        {
+            PipelineStage stages[3];
+            for (int i = 0; i < 3; i++)
+            {
+                stages[i].name = "test";
+                stages[i].func = TestStage;
+                stages[i].pArg = &numbers[i];
+                stages[i].threads = threads[t][i];
+                stages[i].busy = 0.0;
+            }
+
+            TestItem items[PIPELINE_TEST_ITEMS];
+            void * ppItems[PIPELINE_TEST_ITEMS];
+            for (int i = 0; i < PIPELINE_TEST_ITEMS; i++)
+            {
+                items[i].index = i;
+                items[i].value = 0;
+                ppItems[i] = &items[i];
+            }
+
+            TestDone done;
+            pthread_mutex_init(&done.lock, NULL);
+            memset(done.calls, 0, sizeof(done.calls));
+            done.wrong = false;
+
+            int completed = RunPipeline(stages, 3, ppItems, PIPELINE_TEST_ITEMS, depths[d], TestItemDone, &done);
+            pthread_mutex_destroy(&done.lock);
+
+            bool passed = !done.wrong && completed == PIPELINE_TEST_ITEMS - PIPELINE_TEST_ITEMS / 5;
+            for (int i = 0; i < PIPELINE_TEST_ITEMS; i++)
+                passed = passed && done.calls[i] == 1;
+            printf("pipeline\t%d,%d,%d\t%d\t%s\t%d\n", threads[t][0], threads[t][1], threads[t][2],
+                depths[d], passed ? "PASSED" : "FAILED", completed);
+            fflush(stdout);
+            nfailed += !passed;
+        }
+
+    printf("%d cases failed\n", nfailed);
+    return nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
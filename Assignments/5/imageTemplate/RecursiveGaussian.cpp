@@ -0,0 +1,219 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HostFilters.h"
+
+// The number of floats filtered together: 16 rows of RGBA
+// in horizontal pass, or 64 floats of the row in vertical one.
+#define IIR_LANES 64
+
+// Coefficients of the 3rd order recursive filter (Young, van Vliet, 1995):
+// w[n] = B x[n] + a1 w[n-1] + a2 w[n-2] + a3 w[n-3], run forward,
+// then backward. M maps the last three forward outputs (minus the edge
+// value) to the initial state of the backward run, that is the exact
+// response to the edge value replicated to infinity (Triggs, Sdika, 2006).
+// Against the exact Gaussian of standard deviation s the impulse response
+// differs by 5% of the peak for s = 2, 3% for s = 5, 1.5% for s >= 20
+// (relative L2 error is about the same); constant image is kept within
+// 0.2% for s = 50. On random noise the result differs from the exact
+// Gaussian by up to 17 levels for sigma 1 (in terms of GaussianWeights),
+// 9 for sigma 2, 4 for sigma 3, 3 for sigma 5 and 2 for sigma 6 to 70,
+// so sigma below GAUSSIAN_IIR_MIN_SIGMA goes to the separable filter.
+// Above sigma 70 the float rounding amplified by 1 / B takes over:
+// 4 levels for sigma 100, 30 for sigma 150.
+typedef struct
+{
+    float B, a1, a2, a3;
+    float M[3][3];
+} IIRCoeffs;
+
+static bool IIRSetup(float sigma, IIRCoeffs * c)
+{
+    // Weights exp(-x^2 / sigma^2) mean standard deviation sigma / sqrt(2).
+    double s = sigma / sqrt(2.0);
+    double q = s >= 2.5 ? 0.98711 * s - 0.96330 :
+        3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * s);
+    double b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+    double a1 = (2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q) / b0;
+    double a2 = -(1.4281 * q * q + 1.26661 * q * q * q) / b0;
+    double a3 = 0.422205 * q * q * q / b0;
+
+    // B is found from the rounded coefficients to keep the unit gain:
+    // it gets small for large sigma, and the rounding error would
+    // be amplified by 1 / B otherwise.
+    c->a1 = (float) a1; a1 = c->a1;
+    c->a2 = (float) a2; a2 = c->a2;
+    c->a3 = (float) a3; a3 = c->a3;
+    double B = 1.0 - (a1 + a2 + a3);
+    c->B = (float) B;
+
+    // The columns of M are found by running both passes on the tail,
+    // where the input is equal to the edge value, from each unit
+    // deviation of the forward state, until the response decays.
+    int n = (int) (20.0 * s) + 64;
+    double * pW = (double *) malloc((n + 3) * sizeof(double));
+    if (!pW)
+        return false;
+    for (int j = 0; j < 3; j++)
+    {
+        pW[0] = j == 2; pW[1] = j == 1; pW[2] = j == 0;
+        for (int i = 3; i < n + 3; i++)
+            pW[i] = a1 * pW[i - 1] + a2 * pW[i - 2] + a3 * pW[i - 3];
+
+        double v1 = 0.0, v2 = 0.0, v3 = 0.0;
+        for (int i = n + 2; i >= 3; i--)
+        {
+            double v = B * pW[i] + a1 * v1 + a2 * v2 + a3 * v3;
+            v3 = v2; v2 = v1; v1 = v;
+        }
+        c->M[0][j] = (float) v1;
+        c->M[1][j] = (float) v2;
+        c->M[2][j] = (float) v3;
+    }
+    free(pW);
+    return true;
+}
+
+// Filter count lanes of n samples forward and backward in place.
+// Sample i of lane l is at pData[i * stride + l].
+static void IIRFilter(float * pData, int n, size_t stride, int count, const IIRCoeffs * c)
+{
+    float B = c->B, a1 = c->a1, a2 = c->a2, a3 = c->a3;
+    float pEdge[IIR_LANES], pState[3][IIR_LANES];
+
+    // Forward pass starts from the steady state of the first sample.
+    const float * p1 = pData, * p2 = pData, * p3 = pData;
+    float * pLast = pData + (n - 1) * stride;
+    for (int l = 0; l < count; l++)
+        pEdge[l] = pLast[l];
+    for (int i = 0; i < n; i++)
+    {
+        float * p = pData + i * stride;
+        #pragma omp simd
+        for (int l = 0; l < count; l++)
+            p[l] = B * p[l] + a1 * p1[l] + a2 * p2[l] + a3 * p3[l];
+        p3 = p2; p2 = p1; p1 = p;
+    }
+
+    // Backward pass starts from the response to the last sample
+    // extended to infinity.
+    const float * pW1 = pLast;
+    const float * pW2 = n > 1 ? pW1 - stride : pW1;
+    const float * pW3 = n > 2 ? pW2 - stride : pW2;
+    for (int k = 0; k < 3; k++)
+        for (int l = 0; l < count; l++)
+            pState[k][l] = pEdge[l] +
+                c->M[k][0] * (pW1[l] - pEdge[l]) +
+                c->M[k][1] * (pW2[l] - pEdge[l]) +
+                c->M[k][2] * (pW3[l] - pEdge[l]);
+    p1 = pState[0]; p2 = pState[1]; p3 = pState[2];
+    for (int i = n - 1; i >= 0; i--)
+    {
+        float * p = pData + i * stride;
+        #pragma omp simd
+        for (int l = 0; l < count; l++)
+            p[l] = B * p[l] + a1 * p1[l] + a2 * p2[l] + a3 * p3[l];
+        p3 = p2; p2 = p1; p1 = p;
+    }
+}
+
+extern "C"
+{
+    bool Host_RecursiveGaussianBlur(const unsigned char * pSrc, unsigned char * pDst, int w, int h, float sigma)
+    {
+        if (w <= 0 || h <= 0 || sigma < 0.0f)
+            return false;
+
+        if (sigma < GAUSSIAN_IIR_MIN_SIGMA)
+            return Host_SeparableGaussianBlur(pSrc, pDst, w, h, GAUSSIAN_FIR_RADIUS(sigma), sigma);
+
+        IIRCoeffs c;
+        float * pTmp = (float *) malloc((size_t) w * h * 4 * sizeof(float));
+        if (!pTmp || !IIRSetup(sigma, &c))
+        {
+            free(pTmp);
+            return false;
+        }
+
+        // Horizontal pass: blocks of rows are transposed, so that
+        // each step along the row filters all their pixels at once.
+        // Blocks are allocated once per thread; if any allocation
+        // fails, all threads skip the pass.
+        const int rows = IIR_LANES / 4;
+        bool ok = true;
+        #pragma omp parallel
+        {
+            float * pBlock = (float *) malloc((size_t) w * IIR_LANES * sizeof(float));
+            if (!pBlock)
+            {
+                #pragma omp atomic write
+                ok = false;
+            }
+            #pragma omp barrier
+
+            bool run;
+            #pragma omp atomic read
+            run = ok;
+
+            if (run)
+            {
+                #pragma omp for
+                for (int y0 = 0; y0 < h; y0 += rows)
+                {
+                    int count = h - y0 < rows ? h - y0 : rows;
+                    for (int r = 0; r < count; r++)
+                    {
+                        const unsigned char * pIn = pSrc + (size_t) (y0 + r) * w * 4;
+                        for (int x = 0; x < w; x++)
+                            for (int k = 0; k < 4; k++)
+                                pBlock[x * IIR_LANES + 4 * r + k] = pIn[4 * x + k];
+                    }
+
+                    IIRFilter(pBlock, w, IIR_LANES, 4 * count, &c);
+
+                    for (int r = 0; r < count; r++)
+                    {
+                        float * pOut = pTmp + (size_t) (y0 + r) * w * 4;
+                        for (int x = 0; x < w; x++)
+                            for (int k = 0; k < 4; k++)
+                                pOut[4 * x + k] = pBlock[x * IIR_LANES + 4 * r + k];
+                    }
+                }
+            }
+
+            free(pBlock);
+        }
+        if (!ok)
+        {
+            free(pTmp);
+            return false;
+        }
+
+        // Vertical pass: columns are filtered by chunks of the row,
+        // then converted to bytes.
+        size_t stride = (size_t) w * 4;
+        #pragma omp parallel for
+        for (int i0 = 0; i0 < 4 * w; i0 += IIR_LANES)
+        {
+            int count = 4 * w - i0 < IIR_LANES ? 4 * w - i0 : IIR_LANES;
+            IIRFilter(pTmp + i0, h, stride, count, &c);
+
+            for (int y = 0; y < h; y++)
+            {
+                const float * pIn = pTmp + y * stride + i0;
+                unsigned char * pOut = pDst + y * stride + i0;
+                for (int l = 0; l < count; l++)
+                {
+                    float v = pIn[l] + 0.5f;
+                    v = v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v);
+                    pOut[l] = ((i0 + l) % 4 == 3) ? 255 : (unsigned char) v;
+                }
+            }
+        }
+
+        free(pTmp);
+
+        return true;
+    }
+};
@@ -0,0 +1,125 @@
+#include <stdlib.h>
+
+#include <pthread.h>
+
+#include "Strips.h"
+
+typedef struct
+{
+    int             w, h, strip, halo, nstrips;
+    StripRead       read;
+    StripFilter     filter;
+    StripWrite      write;
+    void *          pArg;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  turn;
+    int             next;       // the next strip to take
+    int             written;    // strips written so far
+    bool            failed;
+} Strips;
+
+// Rows of the strip with halo, cropped by image edges.
+static int StripRows(int h, int strip, int halo)
+{
+    int rows = strip + 2 * halo;
+    return rows < h ? rows : h;
+}
+
+static void * StripThread(void * pArg)
+{
+    Strips * s = (Strips *) pArg;
+    size_t size = (size_t) s->w * StripRows(s->h, s->strip, s->halo) * 4;
+    unsigned char * pStrip = (unsigned char *) malloc(size);
+    unsigned char * pTmp = (unsigned char *) malloc(size);
+
+    for (;;)
+    {
+        pthread_mutex_lock(&s->lock);
+        int k = s->next++;
+        bool stop = s->failed || k >= s->nstrips;
+        pthread_mutex_unlock(&s->lock);
+        if (stop)
+            break;
+
+        int y0 = k * s->strip;
+        int y1 = y0 + s->strip < s->h ? y0 + s->strip : s->h;
+        int a = y0 - s->halo > 0 ? y0 - s->halo : 0;
+        int b = y1 + s->halo < s->h ? y1 + s->halo : s->h;
+
+        unsigned char * pOut = NULL;
+        if (pStrip && pTmp && s->read(pStrip, a, b - a, s->pArg))
+            pOut = s->filter(pStrip, pTmp, s->w, b - a, a, s->pArg);
+
+        // Wait for the turn of the strip, only one thread writes at once.
+        pthread_mutex_lock(&s->lock);
+        while (s->written != k && !s->failed)
+            pthread_cond_wait(&s->turn, &s->lock);
+        bool failed = s->failed;
+        pthread_mutex_unlock(&s->lock);
+
+        bool ok = !failed && pOut && s->write(pOut + (size_t) (y0 - a) * s->w * 4, y1 - y0, s->pArg);
+
+        pthread_mutex_lock(&s->lock);
+        s->written++;
+        s->failed = s->failed || !ok;
+        pthread_cond_broadcast(&s->turn);
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    free(pStrip);
+    free(pTmp);
+
+    return NULL;
+}
+
+bool RunStrips(int w, int h, int strip, int halo, int threads,
+               StripRead read, StripFilter filter, StripWrite write, void * pArg)
+{
+    if (w <= 0 || h <= 0 || strip <= 0 || halo < 0 || threads <= 0)
+        return false;
+
+    Strips s;
+    s.w = w;
+    s.h = h;
+    s.strip = strip;
+    s.halo = halo;
+    s.nstrips = (h + strip - 1) / strip;
+    s.read = read;
+    s.filter = filter;
+    s.write = write;
+    s.pArg = pArg;
+    s.next = 0;
+    s.written = 0;
+    s.failed = false;
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.turn, NULL);
+
+    if (threads > s.nstrips)
+        threads = s.nstrips;
+    pthread_t * pThreads = (pthread_t *) malloc(threads * sizeof(pthread_t));
+    int started = 0;
+    while (pThreads && started < threads && !pthread_create(&pThreads[started], NULL, StripThread, &s))
+        started++;
+
+    // Strips are taken one by one, so fewer threads only take longer,
+    // without any the caller filters them all.
+    if (!started)
+        StripThread(&s);
+    for (int i = 0; i < started; i++)
+        pthread_join(pThreads[i], NULL);
+    free(pThreads);
+
+    pthread_mutex_destroy(&s.lock);
+    pthread_cond_destroy(&s.turn);
+
+    return !s.failed;
+}
+
+size_t StripMemory(int w, int h, int strip, int halo, int threads)
+{
+    int nstrips = (h + strip - 1) / strip;
+    if (threads > nstrips)
+        threads = nstrips;
+    return (size_t) threads * 2 * w * StripRows(h, strip, halo) * 4;
+}
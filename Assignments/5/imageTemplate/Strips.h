@@ -0,0 +1,29 @@
+#ifndef _STRIPS_H_
+#define _STRIPS_H_
+
+// Read rows y0 .. y0 + rows - 1 of the source image as RGBA.
+typedef bool (*StripRead)(unsigned char * pDst, int y0, int rows, void * pArg);
+
+// Filter w x h strip of image rows y0 .. y0 + h - 1, pTmp is the scratch
+// buffer of the same size. Returns the one of two buffers holding the
+// result, NULL on failure.
+typedef unsigned char * (*StripFilter)(unsigned char * pStrip, unsigned char * pTmp, int w, int h, int y0, void * pArg);
+
+// Take the next rows of the result, they come in order.
+typedef bool (*StripWrite)(const unsigned char * pSrc, int rows, void * pArg);
+
+// Filter w x h image by horizontal strips of the given number of rows,
+// each one read with halo rows above and below, so that its rows do not
+// depend on image data beyond the strip. Strips are filtered by the given
+// number of threads in parallel, each thread takes the next strip only
+// after it has written the previous one in order, so the rolling window
+// of strips in flight, and the memory, stays bounded by
+// threads x w x (strip + 2 x halo) pixels.
+// Returns false if any callback fails, the rest of strips is skipped then.
+bool RunStrips(int w, int h, int strip, int halo, int threads,
+               StripRead read, StripFilter filter, StripWrite write, void * pArg);
+
+// The memory used by strip buffers of RunStrips.
+size_t StripMemory(int w, int h, int strip, int halo, int threads);
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef _STRIPS_TEST_H_
+#define _STRIPS_TEST_H_
+
+// Self-check of strip mode: random images are filtered by box blur,
+// median and Gaussian blur in turn, by strips of 1 to 64 rows with the
+// halo of the sum of radii, on 1 to 3 threads, and must match the
+// whole image filtered at once exactly. Failing read and write callbacks
+// must stop RunStrips, and rows after the failure must not be written.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HostFilters.h"
+#include "Strips.h"
+
+#define STRIPS_TEST_BOX_RADIUS      2
+#define STRIPS_TEST_MEDIAN_RADIUS   1
+#define STRIPS_TEST_GAUSSIAN_RADIUS 3
+#define STRIPS_TEST_HALO            (STRIPS_TEST_BOX_RADIUS + STRIPS_TEST_MEDIAN_RADIUS + STRIPS_TEST_GAUSSIAN_RADIUS)
+
+typedef struct
+{
+    const unsigned char * pSrc;
+    unsigned char *       pDst;
+    int                   w, h;
+    int                   rows;       // rows written so far
+    int                   failRow;    // read or write of this row fails, -1 for none
+    bool                  failWrite;
+} StripsTest;
+
+static bool TestReadStrip(unsigned char * pDst, int y0, int rows, void * pArg)
+{
+    StripsTest * t = (StripsTest *) pArg;
+    if (!t->failWrite && t->failRow >= y0 && t->failRow < y0 + rows)
+        return false;
+    memcpy(pDst, t->pSrc + (size_t) y0 * t->w * 4, (size_t) rows * t->w * 4);
+    return true;
+}
+
+// Box blur, median and Gaussian blur of the strip or the whole image.
+static unsigned char * TestFilterStrip(unsigned char * pStrip, unsigned char * pTmp, int w, int h, int, void *)
+{
+    if (!Host_BoxBlur(pStrip, pTmp, w, h, STRIPS_TEST_BOX_RADIUS) ||
+        !Host_MedianFilter(pTmp, pStrip, w, h, STRIPS_TEST_MEDIAN_RADIUS) ||
+        !Host_GaussianBlur(pStrip, pTmp, w, h, STRIPS_TEST_GAUSSIAN_RADIUS))
+        return NULL;
+    return pTmp;
+}
+
+static bool TestWriteStrip(const unsigned char * pSrc, int rows, void * pArg)
+{
+    StripsTest * t = (StripsTest *) pArg;
+    if (t->failWrite && t->failRow >= t->rows && t->failRow < t->rows + rows)
+        return false;
+    if (t->rows + rows > t->h)
+        return false;
+    memcpy(t->pDst + (size_t) t->rows * t->w * 4, pSrc, (size_t) rows * t->w * 4);
+    t->rows += rows;
+    return true;
+}
+
+// Rows written before the strip of the failing row, the one read with
+// the halo fails before it is written.
+static int TestFailedRows(int h, int strip, int failRow, bool failWrite)
+{
+    int k = 0;
+    while ((failWrite ? (k + 1) * strip : (k + 1) * strip + STRIPS_TEST_HALO) <= failRow)
+        k++;
+    return k * strip < h ? k * strip : h;
+}
+
+// Run all cases, returns EXIT_SUCCESS if all of them passed.
+static int Strips_Test(void)
+{
+    static const int sizes[][2] = { { 1, 1 }, { 5, 7 }, { 37, 61 }, { 130, 45 } };
+    const int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    static const int strips[] = { 1, 7, 64 };
+    const int nstrips = sizeof(strips) / sizeof(strips[0]);
+
+    srand(1);
+    int nfailed = 0;
+    printf("strips\tsize\tstrip\tthreads\ttest\n");
+    for (int s = 0; s < nsizes; s++)
+    {
+        int w = sizes[s][0], h = sizes[s][1];
+        size_t size = (size_t) w * h * 4;
+        unsigned char * pSrc = (unsigned char *) malloc(size);
+        unsigned char * pRef = (unsigned char *) malloc(size);
+        unsigned char * pTmp = (unsigned char *) malloc(size);
+        unsigned char * pDst = (unsigned char *) malloc(size);
+        if (!pSrc || !pRef || !pTmp || !pDst)
+        {
+            fprintf(stderr, "Cannot allocate test images\n");
+            free(pSrc);
+            free(pRef);
+            free(pTmp);
+            free(pDst);
+            return EXIT_FAILURE;
+        }
+        for (size_t i = 0; i < size; i++)
+            pSrc[i] = (unsigned char) rand();
+        memcpy(pRef, pSrc, size);
+        const unsigned char * pWhole = TestFilterStrip(pRef, pTmp, w, h, 0, NULL);
+
+        StripsTest t;
+        t.pSrc = pSrc;
+        t.pDst = pDst;
+        t.w = w;
+        t.h = h;
+        for (int k = 0; k < nstrips; k++)
+            for (int threads = 1; threads <= 3; threads += 2)
+            {
+                t.rows = 0;
+                t.failRow = -1;
+                t.failWrite = false;
+                memset(pDst, 0, size);
+                bool passed = pWhole && RunStrips(w, h, strips[k], STRIPS_TEST_HALO, threads,
+                    TestReadStrip, TestFilterStrip, TestWriteStrip, &t) && t.rows == h && !memcmp(pDst, pWhole, size);
+                printf("whole\t%dx%d\t%d\t%d\t%s\n", w, h, strips[k], threads, passed ? "PASSED" : "FAILED");
+                fflush(stdout);
+                nfailed += !passed;
+
+                // Fail the middle row, strips before it must be written,
+                // none after it.
+                for (int failWrite = 0; failWrite < 2; failWrite++)
+                {
+                    t.rows = 0;
+                    t.failRow = h / 2;
+                    t.failWrite = failWrite != 0;
+                    passed = !RunStrips(w, h, strips[k], STRIPS_TEST_HALO, threads,
+                        TestReadStrip, TestFilterStrip, TestWriteStrip, &t) && t.rows == TestFailedRows(h, strips[k], t.failRow, t.failWrite);
+                    printf("%s\t%dx%d\t%d\t%d\t%s\n", failWrite ? "nowrite" : "noread", w, h, strips[k], threads,
+                        passed ? "PASSED" : "FAILED");
+                    fflush(stdout);
+                    nfailed += !passed;
+                }
+            }
+
+        free(pSrc);
+        free(pRef);
+        free(pTmp);
+        free(pDst);
+    }
+
+    printf("%d cases failed\n", nfailed);
+    return nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef _BMP_FORMAT_H_
+#define _BMP_FORMAT_H_
+
+#pragma pack(push)
+#pragma pack(1)
+
+typedef struct
+{
+    short type;
+    int size;
+    short reserved1;
+    short reserved2;
+    int offset;
+} BMPHeader;
+
+typedef struct
+{
+    int size;
+    int width;
+    int height;
+    short planes;
+    short bitsPerPixel;
+    unsigned compression;
+    unsigned imageSize;
+    int xPelsPerMeter;
+    int yPelsPerMeter;
+    int clrUsed;
+    int clrImportant;
+} BMPInfoHeader;
+
+#pragma pack(pop)
+
+#endif
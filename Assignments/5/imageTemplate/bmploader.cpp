@@ -1,121 +1,337 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   include <immintrin.h>
+#   define HAVE_X86_SIMD
+#endif
 
 #include "bmploader.h"
+#include "bmpformat.h"
 
 #ifdef _WIN32
-#   pragma warning( disable : 4996 ) // disable deprecated warning 
+#   pragma warning( disable : 4996 ) // disable deprecated warning
 #endif
 
+// Images of more pixels are converted by rows in parallel.
+#define PARALLEL_PIXELS (1 << 20)
+
+// Files up to this size are read ahead entirely when mapped.
+#define PREFETCH_SIZE (256 << 20)
+
 #pragma pack(push)
 #pragma pack(1)
 
+//Isolated definition
 typedef struct
 {
-    short type;
-    int size;
-    short reserved1;
-    short reserved2;
-    int offset;
-} BMPHeader;
+    unsigned char x, y, z, w;
+} uchar4;
 
-typedef struct
+#pragma pack(pop)
+
+// Convert the row of w pixels from BMP order into RGBA with opaque alpha.
+typedef void (*ConvertRowFunc)(uchar4 *dst, const unsigned char *src, int w);
+
+static void ConvertRowBGR(uchar4 *dst, const unsigned char *src, int w)
 {
-    int size;
-    int width;
-    int height;
-    short planes;
-    short bitsPerPixel;
-    unsigned compression;
-    unsigned imageSize;
-    int xPelsPerMeter;
-    int yPelsPerMeter;
-    int clrUsed;
-    int clrImportant;
-} BMPInfoHeader;
+    for(int x = 0; x < w; x++){
+        dst[x].x = src[3 * x + 2];
+        dst[x].y = src[3 * x + 1];
+        dst[x].z = src[3 * x + 0];
+        dst[x].w = 255;
+    }
+}
 
+static void ConvertRowBGRA(uchar4 *dst, const unsigned char *src, int w)
+{
+    for(int x = 0; x < w; x++){
+        dst[x].x = src[4 * x + 2];
+        dst[x].y = src[4 * x + 1];
+        dst[x].z = src[4 * x + 0];
+        dst[x].w = 255;
+    }
+}
 
-//Isolated definition
-typedef struct
+#ifdef HAVE_X86_SIMD
+
+// Byte shuffles of 4 pixels: BGR or BGRA into RGB0, alpha is or-ed then.
+#define SHUFFLE_BGR  2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1
+#define SHUFFLE_BGRA 2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1
+
+// 16-byte loads of 4 pixels read 4 bytes beyond them,
+// so the last pixels of the row are left to the scalar code.
+__attribute__((target("ssse3")))
+static void ConvertRowBGR_SSSE3(uchar4 *dst, const unsigned char *src, int w)
 {
-    unsigned char x, y, z, w;
-} uchar4;
+    const __m128i shuffle = _mm_setr_epi8(SHUFFLE_BGR);
+    const __m128i alpha = _mm_set1_epi32(0xFF000000);
+    int x = 0;
+    for(; x + 6 <= w; x += 4){
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 3 * x));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha));
+    }
+    ConvertRowBGR(dst + x, src + 3 * x, w - x);
+}
 
-#pragma pack(pop)
+__attribute__((target("ssse3")))
+static void ConvertRowBGRA_SSSE3(uchar4 *dst, const unsigned char *src, int w)
+{
+    const __m128i shuffle = _mm_setr_epi8(SHUFFLE_BGRA);
+    const __m128i alpha = _mm_set1_epi32(0xFF000000);
+    int x = 0;
+    for(; x + 4 <= w; x += 4){
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 4 * x));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha));
+    }
+    ConvertRowBGRA(dst + x, src + 4 * x, w - x);
+}
 
+// 8 pixels of BGR are loaded as two 12-byte halves into 128-bit lanes.
+__attribute__((target("avx2")))
+static void ConvertRowBGR_AVX2(uchar4 *dst, const unsigned char *src, int w)
+{
+    const __m256i shuffle = _mm256_setr_epi8(SHUFFLE_BGR, SHUFFLE_BGR);
+    const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+    int x = 0;
+    for(; x + 10 <= w; x += 8){
+        __m128i lo = _mm_loadu_si128((const __m128i *)(src + 3 * x));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(src + 3 * x + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha));
+    }
+    ConvertRowBGR(dst + x, src + 3 * x, w - x);
+}
 
-extern "C" 
+__attribute__((target("avx2")))
+static void ConvertRowBGRA_AVX2(uchar4 *dst, const unsigned char *src, int w)
 {
-    bool LoadBMPFile(void **pDst, int *width, int *height, const char *name)
+    const __m256i shuffle = _mm256_setr_epi8(SHUFFLE_BGRA, SHUFFLE_BGRA);
+    const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+    int x = 0;
+    for(; x + 8 <= w; x += 8){
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + 4 * x));
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha));
+    }
+    ConvertRowBGRA(dst + x, src + 4 * x, w - x);
+}
+
+#endif
+
+// Select the fastest row conversion supported by CPU.
+static ConvertRowFunc SelectConvertRow(int bitsPerPixel)
+{
+#ifdef HAVE_X86_SIMD
+    if(__builtin_cpu_supports("avx2"))
+        return bitsPerPixel == 24 ? ConvertRowBGR_AVX2 : ConvertRowBGRA_AVX2;
+    if(__builtin_cpu_supports("ssse3"))
+        return bitsPerPixel == 24 ? ConvertRowBGR_SSSE3 : ConvertRowBGRA_SSSE3;
+#endif
+    return bitsPerPixel == 24 ? ConvertRowBGR : ConvertRowBGRA;
+}
+
+extern "C"
+{
+    bool MapBMPFile(const void **pData, size_t *pSize, const char *name)
     {
-        BMPHeader hdr;
-        BMPInfoHeader infoHdr;
-        int x, y;
+#ifdef _WIN32
+        HANDLE file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if(file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        HANDLE mapping = NULL;
+        if(GetFileSizeEx(file, &size) && size.QuadPart > 0)
+            mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if(!mapping)
+            return false;
+        void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if(!data)
+            return false;
+        *pSize = (size_t)size.QuadPart;
+#else
+        int fd = open(name, O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat st;
+        void *data = MAP_FAILED;
+        if(!fstat(fd, &st) && st.st_size > 0)
+            data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(data == MAP_FAILED)
+            return false;
 
-        FILE *fd;
+        // Start reading ahead, pages are converted in order. Huge files
+        // are read on demand, not to evict their own first pages.
+        posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+        if(st.st_size <= PREFETCH_SIZE)
+            posix_madvise(data, st.st_size, POSIX_MADV_WILLNEED);
+        *pSize = st.st_size;
+#endif
+        *pData = data;
+        return true;
+    }
 
+    void UnmapBMPFile(const void *data, size_t size)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap((void *)data, size);
+#endif
+    }
+
+    bool LoadBMPFile(void **pDst, int *width, int *height, const char *name)
+    {
         printf("Loading %s...\n", name);
         if(sizeof(uchar4) != 4){
             printf("***Bad uchar4 size***\n");
             return false;
         }
 
-        if( !(fd = fopen(name,"rb")) ){
+        const void *data;
+        size_t size;
+        if(!MapBMPFile(&data, &size, name)){
             printf("***BMP load error: file access denied***\n");
             return false;
         }
 
-        fread(&hdr, sizeof(hdr), 1, fd);
-        if(hdr.type != 0x4D42){
-            printf("***BMP load error: bad file format***\n");
+        bool ok = DecodeBMP(pDst, width, height, data, size);
+        UnmapBMPFile(data, size);
+        if(!ok){
+            printf("***BMP load error: bad file %s***\n", name);
             return false;
         }
-        fread(&infoHdr, sizeof(infoHdr), 1, fd);
 
-        if(infoHdr.bitsPerPixel != 24){
-            printf("***BMP load error: invalid color depth***\n");
+        printf("BMP width: %u\n", *width);
+        printf("BMP height: %u\n", *height);
+        printf("BMP file loaded successfully!\n");
+
+        return true;
+    }
+
+    bool ParseBMP(BMPLayout *layout, const void *pData, size_t size)
+    {
+        BMPHeader hdr;
+        BMPInfoHeader infoHdr;
+        const unsigned char *src = (const unsigned char *)pData;
+
+        if(size < sizeof(hdr) + sizeof(infoHdr)){
+            fprintf(stderr, "***BMP decode error: truncated header***\n");
             return false;
         }
+        memcpy(&hdr, src, sizeof(hdr));
+        memcpy(&infoHdr, src + sizeof(hdr), sizeof(infoHdr));
 
-        if(infoHdr.compression){
-            printf("***BMP load error: compressed image***\n");
+        if(hdr.type != 0x4D42 || infoHdr.size < (int)sizeof(infoHdr) || infoHdr.planes != 1){
+            fprintf(stderr, "***BMP decode error: bad file format***\n");
+            return false;
+        }
+        int bpp = infoHdr.bitsPerPixel;
+        if(bpp != 24 && bpp != 32){
+            fprintf(stderr, "***BMP decode error: invalid color depth***\n");
             return false;
         }
 
-        *width  = infoHdr.width;
-        *height = infoHdr.height;
-
-        uchar4 * dst = (uchar4 *)malloc(*width * *height * 4);
+        // 32-bit files may give the standard BGRA layout by bit masks,
+        // which follow the header of 40 bytes, or are its part.
+        bool bitfields = false;
+        if(bpp == 32 && infoHdr.compression == 3){
+            unsigned int masks[3] = { 0, 0, 0 };
+            size_t at = sizeof(hdr) + sizeof(infoHdr);
+            if(size >= at + sizeof(masks))
+                memcpy(masks, src + at, sizeof(masks));
+            bitfields = masks[0] == 0x00FF0000 && masks[1] == 0x0000FF00 && masks[2] == 0x000000FF;
+        }
+        if(infoHdr.compression && !bitfields){
+            fprintf(stderr, "***BMP decode error: compressed image***\n");
+            return false;
+        }
 
-        printf("BMP width: %u\n", infoHdr.width);
-        printf("BMP height: %u\n", infoHdr.height);
+        // Negative height means top-down rows.
+        int w = infoHdr.width;
+        bool topDown = infoHdr.height < 0;
+        int h = topDown ? -infoHdr.height : infoHdr.height;
+        if(w <= 0 || h <= 0 || hdr.offset < 0 || (size_t)hdr.offset > size){
+            fprintf(stderr, "***BMP decode error: bad image size***\n");
+            return false;
+        }
+        size_t avail = size - hdr.offset;
+        size_t pitch = (((size_t)bpp * w + 31) / 32) * 4;
+        if((size_t)w > avail / h / (bpp / 8) || pitch * h > avail){
+            fprintf(stderr, "***BMP decode error: truncated image***\n");
+            return false;
+        }
 
-        fseek(fd, hdr.offset - sizeof(hdr) - sizeof(infoHdr), SEEK_CUR);
+        layout->width = w;
+        layout->height = h;
+        layout->bitsPerPixel = bpp;
+        layout->topDown = topDown;
+        layout->pitch = pitch;
+        layout->pixels = src + hdr.offset;
 
-        for(y = 0; y < infoHdr.height; y++){
-            for(x = 0; x < infoHdr.width; x++){
-                dst[(y * infoHdr.width + x)].z = fgetc(fd);
-                dst[(y * infoHdr.width + x)].y = fgetc(fd);
-                dst[(y * infoHdr.width + x)].x = fgetc(fd);
-            }
+        return true;
+    }
 
-            for(x = 0; x < (4 - (3 * infoHdr.width) % 4) % 4; x++)
-                fgetc(fd);
+    void DecodeBMPRows(void *pDst, const BMPLayout *layout, int y0, int rows)
+    {
+        // Rows are stored bottom-up, like in GL textures.
+        ConvertRowFunc convert = SelectConvertRow(layout->bitsPerPixel);
+        uchar4 *dst = (uchar4 *)pDst;
+        int w = layout->width, h = layout->height;
+        #pragma omp parallel for if ((size_t)w * rows >= PARALLEL_PIXELS)
+        for(int y = 0; y < rows; y++){
+            int row = layout->topDown ? h - 1 - (y0 + y) : y0 + y;
+            convert(dst + (size_t)y * w, layout->pixels + layout->pitch * row, w);
         }
+    }
+
+    void ReleaseBMPRows(const BMPLayout *layout, int y0, int rows)
+    {
+#if !defined(_WIN32) && defined(MADV_DONTNEED)
+        // Only whole pages inside the rows are released.
+        int first = layout->topDown ? layout->height - (y0 + rows) : y0;
+        uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+        uintptr_t begin = (uintptr_t)(layout->pixels + layout->pitch * first);
+        uintptr_t end = begin + layout->pitch * rows;
+        begin = (begin + page - 1) & ~(page - 1);
+        end &= ~(page - 1);
+        if(begin < end)
+            madvise((void *)begin, end - begin, MADV_DONTNEED);
+#endif
+    }
 
+    bool DecodeBMP(void **pDst, int *width, int *height, const void *pData, size_t size)
+    {
+        BMPLayout layout;
+        if(!ParseBMP(&layout, pData, size))
+            return false;
 
-        if(ferror(fd))
-        {
-            printf("***Unknown BMP load error.***\n");
-            free(dst);
+        uchar4 * dst = (uchar4 *)malloc((size_t)layout.width * layout.height * 4);
+        if(!dst){
+            fprintf(stderr, "***BMP decode error: out of memory***\n");
             return false;
-        }else
-            printf("BMP file loaded successfully!\n");
+        }
 
-        *pDst = dst;
+        DecodeBMPRows(dst, &layout, 0, layout.height);
 
-        fclose(fd);
+        *width  = layout.width;
+        *height = layout.height;
+        *pDst = dst;
 
         return true;
     }
-}
\ No newline at end of file
+}
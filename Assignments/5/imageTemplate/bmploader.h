@@ -1,7 +1,44 @@
 #ifndef _BMP_LOADER_H_
 #define _BMP_LOADER_H_
 
+#include <stddef.h>
+
 extern "C"
 bool LoadBMPFile(void **dst, int *width, int *height, const char *name);
 
+// Decode BMP file contents of the given size into RGBA image, rows go
+// bottom-up. 24-bit and 32-bit images of either row order are accepted.
+extern "C"
+bool DecodeBMP(void **dst, int *width, int *height, const void *data, size_t size);
+
+// Location of rows in BMP file contents.
+typedef struct
+{
+    int width, height;
+    int bitsPerPixel;
+    bool topDown;
+    size_t pitch;
+    const unsigned char *pixels;
+} BMPLayout;
+
+// Validate headers of BMP file contents of the given size and locate rows.
+extern "C"
+bool ParseBMP(BMPLayout *layout, const void *data, size_t size);
+
+// Convert rows y0 .. y0 + rows - 1, counted bottom-up, into RGBA.
+extern "C"
+void DecodeBMPRows(void *dst, const BMPLayout *layout, int y0, int rows);
+
+// Let the system drop pages of mapped rows, which are decoded already;
+// they are read again from the file, if touched.
+extern "C"
+void ReleaseBMPRows(const BMPLayout *layout, int y0, int rows);
+
+// Map the whole file into memory read-only, DecodeBMP reads it in place.
+extern "C"
+bool MapBMPFile(const void **data, size_t *size, const char *name);
+
+extern "C"
+void UnmapBMPFile(const void *data, size_t size);
+
 #endif
\ No newline at end of file
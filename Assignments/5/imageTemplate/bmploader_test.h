@@ -0,0 +1,167 @@
+#ifndef _BMP_LOADER_TEST_H_
+#define _BMP_LOADER_TEST_H_
+
+// Self-check of BMP decoding: random images are stored into 24-bit and
+// 32-bit BMP contents of both row orders by hand, and must be decoded
+// back exactly, from memory, from the mapped file, and by ranges of rows.
+// Contents short by one byte must be rejected. Images encoded by
+// EncodeBMP must be decoded back as well.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include "bmpformat.h"
+#include "bmploader.h"
+#include "bmpwriter.h"
+
+// Store w x h RGBA image into BMP contents allocated with malloc.
+static unsigned char * TestStoreBMP(const unsigned char * pSrc, int w, int h, int bpp, bool topDown, size_t * pSize)
+{
+    BMPHeader hdr;
+    BMPInfoHeader infoHdr;
+    size_t pitch = ((size_t) bpp * w + 31) / 32 * 4;
+    size_t offset = sizeof(hdr) + sizeof(infoHdr);
+    *pSize = offset + pitch * h;
+    unsigned char * pData = (unsigned char *) calloc(*pSize, 1);
+    if (!pData)
+        return NULL;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memset(&infoHdr, 0, sizeof(infoHdr));
+    hdr.type = 0x4D42;
+    hdr.size = (int) *pSize;
+    hdr.offset = (int) offset;
+    infoHdr.size = sizeof(infoHdr);
+    infoHdr.width = w;
+    infoHdr.height = topDown ? -h : h;
+    infoHdr.planes = 1;
+    infoHdr.bitsPerPixel = (short) bpp;
+    memcpy(pData, &hdr, sizeof(hdr));
+    memcpy(pData + sizeof(hdr), &infoHdr, sizeof(infoHdr));
+
+    // Rows of the image go bottom-up, alpha of 32-bit files is random,
+    // it must be ignored.
+    for (int y = 0; y < h; y++)
+    {
+        unsigned char * pRow = pData + offset + pitch * (topDown ? h - 1 - y : y);
+        for (int x = 0; x < w; x++)
+        {
+            const unsigned char * p = pSrc + 4 * ((size_t) y * w + x);
+            unsigned char * q = pRow + x * (bpp / 8);
+            q[0] = p[2];
+            q[1] = p[1];
+            q[2] = p[0];
+            if (bpp == 32)
+                q[3] = (unsigned char) rand();
+        }
+    }
+    return pData;
+}
+
+// Compare RGB of the decoded image, which alpha must be 255.
+static bool TestSameRGB(const unsigned char * pImage, const unsigned char * pRef, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; i++)
+        if (memcmp(pImage + 4 * i, pRef + 4 * i, 3) || pImage[4 * i + 3] != 255)
+            return false;
+    return true;
+}
+
+// Decode contents from memory, then from the file, the middle third
+// of rows alone, and check that truncated contents are rejected.
+static bool TestDecodeBMP(const unsigned char * pData, size_t size, const unsigned char * pSrc, int w, int h)
+{
+    void * pImage = NULL;
+    int iw = 0, ih = 0;
+    bool ok = DecodeBMP(&pImage, &iw, &ih, pData, size) && iw == w && ih == h &&
+        TestSameRGB((const unsigned char *) pImage, pSrc, (size_t) w * h);
+    free(pImage);
+    pImage = NULL;
+
+    char name[] = "/tmp/bmptestXXXXXX";
+    int fd = mkstemp(name);
+    if (fd < 0)
+        return false;
+    ok = ok && write(fd, pData, size) == (ssize_t) size;
+    close(fd);
+    const void * pMap;
+    size_t mapSize;
+    if (ok && MapBMPFile(&pMap, &mapSize, name))
+    {
+        ok = mapSize == size && DecodeBMP(&pImage, &iw, &ih, pMap, mapSize) && iw == w && ih == h &&
+            TestSameRGB((const unsigned char *) pImage, pSrc, (size_t) w * h);
+        free(pImage);
+        UnmapBMPFile(pMap, mapSize);
+    }
+    else
+        ok = false;
+    unlink(name);
+
+    BMPLayout layout;
+    int y0 = h / 3, rows = h - 2 * (h / 3);
+    unsigned char * pRows = (unsigned char *) malloc((size_t) w * rows * 4);
+    ok = ok && pRows && ParseBMP(&layout, pData, size);
+    if (ok)
+    {
+        DecodeBMPRows(pRows, &layout, y0, rows);
+        ok = TestSameRGB(pRows, pSrc + (size_t) y0 * w * 4, (size_t) w * rows);
+    }
+    free(pRows);
+
+    return ok && !ParseBMP(&layout, pData, size - 1);
+}
+
+// Run all cases, returns EXIT_SUCCESS if all of them passed.
+static int BMPLoader_Test(void)
+{
+    static const int sizes[][2] = { { 1, 1 }, { 3, 2 }, { 5, 7 }, { 37, 61 }, { 130, 45 } };
+    const int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    srand(1);
+    int nfailed = 0;
+    printf("bmp\tsize\tformat\ttest\n");
+    for (int s = 0; s < nsizes; s++)
+    {
+        int w = sizes[s][0], h = sizes[s][1];
+        unsigned char * pSrc = (unsigned char *) malloc((size_t) w * h * 4);
+        if (!pSrc)
+        {
+            fprintf(stderr, "Cannot allocate test images\n");
+            return EXIT_FAILURE;
+        }
+        for (size_t i = 0; i < (size_t) w * h * 4; i++)
+            pSrc[i] = (unsigned char) rand();
+
+        for (int bpp = 24; bpp <= 32; bpp += 8)
+            for (int topDown = 0; topDown < 2; topDown++)
+            {
+                size_t size;
+                unsigned char * pData = TestStoreBMP(pSrc, w, h, bpp, topDown != 0, &size);
+                bool passed = pData && TestDecodeBMP(pData, size, pSrc, w, h);
+                free(pData);
+                printf("decode\t%dx%d\t%d%s\t%s\n", w, h, bpp, topDown ? " top-down" : "",
+                    passed ? "PASSED" : "FAILED");
+                fflush(stdout);
+                nfailed += !passed;
+            }
+
+        void * pData = NULL;
+        size_t size;
+        bool passed = EncodeBMP(&pData, &size, pSrc, w, h) &&
+            TestDecodeBMP((const unsigned char *) pData, size, pSrc, w, h);
+        free(pData);
+        printf("encode\t%dx%d\t24\t%s\n", w, h, passed ? "PASSED" : "FAILED");
+        fflush(stdout);
+        nfailed += !passed;
+
+        free(pSrc);
+    }
+
+    printf("%d cases failed\n", nfailed);
+    return nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
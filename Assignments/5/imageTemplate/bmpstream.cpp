@@ -0,0 +1,194 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bmpstream.h"
+#include "bmpwriter.h"
+
+// The size of each of two blocks written at once.
+#define BMP_STREAM_BLOCK (4 << 20)
+
+struct BMPStream
+{
+    char *          name;
+    int             fd;
+    int             width, height, bitsPerPixel;
+    size_t          pitch;
+    int             rows;           // rows appended so far
+
+    unsigned char * pBlocks[2];
+    size_t          blockSize;
+    size_t          pending[2];     // bytes given to the writer, zero when the block is free
+    int             current;        // block filled by the caller
+    size_t          fill;
+
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    bool            closing;
+    bool            failed;
+};
+
+static bool WriteAll(int fd, const unsigned char *data, size_t size)
+{
+    while(size){
+        ssize_t n = write(fd, data, size);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Write blocks in the order they are given, until the stream is closed.
+static void *WriterThread(void *pArg)
+{
+    BMPStream *s = (BMPStream *)pArg;
+    for(int i = 0; ; i ^= 1){
+        pthread_mutex_lock(&s->lock);
+        while(!s->pending[i] && !s->closing)
+            pthread_cond_wait(&s->cond, &s->lock);
+        size_t size = s->pending[i];
+        bool failed = s->failed;
+        pthread_mutex_unlock(&s->lock);
+        if(!size)
+            break;
+
+        // After the error blocks are only released.
+        bool ok = failed || WriteAll(s->fd, s->pBlocks[i], size);
+
+        pthread_mutex_lock(&s->lock);
+        s->failed = s->failed || !ok;
+        s->pending[i] = 0;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+    }
+    return NULL;
+}
+
+// Give the current block to the writer and wait for the other one.
+static void SwapBlocks(BMPStream *s)
+{
+    pthread_mutex_lock(&s->lock);
+    s->pending[s->current] = s->fill;
+    s->current ^= 1;
+    pthread_cond_broadcast(&s->cond);
+    while(s->pending[s->current])
+        pthread_cond_wait(&s->cond, &s->lock);
+    pthread_mutex_unlock(&s->lock);
+    s->fill = 0;
+}
+
+extern "C"
+{
+    BMPStream *OpenBMPStream(const char *name, int width, int height, int bitsPerPixel)
+    {
+        if(width <= 0 || height <= 0 || (bitsPerPixel != 24 && bitsPerPixel != 32))
+            return NULL;
+
+        BMPStream *s = (BMPStream *)calloc(1, sizeof(BMPStream));
+        if(!s)
+            return NULL;
+        s->name = strdup(name);
+        s->width = width;
+        s->height = height;
+        s->bitsPerPixel = bitsPerPixel;
+        s->pitch = BMPPitch(width, bitsPerPixel);
+
+        // Blocks hold whole rows, at least one besides headers.
+        size_t rows = BMP_STREAM_BLOCK / s->pitch;
+        s->blockSize = (rows > 1 ? rows : 2) * s->pitch;
+        s->pBlocks[0] = (unsigned char *)malloc(s->blockSize);
+        s->pBlocks[1] = (unsigned char *)malloc(s->blockSize);
+
+        s->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(s->fd < 0 || !s->name || !s->pBlocks[0] || !s->pBlocks[1]){
+            fprintf(stderr, "***BMP save error: cannot create %s***\n", name);
+            if(s->fd >= 0)
+                close(s->fd);
+            free(s->pBlocks[0]);
+            free(s->pBlocks[1]);
+            free(s->name);
+            free(s);
+            return NULL;
+        }
+
+        s->fill = EncodeBMPHeader(s->pBlocks[0], width, height, bitsPerPixel);
+
+        pthread_mutex_init(&s->lock, NULL);
+        pthread_cond_init(&s->cond, NULL);
+        if(pthread_create(&s->thread, NULL, WriterThread, s)){
+            fprintf(stderr, "***BMP save error: cannot start the writer of %s***\n", name);
+            close(s->fd);
+            pthread_mutex_destroy(&s->lock);
+            pthread_cond_destroy(&s->cond);
+            free(s->pBlocks[0]);
+            free(s->pBlocks[1]);
+            free(s->name);
+            free(s);
+            return NULL;
+        }
+
+        return s;
+    }
+
+    bool WriteBMPStream(BMPStream *s, const void *pSrc, int rows)
+    {
+        const unsigned char *src = (const unsigned char *)pSrc;
+        if(rows > s->height - s->rows)
+            rows = s->height - s->rows;
+        s->rows += rows;
+
+        while(rows > 0){
+            size_t room = (s->blockSize - s->fill) / s->pitch;
+            int n = rows < (int)room ? rows : (int)room;
+            if(n){
+                EncodeBMPRows(s->pBlocks[s->current] + s->fill, src, s->width, n, s->bitsPerPixel);
+                s->fill += s->pitch * n;
+                src += (size_t)s->width * 4 * n;
+                rows -= n;
+            }
+            if(s->fill + s->pitch > s->blockSize)
+                SwapBlocks(s);
+        }
+
+        pthread_mutex_lock(&s->lock);
+        bool ok = !s->failed;
+        pthread_mutex_unlock(&s->lock);
+        return ok;
+    }
+
+    bool CloseBMPStream(BMPStream *s)
+    {
+        if(s->fill)
+            SwapBlocks(s);
+
+        pthread_mutex_lock(&s->lock);
+        s->closing = true;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+        pthread_join(s->thread, NULL);
+
+        bool ok = !s->failed && s->rows == s->height;
+        ok = !close(s->fd) && ok;
+        if(!ok)
+            fprintf(stderr, "***BMP save error: cannot write %s***\n", s->name);
+
+        pthread_mutex_destroy(&s->lock);
+        pthread_cond_destroy(&s->cond);
+        free(s->pBlocks[0]);
+        free(s->pBlocks[1]);
+        free(s->name);
+        free(s);
+
+        return ok;
+    }
+}
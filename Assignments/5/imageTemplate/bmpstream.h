@@ -0,0 +1,21 @@
+#ifndef _BMP_STREAM_H_
+#define _BMP_STREAM_H_
+
+// BMP file written row by row while the image is still computed. Rows
+// are packed into one of two blocks, while the other one is written
+// by the background thread, so that encoding overlaps disk writes.
+typedef struct BMPStream BMPStream;
+
+// Create the file of 24-bit or 32-bit w x h image, rows go bottom-up.
+extern "C"
+BMPStream *OpenBMPStream(const char *name, int width, int height, int bitsPerPixel);
+
+// Append the given number of RGBA rows, returns false after write error.
+extern "C"
+bool WriteBMPStream(BMPStream *stream, const void *src, int rows);
+
+// Flush and close the file, returns false if it is not written completely.
+extern "C"
+bool CloseBMPStream(BMPStream *stream);
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef _BMP_STREAM_TEST_H_
+#define _BMP_STREAM_TEST_H_
+
+// Self-check of BMP streams: random images are written by chunks of
+// 1 to 7 rows, including images of several blocks and rows longer
+// than a block, and must be decoded back exactly from the file; 24-bit
+// files must match EncodeBMP byte for byte. Streams closed before the
+// last row and files which cannot be created must be reported.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include "bmploader.h"
+#include "bmploader_test.h"
+#include "bmpstream.h"
+#include "bmpwriter.h"
+
+// Write the image by chunks into the stream of the given file, all of
+// them or all but the last row, returns the result of CloseBMPStream.
+static bool TestWriteStream(const char * name, const unsigned char * pSrc, int w, int h, int bpp, int rows)
+{
+    BMPStream * pStream = OpenBMPStream(name, w, h, bpp);
+    if (!pStream)
+        return false;
+    bool ok = true;
+    for (int y = 0, n = 1; y < rows; y += n, n = n % 7 + 1)
+        ok = WriteBMPStream(pStream, pSrc + (size_t) y * w * 4, y + n < rows ? n : rows - y) && ok;
+    return CloseBMPStream(pStream) && ok;
+}
+
+// Check the file against the image, and 24-bit one against EncodeBMP.
+static bool TestStreamFile(const char * name, const unsigned char * pSrc, int w, int h, int bpp)
+{
+    const void * pMap;
+    size_t mapSize;
+    if (!MapBMPFile(&pMap, &mapSize, name))
+        return false;
+
+    void * pImage = NULL;
+    int iw = 0, ih = 0;
+    bool ok = DecodeBMP(&pImage, &iw, &ih, pMap, mapSize) && iw == w && ih == h &&
+        TestSameRGB((const unsigned char *) pImage, pSrc, (size_t) w * h);
+    free(pImage);
+
+    if (ok && bpp == 24)
+    {
+        void * pData = NULL;
+        size_t size;
+        ok = EncodeBMP(&pData, &size, pSrc, w, h) && size == mapSize && !memcmp(pData, pMap, size);
+        free(pData);
+    }
+    UnmapBMPFile(pMap, mapSize);
+    return ok;
+}
+
+// Run all cases, returns EXIT_SUCCESS if all of them passed.
+static int BMPStream_Test(void)
+{
+    // 1500x1000 takes 2 blocks, rows of 1200000 pixels are longer than one.
+    static const int sizes[][2] = { { 1, 1 }, { 3, 2 }, { 37, 61 }, { 130, 45 }, { 1500, 1000 }, { 1200000, 3 } };
+    const int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    char name[] = "/tmp/bmpstreamXXXXXX";
+    int fd = mkstemp(name);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Cannot create the test file\n");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+
+    srand(1);
+    int nfailed = 0;
+    printf("stream\tsize\tformat\ttest\n");
+    for (int s = 0; s < nsizes; s++)
+    {
+        int w = sizes[s][0], h = sizes[s][1];
+        unsigned char * pSrc = (unsigned char *) malloc((size_t) w * h * 4);
+        if (!pSrc)
+        {
+            fprintf(stderr, "Cannot allocate test images\n");
+            unlink(name);
+            return EXIT_FAILURE;
+        }
+        for (size_t i = 0; i < (size_t) w * h * 4; i++)
+            pSrc[i] = (unsigned char) rand();
+
+        for (int bpp = 24; bpp <= 32; bpp += 8)
+        {
+            bool passed = TestWriteStream(name, pSrc, w, h, bpp, h) && TestStreamFile(name, pSrc, w, h, bpp);
+            printf("write\t%dx%d\t%d\t%s\n", w, h, bpp, passed ? "PASSED" : "FAILED");
+            fflush(stdout);
+            nfailed += !passed;
+        }
+
+        bool passed = !TestWriteStream(name, pSrc, w, h, 24, h - 1);
+        printf("short\t%dx%d\t24\t%s\n", w, h, passed ? "PASSED" : "FAILED");
+        fflush(stdout);
+        nfailed += !passed;
+
+        free(pSrc);
+    }
+    unlink(name);
+
+    bool passed = !OpenBMPStream("/nonexistent/stream.bmp", 1, 1, 24);
+    printf("create\t1x1\t24\t%s\n", passed ? "PASSED" : "FAILED");
+    nfailed += !passed;
+
+    printf("%d cases failed\n", nfailed);
+    return nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   include <immintrin.h>
+#   define HAVE_X86_SIMD
+#endif
+
+#include "bmpwriter.h"
+#include "bmpformat.h"
+
+#ifdef _WIN32
+#   pragma warning( disable : 4996 ) // disable deprecated warning 
+#endif
+
+// Images of more pixels are packed by rows in parallel.
+#define PARALLEL_PIXELS (1 << 20)
+
+// Pack the row of w RGBA pixels into BMP order: BGR or BGRA.
+typedef void (*PackRowFunc)(unsigned char *dst, const unsigned char *src, int w);
+
+static void PackRowBGR(unsigned char *dst, const unsigned char *src, int w)
+{
+    for(int x = 0; x < w; x++){
+        dst[3 * x + 0] = src[4 * x + 2];
+        dst[3 * x + 1] = src[4 * x + 1];
+        dst[3 * x + 2] = src[4 * x + 0];
+    }
+}
+
+static void PackRowBGRA(unsigned char *dst, const unsigned char *src, int w)
+{
+    for(int x = 0; x < w; x++){
+        dst[4 * x + 0] = src[4 * x + 2];
+        dst[4 * x + 1] = src[4 * x + 1];
+        dst[4 * x + 2] = src[4 * x + 0];
+        dst[4 * x + 3] = src[4 * x + 3];
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+// Byte shuffles of 4 pixels: RGBA into 12 bytes of BGR, or into BGRA.
+#define SHUFFLE_BGR  2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+#define SHUFFLE_BGRA 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+
+// 16-byte stores of 4 pixels write 4 bytes beyond them,
+// so the last pixels of the row are left to the scalar code.
+__attribute__((target("ssse3")))
+static void PackRowBGR_SSSE3(unsigned char *dst, const unsigned char *src, int w)
+{
+    const __m128i shuffle = _mm_setr_epi8(SHUFFLE_BGR);
+    int x = 0;
+    for(; x + 6 <= w; x += 4){
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 4 * x));
+        _mm_storeu_si128((__m128i *)(dst + 3 * x), _mm_shuffle_epi8(v, shuffle));
+    }
+    PackRowBGR(dst + 3 * x, src + 4 * x, w - x);
+}
+
+__attribute__((target("ssse3")))
+static void PackRowBGRA_SSSE3(unsigned char *dst, const unsigned char *src, int w)
+{
+    const __m128i shuffle = _mm_setr_epi8(SHUFFLE_BGRA);
+    int x = 0;
+    for(; x + 4 <= w; x += 4){
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 4 * x));
+        _mm_storeu_si128((__m128i *)(dst + 4 * x), _mm_shuffle_epi8(v, shuffle));
+    }
+    PackRowBGRA(dst + 4 * x, src + 4 * x, w - x);
+}
+
+// 12 bytes of each 128-bit lane are joined by the dword permutation
+// into 24 contiguous bytes of 8 pixels, the 32-byte store writes
+// 8 bytes beyond them.
+__attribute__((target("avx2")))
+static void PackRowBGR_AVX2(unsigned char *dst, const unsigned char *src, int w)
+{
+    const __m256i shuffle = _mm256_setr_epi8(SHUFFLE_BGR, SHUFFLE_BGR);
+    const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    int x = 0;
+    for(; x + 11 <= w; x += 8){
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + 4 * x));
+        v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, shuffle), join);
+        _mm256_storeu_si256((__m256i *)(dst + 3 * x), v);
+    }
+    PackRowBGR(dst + 3 * x, src + 4 * x, w - x);
+}
+
+__attribute__((target("avx2")))
+static void PackRowBGRA_AVX2(unsigned char *dst, const unsigned char *src, int w)
+{
+    const __m256i shuffle = _mm256_setr_epi8(SHUFFLE_BGRA, SHUFFLE_BGRA);
+    int x = 0;
+    for(; x + 8 <= w; x += 8){
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + 4 * x));
+        _mm256_storeu_si256((__m256i *)(dst + 4 * x), _mm256_shuffle_epi8(v, shuffle));
+    }
+    PackRowBGRA(dst + 4 * x, src + 4 * x, w - x);
+}
+
+#endif
+
+// Select the fastest row packing supported by CPU.
+static PackRowFunc SelectPackRow(int bitsPerPixel)
+{
+#ifdef HAVE_X86_SIMD
+    if(__builtin_cpu_supports("avx2"))
+        return bitsPerPixel == 24 ? PackRowBGR_AVX2 : PackRowBGRA_AVX2;
+    if(__builtin_cpu_supports("ssse3"))
+        return bitsPerPixel == 24 ? PackRowBGR_SSSE3 : PackRowBGRA_SSSE3;
+#endif
+    return bitsPerPixel == 24 ? PackRowBGR : PackRowBGRA;
+}
+
+extern "C" 
+{
+    size_t BMPPitch(int width, int bitsPerPixel)
+    {
+        return (((size_t)bitsPerPixel * width + 31) / 32) * 4;
+    }
+
+    size_t EncodeBMPHeader(void *pDst, int width, int height, int bitsPerPixel)
+    {
+        size_t offset = sizeof(BMPHeader) + sizeof(BMPInfoHeader);
+        size_t imageSize = BMPPitch(width, bitsPerPixel) * height;
+
+        BMPHeader hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.type = 0x4D42;
+        hdr.size = (int)(offset + imageSize);
+        hdr.offset = (int)offset;
+
+        BMPInfoHeader infoHdr;
+        memset(&infoHdr, 0, sizeof(infoHdr));
+        infoHdr.size = sizeof(infoHdr);
+        infoHdr.width = width;
+        infoHdr.height = height;
+        infoHdr.planes = 1;
+        infoHdr.bitsPerPixel = (short)bitsPerPixel;
+        infoHdr.imageSize = (unsigned)imageSize;
+
+        unsigned char *dst = (unsigned char *)pDst;
+        memcpy(dst, &hdr, sizeof(hdr));
+        memcpy(dst + sizeof(hdr), &infoHdr, sizeof(infoHdr));
+
+        return offset;
+    }
+
+    void EncodeBMPRows(void *pDst, const void *pSrc, int width, int rows, int bitsPerPixel)
+    {
+        PackRowFunc pack = SelectPackRow(bitsPerPixel);
+        size_t pitch = BMPPitch(width, bitsPerPixel);
+        size_t used = (size_t)width * (bitsPerPixel / 8);
+        unsigned char *dst = (unsigned char *)pDst;
+        const unsigned char *src = (const unsigned char *)pSrc;
+
+        #pragma omp parallel for if ((size_t)width * rows >= PARALLEL_PIXELS)
+        for(int y = 0; y < rows; y++){
+            unsigned char *row = dst + pitch * y;
+            pack(row, src + (size_t)y * width * 4, width);
+            memset(row + used, 0, pitch - used);
+        }
+    }
+
+    bool EncodeBMP(void **pData, size_t *pSize, const void *pSrc, int width, int height)
+    {
+        if(width <= 0 || height <= 0)
+            return false;
+
+        size_t offset = sizeof(BMPHeader) + sizeof(BMPInfoHeader);
+        size_t size = offset + BMPPitch(width, 24) * height;
+
+        unsigned char *dst = (unsigned char *)malloc(size);
+        if(!dst){
+            fprintf(stderr, "***BMP encode error: out of memory***\n");
+            return false;
+        }
+
+        EncodeBMPHeader(dst, width, height, 24);
+        EncodeBMPRows(dst + offset, pSrc, width, height, 24);
+
+        *pData = dst;
+        *pSize = size;
+
+        return true;
+    }
+
+    bool SaveBMPFile(const char *name, const void *pSrc, int width, int height)
+    {
+        void *data;
+        size_t size;
+        if(!EncodeBMP(&data, &size, pSrc, width, height))
+            return false;
+
+        FILE *fd = fopen(name, "wb");
+        if(!fd){
+            fprintf(stderr, "***BMP save error: cannot create %s***\n", name);
+            free(data);
+            return false;
+        }
+        bool ok = fwrite(data, 1, size, fd) == size;
+        ok = !fclose(fd) && ok;
+        if(!ok)
+            fprintf(stderr, "***BMP save error: cannot write %s***\n", name);
+
+        free(data);
+
+        return ok;
+    }
+}
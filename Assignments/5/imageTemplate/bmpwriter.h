@@ -0,0 +1,26 @@
+#ifndef _BMP_WRITER_H_
+#define _BMP_WRITER_H_
+
+#include <stddef.h>
+
+// Encode w x h RGBA image into 24-bit BMP file contents,
+// allocated with malloc.
+extern "C"
+bool EncodeBMP(void **data, size_t *size, const void *src, int width, int height);
+
+extern "C"
+bool SaveBMPFile(const char *name, const void *src, int width, int height);
+
+// Bytes per row of BMP image, padded to 4 bytes.
+extern "C"
+size_t BMPPitch(int width, int bitsPerPixel);
+
+// Write headers of 24-bit or 32-bit BMP file, returns their size.
+extern "C"
+size_t EncodeBMPHeader(void *dst, int width, int height, int bitsPerPixel);
+
+// Pack rows of RGBA image into padded BGR or BGRA rows of BMP file.
+extern "C"
+void EncodeBMPRows(void *dst, const void *src, int width, int rows, int bitsPerPixel);
+
+#endif
@@ -0,0 +1,734 @@
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "bmploader.h"
+#include "bmploader_test.h"
+#include "bmpstream.h"
+#include "bmpstream_test.h"
+#include "bmpwriter.h"
+#include "HostFilters.h"
+#include "HostFilters_test.h"
+#include "Pipeline.h"
+#include "Pipeline_test.h"
+#include "Strips.h"
+#include "Strips_test.h"
+
+// The maximum number of filters in chain.
+#define MAX_FILTERS 16
+
+// The maximum number of parameters of filter.
+#define MAX_PARAMS 2
+
+// Filter w x h image, or the strip of image rows y0 .. y0 + h - 1.
+typedef bool (*FilterFunc)(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int y0, const float * pParams);
+
+// Rows around the output row, which the filter reads.
+typedef int (*HaloFunc)(const float * pParams);
+
+typedef struct
+{
+    const char * name;
+    FilterFunc   func;
+    HaloFunc     halo;
+    int          nparams;
+    float        params[MAX_PARAMS];    // default parameters
+    const char * help;
+} FilterDesc;
+
+typedef struct
+{
+    const FilterDesc * pDesc;
+    float              params[MAX_PARAMS];
+} Filter;
+
+// The image on its way through the pipeline.
+typedef struct
+{
+    const char *    pInName;
+    char *          pOutName;
+    const void *    pMap;       // mapped input file (read, decode stages)
+    size_t          mapSize;
+    void *          pFile;      // encoded output file (encode, write stages)
+    size_t          fileSize;
+    unsigned char * pRGBA;      // decoded image
+    int             w, h;
+} Job;
+
+// The image filtered by strips.
+typedef struct
+{
+    BMPLayout   layout;
+    BMPStream * pStream;
+    int         halo;
+    int         ompThreads;
+} StripJob;
+
+static bool Gaussian(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int, const float * pParams)
+{
+    return Host_GaussianBlur(pSrc, pDst, w, h, (int) pParams[0]);
+}
+
+static bool RecursiveGaussian(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int, const float * pParams)
+{
+    return Host_RecursiveGaussianBlur(pSrc, pDst, w, h, pParams[0]);
+}
+
+static bool Box(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int, const float * pParams)
+{
+    return Host_BoxBlur(pSrc, pDst, w, h, (int) pParams[0]);
+}
+
+static bool BoxGaussian(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int, const float * pParams)
+{
+    return Host_BoxGaussianBlur(pSrc, pDst, w, h, pParams[0]);
+}
+
+static bool Bilateral(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int y0, const float * pParams)
+{
+    return Host_BilateralGridRows(pSrc, pDst, w, h, y0, pParams[0], pParams[1]);
+}
+
+static bool Median(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int, const float * pParams)
+{
+    return Host_MedianFilter(pSrc, pDst, w, h, (int) pParams[0]);
+}
+
+// Custom point spread function given by -k.
+static float * g_pPSF = NULL;
+static int     g_PSFWidth = 0;
+static int     g_PSFHeight = 0;
+
+static bool Motion(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int, const float * pParams)
+{
+    int n = MotionBlurKernel(pParams[0], pParams[1], NULL);
+    float * pKernel = (float *) malloc((size_t) n * n * sizeof(float));
+    if (!pKernel)
+        return false;
+    MotionBlurKernel(pParams[0], pParams[1], pKernel);
+    bool ok = Host_Convolve(pSrc, pDst, w, h, pKernel, n, n, CONVOLVE_AUTO);
+    free(pKernel);
+    return ok;
+}
+
+static bool Disk(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int, const float * pParams)
+{
+    int n = DiskKernel(pParams[0], NULL);
+    float * pKernel = (float *) malloc((size_t) n * n * sizeof(float));
+    if (!pKernel)
+        return false;
+    DiskKernel(pParams[0], pKernel);
+    bool ok = Host_Convolve(pSrc, pDst, w, h, pKernel, n, n, CONVOLVE_AUTO);
+    free(pKernel);
+    return ok;
+}
+
+static bool PSF(const unsigned char * pSrc, unsigned char * pDst, int w, int h, int, const float *)
+{
+    return g_pPSF && Host_Convolve(pSrc, pDst, w, h, g_pPSF, g_PSFWidth, g_PSFHeight, CONVOLVE_AUTO);
+}
+
+static int GaussianHalo(const float * pParams)
+{
+    int radius = (int) pParams[0];
+    return radius > GAUSSIAN_IIR_RADIUS ? GAUSSIAN_IIR_HALO(GAUSSIAN_SIGMA(radius)) : radius;
+}
+
+static int RecursiveGaussianHalo(const float * pParams)
+{
+    return GAUSSIAN_IIR_HALO(pParams[0]);
+}
+
+static int BoxHalo(const float * pParams)
+{
+    return (int) pParams[0];
+}
+
+static int BoxGaussianHalo(const float * pParams)
+{
+    return BoxGaussianRadius(pParams[0]);
+}
+
+static int BilateralHalo(const float * pParams)
+{
+    return BilateralGridRadius(pParams[0]);
+}
+
+static int MedianHalo(const float * pParams)
+{
+    return (int) pParams[0];
+}
+
+static int MotionHalo(const float * pParams)
+{
+    return MotionBlurKernel(pParams[0], pParams[1], NULL) / 2;
+}
+
+static int DiskHalo(const float * pParams)
+{
+    return DiskKernel(pParams[0], NULL) / 2;
+}
+
+static int PSFHalo(const float *)
+{
+    return g_PSFHeight / 2;
+}
+
+static const FilterDesc g_FilterTable[] =
+{
+    { "gauss",     Gaussian,          GaussianHalo,          1, { 9.0f },        "Gaussian blur of radius, recursive above 16" },
+    { "iir",       RecursiveGaussian, RecursiveGaussianHalo, 1, { 8.0f },        "recursive Gaussian blur of sigma, separable below 6" },
+    { "box",       Box,               BoxHalo,               1, { 4.0f },        "box blur of radius" },
+    { "boxgauss",  BoxGaussian,       BoxGaussianHalo,       1, { 8.0f },        "Gaussian blur of sigma by 3 boxes" },
+    { "bilateral", Bilateral,         BilateralHalo,         2, { 8.0f, 20.0f }, "edge-preserving blur of spatial:range sigma by bilateral grid" },
+    { "median",    Median,            MedianHalo,            1, { 2.0f },        "median of radius, up to 127" },
+    { "motion",    Motion,            MotionHalo,            2, { 15.0f, 0.0f }, "motion blur of length:angle in degrees" },
+    { "disk",      Disk,              DiskHalo,              1, { 8.0f },        "defocus blur by the disk of radius" },
+    { "psf",       PSF,               PSFHalo,               0, { 0.0f },        "convolution with the kernel given by -k" },
+};
+
+static Filter g_Filters[MAX_FILTERS];
+static int    g_NumFilters = 0;
+
+static double WallTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// Parse the chain like "gauss:20,box:3" into g_Filters.
+static bool ParseFilters(const char * spec)
+{
+    char * copy = strdup(spec);
+    for (char * tok = strtok(copy, ","); tok; tok = strtok(NULL, ","))
+    {
+        char * colon = strchr(tok, ':');
+        if (colon)
+            *colon++ = '\0';
+
+        const FilterDesc * pDesc = NULL;
+        for (size_t i = 0; i < sizeof(g_FilterTable) / sizeof(g_FilterTable[0]); i++)
+            if (!strcmp(tok, g_FilterTable[i].name))
+                pDesc = &g_FilterTable[i];
+        if (!pDesc || g_NumFilters == MAX_FILTERS)
+        {
+            fprintf(stderr, "Unknown filter or too many filters: %s\n", tok);
+            free(copy);
+            return false;
+        }
+
+        // Parameters follow the name, separated by colons.
+        Filter * pFilter = &g_Filters[g_NumFilters++];
+        pFilter->pDesc = pDesc;
+        for (int i = 0; i < pDesc->nparams; i++)
+        {
+            pFilter->params[i] = colon ? (float) atof(colon) : pDesc->params[i];
+            colon = colon ? strchr(colon, ':') : NULL;
+            if (colon)
+                colon++;
+        }
+    }
+    free(copy);
+    return true;
+}
+
+// Load the kernel of the text file: width and height, then rows of weights
+// from the top one. Weights are normalized to the unit sum, unless it is 0.
+static bool LoadPSF(const char * name)
+{
+    FILE * f = fopen(name, "r");
+    if (!f)
+    {
+        fprintf(stderr, "Cannot open %s: %s\n", name, strerror(errno));
+        return false;
+    }
+    bool ok = fscanf(f, "%d %d", &g_PSFWidth, &g_PSFHeight) == 2 &&
+        g_PSFWidth > 0 && g_PSFHeight > 0 && g_PSFWidth <= 65536 / g_PSFHeight;
+    if (ok)
+        g_pPSF = (float *) malloc((size_t) g_PSFWidth * g_PSFHeight * sizeof(float));
+    float sum = 0.0f;
+    for (int j = g_PSFHeight - 1; ok && g_pPSF && j >= 0; j--)
+        for (int i = 0; ok && i < g_PSFWidth; i++)
+        {
+            ok = fscanf(f, "%f", &g_pPSF[j * g_PSFWidth + i]) == 1;
+            sum += ok ? g_pPSF[j * g_PSFWidth + i] : 0.0f;
+        }
+    fclose(f);
+    if (!ok || !g_pPSF)
+    {
+        fprintf(stderr, "Invalid kernel in %s\n", name);
+        free(g_pPSF);
+        g_pPSF = NULL;
+        return false;
+    }
+    if (sum != 0.0f)
+        for (int i = 0; i < g_PSFWidth * g_PSFHeight; i++)
+            g_pPSF[i] /= sum;
+    return true;
+}
+
+static void PrintParams(const FilterDesc * pDesc, const float * pParams)
+{
+    for (int i = 0; i < pDesc->nparams; i++)
+        printf(i ? ":%g" : "%g", pParams[i]);
+}
+
+// Apply the chain to w x h image (or strip from row y0), filters ping-pong
+// between the image and the temporary one. Returns the one holding the result.
+static unsigned char * ApplyFilters(unsigned char * pImage, unsigned char * pTmp, int w, int h, int y0, const char * name)
+{
+    for (int i = 0; i < g_NumFilters; i++)
+    {
+        if (!g_Filters[i].pDesc->func(pImage, pTmp, w, h, y0, g_Filters[i].params))
+        {
+            fprintf(stderr, "Filter %s failed on %s\n", g_Filters[i].pDesc->name, name);
+            return NULL;
+        }
+        unsigned char * p = pImage;
+        pImage = pTmp;
+        pTmp = p;
+    }
+    return pImage;
+}
+
+// Rows of the source, which the output row of the chain depends on.
+static int FiltersHalo()
+{
+    int halo = 0;
+    for (int i = 0; i < g_NumFilters; i++)
+        halo += g_Filters[i].pDesc->halo(g_Filters[i].params);
+    return halo;
+}
+
+static bool HasBMPExtension(const char * name)
+{
+    size_t len = strlen(name);
+    return len > 4 && name[len - 4] == '.' &&
+        tolower(name[len - 3]) == 'b' && tolower(name[len - 2]) == 'm' && tolower(name[len - 1]) == 'p';
+}
+
+// Add the file, or all BMP files of the directory, to the list of names.
+static void CollectInputs(const char * path, char *** pppNames, int * pCount, int * pCapacity)
+{
+    struct stat st;
+    if (stat(path, &st))
+    {
+        fprintf(stderr, "Cannot access %s: %s\n", path, strerror(errno));
+        return;
+    }
+
+    if (!S_ISDIR(st.st_mode))
+    {
+        if (*pCount == *pCapacity)
+        {
+            *pCapacity = *pCapacity ? 2 * *pCapacity : 64;
+            *pppNames = (char **) realloc(*pppNames, *pCapacity * sizeof(char *));
+        }
+        (*pppNames)[(*pCount)++] = strdup(path);
+        return;
+    }
+
+    DIR * dir = opendir(path);
+    if (!dir)
+    {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return;
+    }
+    struct dirent * entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!HasBMPExtension(entry->d_name))
+            continue;
+        char * name = (char *) malloc(strlen(path) + strlen(entry->d_name) + 2);
+        sprintf(name, "%s/%s", path, entry->d_name);
+        CollectInputs(name, pppNames, pCount, pCapacity);
+        free(name);
+    }
+    closedir(dir);
+}
+
+// Stages of the pipeline.
+
+static bool ReadStage(void * pItem, void *)
+{
+    Job * job = (Job *) pItem;
+    if (!MapBMPFile(&job->pMap, &job->mapSize, job->pInName))
+    {
+        fprintf(stderr, "Cannot read %s\n", job->pInName);
+        return false;
+    }
+    return true;
+}
+
+static bool DecodeStage(void * pItem, void * pArg)
+{
+    Job * job = (Job *) pItem;
+    omp_set_num_threads(*(int *) pArg);
+    bool ok = DecodeBMP((void **) &job->pRGBA, &job->w, &job->h, job->pMap, job->mapSize);
+    UnmapBMPFile(job->pMap, job->mapSize);
+    job->pMap = NULL;
+    if (!ok)
+        fprintf(stderr, "Cannot decode %s\n", job->pInName);
+    return ok;
+}
+
+static bool FilterStage(void * pItem, void * pArg)
+{
+    Job * job = (Job *) pItem;
+    omp_set_num_threads(*(int *) pArg);
+
+    unsigned char * pTmp = (unsigned char *) malloc((size_t) job->w * job->h * 4);
+    if (!pTmp)
+        return false;
+    unsigned char * pOut = ApplyFilters(job->pRGBA, pTmp, job->w, job->h, 0, job->pInName);
+    if (pOut == pTmp)
+    {
+        pTmp = job->pRGBA;
+        job->pRGBA = pOut;
+    }
+    free(pTmp);
+    return pOut != NULL;
+}
+
+static bool EncodeStage(void * pItem, void *)
+{
+    Job * job = (Job *) pItem;
+    bool ok = EncodeBMP(&job->pFile, &job->fileSize, job->pRGBA, job->w, job->h);
+    free(job->pRGBA);
+    job->pRGBA = NULL;
+    return ok;
+}
+
+static bool WriteStage(void * pItem, void *)
+{
+    Job * job = (Job *) pItem;
+    FILE * fd = fopen(job->pOutName, "wb");
+    bool ok = fd && fwrite(job->pFile, 1, job->fileSize, fd) == job->fileSize;
+    if (fd)
+        ok = !fclose(fd) && ok;
+    if (!ok)
+        fprintf(stderr, "Cannot write %s\n", job->pOutName);
+    free(job->pFile);
+    job->pFile = NULL;
+    return ok;
+}
+
+// Release whatever the job holds, when it is done or dropped.
+static void JobDone(void * pItem, bool, void *)
+{
+    Job * job = (Job *) pItem;
+    if (job->pMap)
+        UnmapBMPFile(job->pMap, job->mapSize);
+    free(job->pFile);
+    free(job->pRGBA);
+    job->pMap = NULL;
+    job->pFile = NULL;
+    job->pRGBA = NULL;
+}
+
+// Callbacks of strip mode: strips are decoded from the mapped file,
+// filtered and appended to the output file in order.
+
+static bool ReadStrip(unsigned char * pDst, int y0, int rows, void * pArg)
+{
+    StripJob * job = (StripJob *) pArg;
+    omp_set_num_threads(job->ompThreads);
+    DecodeBMPRows(pDst, &job->layout, y0, rows);
+
+    // Rows below the halo of the next strip are not read again.
+    int rest = rows - 2 * job->halo;
+    if (rest > 0)
+        ReleaseBMPRows(&job->layout, y0, rest);
+    return true;
+}
+
+static unsigned char * FilterStrip(unsigned char * pStrip, unsigned char * pTmp, int w, int h, int y0, void * pArg)
+{
+    StripJob * job = (StripJob *) pArg;
+    omp_set_num_threads(job->ompThreads);
+    return ApplyFilters(pStrip, pTmp, w, h, y0, "strip");
+}
+
+static bool WriteStrip(const unsigned char * pSrc, int rows, void * pArg)
+{
+    StripJob * job = (StripJob *) pArg;
+    return WriteBMPStream(job->pStream, pSrc, rows);
+}
+
+// Filter the file by strips of the given number of rows, so that
+// neither the source nor the result is held in memory entirely.
+static bool ProcessStrips(const char * pInName, const char * pOutName, int strip, int threads, int ncores,
+                          double * pPixels, size_t * pMemory)
+{
+    const void * pMap;
+    size_t mapSize;
+    if (!MapBMPFile(&pMap, &mapSize, pInName))
+    {
+        fprintf(stderr, "Cannot read %s\n", pInName);
+        return false;
+    }
+
+    StripJob job;
+    bool ok = ParseBMP(&job.layout, pMap, mapSize);
+    if (ok)
+    {
+        int w = job.layout.width, h = job.layout.height, halo = FiltersHalo();
+        job.halo = halo;
+        job.pStream = OpenBMPStream(pOutName, w, h, 24);
+        job.ompThreads = ncores / threads > 1 ? ncores / threads : 1;
+        ok = job.pStream && RunStrips(w, h, strip, halo, threads, ReadStrip, FilterStrip, WriteStrip, &job);
+        if (job.pStream)
+            ok = CloseBMPStream(job.pStream) && ok;
+        *pPixels += (double) w * h;
+        size_t memory = StripMemory(w, h, strip, halo, threads);
+        if (memory > *pMemory)
+            *pMemory = memory;
+    }
+    if (!ok)
+        fprintf(stderr, "Cannot filter %s\n", pInName);
+    UnmapBMPFile(pMap, mapSize);
+    return ok;
+}
+
+static void Usage(const char * name)
+{
+    printf("Usage: %s [-t <read,decode,filter,encode,write>] [-q <depth>] [-s <rows>] [-f <filter[:param...],...>]\n", name);
+    printf("       %*s [-k <kernel.txt>]", (int) strlen(name), "");
+    printf(" -o <outdir> <file | directory> ...\n");
+    printf("where -t gives the number of threads of each stage (default 1,N,N,N,1\n");
+    printf("for N cores), -q the depth of queues between stages (default 2 x threads),\n");
+    printf("-s turns on strip mode for huge images: files are filtered one by one,\n");
+    printf("by strips of rows in parallel by filter threads, with bounded memory,\n");
+    printf("and -f the chain of filters applied in order (default gauss), one of:\n");
+    for (size_t i = 0; i < sizeof(g_FilterTable) / sizeof(g_FilterTable[0]); i++)
+    {
+        printf("  %-10s %s", g_FilterTable[i].name, g_FilterTable[i].help);
+        if (g_FilterTable[i].nparams)
+        {
+            printf(" (default ");
+            PrintParams(&g_FilterTable[i], g_FilterTable[i].params);
+            printf(")");
+        }
+        printf("\n");
+    }
+    printf("-k loads the kernel of psf: width and height, then rows of weights from\n");
+    printf("the top one, normalized to the unit sum. Convolutions choose direct or FFT\n");
+    printf("method by cost. Directories are scanned for *.bmp files, results go to outdir\n");
+    printf("under the same names. %s -c checks host filters against brute force.\n", name);
+}
+
+int main(int argc, char ** argv)
+{
+    const char * outdir = NULL;
+    const char * threads = NULL;
+    const char * filters = "gauss";
+    const char * kernel = NULL;
+    int depth = 0;
+    int strip = 0;
+    bool check = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:q:s:f:k:o:ch")) != -1)
+    {
+        switch (opt)
+        {
+            case 't': threads = optarg; break;
+            case 'q': depth = atoi(optarg); break;
+            case 's': strip = atoi(optarg); break;
+            case 'f': filters = optarg; break;
+            case 'k': kernel = optarg; break;
+            case 'o': outdir = optarg; break;
+            case 'c': check = true; break;
+            default:
+                Usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (check)
+    {
+        bool failed = HostFilters_Test() != EXIT_SUCCESS;
+        failed = Pipeline_Test() != EXIT_SUCCESS || failed;
+        failed = BMPLoader_Test() != EXIT_SUCCESS || failed;
+        failed = BMPStream_Test() != EXIT_SUCCESS || failed;
+        failed = Strips_Test() != EXIT_SUCCESS || failed;
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    if (!outdir || optind == argc)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+    if (!ParseFilters(filters) || (kernel && !LoadPSF(kernel)))
+        return 1;
+    for (int i = 0; i < g_NumFilters; i++)
+        if (g_Filters[i].pDesc->func == PSF && !g_pPSF)
+        {
+            fprintf(stderr, "Filter psf needs the kernel given by -k\n");
+            return 1;
+        }
+
+    int ncores = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncores < 1)
+        ncores = 1;
+
+    PipelineStage stages[] =
+    {
+        { "read",   ReadStage,   NULL, 1,      0.0 },
+        { "decode", DecodeStage, NULL, ncores, 0.0 },
+        { "filter", FilterStage, NULL, ncores, 0.0 },
+        { "encode", EncodeStage, NULL, ncores, 0.0 },
+        { "write",  WriteStage,  NULL, 1,      0.0 },
+    };
+    const int nstages = sizeof(stages) / sizeof(stages[0]);
+    if (threads)
+    {
+        const char * p = threads;
+        for (int i = 0; i < nstages && *p; i++)
+        {
+            stages[i].threads = atoi(p);
+            if (stages[i].threads < 1)
+            {
+                fprintf(stderr, "Invalid thread count in %s\n", threads);
+                return 1;
+            }
+            p = strchr(p, ',');
+            if (!p)
+                break;
+            p++;
+        }
+    }
+    int maxThreads = 1;
+    for (int i = 0; i < nstages; i++)
+        if (stages[i].threads > maxThreads)
+            maxThreads = stages[i].threads;
+    if (depth < 1)
+        depth = 2 * maxThreads;
+
+    // Cores are shared between threads of the decode and filter stages,
+    // each one gets the number of OpenMP threads as argument.
+    int ompThreads[nstages];
+    for (int i = 0; i < nstages; i++)
+    {
+        ompThreads[i] = ncores / stages[i].threads;
+        if (ompThreads[i] < 1)
+            ompThreads[i] = 1;
+        stages[i].pArg = &ompThreads[i];
+    }
+
+    if (mkdir(outdir, 0755) && errno != EEXIST)
+    {
+        fprintf(stderr, "Cannot create %s: %s\n", outdir, strerror(errno));
+        return 1;
+    }
+
+    char ** ppNames = NULL;
+    int count = 0, capacity = 0;
+    for (int i = optind; i < argc; i++)
+        CollectInputs(argv[i], &ppNames, &count, &capacity);
+    if (!count)
+    {
+        fprintf(stderr, "No input files\n");
+        return 1;
+    }
+
+    if (strip > 0)
+    {
+        int threads = stages[2].threads;
+        printf("%d files, strips of %d rows, halo %d, threads %d, filters", count, strip, FiltersHalo(), threads);
+        for (int i = 0; i < g_NumFilters; i++)
+        {
+            printf(" %s%s", g_Filters[i].pDesc->name, g_Filters[i].pDesc->nparams ? ":" : "");
+            PrintParams(g_Filters[i].pDesc, g_Filters[i].params);
+        }
+        printf("\n");
+
+        double start = WallTime();
+        double pixels = 0;
+        size_t memory = 0;
+        int completed = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const char * base = strrchr(ppNames[i], '/');
+            base = base ? base + 1 : ppNames[i];
+            char * pOutName = (char *) malloc(strlen(outdir) + strlen(base) + 2);
+            sprintf(pOutName, "%s/%s", outdir, base);
+            completed += ProcessStrips(ppNames[i], pOutName, strip, threads, ncores, &pixels, &memory);
+            free(pOutName);
+        }
+        double time = WallTime() - start;
+
+        printf("%d of %d files processed in %f sec, %f Mpixels/s, strip buffers %f MB\n",
+            completed, count, time, 1e-6 * pixels / time, memory / 1048576.0);
+
+        for (int i = 0; i < count; i++)
+            free(ppNames[i]);
+        free(ppNames);
+
+        return completed == count ? 0 : 1;
+    }
+
+    Job * pJobs = (Job *) calloc(count, sizeof(Job));
+    void ** ppItems = (void **) malloc(count * sizeof(void *));
+    for (int i = 0; i < count; i++)
+    {
+        const char * base = strrchr(ppNames[i], '/');
+        base = base ? base + 1 : ppNames[i];
+        pJobs[i].pInName = ppNames[i];
+        pJobs[i].pOutName = (char *) malloc(strlen(outdir) + strlen(base) + 2);
+        sprintf(pJobs[i].pOutName, "%s/%s", outdir, base);
+        ppItems[i] = &pJobs[i];
+    }
+
+    printf("%d files, threads", count);
+    for (int i = 0; i < nstages; i++)
+        printf(" %s %d", stages[i].name, stages[i].threads);
+    printf(", queue depth %d, filters", depth);
+    for (int i = 0; i < g_NumFilters; i++)
+    {
+        printf(" %s%s", g_Filters[i].pDesc->name, g_Filters[i].pDesc->nparams ? ":" : "");
+        PrintParams(g_Filters[i].pDesc, g_Filters[i].params);
+    }
+    printf("\n");
+
+    double start = WallTime();
+
+    int completed = RunPipeline(stages, nstages, ppItems, count, depth, JobDone, NULL);
+
+    double time = WallTime() - start;
+
+    if (completed < 0)
+    {
+        fprintf(stderr, "Cannot start the pipeline\n");
+        completed = 0;
+    }
+
+    double pixels = 0;
+    for (int i = 0; i < count; i++)
+        pixels += (double) pJobs[i].w * pJobs[i].h;
+    printf("%d of %d files processed in %f sec, %f images/s, %f Mpixels/s\n",
+        completed, count, time, completed / time, 1e-6 * pixels / time);
+    printf("stage\tthreads\tbusy\n");
+    for (int i = 0; i < nstages; i++)
+        printf("%s\t%d\t%f sec\n", stages[i].name, stages[i].threads, stages[i].busy);
+
+    for (int i = 0; i < count; i++)
+    {
+        free(ppNames[i]);
+        free(pJobs[i].pOutName);
+    }
+    free(ppNames);
+    free(pJobs);
+    free(ppItems);
+
+    return completed == count ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Mixed precision solver: LU factorization is done in single precision,
+ * which is about twice faster, then the solution is refined iteratively
+ * with residuals computed in double precision, until it is accurate to
+ * double precision. If refinement does not converge, the system is
+ * solved by double precision factorization, as in LAPACK dsgesv.
+ * Must be included after dense_solve.h for both precisions.
+ */
+
+#ifndef DENSE_REFINE_H
+#define DENSE_REFINE_H
+
+// The maximum number of refinement iterations.
+#define DENSE_REFINE_ITMAX 30
+
+// The stopping criterion: ||r|| < ||x|| * ||A|| * eps * sqrt(n) * BWDMAX.
+#define DENSE_REFINE_BWDMAX 1.0
+
+// Reasons of falling back to double precision factorization,
+// reported in iter (positive iter is the number of iterations).
+#define DENSE_REFINE_OVERFLOW -2
+#define DENSE_REFINE_SGETRF -3
+#define DENSE_REFINE_DIVERGED (-DENSE_REFINE_ITMAX - 1)
+
+// Convert m x n matrix to single precision. Returns nonzero,
+// if some element does not fit the single precision range.
+static int dense_refine_dtos(int m, int n, const double* A, int lda, float* SA, int ldsa)
+{
+	int overflow = 0;
+	#pragma omp parallel for reduction(|:overflow) if ((size_t)m * n > (1 << 16))
+	for (int j = 0; j < n; j++)
+		for (int i = 0; i < m; i++)
+		{
+			double a = A[i + (size_t)j * lda];
+			if (fabs(a) > FLT_MAX) overflow = 1;
+			SA[i + (size_t)j * ldsa] = (float)a;
+		}
+	return overflow;
+}
+
+// Compute R = B - A * X in double precision and check, if every
+// column of X is converged: max |r| < max |x| * cte. There are few
+// right hand sides, so A is not packed, but swept by columns, each
+// thread taking the contiguous chunk of rows.
+static int dense_refine_residual(int n, int nrhs, const double* A, int lda,
+	const double* B, int ldb, const double* X, int ldx, double* R, double cte)
+{
+	#pragma omp parallel if ((size_t)n * n > (1 << 16))
+	{
+		int nthreads = omp_get_num_threads(), ithread = omp_get_thread_num();
+		int i0 = (int)((size_t)n * ithread / nthreads);
+		int i1 = (int)((size_t)n * (ithread + 1) / nthreads);
+		for (int k = 0; k < nrhs; k++)
+		{
+			double* r = R + (size_t)k * n;
+			const double* x = X + (size_t)k * ldx;
+			memcpy(r + i0, B + (size_t)k * ldb + i0, (i1 - i0) * sizeof(double));
+			for (int j = 0; j < n; j++)
+			{
+				const double* a = A + (size_t)j * lda;
+				double xj = x[j];
+				for (int i = i0; i < i1; i++)
+					r[i] -= a[i] * xj;
+			}
+		}
+	}
+
+	for (int j = 0; j < nrhs; j++)
+	{
+		double xnrm = 0, rnrm = 0;
+		for (int i = 0; i < n; i++)
+		{
+			double x = fabs(X[i + (size_t)j * ldx]), r = fabs(R[i + (size_t)j * n]);
+			if (x > xnrm) xnrm = x;
+			if (r > rnrm) rnrm = r;
+		}
+		if (rnrm >= xnrm * cte) return 0;
+	}
+	return 1;
+}
+
+// Solve n x n system A * X = B with nrhs right hand sides, using single
+// precision factorization with iterative refinement. A and B are left
+// intact, unless refinement fails: then A is overwritten by double
+// precision LU factors. Returns 0 or the 1-based index of the first
+// zero pivot of the double precision factorization.
+int dsgesv_host(int n, int nrhs, double* A, int lda, int* ipiv,
+	const double* B, int ldb, double* X, int ldx, int* iter)
+{
+	*iter = 0;
+	if (!n || !nrhs) return 0;
+
+	// Infinity norm of A, row sums are accumulated by columns.
+	double anrm = 0;
+	double* R = (double*)calloc((size_t)n * nrhs, sizeof(double)); assert(R);
+	for (int j = 0; j < n; j++)
+		for (int i = 0; i < n; i++)
+			R[i] += fabs(A[i + (size_t)j * lda]);
+	for (int i = 0; i < n; i++)
+		if (R[i] > anrm) anrm = R[i];
+	double cte = anrm * (DBL_EPSILON / 2) * sqrt((double)n) * DENSE_REFINE_BWDMAX;
+
+	float* SA = (float*)malloc((size_t)n * n * sizeof(float)); assert(SA);
+	float* SX = (float*)malloc((size_t)n * nrhs * sizeof(float)); assert(SX);
+
+	int converged = 0;
+	if (dense_refine_dtos(n, n, A, lda, SA, n) ||
+		dense_refine_dtos(n, nrhs, B, ldb, SX, n))
+		*iter = DENSE_REFINE_OVERFLOW;
+	else if (sgetrf_host(n, SA, n, ipiv))
+		*iter = DENSE_REFINE_SGETRF;
+	else
+	{
+		// The initial solution.
+		sgetrs_host(n, nrhs, SA, n, ipiv, SX, n);
+		for (int j = 0; j < nrhs; j++)
+			for (int i = 0; i < n; i++)
+				X[i + (size_t)j * ldx] = SX[i + (size_t)j * n];
+
+		converged = dense_refine_residual(n, nrhs, A, lda, B, ldb, X, ldx, R, cte);
+		for (int it = 1; !converged && (it <= DENSE_REFINE_ITMAX); it++)
+		{
+			// Solve for the correction in single precision
+			// and add it to the solution in double precision.
+			if (dense_refine_dtos(n, nrhs, R, n, SX, n))
+				break;
+			sgetrs_host(n, nrhs, SA, n, ipiv, SX, n);
+			for (int j = 0; j < nrhs; j++)
+				for (int i = 0; i < n; i++)
+					X[i + (size_t)j * ldx] += SX[i + (size_t)j * n];
+
+			converged = dense_refine_residual(n, nrhs, A, lda, B, ldb, X, ldx, R, cte);
+			*iter = it;
+		}
+		if (!converged) *iter = DENSE_REFINE_DIVERGED;
+	}
+
+	free(SA);
+	free(SX);
+	free(R);
+
+	if (converged) return 0;
+
+	int info = dgetrf_host(n, A, lda, ipiv);
+	for (int j = 0; j < nrhs; j++)
+		memcpy(X + (size_t)j * ldx, B + (size_t)j * ldb, n * sizeof(double));
+	if (!info)
+		dgetrs_host(n, nrhs, A, lda, ipiv, X, ldx);
+	return info;
+}
+
+#endif // DENSE_REFINE_H
@@ -0,0 +1,134 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Test of mixed precision solver: the solution must have the double
+ * precision residual. For comparison, single and double precision
+ * LU factorizations of the same matrix are measured as well.
+ */
+
+#ifndef DENSE_REFINE_TEST_H
+#define DENSE_REFINE_TEST_H
+
+// Print the double precision scaled residual ||B - A X|| / (||A|| ||X|| n eps)
+// of n x n system, which must be of order 1.
+static int dense_refine_check(int n, const double* A, int lda, const double* B,
+	const double* X)
+{
+	double norm_a = 0, norm_x = 0, norm_r = 0;
+	for (int i = 0; i < n; i++)
+	{
+		double s = 0;
+		for (int j = 0; j < n; j++)
+			s += fabs(A[i + (size_t)j * lda]);
+		if (s > norm_a) norm_a = s;
+	}
+	double* R = (double*)malloc(n * sizeof(double)); assert(R);
+	memcpy(R, B, n * sizeof(double));
+	dgemm_host('N', 'N', n, 1, n, -1, A, lda, X, n, 1, R, n);
+	for (int i = 0; i < n; i++)
+	{
+		if (fabs(X[i]) > norm_x) norm_x = fabs(X[i]);
+		if (fabs(R[i]) > norm_r) norm_r = fabs(R[i]);
+	}
+	free(R);
+
+	double resid = norm_r / (norm_a * norm_x * n * DBL_EPSILON);
+	int status = (resid < 16) ? EXIT_SUCCESS : EXIT_FAILURE;
+	printf("%s\t%f", (status == EXIT_SUCCESS) ? "PASSED" : "FAILED", resid);
+	return status;
+}
+
+// Solve n x n system by mixed precision solver. The matrix is taken
+// from A0, if it is not NULL, otherwise it is generated.
+int dense_refine_test(int n, const double* A0)
+{
+	int lda = n;
+	double* A = (double*)malloc((size_t)lda * n * sizeof(double)); assert(A);
+	double* LU = (double*)malloc((size_t)lda * n * sizeof(double)); assert(LU);
+	float* SLU = (float*)malloc((size_t)lda * n * sizeof(float)); assert(SLU);
+	double* B = (double*)malloc(n * sizeof(double)); assert(B);
+	double* X = (double*)malloc(n * sizeof(double)); assert(X);
+	int* ipiv = (int*)malloc(n * sizeof(int)); assert(ipiv);
+
+	if (A0)
+		memcpy(A, A0, (size_t)lda * n * sizeof(double));
+	else
+		dgenerate_data(n, n, lda, A);
+	dgenerate_data(n, 1, n, B);
+	memcpy(LU, A, (size_t)lda * n * sizeof(double));
+
+	double flops = 2.0 / 3.0 * n * n * n;
+	printf("%d\t%s\t", n, "ir"); fflush(stdout);
+
+	double start = omp_get_wtime();
+
+	int iter = 0;
+	int info = dsgesv_host(n, 1, LU, lda, ipiv, B, n, X, n, &iter);
+
+	double time = omp_get_wtime() - start;
+	printf("%f sec\t%f\t", time, 1.0e-9 * flops / time); fflush(stdout);
+
+	int status = EXIT_FAILURE;
+	if (info)
+		printf("FAILED\tzero pivot %d", info);
+	else
+		status = dense_refine_check(n, A, lda, B, X);
+	if (iter >= 0)
+		printf("\t%d iterations\n", iter);
+	else
+		printf("\tfallback to fp64 (%d)\n", iter);
+
+	// Double precision solver.
+	memcpy(LU, A, (size_t)lda * n * sizeof(double));
+	memcpy(X, B, n * sizeof(double));
+
+	printf("%d\t%s\t", n, "lu64"); fflush(stdout);
+
+	start = omp_get_wtime();
+
+	info = dgetrf_host(n, LU, lda, ipiv);
+	if (!info) dgetrs_host(n, 1, LU, lda, ipiv, X, n);
+
+	time = omp_get_wtime() - start;
+	printf("%f sec\t%f\t", time, 1.0e-9 * flops / time); fflush(stdout);
+
+	if (info)
+		printf("FAILED\tzero pivot %d", info);
+	else
+		dense_refine_check(n, A, lda, B, X);
+	printf("\n");
+
+	// Single precision factorization, which bounds
+	// the speed of mixed precision solver.
+	for (size_t i = 0; i < (size_t)lda * n; i++)
+		SLU[i] = (float)A[i];
+
+	printf("%d\t%s\t", n, "lu32"); fflush(stdout);
+
+	start = omp_get_wtime();
+
+	sgetrf_host(n, SLU, lda, ipiv);
+
+	time = omp_get_wtime() - start;
+	printf("%f sec\t%f\n", time, 1.0e-9 * flops / time);
+
+	free(A);
+	free(LU);
+	free(SLU);
+	free(B);
+	free(X);
+	free(ipiv);
+
+	return status;
+}
+
+#endif // DENSE_REFINE_TEST_H
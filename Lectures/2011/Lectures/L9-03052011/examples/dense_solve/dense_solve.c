@@ -0,0 +1,150 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * This sample solves dense linear systems by blocked LU and Cholesky
+ * factorizations on top of the multithreaded host GEMM, or by mixed
+ * precision LU with iterative refinement. The matrix is either read from
+ * file in the format of Assignments/1/matrix.txt, or generated.
+ */
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gemm_partition.h"
+
+#define HAVE_SINGLE
+#include "gemm_check.h"
+#include "gemm_host.h"
+#include "gemm_trsm.h"
+#include "dense_solve.h"
+#include "dense_solve_test.h"
+#undef HAVE_SINGLE
+
+#define HAVE_DOUBLE
+#include "gemm_check.h"
+#include "gemm_host.h"
+#include "gemm_trsm.h"
+#include "dense_solve.h"
+#include "dense_solve_test.h"
+#undef HAVE_DOUBLE
+
+#include "dense_refine.h"
+#include "dense_refine_test.h"
+
+// Read the matrix file: the number of rows and columns, followed
+// by elements row by row. Returns the column-major square matrix.
+static double* read_matrix(const char* filename, int* n)
+{
+	FILE* file = fopen(filename, "r");
+	if (!file) return NULL;
+
+	int rows = 0, cols = 0;
+	if ((fscanf(file, "%d %d", &rows, &cols) != 2) || (rows <= 0) || (rows != cols))
+	{
+		fprintf(stderr, "%s: expected square matrix dimensions\n", filename);
+		fclose(file);
+		return NULL;
+	}
+
+	double* A = (double*)malloc((size_t)rows * cols * sizeof(double)); assert(A);
+	for (int i = 0; i < rows; i++)
+		for (int j = 0; j < cols; j++)
+			if (fscanf(file, "%lf", &A[i + (size_t)j * rows]) != 1)
+			{
+				fprintf(stderr, "%s: expected %d x %d elements\n", filename, rows, cols);
+				fclose(file);
+				free(A);
+				return NULL;
+			}
+
+	fclose(file);
+	*n = rows;
+	return A;
+}
+
+// Generate n x n matrix of the assignment at scale: the tridiagonal
+// matrix with -2 on the diagonal and 1 on both off-diagonals.
+static double* generate_laplace(int n)
+{
+	double* A = (double*)calloc((size_t)n * n, sizeof(double)); assert(A);
+	for (int i = 0; i < n; i++)
+	{
+		A[i + (size_t)i * n] = -2;
+		if (i > 0) A[i + (size_t)(i - 1) * n] = 1;
+		if (i < n - 1) A[i + (size_t)(i + 1) * n] = 1;
+	}
+	return A;
+}
+
+int main(int argc, char* argv[])
+{
+	if ((argc != 4) && (argc != 5))
+	{
+		printf("Usage: %s <precision> <method> <n | matrix_file> [laplace]\n", argv[0]);
+		printf("where method is lu, chol or ir (mixed precision LU with iterative\n");
+		printf("refinement, precision 8 only), laplace generates n x n matrix\n");
+		printf("of the same kind as Assignments/1/matrix.txt\n");
+		return 0;
+	}
+
+	int precision = atoi(argv[1]);
+	assert((precision == 4) || (precision == 8));
+
+	char method = argv[2][0];
+	assert(!strcmp(argv[2], "lu") || !strcmp(argv[2], "chol") ||
+		(!strcmp(argv[2], "ir") && (precision == 8)));
+
+	// Argument is either the matrix file, or the size
+	// of the generated matrix.
+	int n = 0;
+	double* A = NULL;
+	FILE* file = fopen(argv[3], "r");
+	if (file)
+	{
+		fclose(file);
+		A = read_matrix(argv[3], &n);
+		if (!A) return EXIT_FAILURE;
+	}
+	else
+	{
+		// Not a file and not a number: most likely, the mistyped path.
+		char* end;
+		long size = strtol(argv[3], &end, 10);
+		if ((end == argv[3]) || *end)
+		{
+			fprintf(stderr, "Cannot open %s\n", argv[3]);
+			return EXIT_FAILURE;
+		}
+		n = (int)size;
+		assert(n > 0);
+		if (argc == 5)
+		{
+			assert(!strcmp(argv[4], "laplace"));
+			A = generate_laplace(n);
+		}
+	}
+
+	printf("%d OpenMP threads used\n", omp_get_max_threads());
+	printf("n\tmethod\ttime\t\tgflops\t\ttest\tresidual\n");
+
+	int status = (method == 'i') ? dense_refine_test(n, A) : (precision == 4) ?
+		sdense_solve_test(method, n, A) : ddense_solve_test(method, n, A);
+
+	if (A) free(A);
+
+	return status;
+}
@@ -0,0 +1,238 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Blocked LU factorization with partial pivoting and blocked Cholesky
+ * factorization on top of the host GEMM. Both are right-looking: the
+ * narrow panel is factored, then the trailing matrix is updated by GEMM
+ * (syrk for Cholesky), which takes most of the flops and is threaded by
+ * gemm_host itself. Must be included after gemm_trsm.h.
+ * All matrices are column-major, pivot indices are 0-based.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define gemm_host sgemm_host
+#define laswp_host slaswp_host
+#define trsm_host strsm_host
+#define syrk_host ssyrk_host
+#define getrf_panel sgetrf_panel
+#define getrf_host sgetrf_host
+#define getrs_host sgetrs_host
+#define potf2_host spotf2_host
+#define potrf_host spotrf_host
+#define potrs_host spotrs_host
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define gemm_host dgemm_host
+#define laswp_host dlaswp_host
+#define trsm_host dtrsm_host
+#define syrk_host dsyrk_host
+#define getrf_panel dgetrf_panel
+#define getrf_host dgetrf_host
+#define getrs_host dgetrs_host
+#define potf2_host dpotf2_host
+#define potrf_host dpotrf_host
+#define potrs_host dpotrs_host
+#endif
+
+// The width of factored panel.
+#ifndef DENSE_NB
+#define DENSE_NB 128
+#endif
+
+// The width of panel, factored without recursion.
+#ifndef DENSE_LEAF
+#define DENSE_LEAF 8
+#endif
+
+// Apply row interchanges k1 <= i < k2 from ipiv to n columns of A.
+static void laswp_host(int n, real* A, int lda, int k1, int k2, const int* ipiv)
+{
+	#pragma omp parallel for if (n > 64)
+	for (int j = 0; j < n; j++)
+	{
+		real* a = A + (size_t)j * lda;
+		for (int i = k1; i < k2; i++)
+		{
+			int p = ipiv[i];
+			if (p == i) continue;
+			real t = a[i]; a[i] = a[p]; a[p] = t;
+		}
+	}
+}
+
+// Factor m x n panel (m >= n) recursively: the left half is factored,
+// the right half is updated by GEMM, then factored as well. Returns
+// 0 or the 1-based index of the first zero pivot.
+static int getrf_panel(int m, int n, real* A, int lda, int* ipiv)
+{
+	int info = 0;
+	if (n <= DENSE_LEAF)
+	{
+		for (int j = 0; j < n; j++)
+		{
+			real* a = A + (size_t)j * lda;
+
+			// Find the pivot and swap rows within the panel.
+			int p = j;
+			for (int i = j + 1; i < m; i++)
+				if (fabs(a[i]) > fabs(a[p])) p = i;
+			ipiv[j] = p;
+			if (a[p] == 0)
+			{
+				if (!info) info = j + 1;
+				continue;
+			}
+			if (p != j)
+				for (int l = 0; l < n; l++)
+				{
+					real* al = A + (size_t)l * lda;
+					real t = al[j]; al[j] = al[p]; al[p] = t;
+				}
+
+			// Scale the column and update the rest of the panel.
+			real r = 1 / a[j];
+			#pragma omp parallel for if (m - j > 4096)
+			for (int i = j + 1; i < m; i++)
+			{
+				a[i] *= r;
+				for (int l = j + 1; l < n; l++)
+					A[i + (size_t)l * lda] -= a[i] * A[j + (size_t)l * lda];
+			}
+		}
+		return info;
+	}
+
+	int n1 = n / 2, n2 = n - n1;
+	real* A12 = A + (size_t)n1 * lda;
+	real* A21 = A + n1;
+	real* A22 = A12 + n1;
+
+	info = getrf_panel(m, n1, A, lda, ipiv);
+	laswp_host(n2, A12, lda, 0, n1, ipiv);
+	trsm_host('L', 'L', 'N', 'U', n1, n2, 1, A, lda, A12, lda);
+	gemm_host('N', 'N', m - n1, n2, n1, -1, A21, lda, A12, lda, 1, A22, lda);
+
+	int info2 = getrf_panel(m - n1, n2, A22, lda, ipiv + n1);
+	if (!info && info2) info = info2 + n1;
+	for (int i = n1; i < n; i++)
+		ipiv[i] += n1;
+	laswp_host(n1, A, lda, n1, n, ipiv);
+
+	return info;
+}
+
+// Compute LU factorization of n x n A with partial pivoting:
+// P * A = L * U. Returns 0 or the 1-based index of the first
+// zero pivot (factorization is completed anyway).
+int getrf_host(int n, real* A, int lda, int* ipiv)
+{
+	int info = 0;
+	for (int j = 0; j < n; j += DENSE_NB)
+	{
+		int jb = n - j < DENSE_NB ? n - j : DENSE_NB;
+		real* A11 = A + j + (size_t)j * lda;
+
+		int info1 = getrf_panel(n - j, jb, A11, lda, ipiv + j);
+		if (!info && info1) info = info1 + j;
+		for (int i = j; i < j + jb; i++)
+			ipiv[i] += j;
+
+		// Apply interchanges to the left and right of the panel.
+		laswp_host(j, A, lda, j, j + jb, ipiv);
+		if (j + jb == n) break;
+		real* A12 = A11 + (size_t)jb * lda;
+		laswp_host(n - j - jb, A + (size_t)(j + jb) * lda, lda, j, j + jb, ipiv);
+
+		// Compute the block row of U and update the trailing matrix.
+		trsm_host('L', 'L', 'N', 'U', jb, n - j - jb, 1, A11, lda, A12, lda);
+		gemm_host('N', 'N', n - j - jb, n - j - jb, jb,
+			-1, A11 + jb, lda, A12, lda, 1, A12 + jb, lda);
+	}
+	return info;
+}
+
+// Solve A * X = B with LU factorization from getrf_host.
+void getrs_host(int n, int nrhs, const real* A, int lda, const int* ipiv,
+	real* B, int ldb)
+{
+	laswp_host(nrhs, B, ldb, 0, n, ipiv);
+	trsm_host('L', 'L', 'N', 'U', n, nrhs, 1, A, lda, B, ldb);
+	trsm_host('L', 'U', 'N', 'N', n, nrhs, 1, A, lda, B, ldb);
+}
+
+// Compute Cholesky factorization of small n x n A = L * L^T
+// without blocking. Returns 0 or the 1-based index of the
+// first non-positive pivot.
+static int potf2_host(int n, real* A, int lda)
+{
+	for (int k = 0; k < n; k++)
+	{
+		real* a = A + (size_t)k * lda;
+		if (a[k] <= 0) return k + 1;
+		a[k] = sqrt(a[k]);
+		for (int i = k + 1; i < n; i++)
+			a[i] /= a[k];
+		for (int j = k + 1; j < n; j++)
+		{
+			real* aj = A + (size_t)j * lda;
+			for (int i = j; i < n; i++)
+				aj[i] -= a[i] * a[j];
+		}
+	}
+	return 0;
+}
+
+// Compute Cholesky factorization of symmetric positive definite
+// n x n A = L * L^T. Only the lower triangle of A is referenced
+// and overwritten. Returns 0 or the 1-based index of the first
+// non-positive pivot.
+int potrf_host(int n, real* A, int lda)
+{
+	for (int j = 0; j < n; j += DENSE_NB)
+	{
+		int jb = n - j < DENSE_NB ? n - j : DENSE_NB;
+		real* A11 = A + j + (size_t)j * lda;
+
+		int info = potf2_host(jb, A11, lda);
+		if (info) return info + j;
+		if (j + jb == n) break;
+
+		// Compute the block column of L and update lower
+		// triangle of the trailing matrix A22 -= A21 * A21^T.
+		real* A21 = A11 + jb;
+		trsm_host('R', 'L', 'T', 'N', n - j - jb, jb, 1, A11, lda, A21, lda);
+		syrk_host('L', 'N', n - j - jb, jb, -1, A21, lda, 1, A21 + (size_t)jb * lda, lda);
+	}
+	return 0;
+}
+
+// Solve A * X = B with Cholesky factorization from potrf_host.
+void potrs_host(int n, int nrhs, const real* A, int lda, real* B, int ldb)
+{
+	trsm_host('L', 'L', 'N', 'N', n, nrhs, 1, A, lda, B, ldb);
+	trsm_host('L', 'L', 'T', 'N', n, nrhs, 1, A, lda, B, ldb);
+}
+
+#undef real
+#undef gemm_host
+#undef laswp_host
+#undef trsm_host
+#undef syrk_host
+#undef getrf_panel
+#undef getrf_host
+#undef getrs_host
+#undef potf2_host
+#undef potrf_host
+#undef potrs_host
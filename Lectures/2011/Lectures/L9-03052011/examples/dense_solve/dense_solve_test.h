@@ -0,0 +1,146 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Test of dense solvers: factor the matrix, solve for the random right
+ * hand side and check the scaled residual. For comparison, the GEMM of
+ * the same size is measured as well.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define real_eps FLT_EPSILON
+#define gemm_host sgemm_host
+#define getrf_host sgetrf_host
+#define getrs_host sgetrs_host
+#define potrf_host spotrf_host
+#define potrs_host spotrs_host
+#define generate_data sgenerate_data
+#define dense_solve_test sdense_solve_test
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define real_eps DBL_EPSILON
+#define gemm_host dgemm_host
+#define getrf_host dgetrf_host
+#define getrs_host dgetrs_host
+#define potrf_host dpotrf_host
+#define potrs_host dpotrs_host
+#define generate_data dgenerate_data
+#define dense_solve_test ddense_solve_test
+#endif
+
+// Solve n x n system with the given method ('l' for LU, 'c' for
+// Cholesky). The matrix is taken from A0, if it is not NULL,
+// otherwise it is generated (diagonally dominant for Cholesky).
+int dense_solve_test(char method, int n, const double* A0)
+{
+	int lda = n, nrhs = 1;
+	real* A = (real*)malloc((size_t)lda * n * sizeof(real)); assert(A);
+	real* LU = (real*)malloc((size_t)lda * n * sizeof(real)); assert(LU);
+	real* B = (real*)malloc((size_t)n * nrhs * sizeof(real)); assert(B);
+	real* X = (real*)malloc((size_t)n * nrhs * sizeof(real)); assert(X);
+	int* ipiv = (int*)malloc(n * sizeof(int)); assert(ipiv);
+
+	if (A0)
+	{
+		for (size_t i = 0; i < (size_t)lda * n; i++)
+			A[i] = A0[i];
+	}
+	else
+	{
+		generate_data(n, n, lda, A);
+		if (method == 'c')
+			for (int j = 0; j < n; j++)
+			{
+				for (int i = j + 1; i < n; i++)
+					A[j + (size_t)i * lda] = A[i + (size_t)j * lda];
+				A[j + (size_t)j * lda] += n;
+			}
+	}
+	generate_data(n, nrhs, n, B);
+	memcpy(LU, A, (size_t)lda * n * sizeof(real));
+	memcpy(X, B, (size_t)n * nrhs * sizeof(real));
+
+	printf("%d\t%s\t", n, (method == 'l') ? "lu" : "chol"); fflush(stdout);
+
+	double start = omp_get_wtime();
+
+	int info = (method == 'l') ? getrf_host(n, LU, lda, ipiv) :
+		potrf_host(n, LU, lda);
+
+	double time = omp_get_wtime() - start;
+	double flops = (method == 'l') ? 2.0 / 3.0 * n * n * n : 1.0 / 3.0 * n * n * n;
+	printf("%f sec\t%f\t", time, 1.0e-9 * flops / time); fflush(stdout);
+
+	if (info)
+	{
+		printf("FAILED\t%s %d\n", (method == 'l') ? "zero pivot" :
+			"not positive definite at", info);
+		free(A); free(LU); free(B); free(X); free(ipiv);
+		return EXIT_FAILURE;
+	}
+
+	if (method == 'l')
+		getrs_host(n, nrhs, LU, lda, ipiv, X, n);
+	else
+		potrs_host(n, nrhs, LU, lda, X, n);
+
+	// Scaled residual ||B - A X|| / (||A|| ||X|| n eps)
+	// in the infinity norm must be of order 1.
+	double norm_a = 0, norm_x = 0, norm_r = 0;
+	for (int i = 0; i < n; i++)
+	{
+		double s = 0;
+		for (int j = 0; j < n; j++)
+			s += fabs(A[i + (size_t)j * lda]);
+		if (s > norm_a) norm_a = s;
+	}
+	gemm_host('N', 'N', n, nrhs, n, -1, A, lda, X, n, 1, B, n);
+	for (size_t i = 0; i < (size_t)n * nrhs; i++)
+	{
+		if (fabs(X[i]) > norm_x) norm_x = fabs(X[i]);
+		if (fabs(B[i]) > norm_r) norm_r = fabs(B[i]);
+	}
+	double resid = norm_r / (norm_a * norm_x * n * real_eps);
+	int status = (resid < 16) ? EXIT_SUCCESS : EXIT_FAILURE;
+	printf("%s\t%f\n", (status == EXIT_SUCCESS) ? "PASSED" : "FAILED", resid);
+
+	// The GEMM of the same size, which bounds
+	// the factorization speed.
+	printf("%d\t%s\t", n, "gemm"); fflush(stdout);
+
+	start = omp_get_wtime();
+
+	gemm_host('N', 'N', n, n, n, 1, A, lda, A, lda, 0, LU, lda);
+
+	time = omp_get_wtime() - start;
+	printf("%f sec\t%f\n", time, 2.0e-9 * n * n * n / time);
+
+	free(A);
+	free(LU);
+	free(B);
+	free(X);
+	free(ipiv);
+
+	return status;
+}
+
+#undef real
+#undef real_eps
+#undef gemm_host
+#undef getrf_host
+#undef getrs_host
+#undef potrf_host
+#undef potrs_host
+#undef generate_data
+#undef dense_solve_test
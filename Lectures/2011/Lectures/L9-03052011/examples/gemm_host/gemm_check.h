@@ -0,0 +1,91 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Test data generation and validation shared by GEMM samples.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define blas_gemm sgemm_
+#define generate_data sgenerate_data
+#define check_result scheck_result
+#define check_result_eps scheck_result_eps
+#define tolerance stolerance
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define blas_gemm dgemm_
+#define generate_data dgenerate_data
+#define check_result dcheck_result
+#define check_result_eps dcheck_result_eps
+#define tolerance dtolerance
+#endif
+
+void blas_gemm(char* transa, char* transb, int* m, int* n, int* k,
+	real* alpha, real* A, int* lda, real* B, int* ldb,
+	real* beta, real* C, int* ldc);
+
+// The control and production results maximum
+// allowed difference.
+const real tolerance = 1e-6;
+
+// Fill the rows x cols matrix with leading dimension ld
+// with test data (padding is filled as well).
+void generate_data(int rows, int cols, int ld, real* A)
+{
+	real invrandmax = 1.0 / (real)RAND_MAX;
+	for (size_t i = 0, size = (size_t)ld * cols; i < size; i++)
+		A[i] = rand() * invrandmax;
+}
+
+// Compare m x n result against reference using the norm
+// of difference, and print the verdict for the given tolerance.
+int check_result_eps(int m, int n, real* C, int ldc,
+	real* C_ref, int ldc_ref, real eps)
+{
+	real error_norm = 0, ref_norm = 0;
+	for (int j = 0; j < n; j++)
+		for (int i = 0; i < m; i++)
+		{
+			real diff = C_ref[i + (size_t)j * ldc_ref] - C[i + (size_t)j * ldc];
+			error_norm += diff * diff;
+			ref_norm += C_ref[i + (size_t)j * ldc_ref] * C_ref[i + (size_t)j * ldc_ref];
+		}
+
+	error_norm = (real)sqrt((double)error_norm);
+	ref_norm = (real)sqrt((double)ref_norm);
+	if (fabs(ref_norm) < tolerance)
+	{
+		printf("Reference norm is 0\n");
+		return EXIT_FAILURE;
+	}
+	int passed = (error_norm / ref_norm < eps);
+	printf("%s\t%f\t%f\n", passed ? "PASSED" : "FAILED", error_norm, ref_norm);
+	fflush(stdout);
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Compare m x n result against reference with the default tolerance.
+int check_result(int m, int n, real* C, int ldc, real* C_ref, int ldc_ref)
+{
+	return check_result_eps(m, n, C, ldc, C_ref, ldc_ref, tolerance);
+}
+
+#undef real
+#undef blas_gemm
+#undef generate_data
+#undef check_result
+#undef check_result_eps
+#undef tolerance
+
@@ -0,0 +1,137 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Building blocks of fused GEMM epilogues. The host GEMM always applies
+ * alpha * AB + beta * C, then the optional tail of element-wise functors
+ * and the store conversion, while the C tile is still in registers.
+ * Functors are macros, composed by nesting, e.g.:
+ *
+ * #define GEMM_HOST_TAIL(x, i, j) GEMM_EPI_RELU(GEMM_EPI_BIAS_N(x, i, j))
+ *
+ * so every composition compiles into straight code without any
+ * runtime dispatch. Functors may refer to the epilogue parameters
+ * through the "epi" pointer.
+ */
+
+#ifndef GEMM_EPILOGUE_H
+#define GEMM_EPILOGUE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+// The epilogue parameters.
+typedef struct
+{
+	float alpha, beta;
+
+	// Bias vector, indexed by row or column of C.
+	const float* bias;
+
+	// Clamping bounds.
+	float lo, hi;
+}
+sgemm_epilogue_t;
+
+typedef struct
+{
+	double alpha, beta;
+	const double* bias;
+	double lo, hi;
+}
+dgemm_epilogue_t;
+
+// The IEEE 754 half precision value storage.
+typedef uint16_t gemm_half_t;
+
+// Convert float to half precision, rounding to nearest even.
+static inline gemm_half_t gemm_float_to_half(float f)
+{
+#ifdef __F16C__
+	return _cvtss_sh(f, 0);
+#else
+	uint32_t x; memcpy(&x, &f, sizeof(x));
+	uint32_t sign = (x >> 16) & 0x8000;
+	uint32_t absx = x & 0x7fffffff;
+
+	// NaN and infinity (and overflow to infinity).
+	if (absx >= 0x7f800000)
+		return sign | 0x7c00 | (absx > 0x7f800000 ? 0x200 : 0);
+	if (absx >= 0x477ff000)
+		return sign | 0x7c00;
+
+	// Subnormal half or zero.
+	if (absx < 0x38800000)
+	{
+		if (absx < 0x33000000) return sign;
+		uint32_t mant = (absx & 0x7fffff) | 0x800000;
+		int shift = 126 - (absx >> 23);
+		uint32_t half = mant >> shift;
+		uint32_t rem = mant & ((1u << shift) - 1);
+		uint32_t mid = 1u << (shift - 1);
+		if ((rem > mid) || ((rem == mid) && (half & 1))) half++;
+		return sign | half;
+	}
+
+	// Normal half: rebias exponent and round mantissa.
+	uint32_t half = ((absx - 0x38000000) >> 13);
+	uint32_t rem = absx & 0x1fff;
+	if ((rem > 0x1000) || ((rem == 0x1000) && (half & 1))) half++;
+	return sign | half;
+#endif
+}
+
+// Convert half precision to float.
+static inline float gemm_half_to_float(gemm_half_t h)
+{
+#ifdef __F16C__
+	return _cvtsh_ss(h);
+#else
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t expo = (h >> 10) & 0x1f;
+	uint32_t mant = h & 0x3ff;
+	uint32_t x;
+	if (expo == 0x1f)
+		x = sign | 0x7f800000 | (mant << 13);
+	else if (expo)
+		x = sign | ((expo + 112) << 23) | (mant << 13);
+	else if (mant)
+	{
+		// Normalize subnormal value.
+		expo = 113;
+		while (!(mant & 0x400)) { mant <<= 1; expo--; }
+		x = sign | (expo << 23) | ((mant & 0x3ff) << 13);
+	}
+	else
+		x = sign;
+	float f; memcpy(&f, &x, sizeof(f));
+	return f;
+#endif
+}
+
+// Add bias, indexed by column (j) or row (i) of C.
+#define GEMM_EPI_BIAS_N(x, i, j) ((x) + epi->bias[j])
+#define GEMM_EPI_BIAS_M(x, i, j) ((x) + epi->bias[i])
+
+// Element-wise activations.
+#define GEMM_EPI_RELU(x) ((x) > 0 ? (x) : 0)
+#define GEMM_EPI_CLAMP(x) ((x) < epi->lo ? epi->lo : ((x) > epi->hi ? epi->hi : (x)))
+
+// Half precision output conversions.
+#define GEMM_EPI_LOAD_F16(c) gemm_half_to_float(c)
+#define GEMM_EPI_STORE_F16(x) gemm_float_to_half(x)
+
+#endif // GEMM_EPILOGUE_H
+
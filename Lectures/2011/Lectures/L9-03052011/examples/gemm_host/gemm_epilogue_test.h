@@ -0,0 +1,169 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Test of fused GEMM epilogue instance, made with the same GEMM_HOST_*
+ * macros as gemm_host.h. Generates GEMM_HOST_NAME_test, which compares
+ * the fused GEMM against GEMM followed by separate epilogue passes.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define blas_gemm sgemm_
+#define gemm_host sgemm_host
+#define epilogue_t sgemm_epilogue_t
+#define generate_data sgenerate_data
+#define check_result_eps scheck_result_eps
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define blas_gemm dgemm_
+#define gemm_host dgemm_host
+#define epilogue_t dgemm_epilogue_t
+#define generate_data dgenerate_data
+#define check_result_eps dcheck_result_eps
+#endif
+
+// Allowed relative error, which depends on the output type.
+#ifndef GEMM_HOST_TOLERANCE
+#define GEMM_HOST_TOLERANCE 1e-6
+#define GEMM_HOST_TOLERANCE_DEFAULT
+#endif
+
+#define out_t GEMM_HOST_OUT
+
+int GEMM_HOST_CAT(GEMM_HOST_NAME, test)(char transa, char transb,
+	real alpha, real beta, int m, int n, int k, int lda, int ldb, int ldc)
+{
+	// Stored shapes of A and B depend on transposition.
+	int ta = (transa != 'n') && (transa != 'N');
+	int tb = (transb != 'n') && (transb != 'N');
+	int rows_a = ta ? k : m, cols_a = ta ? m : k;
+	int rows_b = tb ? n : k, cols_b = tb ? k : n;
+	if (!lda) lda = rows_a;
+	if (!ldb) ldb = rows_b;
+	if (!ldc) ldc = m;
+	assert((lda >= rows_a) && (ldb >= rows_b) && (ldc >= m));
+
+	size_t szc = (size_t)ldc * n;
+	real* A = (real*)malloc((size_t)lda * cols_a * sizeof(real)); assert(A);
+	real* B = (real*)malloc((size_t)ldb * cols_b * sizeof(real)); assert(B);
+	real* C_real = (real*)malloc(szc * sizeof(real)); assert(C_real);
+	real* C_ref = (real*)malloc(szc * sizeof(real)); assert(C_ref);
+	real* bias = (real*)malloc(((m > n) ? m : n) * sizeof(real)); assert(bias);
+	out_t* C = (out_t*)malloc(szc * sizeof(out_t)); assert(C);
+	out_t* C_init = (out_t*)malloc(szc * sizeof(out_t)); assert(C_init);
+
+	generate_data(rows_a, cols_a, lda, A);
+	generate_data(rows_b, cols_b, ldb, B);
+	generate_data(m, n, ldc, C_real);
+	for (size_t i = 0; i < szc; i++)
+		C_init[i] = GEMM_HOST_STORE(C_real[i]);
+
+	// Negative bias of the order of the product itself
+	// makes roughly half of results hit the activation.
+	for (int i = 0; i < ((m > n) ? m : n); i++)
+		bias[i] = -alpha * k * 0.5 * rand() / (real)RAND_MAX;
+
+	epilogue_t epilogue;
+	epilogue_t* epi = &epilogue;
+	epi->alpha = alpha;
+	epi->beta = beta;
+	epi->bias = bias;
+	epi->lo = 0;
+	epi->hi = alpha * k / 8;
+
+	// Fused GEMM.
+	memcpy(C, C_init, szc * sizeof(out_t));
+
+	printf("%d\t%d\t%d\t", m, n, k); fflush(stdout);
+
+	double start = omp_get_wtime();
+
+	gemm_partition_t partition = GEMM_HOST_NAME(transa, transb, m, n, k,
+		A, lda, B, ldb, epi, C, ldc);
+
+	double time = omp_get_wtime() - start;
+	printf("%s\t%f sec\t%f\t", gemm_split_name(partition.split),
+		time, 2.0e-9 * m * n * k / time); fflush(stdout);
+
+	// Reference: host BLAS, then the epilogue functors
+	// one by one, with the same rounding of output.
+	for (size_t i = 0; i < szc; i++)
+		C_ref[i] = GEMM_HOST_LOAD(C_init[i]);
+	blas_gemm(&transa, &transb, &m, &n, &k,
+		&alpha, A, &lda, B, &ldb, &beta, C_ref, &ldc);
+	for (int j = 0; j < n; j++)
+		for (int i = 0; i < m; i++)
+		{
+			real x = C_ref[i + (size_t)j * ldc];
+			C_ref[i + (size_t)j * ldc] = GEMM_HOST_LOAD(
+				GEMM_HOST_STORE(GEMM_HOST_TAIL(x, i, j)));
+		}
+
+	for (size_t i = 0; i < szc; i++)
+		C_real[i] = GEMM_HOST_LOAD(C[i]);
+	int status = check_result_eps(m, n, C_real, ldc, C_ref, ldc,
+		GEMM_HOST_TOLERANCE);
+
+	// Unfused: plain GEMM, followed by separate
+	// passes for the tail and output conversion.
+	for (size_t i = 0; i < szc; i++)
+		C_real[i] = GEMM_HOST_LOAD(C_init[i]);
+
+	printf("%d\t%d\t%d\t", m, n, k); fflush(stdout);
+
+	start = omp_get_wtime();
+
+	gemm_host(transa, transb, m, n, k,
+		alpha, A, lda, B, ldb, beta, C_real, ldc);
+	#pragma omp parallel for
+	for (int j = 0; j < n; j++)
+		for (int i = 0; i < m; i++)
+			C_real[i + (size_t)j * ldc] = GEMM_HOST_TAIL(C_real[i + (size_t)j * ldc], i, j);
+	#pragma omp parallel for
+	for (int j = 0; j < n; j++)
+		for (int i = 0; i < m; i++)
+			C[i + (size_t)j * ldc] = GEMM_HOST_STORE(C_real[i + (size_t)j * ldc]);
+
+	time = omp_get_wtime() - start;
+	printf("%s\t%f sec\t%f\t", "passes", time, 2.0e-9 * m * n * k / time);
+	fflush(stdout);
+
+	for (size_t i = 0; i < szc; i++)
+		C_real[i] = GEMM_HOST_LOAD(C[i]);
+	status |= check_result_eps(m, n, C_real, ldc, C_ref, ldc,
+		GEMM_HOST_TOLERANCE);
+
+	free(A);
+	free(B);
+	free(C);
+	free(C_init);
+	free(C_real);
+	free(C_ref);
+	free(bias);
+
+	return status;
+}
+
+#undef real
+#undef blas_gemm
+#undef gemm_host
+#undef epilogue_t
+#undef generate_data
+#undef check_result_eps
+#undef out_t
+#ifdef GEMM_HOST_TOLERANCE_DEFAULT
+#undef GEMM_HOST_TOLERANCE
+#undef GEMM_HOST_TOLERANCE_DEFAULT
+#endif
+
@@ -0,0 +1,306 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * This sample measures the multithreaded host GEMM on general
+ * rectangular shapes and checks it against the reference host BLAS.
+ * Optionally GEMM is measured with the fused epilogue, against
+ * the GEMM followed by separate epilogue passes. Precision 1 and 2
+ * select u8 * s8 and bf16 GEMM with fp32 result. Instead of epilogue,
+ * trsm or syrk may be given to measure these routines (all variants),
+ * strassen to measure Strassen-Winograd GEMM against the classical one,
+ * or tune (strassen_tune) to search the best blocking for the given
+ * shapes (Strassen crossover up to the largest size) and save it for
+ * the further runs. Level 2 gemv (for the given transa) and ger are
+ * measured on m x n matrices against the stream bandwidth.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gemm_partition.h"
+#include "gemm_tune.h"
+
+#define HAVE_SINGLE
+#include "gemm_check.h"
+#include "gemm_host.h"
+#include "gemm_trsm.h"
+#include "gemm_strassen.h"
+#include "gemm_level2.h"
+#undef HAVE_SINGLE
+
+#define HAVE_DOUBLE
+#include "gemm_check.h"
+#include "gemm_host.h"
+#include "gemm_trsm.h"
+#include "gemm_strassen.h"
+#include "gemm_level2.h"
+#undef HAVE_DOUBLE
+
+#define HAVE_SINGLE
+#include "gemm_host_test.h"
+#include "gemm_host_tune.h"
+#include "gemm_trsm_test.h"
+#include "gemm_strassen_test.h"
+#include "gemm_level2_test.h"
+#undef HAVE_SINGLE
+
+#define HAVE_DOUBLE
+#include "gemm_host_test.h"
+#include "gemm_host_tune.h"
+#include "gemm_trsm_test.h"
+#include "gemm_strassen_test.h"
+#include "gemm_level2_test.h"
+#undef HAVE_DOUBLE
+
+// Fused epilogue instances: per-column bias and ReLU,
+// optionally followed by conversion to half precision,
+// or per-row bias and clamping to half precision.
+#define GEMM_HOST_TAIL(x, i, j) GEMM_EPI_RELU(GEMM_EPI_BIAS_N(x, i, j))
+#define GEMM_HOST_LOAD(c) (c)
+#define GEMM_HOST_STORE(x) (x)
+#define GEMM_HOST_INPLACE
+
+#define HAVE_SINGLE
+#define GEMM_HOST_NAME sgemm_host_bias_relu
+#define GEMM_HOST_OUT float
+#include "gemm_host.h"
+#include "gemm_epilogue_test.h"
+#undef GEMM_HOST_NAME
+#undef GEMM_HOST_OUT
+#undef HAVE_SINGLE
+
+#define HAVE_DOUBLE
+#define GEMM_HOST_NAME dgemm_host_bias_relu
+#define GEMM_HOST_OUT double
+#include "gemm_host.h"
+#include "gemm_epilogue_test.h"
+#undef GEMM_HOST_NAME
+#undef GEMM_HOST_OUT
+#undef HAVE_DOUBLE
+
+#undef GEMM_HOST_LOAD
+#undef GEMM_HOST_STORE
+#undef GEMM_HOST_INPLACE
+
+#define GEMM_HOST_OUT gemm_half_t
+#define GEMM_HOST_LOAD GEMM_EPI_LOAD_F16
+#define GEMM_HOST_STORE GEMM_EPI_STORE_F16
+#define GEMM_HOST_TOLERANCE 1e-3
+
+#define HAVE_SINGLE
+#define GEMM_HOST_NAME sgemm_host_bias_relu_f16
+#include "gemm_host.h"
+#include "gemm_epilogue_test.h"
+#undef GEMM_HOST_NAME
+#undef GEMM_HOST_TAIL
+
+#define GEMM_HOST_TAIL(x, i, j) GEMM_EPI_CLAMP(GEMM_EPI_BIAS_M(x, i, j))
+#define GEMM_HOST_NAME sgemm_host_bias_clamp_f16
+#include "gemm_host.h"
+#include "gemm_epilogue_test.h"
+#undef GEMM_HOST_NAME
+#undef GEMM_HOST_TAIL
+#undef HAVE_SINGLE
+
+#undef GEMM_HOST_OUT
+#undef GEMM_HOST_LOAD
+#undef GEMM_HOST_STORE
+#undef GEMM_HOST_TOLERANCE
+
+#include "gemm_lowp.h"
+#include "gemm_lowp_test.h"
+
+int main(int argc, char* argv[])
+{
+	if ((argc != 9) && (argc != 10) && (argc != 12) && (argc != 13))
+	{
+		printf("Usage: %s <precision> %s %s\n", argv[0],
+			"<n_min> <n_max> <n_step> <transa> <transb>",
+			"<alpha> <beta> [<epilogue>]");
+		printf("       %s <precision> %s %s\n", argv[0],
+			"<m> <n> <k> <lda> <ldb> <ldc> <transa> <transb>",
+			"<alpha> <beta> [<epilogue>]");
+		printf("where precision is 4 (float), 8 (double), %s\n",
+			"1 (u8 * s8) or 2 (bf16 * bf16)");
+		printf("and epilogue is one of: none, bias_relu, %s\n%s\n",
+			"bias_relu_f16, bias_clamp_f16 (float only),",
+			"or trsm, syrk, strassen, tune, strassen_tune, gemv, ger");
+		return 0;
+	}
+
+	int precision = atoi(argv[1]);
+	assert((precision == 1) || (precision == 2) ||
+		(precision == 4) || (precision == 8));
+
+	// Either sweep square sizes, or run single rectangular
+	// shape. Zero leading dimensions mean tight storage.
+	int m = 0, k = 0, lda = 0, ldb = 0, ldc = 0;
+	int n_min, n_max, n_step = 1, iarg = 5;
+	if (argc < 12)
+	{
+		n_min = atoi(argv[2]); assert(n_min > 0);
+		n_max = atoi(argv[3]);
+		n_step = atoi(argv[4]); assert(n_step > 0);
+	}
+	else
+	{
+		m = atoi(argv[2]); assert(m > 0);
+		n_min = atoi(argv[3]); assert(n_min > 0);
+		n_max = n_min + 1;
+		k = atoi(argv[4]); assert(k > 0);
+		lda = atoi(argv[5]); ldb = atoi(argv[6]); ldc = atoi(argv[7]);
+		iarg = 8;
+	}
+
+	char transa = argv[iarg][0];
+	assert((transa == 'n') || (transa == 'N') ||
+		(transa == 't') || (transa == 'T'));
+	char transb = argv[iarg + 1][0];
+	assert((transb == 'n') || (transb == 'N') ||
+		(transb == 't') || (transb == 'T'));
+
+	const char* epilogue = (argc == 10) || (argc == 13) ? argv[iarg + 4] : "none";
+	int level3 = !strcmp(epilogue, "trsm") || !strcmp(epilogue, "syrk") ||
+		!strcmp(epilogue, "strassen") || !strcmp(epilogue, "tune") ||
+		!strcmp(epilogue, "strassen_tune") || !strcmp(epilogue, "gemv") ||
+		!strcmp(epilogue, "ger");
+	assert(!strcmp(epilogue, "none") || !strcmp(epilogue, "bias_relu") || level3 ||
+		(!strcmp(epilogue, "bias_relu_f16") && (precision == 4)) ||
+		(!strcmp(epilogue, "bias_clamp_f16") && (precision == 4)));
+
+	assert(!strcmp(epilogue, "none") || (precision >= 4));
+
+	printf("%d OpenMP threads used\n", omp_get_max_threads());
+	if (precision < 4)
+		printf("%s kernel used\n", gemm_lowp_isa(
+			(precision == 1) ? GEMM_LOWP_U8S8 : GEMM_LOWP_BF16));
+
+	int status = EXIT_SUCCESS;
+
+	// Tune blocking for all shapes together, then
+	// test them with the best blocking.
+	if (!strcmp(epilogue, "tune"))
+	{
+		int nshapes = 0;
+		for (int n = n_min; n < n_max; n += n_step)
+			nshapes++;
+		int* ms = (int*)malloc(nshapes * sizeof(int)); assert(ms);
+		int* ns = (int*)malloc(nshapes * sizeof(int)); assert(ns);
+		int* ks = (int*)malloc(nshapes * sizeof(int)); assert(ks);
+		for (int i = 0, n = n_min; n < n_max; n += n_step, i++)
+		{
+			ms[i] = m ? m : n;
+			ns[i] = n;
+			ks[i] = k ? k : n;
+		}
+		status = (precision == 4) ?
+			sgemm_host_tune(transa, transb, nshapes, ms, ns, ks) :
+			dgemm_host_tune(transa, transb, nshapes, ms, ns, ks);
+		free(ms);
+		free(ns);
+		free(ks);
+		epilogue = "none";
+	}
+
+	// Tune Strassen crossover up to the largest size,
+	// then test Strassen GEMM with it.
+	if (!strcmp(epilogue, "strassen_tune"))
+	{
+		int n_last = n_min;
+		for (int n = n_min; n < n_max; n += n_step)
+			n_last = n;
+		status = (precision == 4) ? sgemm_strassen_tune(n_last) :
+			dgemm_strassen_tune(n_last);
+		epilogue = "strassen";
+	}
+
+	if (precision >= 4)
+	{
+		const gemm_blocking_t* b = (precision == 4) ?
+			sgemm_host_blocking() : dgemm_host_blocking();
+		printf("blocking %d %d %d %dx%d\n", b->mc, b->kc, b->nc, b->mv, b->nr);
+		if (!strcmp(epilogue, "strassen"))
+			printf("crossover %d\n", gemm_tune_crossover((precision == 4) ? 's' : 'd'));
+	}
+	if (!strcmp(epilogue, "gemv") || !strcmp(epilogue, "ger"))
+		printf("m\tn\tlda\top\ttime\t\tGB/s\t\tstream\ttest\tenorm\t\trnorm\n");
+	else
+		printf("m\tn\tk\tsplit\ttime\t\tgflops\t\ttest\tenorm\t\trnorm\n");
+
+	for (int n = n_min; n < n_max; n += n_step)
+	{
+		int mm = m ? m : n, kk = k ? k : n;
+		if (precision < 4)
+			status |= gemm_lowp_test((precision == 1) ?
+				GEMM_LOWP_U8S8 : GEMM_LOWP_BF16, transa, transb,
+				(float)atof(argv[iarg + 2]), (float)atof(argv[iarg + 3]),
+				mm, n, kk, lda, ldb, ldc);
+		if (precision == 4)
+		{
+			float alpha = (float)atof(argv[iarg + 2]);
+			float beta = (float)atof(argv[iarg + 3]);
+
+			if (!strcmp(epilogue, "none"))
+				status |= sgemm_host_test(transa, transb,
+					alpha, beta, mm, n, kk, lda, ldb, ldc);
+			else if (!strcmp(epilogue, "trsm"))
+				status |= strsm_host_test(alpha, mm, n, lda, ldb);
+			else if (!strcmp(epilogue, "syrk"))
+				status |= ssyrk_host_test(transa, alpha, beta, n, kk, lda, ldc);
+			else if (!strcmp(epilogue, "strassen"))
+				status |= sgemm_strassen_test(transa, transb,
+					alpha, beta, mm, n, kk, lda, ldb, ldc);
+			else if (!strcmp(epilogue, "gemv"))
+				status |= sgemv_host_test(transa, alpha, beta, mm, n, lda);
+			else if (!strcmp(epilogue, "ger"))
+				status |= sger_host_test(alpha, mm, n, lda);
+			else if (!strcmp(epilogue, "bias_relu"))
+				status |= sgemm_host_bias_relu_test(transa, transb,
+					alpha, beta, mm, n, kk, lda, ldb, ldc);
+			else if (!strcmp(epilogue, "bias_relu_f16"))
+				status |= sgemm_host_bias_relu_f16_test(transa, transb,
+					alpha, beta, mm, n, kk, lda, ldb, ldc);
+			else
+				status |= sgemm_host_bias_clamp_f16_test(transa, transb,
+					alpha, beta, mm, n, kk, lda, ldb, ldc);
+		}
+		if (precision == 8)
+		{
+			double alpha = atof(argv[iarg + 2]);
+			double beta = atof(argv[iarg + 3]);
+
+			if (!strcmp(epilogue, "none"))
+				status |= dgemm_host_test(transa, transb,
+					alpha, beta, mm, n, kk, lda, ldb, ldc);
+			else if (!strcmp(epilogue, "trsm"))
+				status |= dtrsm_host_test(alpha, mm, n, lda, ldb);
+			else if (!strcmp(epilogue, "syrk"))
+				status |= dsyrk_host_test(transa, alpha, beta, n, kk, lda, ldc);
+			else if (!strcmp(epilogue, "strassen"))
+				status |= dgemm_strassen_test(transa, transb,
+					alpha, beta, mm, n, kk, lda, ldb, ldc);
+			else if (!strcmp(epilogue, "gemv"))
+				status |= dgemv_host_test(transa, alpha, beta, mm, n, lda);
+			else if (!strcmp(epilogue, "ger"))
+				status |= dger_host_test(alpha, mm, n, lda);
+			else
+				status |= dgemm_host_bias_relu_test(transa, transb,
+					alpha, beta, mm, n, kk, lda, ldb, ldc);
+		}
+	}
+
+	return status;
+}
@@ -0,0 +1,457 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Multithreaded host GEMM: operands are packed into cache-sized panels
+ * and multiplied by the register-blocked MR x NR micro-kernel. The
+ * iteration space is split between OpenMP threads by gemm_partition.
+ * Block sizes and the micro-tile are chosen at runtime: tuned ones
+ * are loaded from the file of gemm_tune, if it has them for this CPU.
+ *
+ * Besides precision, the header may be instantiated with a fused
+ * epilogue (see gemm_epilogue.h) by defining before inclusion:
+ *
+ * GEMM_HOST_NAME - the name of generated function;
+ * GEMM_HOST_OUT - the type of C elements;
+ * GEMM_HOST_LOAD(c) - convert C element to real for beta * C;
+ * GEMM_HOST_TAIL(x, i, j) - element-wise functors after alpha/beta;
+ * GEMM_HOST_STORE(x) - convert real to C element;
+ * GEMM_HOST_INPLACE - define, if C elements are real, so partial
+ *	sums over k blocks can be kept in C itself.
+ *
+ * These macros are not undefined here. Without GEMM_HOST_NAME the
+ * plain gemm_host(..., alpha, ..., beta, C, ldc) is generated.
+ */
+
+#include "gemm_epilogue.h"
+#include "gemm_tune.h"
+
+// The size of SIMD vector in bytes for the micro-kernel.
+#ifndef GEMM_VECTOR_SIZE
+#if defined(__AVX512F__)
+#define GEMM_VECTOR_SIZE 64
+#elif defined(__AVX__)
+#define GEMM_VECTOR_SIZE 32
+#else
+#define GEMM_VECTOR_SIZE 16
+#endif
+#endif
+
+// The limit of real elements in per-thread scratch,
+// used for partial sums when C is not real.
+#ifndef GEMM_HOST_SCRATCH
+#define GEMM_HOST_SCRATCH (1 << 22)
+#endif
+
+#ifndef GEMM_HOST_CAT
+#define GEMM_HOST_CAT_(a, b) a##_##b
+#define GEMM_HOST_CAT(a, b) GEMM_HOST_CAT_(a, b)
+
+// Supported micro-tiles: the number of vectors in height
+// and the number of columns. Must match kernels below.
+static const int gemm_host_tiles[][2] =
+{
+	{ 2, 4 }, { 2, 6 }, { 3, 4 }, { 3, 8 }, { 4, 4 }, { 4, 6 }
+};
+#define GEMM_HOST_NTILES (int)(sizeof(gemm_host_tiles) / sizeof(gemm_host_tiles[0]))
+
+// The default micro-tile, used until tuned one is found.
+#define GEMM_HOST_MV 2
+#define GEMM_HOST_NR 6
+#endif
+
+#ifdef HAVE_SINGLE
+#define real float
+#define vector svector
+#define epilogue_t sgemm_epilogue_t
+#define GEMM_DTYPE 's'
+#define GEMM_MC 192
+#define GEMM_KC 384
+#define GEMM_NC 4092
+#ifndef GEMM_HOST_NAME
+#define GEMM_HOST_DEFAULT
+#define gemm_host sgemm_host
+#define gemm_host_blocking sgemm_host_blocking
+#define GEMM_HOST_NAME sgemm_host_ex
+#endif
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define vector dvector
+#define epilogue_t dgemm_epilogue_t
+#define GEMM_DTYPE 'd'
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 4092
+#ifndef GEMM_HOST_NAME
+#define GEMM_HOST_DEFAULT
+#define gemm_host dgemm_host
+#define gemm_host_blocking dgemm_host_blocking
+#define GEMM_HOST_NAME dgemm_host_ex
+#endif
+#endif
+
+#ifdef GEMM_HOST_DEFAULT
+#define GEMM_HOST_OUT real
+#define GEMM_HOST_LOAD(c) (c)
+#define GEMM_HOST_TAIL(x, i, j) (x)
+#define GEMM_HOST_STORE(x) (x)
+#define GEMM_HOST_INPLACE
+#endif
+
+#define out_t GEMM_HOST_OUT
+#define gemm_host_part GEMM_HOST_CAT(GEMM_HOST_NAME, part)
+#define gemm_host_pack_a GEMM_HOST_CAT(GEMM_HOST_NAME, pack_a)
+#define gemm_host_pack_b GEMM_HOST_CAT(GEMM_HOST_NAME, pack_b)
+#define gemm_host_kernel GEMM_HOST_CAT(GEMM_HOST_NAME, kernel)
+#define gemm_host_kernel_t GEMM_HOST_CAT(GEMM_HOST_NAME, kernel_t)
+#define gemm_host_select GEMM_HOST_CAT(GEMM_HOST_NAME, select)
+
+typedef real vector __attribute__((vector_size(GEMM_VECTOR_SIZE)));
+
+// The number of real elements in vector.
+#define GEMM_VL (int)(GEMM_VECTOR_SIZE / sizeof(real))
+
+// Pack mc x kc block of op(A) into the MR-row slivers,
+// each stored column by column. Rows beyond mc are zeroed.
+static void gemm_host_pack_a(char transa, int mc, int kc,
+	const real* A, int lda, real* restrict Ap, int MR)
+{
+	for (int ir = 0; ir < mc; ir += MR)
+	{
+		int mr = mc - ir < MR ? mc - ir : MR;
+		if ((transa == 'n') || (transa == 'N'))
+		{
+			for (int p = 0; p < kc; p++, Ap += MR)
+			{
+				const real* a = A + ir + (size_t)p * lda;
+				for (int i = 0; i < mr; i++) Ap[i] = a[i];
+				for (int i = mr; i < MR; i++) Ap[i] = 0;
+			}
+		}
+		else
+		{
+			for (int p = 0; p < kc; p++, Ap += MR)
+			{
+				const real* a = A + p + (size_t)ir * lda;
+				for (int i = 0; i < mr; i++) Ap[i] = a[(size_t)i * lda];
+				for (int i = mr; i < MR; i++) Ap[i] = 0;
+			}
+		}
+	}
+}
+
+// Pack kc x nc block of op(B) into the NR-column slivers,
+// each stored row by row. Columns beyond nc are zeroed.
+static void gemm_host_pack_b(char transb, int kc, int nc,
+	const real* B, int ldb, real* restrict Bp, int NR)
+{
+	for (int jr = 0; jr < nc; jr += NR)
+	{
+		int nr = nc - jr < NR ? nc - jr : NR;
+		if ((transb == 'n') || (transb == 'N'))
+		{
+			for (int p = 0; p < kc; p++, Bp += NR)
+			{
+				const real* b = B + p + (size_t)jr * ldb;
+				for (int j = 0; j < nr; j++) Bp[j] = b[(size_t)j * ldb];
+				for (int j = nr; j < NR; j++) Bp[j] = 0;
+			}
+		}
+		else
+		{
+			for (int p = 0; p < kc; p++, Bp += NR)
+			{
+				const real* b = B + jr + (size_t)p * ldb;
+				for (int j = 0; j < nr; j++) Bp[j] = b[j];
+				for (int j = nr; j < NR; j++) Bp[j] = 0;
+			}
+		}
+	}
+}
+
+// Micro-kernels for all supported micro-tiles.
+typedef void (*gemm_host_kernel_t)(int kc,
+	const real* restrict a, const real* restrict b,
+	int mr, int nr, const epilogue_t* epi, int first, int last,
+	real* S, int lds, out_t* C, int ldc, int i0, int j0);
+
+#define GEMM_MV 2
+#define GEMM_NR 4
+#include "gemm_host_kernel.h"
+#undef GEMM_NR
+#define GEMM_NR 6
+#include "gemm_host_kernel.h"
+#undef GEMM_MV
+#undef GEMM_NR
+#define GEMM_MV 3
+#define GEMM_NR 4
+#include "gemm_host_kernel.h"
+#undef GEMM_NR
+#define GEMM_NR 8
+#include "gemm_host_kernel.h"
+#undef GEMM_MV
+#undef GEMM_NR
+#define GEMM_MV 4
+#define GEMM_NR 4
+#include "gemm_host_kernel.h"
+#undef GEMM_NR
+#define GEMM_NR 6
+#include "gemm_host_kernel.h"
+#undef GEMM_MV
+#undef GEMM_NR
+
+// Get the micro-kernel for mv x nr micro-tile.
+static gemm_host_kernel_t gemm_host_select(int mv, int nr)
+{
+	switch (mv * 100 + nr)
+	{
+	case 204 : return GEMM_HOST_CAT(gemm_host_kernel, 2_4);
+	case 206 : return GEMM_HOST_CAT(gemm_host_kernel, 2_6);
+	case 304 : return GEMM_HOST_CAT(gemm_host_kernel, 3_4);
+	case 308 : return GEMM_HOST_CAT(gemm_host_kernel, 3_8);
+	case 404 : return GEMM_HOST_CAT(gemm_host_kernel, 4_4);
+	case 406 : return GEMM_HOST_CAT(gemm_host_kernel, 4_6);
+	}
+	assert(0 && "Unsupported micro-tile");
+	return NULL;
+}
+
+// Compute m x n x k GEMM part in current thread, using Ap and Bp
+// as the packing buffers. Partial sums over k blocks go to S, which
+// may alias C for real C. With accumulate set, S already holds
+// the initial value. (i0, j0) is the part offset in C.
+static void gemm_host_part(char transa, char transb,
+	int m, int n, int k, const real* A, int lda,
+	const real* B, int ldb, const epilogue_t* epi, int accumulate,
+	real* S, int lds, out_t* C, int ldc, int i0, int j0,
+	const gemm_blocking_t* blocking, real* Ap, real* Bp)
+{
+	int ta = (transa != 'n') && (transa != 'N');
+	int tb = (transb != 'n') && (transb != 'N');
+
+	int MC = blocking->mc, KC = blocking->kc, NC = blocking->nc;
+	int MR = blocking->mv * GEMM_VL, NR = blocking->nr;
+	gemm_host_kernel_t kernel = gemm_host_select(blocking->mv, blocking->nr);
+
+	for (int jc = 0; jc < n; jc += NC)
+	{
+		int nc = n - jc < NC ? n - jc : NC;
+		for (int pc = 0; pc < k; pc += KC)
+		{
+			int kc = k - pc < KC ? k - pc : KC;
+			int first = (pc == 0) && !accumulate, last = (pc + kc == k);
+
+			gemm_host_pack_b(transb, kc, nc, tb ?
+				B + jc + (size_t)pc * ldb : B + pc + (size_t)jc * ldb, ldb, Bp, NR);
+
+			for (int ic = 0; ic < m; ic += MC)
+			{
+				int mc = m - ic < MC ? m - ic : MC;
+
+				gemm_host_pack_a(transa, mc, kc, ta ?
+					A + pc + (size_t)ic * lda : A + ic + (size_t)pc * lda, lda, Ap, MR);
+
+				for (int jr = 0; jr < nc; jr += NR)
+				{
+					int nr = nc - jr < NR ? nc - jr : NR;
+					for (int ir = 0; ir < mc; ir += MR)
+					{
+						int mr = mc - ir < MR ? mc - ir : MR;
+						int i = ic + ir, j = jc + jr;
+						kernel(kc, Ap + (size_t)ir * kc,
+							Bp + (size_t)jr * kc, mr, nr, epi, first, last,
+							S + i + (size_t)j * lds, lds,
+							C ? C + i + (size_t)j * ldc : NULL, ldc,
+							i0 + i, j0 + j);
+					}
+				}
+			}
+		}
+	}
+}
+
+// Compute C = epilogue(op(A) * op(B), C), where op(A) is m x k,
+// op(B) is k x n and C is m x n, all stored column-major with the
+// given leading dimensions. Returns the partitioning used.
+gemm_partition_t GEMM_HOST_NAME(char transa, char transb,
+	int m, int n, int k, const real* A, int lda,
+	const real* B, int ldb, const epilogue_t* epi, out_t* C, int ldc)
+{
+	int ta = (transa != 'n') && (transa != 'N');
+	int tb = (transb != 'n') && (transb != 'N');
+
+	// Tuned blocking, if there is.
+	const gemm_blocking_t defaults = { GEMM_MC, GEMM_KC, GEMM_NC, GEMM_HOST_MV, GEMM_HOST_NR };
+	const gemm_blocking_t* blocking = gemm_tune_blocking(GEMM_DTYPE, &defaults,
+		gemm_host_tiles, GEMM_HOST_NTILES);
+	int MR = blocking->mv * GEMM_VL, NR = blocking->nr;
+
+	gemm_partition_t partition;
+	gemm_partition(m, n, k, omp_get_max_threads(),
+		GEMM_PARTITION_HOST_COST, 1, &partition);
+	int nparts = gemm_partition_size(&partition);
+
+	// For K split, parts produce linear partial products into the
+	// workspace, and the epilogue tail is applied after reduction.
+	real* W = NULL;
+	if (partition.pk > 1)
+	{
+		W = (real*)malloc((size_t)partition.pk * m * n * sizeof(real));
+		assert(W);
+	}
+
+	#pragma omp parallel num_threads(nparts)
+	{
+		// Packed slivers are loaded as vectors, so align them.
+		real *Ap, *Bp;
+		int status = posix_memalign((void**)&Ap, GEMM_VECTOR_SIZE, (size_t)blocking->kc *
+			((blocking->mc + MR - 1) / MR) * MR * sizeof(real));
+		assert(!status);
+		status = posix_memalign((void**)&Bp, GEMM_VECTOR_SIZE, (size_t)blocking->kc *
+			((blocking->nc + NR - 1) / NR) * NR * sizeof(real));
+		assert(!status);
+
+		// Runtime may give less threads than requested,
+		// so each thread loops over its share of parts.
+		for (int ipart = omp_get_thread_num(); ipart < nparts;
+			ipart += omp_get_num_threads())
+		{
+			gemm_part_t part;
+			gemm_partition_part(&partition, m, n, k, ipart, &part);
+
+			const real* a = ta ? A + part.k0 + (size_t)part.m0 * lda :
+				A + part.m0 + (size_t)part.k0 * lda;
+			const real* b = tb ? B + part.n0 + (size_t)part.k0 * ldb :
+				B + part.k0 + (size_t)part.n0 * ldb;
+			out_t* c = C + part.m0 + (size_t)part.n0 * ldc;
+
+			if (partition.pk > 1)
+			{
+				// The first part starts from beta * C, others from zero.
+				real* w = W + (size_t)part.ik * m * n + part.m0 + (size_t)part.n0 * m;
+				if (part.ik == 0)
+					for (int j = 0; j < part.n; j++)
+						for (int i = 0; i < part.m; i++)
+							w[i + (size_t)j * m] = (epi->beta == 0) ? 0 :
+								epi->beta * GEMM_HOST_LOAD(c[i + (size_t)j * ldc]);
+				gemm_host_part(transa, transb, part.m, part.n, part.k,
+					a, lda, b, ldb, epi, part.ik == 0, w, m, NULL, ldc,
+					part.m0, part.n0, blocking, Ap, Bp);
+				continue;
+			}
+
+#ifdef GEMM_HOST_INPLACE
+			gemm_host_part(transa, transb, part.m, part.n, part.k,
+				a, lda, b, ldb, epi, 0, c, ldc, c, ldc, part.m0, part.n0, blocking, Ap, Bp);
+#else
+			// Partial sums over k blocks need the real scratch,
+			// so the part is processed by column panels that fit in it.
+			int ncs = part.n;
+			real* S = NULL;
+			if (part.k > blocking->kc)
+			{
+				ncs = GEMM_HOST_SCRATCH / part.m;
+				if (ncs < 1) ncs = 1;
+				if (ncs > part.n) ncs = part.n;
+				S = (real*)malloc((size_t)part.m * ncs * sizeof(real));
+				assert(S);
+			}
+			for (int jc = 0; jc < part.n; jc += ncs)
+			{
+				int nc = part.n - jc < ncs ? part.n - jc : ncs;
+				gemm_host_part(transa, transb, part.m, nc, part.k,
+					a, lda, tb ? b + jc : b + (size_t)jc * ldb, ldb, epi, 0,
+					S, part.m, c + (size_t)jc * ldc, ldc, part.m0, part.n0 + jc,
+					blocking, Ap, Bp);
+			}
+			if (S) free(S);
+#endif
+		}
+
+		free(Ap);
+		free(Bp);
+
+		// Reduce partial products into C and apply the tail.
+		if (partition.pk > 1)
+		{
+			#pragma omp barrier
+			#pragma omp for
+			for (int j = 0; j < n; j++)
+			{
+				out_t* c = C + (size_t)j * ldc;
+				for (int i = 0; i < m; i++)
+				{
+					real x = W[i + (size_t)j * m];
+					for (int l = 1; l < partition.pk; l++)
+						x += W[(size_t)l * m * n + i + (size_t)j * m];
+					c[i] = GEMM_HOST_STORE(GEMM_HOST_TAIL(x, i, j));
+				}
+			}
+		}
+	}
+
+	if (W) free(W);
+
+	return partition;
+}
+
+#ifdef GEMM_HOST_DEFAULT
+// Compute C = alpha * op(A) * op(B) + beta * C.
+gemm_partition_t gemm_host(char transa, char transb,
+	int m, int n, int k, real alpha, const real* A, int lda,
+	const real* B, int ldb, real beta, real* C, int ldc)
+{
+	epilogue_t epi;
+	memset(&epi, 0, sizeof(epi));
+	epi.alpha = alpha;
+	epi.beta = beta;
+
+	return GEMM_HOST_NAME(transa, transb, m, n, k,
+		A, lda, B, ldb, &epi, C, ldc);
+}
+
+// Get the blocking used by GEMM: tuned one or the default.
+const gemm_blocking_t* gemm_host_blocking(void)
+{
+	const gemm_blocking_t defaults = { GEMM_MC, GEMM_KC, GEMM_NC, GEMM_HOST_MV, GEMM_HOST_NR };
+	return gemm_tune_blocking(GEMM_DTYPE, &defaults,
+		gemm_host_tiles, GEMM_HOST_NTILES);
+}
+
+#undef gemm_host
+#undef gemm_host_blocking
+#undef GEMM_HOST_NAME
+#undef GEMM_HOST_OUT
+#undef GEMM_HOST_LOAD
+#undef GEMM_HOST_TAIL
+#undef GEMM_HOST_STORE
+#undef GEMM_HOST_INPLACE
+#undef GEMM_HOST_DEFAULT
+#endif
+
+#undef real
+#undef vector
+#undef epilogue_t
+#undef out_t
+#undef gemm_host_part
+#undef gemm_host_pack_a
+#undef gemm_host_pack_b
+#undef gemm_host_kernel
+#undef gemm_host_kernel_t
+#undef gemm_host_select
+#undef GEMM_DTYPE
+#undef GEMM_VL
+#undef GEMM_MC
+#undef GEMM_KC
+#undef GEMM_NC
+
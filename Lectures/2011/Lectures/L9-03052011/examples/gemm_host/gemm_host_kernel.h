@@ -0,0 +1,75 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * The micro-kernel of host GEMM for the micro-tile of GEMM_MV vectors
+ * high and GEMM_NR columns wide. Included by gemm_host.h once for each
+ * supported micro-tile, with the same macros defined.
+ */
+
+#define GEMM_MR (GEMM_MV * GEMM_VL)
+#define gemm_host_kernel_tile GEMM_HOST_CAT(gemm_host_kernel, GEMM_HOST_CAT(GEMM_MV, GEMM_NR))
+
+// Multiply MR x kc sliver of A by kc x NR sliver of B and update
+// the mr x nr tile, while the accumulators are still in registers.
+// The first block of k computes alpha * AB + beta * C, further ones
+// add alpha * AB to the partial sum in S. The last block applies
+// the epilogue tail and stores the result to C. If C is NULL, the
+// linear result is left in S for the later reduction.
+static void gemm_host_kernel_tile(int kc,
+	const real* restrict a, const real* restrict b,
+	int mr, int nr, const epilogue_t* epi, int first, int last,
+	real* S, int lds, out_t* C, int ldc, int i0, int j0)
+{
+	vector ab[GEMM_NR][GEMM_MV];
+	for (int j = 0; j < GEMM_NR; j++)
+		for (int v = 0; v < GEMM_MV; v++)
+			ab[j][v] = (vector){ 0 };
+
+	for (int p = 0; p < kc; p++, a += GEMM_MR, b += GEMM_NR)
+	{
+		vector av[GEMM_MV];
+		for (int v = 0; v < GEMM_MV; v++)
+			av[v] = ((const vector*)a)[v];
+		for (int j = 0; j < GEMM_NR; j++)
+			for (int v = 0; v < GEMM_MV; v++)
+				ab[j][v] += av[v] * b[j];
+	}
+
+	real alpha = epi->alpha, beta = epi->beta;
+	for (int j = 0; j < nr; j++)
+	{
+		const real* t = (const real*)ab[j];
+		real* s = S + (size_t)j * lds;
+		out_t* c = C + (size_t)j * ldc;
+
+		real x[GEMM_MR];
+		if (!first)
+			for (int i = 0; i < mr; i++)
+				x[i] = alpha * t[i] + s[i];
+		else if (C && (beta != 0))
+			for (int i = 0; i < mr; i++)
+				x[i] = alpha * t[i] + beta * GEMM_HOST_LOAD(c[i]);
+		else
+			for (int i = 0; i < mr; i++)
+				x[i] = alpha * t[i];
+
+		if (last && C)
+			for (int i = 0; i < mr; i++)
+				c[i] = GEMM_HOST_STORE(GEMM_HOST_TAIL(x[i], i0 + i, j0 + j));
+		else
+			for (int i = 0; i < mr; i++)
+				s[i] = x[i];
+	}
+}
+
+#undef GEMM_MR
+#undef gemm_host_kernel_tile
@@ -0,0 +1,88 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define blas_gemm sgemm_
+#define gemm_host sgemm_host
+#define gemm_host_test sgemm_host_test
+#define generate_data sgenerate_data
+#define check_result scheck_result
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define blas_gemm dgemm_
+#define gemm_host dgemm_host
+#define gemm_host_test dgemm_host_test
+#define generate_data dgenerate_data
+#define check_result dcheck_result
+#endif
+
+int gemm_host_test(char transa, char transb, real alpha, real beta,
+	int m, int n, int k, int lda, int ldb, int ldc)
+{
+	printf("%d\t%d\t%d\t", m, n, k); fflush(stdout);
+
+	// Stored shapes of A and B depend on transposition.
+	int ta = (transa != 'n') && (transa != 'N');
+	int tb = (transb != 'n') && (transb != 'N');
+	int rows_a = ta ? k : m, cols_a = ta ? m : k;
+	int rows_b = tb ? n : k, cols_b = tb ? k : n;
+	if (!lda) lda = rows_a;
+	if (!ldb) ldb = rows_b;
+	if (!ldc) ldc = m;
+	assert((lda >= rows_a) && (ldb >= rows_b) && (ldc >= m));
+
+	// Allocate host memory for the matrices
+	real* A = (real*)malloc((size_t)lda * cols_a * sizeof(real)); assert(A);
+	real* B = (real*)malloc((size_t)ldb * cols_b * sizeof(real)); assert(B);
+	real* C = (real*)malloc((size_t)ldc * n * sizeof(real)); assert(C);
+	real* C_ref = (real*)malloc((size_t)ldc * n * sizeof(real)); assert(C_ref);
+
+	generate_data(rows_a, cols_a, lda, A);
+	generate_data(rows_b, cols_b, ldb, B);
+	generate_data(m, n, ldc, C);
+	memcpy(C_ref, C, (size_t)ldc * n * sizeof(real));
+
+	double start = omp_get_wtime();
+
+	gemm_partition_t partition = gemm_host(transa, transb, m, n, k,
+		alpha, A, lda, B, ldb, beta, C, ldc);
+
+	double time = omp_get_wtime() - start;
+	double gflops = 2.0e-9 * m * n * k / time;
+	printf("%s\t%f sec\t%f\t", gemm_split_name(partition.split),
+		time, gflops); fflush(stdout);
+
+	// Perform matmul using host BLAS
+	blas_gemm(&transa, &transb, &m, &n, &k,
+		&alpha, A, &lda, B, &ldb, &beta, C_ref, &ldc);
+
+	int status = check_result(m, n, C, ldc, C_ref, ldc);
+
+	free(A);
+	free(B);
+	free(C);
+	free(C_ref);
+
+	return status;
+}
+
+#undef real
+#undef blas_gemm
+#undef gemm_host
+#undef gemm_host_test
+#undef generate_data
+#undef check_result
+
@@ -0,0 +1,190 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Autotuner of host GEMM blocking: the micro-tile, then kc, mc and nc
+ * are searched one by one (coordinate descent, two passes), measuring
+ * the total time of GEMM on the given representative shapes. The best
+ * blocking is saved by gemm_tune for the current CPU and precision.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define gemm_host sgemm_host
+#define gemm_host_blocking sgemm_host_blocking
+#define gemm_host_tune sgemm_host_tune
+#define gemm_host_tune_time sgemm_host_tune_time
+#define generate_data sgenerate_data
+#define GEMM_DTYPE 's'
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define gemm_host dgemm_host
+#define gemm_host_blocking dgemm_host_blocking
+#define gemm_host_tune dgemm_host_tune
+#define gemm_host_tune_time dgemm_host_tune_time
+#define generate_data dgenerate_data
+#define GEMM_DTYPE 'd'
+#endif
+
+// The number of timed runs of each shape, the best one is taken.
+#ifndef GEMM_TUNE_RUNS
+#define GEMM_TUNE_RUNS 3
+#endif
+
+// Measure the total time of shapes with the given blocking.
+static double gemm_host_tune_time(char transa, char transb,
+	int nshapes, const int* m, const int* n, const int* k,
+	real** A, real** B, real** C, const gemm_blocking_t* blocking)
+{
+	gemm_tune_set_blocking(GEMM_DTYPE, blocking);
+
+	double total = 0, flops = 0;
+	for (int i = 0; i < nshapes; i++)
+	{
+		int ta = (transa != 'n') && (transa != 'N');
+		int tb = (transb != 'n') && (transb != 'N');
+
+		// The first run warms up caches and pages.
+		double best = 0;
+		for (int run = 0; run <= GEMM_TUNE_RUNS; run++)
+		{
+			double start = omp_get_wtime();
+
+			gemm_host(transa, transb, m[i], n[i], k[i], 1, A[i], ta ? k[i] : m[i],
+				B[i], tb ? n[i] : k[i], 0, C[i], m[i]);
+
+			double time = omp_get_wtime() - start;
+			if ((run == 1) || ((run > 1) && (time < best))) best = time;
+		}
+		total += best;
+		flops += 2.0 * m[i] * n[i] * k[i];
+	}
+
+	printf("%d\t%d\t%d\t%dx%d\t%f sec\t%f\n", blocking->mc, blocking->kc,
+		blocking->nc, blocking->mv, blocking->nr, total, 1.0e-9 * flops / total);
+	fflush(stdout);
+
+	return total;
+}
+
+// Tune blocking for nshapes m x n x k shapes and save it.
+// Returns 0 on success.
+int gemm_host_tune(char transa, char transb,
+	int nshapes, const int* m, const int* n, const int* k)
+{
+	int ta = (transa != 'n') && (transa != 'N');
+	int tb = (transb != 'n') && (transb != 'N');
+	real** A = (real**)malloc(nshapes * sizeof(real*)); assert(A);
+	real** B = (real**)malloc(nshapes * sizeof(real*)); assert(B);
+	real** C = (real**)malloc(nshapes * sizeof(real*)); assert(C);
+	for (int i = 0; i < nshapes; i++)
+	{
+		A[i] = (real*)malloc((size_t)m[i] * k[i] * sizeof(real)); assert(A[i]);
+		B[i] = (real*)malloc((size_t)k[i] * n[i] * sizeof(real)); assert(B[i]);
+		C[i] = (real*)malloc((size_t)m[i] * n[i] * sizeof(real)); assert(C[i]);
+		generate_data(ta ? k[i] : m[i], ta ? m[i] : k[i], ta ? k[i] : m[i], A[i]);
+		generate_data(tb ? n[i] : k[i], tb ? k[i] : n[i], tb ? n[i] : k[i], B[i]);
+	}
+
+	printf("mc\tkc\tnc\ttile\ttime\t\tgflops\n");
+
+	// Start from the current (tuned or default) blocking.
+	gemm_blocking_t best = *gemm_host_blocking();
+	double best_time = gemm_host_tune_time(transa, transb,
+		nshapes, m, n, k, A, B, C, &best);
+
+	// Micro-tile, with mc rounded to its height.
+	int vl = GEMM_VECTOR_SIZE / sizeof(real);
+	for (int i = 0; i < GEMM_HOST_NTILES; i++)
+	{
+		gemm_blocking_t b = best;
+		b.mv = gemm_host_tiles[i][0];
+		b.nr = gemm_host_tiles[i][1];
+		if ((b.mv == best.mv) && (b.nr == best.nr)) continue;
+		b.mc = (b.mc + b.mv * vl - 1) / (b.mv * vl) * (b.mv * vl);
+
+		double time = gemm_host_tune_time(transa, transb,
+			nshapes, m, n, k, A, B, C, &b);
+		if (time < best_time) { best_time = time; best = b; }
+	}
+
+	const int kcs[] = { 128, 192, 256, 320, 384, 512, 768 };
+	const int mcs[] = { 2, 3, 4, 6, 8, 12, 16, 24 };
+	const int ncs[] = { 512, 1024, 2048, 4096, 8192 };
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (int i = 0; i < (int)(sizeof(kcs) / sizeof(kcs[0])); i++)
+		{
+			gemm_blocking_t b = best;
+			b.kc = kcs[i];
+			if (b.kc == best.kc) continue;
+			double time = gemm_host_tune_time(transa, transb,
+				nshapes, m, n, k, A, B, C, &b);
+			if (time < best_time) { best_time = time; best = b; }
+		}
+
+		// mc is the multiple of micro-tile height.
+		for (int i = 0; i < (int)(sizeof(mcs) / sizeof(mcs[0])); i++)
+		{
+			gemm_blocking_t b = best;
+			b.mc = mcs[i] * best.mv * vl;
+			if (b.mc == best.mc) continue;
+			double time = gemm_host_tune_time(transa, transb,
+				nshapes, m, n, k, A, B, C, &b);
+			if (time < best_time) { best_time = time; best = b; }
+		}
+
+		// nc is the multiple of micro-tile width.
+		for (int i = 0; i < (int)(sizeof(ncs) / sizeof(ncs[0])); i++)
+		{
+			gemm_blocking_t b = best;
+			b.nc = ncs[i] / best.nr * best.nr;
+			if (b.nc == best.nc) continue;
+			double time = gemm_host_tune_time(transa, transb,
+				nshapes, m, n, k, A, B, C, &b);
+			if (time < best_time) { best_time = time; best = b; }
+		}
+	}
+
+	for (int i = 0; i < nshapes; i++)
+	{
+		free(A[i]);
+		free(B[i]);
+		free(C[i]);
+	}
+	free(A);
+	free(B);
+	free(C);
+
+	// Further GEMMs use the best blocking. Keep the other
+	// tuned parameters of this precision, if any.
+	gemm_tune_set_blocking(GEMM_DTYPE, &best);
+	gemm_tune_t tune;
+	gemm_tune_load(GEMM_DTYPE, &tune);
+	tune.blocking = best;
+	int status = gemm_tune_save(&tune);
+
+	printf("best blocking %d %d %d %dx%d for %s saved to %s\n",
+		best.mc, best.kc, best.nc, best.mv, best.nr, gemm_tune_cpu(),
+		gemm_tune_file());
+
+	return status;
+}
+
+#undef real
+#undef gemm_host
+#undef gemm_host_blocking
+#undef gemm_host_tune
+#undef gemm_host_tune_time
+#undef generate_data
+#undef GEMM_DTYPE
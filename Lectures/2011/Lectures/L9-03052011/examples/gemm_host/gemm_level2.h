@@ -0,0 +1,252 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Level 2 routines: matrix-vector product (gemv) and rank-1 update (ger)
+ * of the column-major matrix. Both are bound by the memory bandwidth,
+ * so the matrix is read once in contiguous column segments, and
+ * everything else is kept in L1. Rows are split into blocks of
+ * GEMM_L2_BLOCK bytes, the blocks are distributed between threads.
+ * For each block all columns are swept a few at a time, so that
+ * the segment of y (gemv N) or x (gemv T, ger) stays in L1.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define gemv_host sgemv_host
+#define gemv_n_block sgemv_n_block
+#define gemv_t_block sgemv_t_block
+#define ger_host sger_host
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define gemv_host dgemv_host
+#define gemv_n_block dgemv_n_block
+#define gemv_t_block dgemv_t_block
+#define ger_host dger_host
+#endif
+
+// The size of the block of rows, in bytes.
+#ifndef GEMM_L2_BLOCK
+#define GEMM_L2_BLOCK 8192
+#endif
+
+// The minimum number of matrix elements to go parallel.
+#ifndef GEMM_L2_PARALLEL
+#define GEMM_L2_PARALLEL (1 << 16)
+#endif
+
+#ifndef GEMM_LEVEL2_H
+#define GEMM_LEVEL2_H
+
+// Get the number of rows in block for m rows and nthreads threads:
+// GEMM_L2_BLOCK bytes, or less, if there are not enough blocks
+// for all threads, rounded up to the whole 64-byte lines.
+static int gemm_l2_rows(int m, int nthreads, int size)
+{
+	int line = 64 / size, rows = GEMM_L2_BLOCK / size;
+	int share = (m + nthreads - 1) / nthreads;
+	share = (share + line - 1) / line * line;
+	return share < rows ? share : rows;
+}
+
+#endif // GEMM_LEVEL2_H
+
+// Accumulate t = A * x for the block of mb rows of A.
+static void gemv_n_block(int mb, int n, const real* A, int lda,
+	const real* x, real* restrict t)
+{
+	#pragma omp simd
+	for (int i = 0; i < mb; i++)
+		t[i] = 0;
+
+	int j = 0;
+	for ( ; j + 4 <= n; j += 4)
+	{
+		const real* restrict a0 = A + (size_t)j * lda;
+		const real* restrict a1 = a0 + lda;
+		const real* restrict a2 = a1 + lda;
+		const real* restrict a3 = a2 + lda;
+		real x0 = x[j], x1 = x[j + 1], x2 = x[j + 2], x3 = x[j + 3];
+		#pragma omp simd
+		for (int i = 0; i < mb; i++)
+			t[i] += a0[i] * x0 + a1[i] * x1 + a2[i] * x2 + a3[i] * x3;
+	}
+	for ( ; j < n; j++)
+	{
+		const real* restrict a0 = A + (size_t)j * lda;
+		real x0 = x[j];
+		#pragma omp simd
+		for (int i = 0; i < mb; i++)
+			t[i] += a0[i] * x0;
+	}
+}
+
+// Accumulate p += A^T * x for the block of mb rows of A.
+static void gemv_t_block(int mb, int n, const real* A, int lda,
+	const real* restrict x, real* p)
+{
+	int j = 0;
+	for ( ; j + 4 <= n; j += 4)
+	{
+		const real* restrict a0 = A + (size_t)j * lda;
+		const real* restrict a1 = a0 + lda;
+		const real* restrict a2 = a1 + lda;
+		const real* restrict a3 = a2 + lda;
+		real s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+		#pragma omp simd reduction(+:s0, s1, s2, s3)
+		for (int i = 0; i < mb; i++)
+		{
+			s0 += a0[i] * x[i];
+			s1 += a1[i] * x[i];
+			s2 += a2[i] * x[i];
+			s3 += a3[i] * x[i];
+		}
+		p[j] += s0; p[j + 1] += s1; p[j + 2] += s2; p[j + 3] += s3;
+	}
+	for ( ; j < n; j++)
+	{
+		const real* restrict a0 = A + (size_t)j * lda;
+		real s0 = 0;
+		#pragma omp simd reduction(+:s0)
+		for (int i = 0; i < mb; i++)
+			s0 += a0[i] * x[i];
+		p[j] += s0;
+	}
+}
+
+// Compute y = alpha * op(A) * x + beta * y, where A is m x n,
+// op(A) is A for trans 'N', A^T for trans 'T' or 'C'. Vectors
+// are contiguous; y is not read, if beta is zero.
+void gemv_host(char trans, int m, int n, real alpha, const real* A, int lda,
+	const real* x, real beta, real* y)
+{
+	int notrans = (trans == 'n') || (trans == 'N');
+	int ny = notrans ? m : n;
+	if (!m || !n)
+	{
+		for (int i = 0; i < ny; i++)
+			y[i] = (beta == 0) ? 0 : beta * y[i];
+		return;
+	}
+
+	int parallel = (size_t)m * n > GEMM_L2_PARALLEL;
+	int nthreads = parallel ? omp_get_max_threads() : 1;
+	int mb = gemm_l2_rows(m, nthreads, sizeof(real));
+
+	// Transposed product is reduced over row blocks,
+	// each thread accumulates its own partial sums.
+	real* P = NULL;
+	if (!notrans)
+	{
+		P = (real*)malloc((size_t)nthreads * n * sizeof(real));
+		assert(P);
+	}
+
+	#pragma omp parallel if (parallel) num_threads(nthreads)
+	{
+		if (notrans)
+		{
+			real t[GEMM_L2_BLOCK / sizeof(real)];
+
+			#pragma omp for schedule(static)
+			for (int i0 = 0; i0 < m; i0 += mb)
+			{
+				int nb = m - i0 < mb ? m - i0 : mb;
+				gemv_n_block(nb, n, A + i0, lda, x, t);
+				real* yb = y + i0;
+				if (beta == 0)
+				{
+					#pragma omp simd
+					for (int i = 0; i < nb; i++)
+						yb[i] = alpha * t[i];
+				}
+				else
+				{
+					#pragma omp simd
+					for (int i = 0; i < nb; i++)
+						yb[i] = alpha * t[i] + beta * yb[i];
+				}
+			}
+		}
+		else
+		{
+			real* p = P + (size_t)omp_get_thread_num() * n;
+			memset(p, 0, n * sizeof(real));
+
+			#pragma omp for schedule(static)
+			for (int i0 = 0; i0 < m; i0 += mb)
+			{
+				int nb = m - i0 < mb ? m - i0 : mb;
+				gemv_t_block(nb, n, A + i0, lda, x + i0, p);
+			}
+
+			int nt = omp_get_num_threads();
+			#pragma omp for simd schedule(static)
+			for (int j = 0; j < n; j++)
+			{
+				real s = 0;
+				for (int t = 0; t < nt; t++)
+					s += P[j + (size_t)t * n];
+				y[j] = (beta == 0) ? alpha * s : alpha * s + beta * y[j];
+			}
+		}
+	}
+
+	if (P) free(P);
+}
+
+// Compute A = alpha * x * y^T + A, where A is m x n,
+// x and y are contiguous vectors of m and n elements.
+void ger_host(int m, int n, real alpha, const real* x, const real* y,
+	real* A, int lda)
+{
+	if (!m || !n || (alpha == 0)) return;
+
+	int parallel = (size_t)m * n > GEMM_L2_PARALLEL;
+	int nthreads = parallel ? omp_get_max_threads() : 1;
+	int mb = gemm_l2_rows(m, nthreads, sizeof(real));
+
+	#pragma omp parallel for schedule(static) if (parallel) num_threads(nthreads)
+	for (int i0 = 0; i0 < m; i0 += mb)
+	{
+		int nb = m - i0 < mb ? m - i0 : mb;
+		const real* restrict xb = x + i0;
+		int j = 0;
+		for ( ; j + 2 <= n; j += 2)
+		{
+			real* restrict a0 = A + i0 + (size_t)j * lda;
+			real* restrict a1 = a0 + lda;
+			real y0 = alpha * y[j], y1 = alpha * y[j + 1];
+			#pragma omp simd
+			for (int i = 0; i < nb; i++)
+			{
+				a0[i] += xb[i] * y0;
+				a1[i] += xb[i] * y1;
+			}
+		}
+		for ( ; j < n; j++)
+		{
+			real* restrict a0 = A + i0 + (size_t)j * lda;
+			real y0 = alpha * y[j];
+			#pragma omp simd
+			for (int i = 0; i < nb; i++)
+				a0[i] += xb[i] * y0;
+		}
+	}
+}
+
+#undef real
+#undef gemv_host
+#undef gemv_n_block
+#undef gemv_t_block
+#undef ger_host
@@ -0,0 +1,216 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Test of level 2 routines: gemv and ger are checked against the
+ * reference host BLAS. Bandwidth is compared to the plain stream
+ * over the same matrix: the sum for gemv and the scaling for ger.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define blas_gemv sgemv_
+#define blas_ger sger_
+#define gemv_host sgemv_host
+#define ger_host sger_host
+#define gemv_host_test sgemv_host_test
+#define ger_host_test sger_host_test
+#define level2_stream slevel2_stream
+#define level2_report slevel2_report
+#define generate_data sgenerate_data
+#define check_result scheck_result
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define blas_gemv dgemv_
+#define blas_ger dger_
+#define gemv_host dgemv_host
+#define ger_host dger_host
+#define gemv_host_test dgemv_host_test
+#define ger_host_test dger_host_test
+#define level2_stream dlevel2_stream
+#define level2_report dlevel2_report
+#define generate_data dgenerate_data
+#define check_result dcheck_result
+#endif
+
+// The number of timed runs, the best one is taken.
+#ifndef GEMM_L2_RUNS
+#define GEMM_L2_RUNS 10
+#endif
+
+void blas_gemv(char* trans, int* m, int* n, real* alpha, real* A, int* lda,
+	real* x, int* incx, real* beta, real* y, int* incy);
+void blas_ger(int* m, int* n, real* alpha, real* x, int* incx,
+	real* y, int* incy, real* A, int* lda);
+
+// Get the best time of streaming through m x n matrix: reading
+// (the sum of elements), or updating, if update is set (scaling
+// by one, that leaves the matrix intact).
+static double level2_stream(int m, int n, real* A, int lda, int update)
+{
+	volatile real one = 1;
+	real scale = one, sum = 0;
+	double best = 0;
+	for (int run = 0; run <= GEMM_L2_RUNS; run++)
+	{
+		double start = omp_get_wtime();
+		if (update)
+		{
+			#pragma omp parallel for schedule(static)
+			for (int j = 0; j < n; j++)
+			{
+				real* a = A + (size_t)j * lda;
+				#pragma omp simd
+				for (int i = 0; i < m; i++)
+					a[i] *= scale;
+			}
+		}
+		else
+		{
+			#pragma omp parallel for schedule(static) reduction(+:sum)
+			for (int j = 0; j < n; j++)
+			{
+				const real* a = A + (size_t)j * lda;
+				#pragma omp simd reduction(+:sum)
+				for (int i = 0; i < m; i++)
+					sum += a[i];
+			}
+		}
+		double time = omp_get_wtime() - start;
+		if ((run == 1) || ((run > 1) && (time < best))) best = time;
+	}
+	if (sum < 0) printf("%f\n", (double)sum);
+	return best;
+}
+
+// Print the time and bandwidth of moving the given number of bytes,
+// and its ratio to the stream bandwidth.
+static void level2_report(const char* op, double time, double bytes, double stream)
+{
+	printf("%s\t%f sec\t%f\t%.1f%%\t", op, time, 1.0e-9 * bytes / time,
+		100.0 * stream / time);
+	fflush(stdout);
+}
+
+// Compute y = alpha * op(A) * x + beta * y for m x n A.
+int gemv_host_test(char trans, real alpha, real beta, int m, int n, int lda)
+{
+	int notrans = (trans == 'n') || (trans == 'N');
+	int nx = notrans ? n : m, ny = notrans ? m : n;
+	if (!lda) lda = m;
+	assert(lda >= m);
+
+	real* A = (real*)malloc((size_t)lda * n * sizeof(real)); assert(A);
+	real* x = (real*)malloc(nx * sizeof(real)); assert(x);
+	real* y = (real*)malloc(ny * sizeof(real)); assert(y);
+	real* y0 = (real*)malloc(ny * sizeof(real)); assert(y0);
+	real* y_ref = (real*)malloc(ny * sizeof(real)); assert(y_ref);
+
+	generate_data(m, n, lda, A);
+	generate_data(nx, 1, nx, x);
+	generate_data(ny, 1, ny, y0);
+	memcpy(y_ref, y0, ny * sizeof(real));
+
+	printf("%d\t%d\t%d\t", m, n, lda); fflush(stdout);
+
+	// The first run warms up caches and pages.
+	double best = 0;
+	for (int run = 0; run <= GEMM_L2_RUNS; run++)
+	{
+		memcpy(y, y0, ny * sizeof(real));
+
+		double start = omp_get_wtime();
+
+		gemv_host(trans, m, n, alpha, A, lda, x, beta, y);
+
+		double time = omp_get_wtime() - start;
+		if ((run == 1) || ((run > 1) && (time < best))) best = time;
+	}
+
+	char op[] = "gemvN";
+	op[4] = notrans ? 'N' : 'T';
+	level2_report(op, best, (double)m * n * sizeof(real),
+		level2_stream(m, n, A, lda, 0));
+
+	int one = 1;
+	blas_gemv(&trans, &m, &n, &alpha, A, &lda, x, &one, &beta, y_ref, &one);
+
+	int status = check_result(ny, 1, y, ny, y_ref, ny);
+
+	free(A);
+	free(x);
+	free(y);
+	free(y0);
+	free(y_ref);
+
+	return status;
+}
+
+// Compute A = alpha * x * y^T + A for m x n A.
+int ger_host_test(real alpha, int m, int n, int lda)
+{
+	if (!lda) lda = m;
+	assert(lda >= m);
+
+	real* A = (real*)malloc((size_t)lda * n * sizeof(real)); assert(A);
+	real* A_ref = (real*)malloc((size_t)lda * n * sizeof(real)); assert(A_ref);
+	real* x = (real*)malloc(m * sizeof(real)); assert(x);
+	real* y = (real*)malloc(n * sizeof(real)); assert(y);
+
+	generate_data(m, n, lda, A);
+	generate_data(m, 1, m, x);
+	generate_data(n, 1, n, y);
+	memcpy(A_ref, A, (size_t)lda * n * sizeof(real));
+
+	printf("%d\t%d\t%d\t", m, n, lda); fflush(stdout);
+
+	// Every run updates A, so the reference is updated as many times.
+	double best = 0;
+	for (int run = 0; run <= GEMM_L2_RUNS; run++)
+	{
+		double start = omp_get_wtime();
+
+		ger_host(m, n, alpha, x, y, A, lda);
+
+		double time = omp_get_wtime() - start;
+		if ((run == 1) || ((run > 1) && (time < best))) best = time;
+	}
+
+	level2_report("ger", best, 2.0 * m * n * sizeof(real),
+		level2_stream(m, n, A_ref, lda, 1));
+
+	int one = 1;
+	for (int run = 0; run <= GEMM_L2_RUNS; run++)
+		blas_ger(&m, &n, &alpha, x, &one, y, &one, A_ref, &lda);
+
+	int status = check_result(m, n, A, lda, A_ref, lda);
+
+	free(A);
+	free(A_ref);
+	free(x);
+	free(y);
+
+	return status;
+}
+
+#undef real
+#undef blas_gemv
+#undef blas_ger
+#undef gemv_host
+#undef ger_host
+#undef gemv_host_test
+#undef ger_host_test
+#undef level2_stream
+#undef level2_report
+#undef generate_data
+#undef check_result
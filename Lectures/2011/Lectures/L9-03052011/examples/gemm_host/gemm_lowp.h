@@ -0,0 +1,427 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Reduced precision host GEMM: u8 * s8 products with 32-bit integer
+ * accumulation, and bf16 * bf16 products with fp32 accumulation.
+ * Result is always fp32. Blocking and threading are the same as in
+ * gemm_host.h, but the micro-kernel consumes groups of k-elements
+ * packed into 32-bit lanes, as the dot-product instructions want:
+ * 4 bytes for AVX512-VNNI vpdpbusd, 2 bf16 for AVX512-BF16 vdpbf16ps.
+ * Instruction set is detected at runtime, and the plain C kernel with
+ * the same data layout is used, if it is missing (or if GEMM_LOWP_EMULATE
+ * environment variable is set).
+ */
+
+#ifndef GEMM_LOWP_H
+#define GEMM_LOWP_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "gemm_epilogue.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GEMM_LOWP_X86
+#endif
+
+// The bfloat16 value storage: upper half of float.
+typedef uint16_t gemm_bf16_t;
+
+// Convert float to bfloat16, rounding to nearest even.
+static inline gemm_bf16_t gemm_float_to_bf16(float f)
+{
+	uint32_t x; memcpy(&x, &f, sizeof(x));
+	if ((x & 0x7fffffff) > 0x7f800000)
+		return (x >> 16) | 0x40;
+	x += 0x7fff + ((x >> 16) & 1);
+	return x >> 16;
+}
+
+// Convert bfloat16 to float.
+static inline float gemm_bf16_to_float(gemm_bf16_t h)
+{
+	uint32_t x = (uint32_t)h << 16;
+	float f; memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+// The reduced precision GEMM kinds.
+typedef enum
+{
+	// u8 * s8 -> s32, with zero points.
+	GEMM_LOWP_U8S8 = 0,
+
+	// bf16 * bf16 -> fp32.
+	GEMM_LOWP_BF16
+}
+gemm_lowp_t;
+
+// The micro-tile is MR x NR, and each of MR lanes holds
+// KG consecutive k-elements of the size ESIZE bytes.
+#define GEMM_LOWP_MR 32
+#define GEMM_LOWP_NR 6
+#define GEMM_LOWP_KG(kind) ((kind) == GEMM_LOWP_U8S8 ? 4 : 2)
+#define GEMM_LOWP_ESIZE(kind) ((kind) == GEMM_LOWP_U8S8 ? 1 : 2)
+
+// Block sizes, KC is in k-elements (same bytes for both kinds).
+#define GEMM_LOWP_MC 192
+#define GEMM_LOWP_KC(kind) ((kind) == GEMM_LOWP_U8S8 ? 512 : 256)
+#define GEMM_LOWP_NC 4092
+
+// The micro-kernel: multiply ng groups of MR x KG sliver of A by
+// KG x NR sliver of B, and write MR x NR tile of accumulators
+// (int32 or float) column by column.
+typedef void (*gemm_lowp_kernel_t)(int ng, const void* a, const void* b, void* acc);
+
+static void gemm_lowp_kernel_u8s8(int ng, const void* a_, const void* b_, void* acc)
+{
+	const uint8_t* a = (const uint8_t*)a_;
+	const int8_t* b = (const int8_t*)b_;
+	int32_t c[GEMM_LOWP_NR][GEMM_LOWP_MR];
+	memset(c, 0, sizeof(c));
+	for (int g = 0; g < ng; g++, a += GEMM_LOWP_MR * 4, b += GEMM_LOWP_NR * 4)
+		for (int j = 0; j < GEMM_LOWP_NR; j++)
+			for (int i = 0; i < GEMM_LOWP_MR; i++)
+				c[j][i] += a[4 * i] * b[4 * j] + a[4 * i + 1] * b[4 * j + 1] +
+					a[4 * i + 2] * b[4 * j + 2] + a[4 * i + 3] * b[4 * j + 3];
+	memcpy(acc, c, sizeof(c));
+}
+
+static void gemm_lowp_kernel_bf16(int ng, const void* a_, const void* b_, void* acc)
+{
+	const gemm_bf16_t* a = (const gemm_bf16_t*)a_;
+	const gemm_bf16_t* b = (const gemm_bf16_t*)b_;
+	float c[GEMM_LOWP_NR][GEMM_LOWP_MR];
+	memset(c, 0, sizeof(c));
+	for (int g = 0; g < ng; g++, a += GEMM_LOWP_MR * 2, b += GEMM_LOWP_NR * 2)
+		for (int j = 0; j < GEMM_LOWP_NR; j++)
+		{
+			float b0 = gemm_bf16_to_float(b[2 * j]);
+			float b1 = gemm_bf16_to_float(b[2 * j + 1]);
+			for (int i = 0; i < GEMM_LOWP_MR; i++)
+				c[j][i] += gemm_bf16_to_float(a[2 * i]) * b0 +
+					gemm_bf16_to_float(a[2 * i + 1]) * b1;
+		}
+	memcpy(acc, c, sizeof(c));
+}
+
+#ifdef GEMM_LOWP_X86
+// The same kernels with 2 x 16 lanes of AVX-512 dot-products.
+__attribute__((target("avx512f,avx512vnni")))
+static void gemm_lowp_kernel_u8s8_vnni(int ng, const void* a_, const void* b_, void* acc)
+{
+	const __m512i* a = (const __m512i*)a_;
+	const uint8_t* b = (const uint8_t*)b_;
+	__m512i c[GEMM_LOWP_NR][2];
+	for (int j = 0; j < GEMM_LOWP_NR; j++)
+		c[j][0] = c[j][1] = _mm512_setzero_si512();
+	for (int g = 0; g < ng; g++, a += 2, b += GEMM_LOWP_NR * 4)
+	{
+		__m512i a0 = _mm512_load_si512(a), a1 = _mm512_load_si512(a + 1);
+		for (int j = 0; j < GEMM_LOWP_NR; j++)
+		{
+			int32_t bj; memcpy(&bj, b + 4 * j, sizeof(bj));
+			__m512i bv = _mm512_set1_epi32(bj);
+			c[j][0] = _mm512_dpbusd_epi32(c[j][0], a0, bv);
+			c[j][1] = _mm512_dpbusd_epi32(c[j][1], a1, bv);
+		}
+	}
+	for (int j = 0; j < GEMM_LOWP_NR; j++)
+	{
+		_mm512_storeu_si512((int32_t*)acc + j * GEMM_LOWP_MR, c[j][0]);
+		_mm512_storeu_si512((int32_t*)acc + j * GEMM_LOWP_MR + 16, c[j][1]);
+	}
+}
+
+__attribute__((target("avx512f,avx512bf16")))
+static void gemm_lowp_kernel_bf16_avx512(int ng, const void* a_, const void* b_, void* acc)
+{
+	const __m512i* a = (const __m512i*)a_;
+	const uint8_t* b = (const uint8_t*)b_;
+	__m512 c[GEMM_LOWP_NR][2];
+	for (int j = 0; j < GEMM_LOWP_NR; j++)
+		c[j][0] = c[j][1] = _mm512_setzero_ps();
+	for (int g = 0; g < ng; g++, a += 2, b += GEMM_LOWP_NR * 4)
+	{
+		__m512bh a0 = (__m512bh)_mm512_load_si512(a);
+		__m512bh a1 = (__m512bh)_mm512_load_si512(a + 1);
+		for (int j = 0; j < GEMM_LOWP_NR; j++)
+		{
+			int32_t bj; memcpy(&bj, b + 4 * j, sizeof(bj));
+			__m512bh bv = (__m512bh)_mm512_set1_epi32(bj);
+			c[j][0] = _mm512_dpbf16_ps(c[j][0], a0, bv);
+			c[j][1] = _mm512_dpbf16_ps(c[j][1], a1, bv);
+		}
+	}
+	for (int j = 0; j < GEMM_LOWP_NR; j++)
+	{
+		_mm512_storeu_ps((float*)acc + j * GEMM_LOWP_MR, c[j][0]);
+		_mm512_storeu_ps((float*)acc + j * GEMM_LOWP_MR + 16, c[j][1]);
+	}
+}
+#endif
+
+// Check, if the dot-product instructions for the given kind are
+// present and not disabled by GEMM_LOWP_EMULATE.
+static int gemm_lowp_native(gemm_lowp_t kind)
+{
+	if (getenv("GEMM_LOWP_EMULATE")) return 0;
+#ifdef GEMM_LOWP_X86
+	__builtin_cpu_init();
+	if (kind == GEMM_LOWP_U8S8)
+		return !!__builtin_cpu_supports("avx512vnni");
+	return !!__builtin_cpu_supports("avx512bf16");
+#else
+	return 0;
+#endif
+}
+
+// Get the printable name of the kernel used for the given kind.
+const char* gemm_lowp_isa(gemm_lowp_t kind)
+{
+	if (!gemm_lowp_native(kind)) return "emulated";
+	return (kind == GEMM_LOWP_U8S8) ? "avx512vnni" : "avx512bf16";
+}
+
+static gemm_lowp_kernel_t gemm_lowp_kernel(gemm_lowp_t kind)
+{
+#ifdef GEMM_LOWP_X86
+	if (gemm_lowp_native(kind))
+		return (kind == GEMM_LOWP_U8S8) ?
+			gemm_lowp_kernel_u8s8_vnni : gemm_lowp_kernel_bf16_avx512;
+#endif
+	return (kind == GEMM_LOWP_U8S8) ?
+		gemm_lowp_kernel_u8s8 : gemm_lowp_kernel_bf16;
+}
+
+// Pack rows x kc block of X into R-row slivers of 8-bit elements,
+// grouped by 4 k-elements. Element (r, p) is X[r + p * ld], or
+// X[p + r * ld] if trans is set. Rows and k beyond the block are
+// zeroed. Row sums go to sums, signed or unsigned.
+static void gemm_lowp_pack_8(int trans, int rows, int kc, int R,
+	const uint8_t* X, int ld, int is_signed, uint8_t* restrict Xp, int32_t* sums)
+{
+	int kcp = (kc + 3) / 4 * 4;
+	for (int ir = 0; ir < rows; ir += R)
+	{
+		int r = rows - ir < R ? rows - ir : R;
+		for (int i = 0; i < R; i++)
+			sums[ir + i] = 0;
+		for (int g = 0; g < kcp; g += 4, Xp += R * 4)
+			for (int i = 0; i < R; i++)
+				for (int t = 0; t < 4; t++)
+				{
+					int p = g + t;
+					uint8_t x = 0;
+					if ((i < r) && (p < kc))
+						x = trans ? X[p + (size_t)(ir + i) * ld] :
+							X[ir + i + (size_t)p * ld];
+					Xp[i * 4 + t] = x;
+					sums[ir + i] += is_signed ? (int8_t)x : x;
+				}
+	}
+}
+
+// Pack rows x kc block of X into R-row slivers of bf16 elements,
+// grouped by 2 k-elements, the same way as above.
+static void gemm_lowp_pack_16(int trans, int rows, int kc, int R,
+	const gemm_bf16_t* X, int ld, gemm_bf16_t* restrict Xp)
+{
+	int kcp = (kc + 1) / 2 * 2;
+	for (int ir = 0; ir < rows; ir += R)
+	{
+		int r = rows - ir < R ? rows - ir : R;
+		for (int g = 0; g < kcp; g += 2, Xp += R * 2)
+			for (int i = 0; i < R; i++)
+				for (int t = 0; t < 2; t++)
+				{
+					int p = g + t;
+					gemm_bf16_t x = 0;
+					if ((i < r) && (p < kc))
+						x = trans ? X[p + (size_t)(ir + i) * ld] :
+							X[ir + i + (size_t)p * ld];
+					Xp[i * 2 + t] = x;
+				}
+	}
+}
+
+// Pack op(A) or op(B)^T block, depending on kind.
+static void gemm_lowp_pack(gemm_lowp_t kind, int trans, int rows, int kc, int R,
+	const void* X, int ld, int is_signed, void* Xp, int32_t* sums)
+{
+	if (kind == GEMM_LOWP_U8S8)
+		gemm_lowp_pack_8(trans, rows, kc, R, (const uint8_t*)X, ld,
+			is_signed, (uint8_t*)Xp, sums);
+	else
+		gemm_lowp_pack_16(trans, rows, kc, R, (const gemm_bf16_t*)X, ld,
+			(gemm_bf16_t*)Xp);
+}
+
+// Compute m x n x k GEMM part in current thread. The first block of k
+// computes alpha * AB + beta * C, further ones add alpha * AB to C,
+// the last one adds bias, if any. For u8 * s8 each block is corrected
+// for zero points exactly in integers:
+// sum (a - za)(b - zb) = sum ab - zb * sum a - za * sum b + kc * za * zb.
+// j0 is the part column offset in C.
+static void gemm_lowp_part(gemm_lowp_t kind, gemm_lowp_kernel_t kernel,
+	char transa, char transb, int m, int n, int k,
+	const void* A, int lda, int za, const void* B, int ldb, int zb,
+	const sgemm_epilogue_t* epi, float* C, int ldc, int j0,
+	void* Ap, void* Bp, int32_t* sa, int32_t* sb)
+{
+	int ta = (transa != 'n') && (transa != 'N');
+	int tb = (transb != 'n') && (transb != 'N');
+	int esize = GEMM_LOWP_ESIZE(kind), kg = GEMM_LOWP_KG(kind);
+	int KC = GEMM_LOWP_KC(kind);
+	const char* a = (const char*)A;
+	const char* b = (const char*)B;
+
+	union { int32_t i[GEMM_LOWP_NR * GEMM_LOWP_MR]; float f[GEMM_LOWP_NR * GEMM_LOWP_MR]; } acc;
+
+	for (int jc = 0; jc < n; jc += GEMM_LOWP_NC)
+	{
+		int nc = n - jc < GEMM_LOWP_NC ? n - jc : GEMM_LOWP_NC;
+		for (int pc = 0; pc < k; pc += KC)
+		{
+			int kc = k - pc < KC ? k - pc : KC;
+			int kcp = (kc + kg - 1) / kg * kg;
+			int first = (pc == 0), last = (pc + kc == k);
+
+			// op(B)^T element (j, p) is B[p + j * ldb], or B[j + p * ldb].
+			gemm_lowp_pack(kind, !tb, nc, kc, GEMM_LOWP_NR, b + (size_t)esize *
+				(tb ? jc + (size_t)pc * ldb : pc + (size_t)jc * ldb), ldb, 1, Bp, sb);
+
+			for (int ic = 0; ic < m; ic += GEMM_LOWP_MC)
+			{
+				int mc = m - ic < GEMM_LOWP_MC ? m - ic : GEMM_LOWP_MC;
+
+				gemm_lowp_pack(kind, ta, mc, kc, GEMM_LOWP_MR, a + (size_t)esize *
+					(ta ? pc + (size_t)ic * lda : ic + (size_t)pc * lda), lda, 0, Ap, sa);
+
+				for (int jr = 0; jr < nc; jr += GEMM_LOWP_NR)
+				{
+					int nr = nc - jr < GEMM_LOWP_NR ? nc - jr : GEMM_LOWP_NR;
+					for (int ir = 0; ir < mc; ir += GEMM_LOWP_MR)
+					{
+						int mr = mc - ir < GEMM_LOWP_MR ? mc - ir : GEMM_LOWP_MR;
+						kernel(kcp / kg, (const char*)Ap + (size_t)ir * kcp * esize,
+							(const char*)Bp + (size_t)jr * kcp * esize, &acc);
+
+						for (int j = 0; j < nr; j++)
+						{
+							float* c = C + ic + ir + (size_t)(jc + jr + j) * ldc;
+							for (int i = 0; i < mr; i++)
+							{
+								float x;
+								if (kind == GEMM_LOWP_U8S8)
+									x = (float)(acc.i[i + j * GEMM_LOWP_MR] -
+										zb * sa[ir + i] - za * sb[jr + j] + kc * za * zb);
+								else
+									x = acc.f[i + j * GEMM_LOWP_MR];
+								x *= epi->alpha;
+								if (!first)
+									x += c[i];
+								else if (epi->beta != 0)
+									x += epi->beta * c[i];
+								if (last && epi->bias)
+									x += epi->bias[j0 + jc + jr + j];
+								c[i] = x;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// Compute C = alpha * op(A) * op(B) + beta * C (+ bias[j]) for
+// the reduced precision op(A) m x k and op(B) k x n.
+static gemm_partition_t gemm_lowp(gemm_lowp_t kind, char transa, char transb,
+	int m, int n, int k, const void* A, int lda, int za,
+	const void* B, int ldb, int zb, const sgemm_epilogue_t* epi, float* C, int ldc)
+{
+	int ta = (transa != 'n') && (transa != 'N');
+	int tb = (transb != 'n') && (transb != 'N');
+	int esize = GEMM_LOWP_ESIZE(kind);
+	size_t KC = GEMM_LOWP_KC(kind);
+	gemm_lowp_kernel_t kernel = gemm_lowp_kernel(kind);
+
+	// Integer accumulators are not reduced across threads,
+	// so only the output is split.
+	gemm_partition_t partition;
+	gemm_partition(m, n, k, omp_get_max_threads(),
+		GEMM_PARTITION_HOST_COST, 0, &partition);
+	int nparts = gemm_partition_size(&partition);
+
+	#pragma omp parallel num_threads(nparts)
+	{
+		void *Ap, *Bp;
+		int status = posix_memalign(&Ap, 64, KC * esize *
+			((GEMM_LOWP_MC + GEMM_LOWP_MR - 1) / GEMM_LOWP_MR) * GEMM_LOWP_MR);
+		assert(!status);
+		status = posix_memalign(&Bp, 64, KC * esize *
+			((GEMM_LOWP_NC + GEMM_LOWP_NR - 1) / GEMM_LOWP_NR) * GEMM_LOWP_NR);
+		assert(!status);
+		int32_t* sa = (int32_t*)malloc((GEMM_LOWP_MC + GEMM_LOWP_MR) * sizeof(int32_t));
+		int32_t* sb = (int32_t*)malloc((GEMM_LOWP_NC + GEMM_LOWP_NR) * sizeof(int32_t));
+		assert(sa); assert(sb);
+
+		for (int ipart = omp_get_thread_num(); ipart < nparts;
+			ipart += omp_get_num_threads())
+		{
+			gemm_part_t part;
+			gemm_partition_part(&partition, m, n, k, ipart, &part);
+
+			const char* a = (const char*)A + (size_t)esize * (ta ?
+				(size_t)part.m0 * lda : part.m0);
+			const char* b = (const char*)B + (size_t)esize * (tb ?
+				part.n0 : (size_t)part.n0 * ldb);
+			gemm_lowp_part(kind, kernel, transa, transb, part.m, part.n, part.k,
+				a, lda, za, b, ldb, zb, epi, C + part.m0 + (size_t)part.n0 * ldc, ldc,
+				part.n0, Ap, Bp, sa, sb);
+		}
+
+		free(Ap);
+		free(Bp);
+		free(sa);
+		free(sb);
+	}
+
+	return partition;
+}
+
+// Compute C = alpha * (op(A) - za) * (op(B) - zb) + beta * C (+ bias[j]),
+// where A is u8 and B is s8 with the given zero points. Quantization
+// scales of A and B are passed as their product in alpha. Each block
+// of products is summed exactly in 32 bits, so KC * 255 * 255 must
+// fit in int32.
+gemm_partition_t gemm_host_u8s8(char transa, char transb,
+	int m, int n, int k, const uint8_t* A, int lda, int za,
+	const int8_t* B, int ldb, int zb, const sgemm_epilogue_t* epi, float* C, int ldc)
+{
+	return gemm_lowp(GEMM_LOWP_U8S8, transa, transb, m, n, k,
+		A, lda, za, B, ldb, zb, epi, C, ldc);
+}
+
+// Compute C = alpha * op(A) * op(B) + beta * C (+ bias[j]),
+// where A and B are bf16, with fp32 accumulation.
+gemm_partition_t gemm_host_bf16(char transa, char transb,
+	int m, int n, int k, const gemm_bf16_t* A, int lda,
+	const gemm_bf16_t* B, int ldb, const sgemm_epilogue_t* epi, float* C, int ldc)
+{
+	return gemm_lowp(GEMM_LOWP_BF16, transa, transb, m, n, k,
+		A, lda, 0, B, ldb, 0, epi, C, ldc);
+}
+
+#endif // GEMM_LOWP_H
@@ -0,0 +1,160 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Test of reduced precision host GEMM. The result is checked against
+ * the double precision host BLAS on the same (exactly representable)
+ * inputs, and compared in speed with the fp32 host GEMM.
+ */
+
+#ifndef GEMM_LOWP_TEST_H
+#define GEMM_LOWP_TEST_H
+
+// Allowed relative error of the fp32 result.
+#define GEMM_LOWP_TOLERANCE 1e-5
+
+// The zero points used in test of u8 * s8 GEMM.
+#define GEMM_LOWP_TEST_ZA 128
+#define GEMM_LOWP_TEST_ZB 3
+
+int gemm_lowp_test(gemm_lowp_t kind, char transa, char transb,
+	float alpha, float beta, int m, int n, int k, int lda, int ldb, int ldc)
+{
+	printf("%d\t%d\t%d\t", m, n, k); fflush(stdout);
+
+	// Stored shapes of A and B depend on transposition.
+	int ta = (transa != 'n') && (transa != 'N');
+	int tb = (transb != 'n') && (transb != 'N');
+	int rows_a = ta ? k : m, cols_a = ta ? m : k;
+	int rows_b = tb ? n : k, cols_b = tb ? k : n;
+	if (!lda) lda = rows_a;
+	if (!ldb) ldb = rows_b;
+	if (!ldc) ldc = m;
+	assert((lda >= rows_a) && (ldb >= rows_b) && (ldc >= m));
+
+	size_t sza = (size_t)lda * cols_a, szb = (size_t)ldb * cols_b;
+	size_t szc = (size_t)ldc * n;
+	int esize = GEMM_LOWP_ESIZE(kind);
+	void* A = malloc(sza * esize); assert(A);
+	void* B = malloc(szb * esize); assert(B);
+	float* C = (float*)malloc(szc * sizeof(float)); assert(C);
+	float* C_init = (float*)malloc(szc * sizeof(float)); assert(C_init);
+	float* bias = (float*)malloc(n * sizeof(float)); assert(bias);
+
+	// The same inputs, with zero points subtracted, in fp32 and fp64.
+	float* As = (float*)malloc(sza * sizeof(float)); assert(As);
+	float* Bs = (float*)malloc(szb * sizeof(float)); assert(Bs);
+	double* Ad = (double*)malloc(sza * sizeof(double)); assert(Ad);
+	double* Bd = (double*)malloc(szb * sizeof(double)); assert(Bd);
+	double* Cd = (double*)malloc(szc * sizeof(double)); assert(Cd);
+	float* C_ref = (float*)malloc(szc * sizeof(float)); assert(C_ref);
+
+	int za = 0, zb = 0;
+	if (kind == GEMM_LOWP_U8S8)
+	{
+		za = GEMM_LOWP_TEST_ZA;
+		zb = GEMM_LOWP_TEST_ZB;
+		for (size_t i = 0; i < sza; i++)
+		{
+			((uint8_t*)A)[i] = rand() & 0xff;
+			As[i] = Ad[i] = ((uint8_t*)A)[i] - za;
+		}
+		for (size_t i = 0; i < szb; i++)
+		{
+			((int8_t*)B)[i] = (int8_t)(rand() & 0xff);
+			Bs[i] = Bd[i] = ((int8_t*)B)[i] - zb;
+		}
+	}
+	else
+	{
+		sgenerate_data(rows_a, cols_a, lda, As);
+		sgenerate_data(rows_b, cols_b, ldb, Bs);
+		for (size_t i = 0; i < sza; i++)
+		{
+			((gemm_bf16_t*)A)[i] = gemm_float_to_bf16(As[i] - 0.5f);
+			As[i] = Ad[i] = gemm_bf16_to_float(((gemm_bf16_t*)A)[i]);
+		}
+		for (size_t i = 0; i < szb; i++)
+		{
+			((gemm_bf16_t*)B)[i] = gemm_float_to_bf16(Bs[i] - 0.5f);
+			Bs[i] = Bd[i] = gemm_bf16_to_float(((gemm_bf16_t*)B)[i]);
+		}
+	}
+	sgenerate_data(m, n, ldc, C_init);
+	for (size_t i = 0; i < szc; i++)
+		Cd[i] = C_init[i];
+	for (int j = 0; j < n; j++)
+		bias[j] = rand() / (float)RAND_MAX;
+
+	sgemm_epilogue_t epi;
+	memset(&epi, 0, sizeof(epi));
+	epi.alpha = alpha;
+	epi.beta = beta;
+	epi.bias = bias;
+
+	memcpy(C, C_init, szc * sizeof(float));
+
+	double start = omp_get_wtime();
+
+	gemm_partition_t partition = (kind == GEMM_LOWP_U8S8) ?
+		gemm_host_u8s8(transa, transb, m, n, k, (uint8_t*)A, lda, za,
+			(int8_t*)B, ldb, zb, &epi, C, ldc) :
+		gemm_host_bf16(transa, transb, m, n, k, (gemm_bf16_t*)A, lda,
+			(gemm_bf16_t*)B, ldb, &epi, C, ldc);
+
+	double time = omp_get_wtime() - start;
+	printf("%s\t%f sec\t%f\t", gemm_split_name(partition.split),
+		time, 2.0e-9 * m * n * k / time); fflush(stdout);
+
+	// Perform reference matmul in double precision.
+	double alphad = alpha, betad = beta;
+	dgemm_(&transa, &transb, &m, &n, &k,
+		&alphad, Ad, &lda, Bd, &ldb, &betad, Cd, &ldc);
+	for (int j = 0; j < n; j++)
+		for (int i = 0; i < m; i++)
+			C_ref[i + (size_t)j * ldc] = (float)(Cd[i + (size_t)j * ldc] + bias[j]);
+
+	int status = scheck_result_eps(m, n, C, ldc, C_ref, ldc, GEMM_LOWP_TOLERANCE);
+
+	// The fp32 GEMM on the same data, for comparison.
+	memcpy(C, C_init, szc * sizeof(float));
+
+	printf("%d\t%d\t%d\t", m, n, k); fflush(stdout);
+
+	start = omp_get_wtime();
+
+	sgemm_host_ex(transa, transb, m, n, k, As, lda, Bs, ldb, &epi, C, ldc);
+
+	time = omp_get_wtime() - start;
+	printf("%s\t%f sec\t%f\t", "fp32", time, 2.0e-9 * m * n * k / time);
+	fflush(stdout);
+
+	for (int j = 0; j < n; j++)
+		for (int i = 0; i < m; i++)
+			C[i + (size_t)j * ldc] += bias[j];
+	status |= scheck_result_eps(m, n, C, ldc, C_ref, ldc, GEMM_LOWP_TOLERANCE);
+
+	free(A);
+	free(B);
+	free(C);
+	free(C_init);
+	free(bias);
+	free(As);
+	free(Bs);
+	free(Ad);
+	free(Bd);
+	free(Cd);
+	free(C_ref);
+
+	return status;
+}
+
+#endif // GEMM_LOWP_TEST_H
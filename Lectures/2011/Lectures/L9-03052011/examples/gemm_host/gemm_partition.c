@@ -0,0 +1,141 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ */
+
+#include "gemm_partition.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+// The minimal number of flops worth to be given
+// to a separate worker.
+#define GEMM_PARTITION_MIN_FLOPS (1 << 18)
+
+// Estimate the time of the slowest part, in flops.
+static double gemm_partition_cost(int m, int n, int k,
+	int pm, int pn, int pk, double cost)
+{
+	double mb = (m + pm - 1) / pm;
+	double nb = (n + pn - 1) / pn;
+	double kb = (k + pk - 1) / pk;
+	int nparts = pm * pn * pk;
+
+	// Each part computes its own block product and
+	// touches its blocks of op(A), op(B) and C.
+	double flops = 2.0 * mb * nb * kb;
+	double traffic = mb * kb + kb * nb + mb * nb;
+
+	// Partial C-s are summed by all workers together.
+	if (pk > 1)
+		traffic += (double)m * n * pk / nparts;
+
+	return flops + cost * traffic;
+}
+
+void gemm_partition(int m, int n, int k, int nworkers,
+	double cost, int allow_ksplit, gemm_partition_t* partition)
+{
+	assert(partition);
+	assert(nworkers > 0);
+
+	partition->split = GEMM_SPLIT_NONE;
+	partition->pm = 1; partition->pn = 1; partition->pk = 1;
+	if ((m <= 0) || (n <= 0) || (k <= 0)) return;
+
+	double best = gemm_partition_cost(m, n, k, 1, 1, 1, cost);
+
+	for (int p = 2; p <= nworkers; p++)
+	{
+		// Candidates are 1D splits along each dimension
+		// and all 2D grids of C with p blocks.
+		for (int pm = 1; pm <= p; pm++)
+		{
+			if (p % pm) continue;
+			int pn = p / pm;
+
+			for (int ksplit = 0; ksplit < 2; ksplit++)
+			{
+				int pk = 1;
+				gemm_split_t split = GEMM_SPLIT_MN;
+				if (ksplit)
+				{
+					// K split only goes alone.
+					if (!allow_ksplit || (pm != 1) || (pn != p)) continue;
+					pk = p; pn = 1;
+					split = GEMM_SPLIT_K;
+				}
+				else if (pn == 1) split = GEMM_SPLIT_M;
+				else if (pm == 1) split = GEMM_SPLIT_N;
+
+				// Do not create empty or too small parts.
+				if ((pm > m) || (pn > n) || (pk > k)) continue;
+				double flops = 2.0 * (double)((m + pm - 1) / pm) *
+					((n + pn - 1) / pn) * ((k + pk - 1) / pk);
+				if (flops < GEMM_PARTITION_MIN_FLOPS) continue;
+
+				double estimate = gemm_partition_cost(
+					m, n, k, pm, pn, pk, cost);
+				if (estimate < best)
+				{
+					best = estimate;
+					partition->split = split;
+					partition->pm = pm;
+					partition->pn = pn;
+					partition->pk = pk;
+				}
+			}
+		}
+	}
+}
+
+int gemm_partition_size(const gemm_partition_t* partition)
+{
+	return partition->pm * partition->pn * partition->pk;
+}
+
+// Cut the range of n elements into np nearly equal pieces,
+// returning the offset and size of the ip-th one.
+static void gemm_partition_range(int n, int np, int ip, int* offset, int* size)
+{
+	int base = n / np, rem = n % np;
+	*offset = ip * base + (ip < rem ? ip : rem);
+	*size = base + (ip < rem ? 1 : 0);
+}
+
+void gemm_partition_part(const gemm_partition_t* partition,
+	int m, int n, int k, int ipart, gemm_part_t* part)
+{
+	assert((ipart >= 0) && (ipart < gemm_partition_size(partition)));
+
+	// Parts are numbered with m index running fastest.
+	part->im = ipart % partition->pm;
+	part->in = (ipart / partition->pm) % partition->pn;
+	part->ik = ipart / (partition->pm * partition->pn);
+
+	gemm_partition_range(m, partition->pm, part->im, &part->m0, &part->m);
+	gemm_partition_range(n, partition->pn, part->in, &part->n0, &part->n);
+	gemm_partition_range(k, partition->pk, part->ik, &part->k0, &part->k);
+}
+
+const char* gemm_split_name(gemm_split_t split)
+{
+	switch (split)
+	{
+	case GEMM_SPLIT_NONE : return "none";
+	case GEMM_SPLIT_M : return "m";
+	case GEMM_SPLIT_N : return "n";
+	case GEMM_SPLIT_K : return "k";
+	case GEMM_SPLIT_MN : return "mn";
+	}
+	return "unknown";
+}
+
@@ -0,0 +1,80 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ */
+
+#ifndef GEMM_PARTITION_H
+#define GEMM_PARTITION_H
+
+// The relative cost of moving one matrix element
+// compared to one flop, for the host threads and for
+// the GPU streams (the latter pay for PCI-E transfer).
+#define GEMM_PARTITION_HOST_COST 8.0
+#define GEMM_PARTITION_STREAM_COST 256.0
+
+// The way GEMM iteration space (m, n, k) is split
+// between parallel workers.
+typedef enum
+{
+	GEMM_SPLIT_NONE = 0,
+
+	// Cut rows of op(A) and C.
+	GEMM_SPLIT_M,
+
+	// Cut columns of op(B) and C.
+	GEMM_SPLIT_N,
+
+	// Cut the common dimension, partial C-s are
+	// reduced afterwards.
+	GEMM_SPLIT_K,
+
+	// Cut C into the 2D grid of blocks.
+	GEMM_SPLIT_MN
+}
+gemm_split_t;
+
+// The GEMM partitioning: pm x pn x pk grid of parts.
+typedef struct
+{
+	gemm_split_t split;
+	int pm, pn, pk;
+}
+gemm_partition_t;
+
+// The single part of GEMM iteration space:
+// its grid coordinates, offsets and sizes.
+typedef struct
+{
+	int im, in, ik;
+	int m0, n0, k0;
+	int m, n, k;
+}
+gemm_part_t;
+
+// Choose the partitioning of (m, n, k) GEMM between
+// at most nworkers workers with the given relative data
+// movement cost. Pass allow_ksplit = 0, if partial
+// results cannot be reduced by the caller.
+void gemm_partition(int m, int n, int k, int nworkers,
+	double cost, int allow_ksplit, gemm_partition_t* partition);
+
+// Get the number of parts in partitioning.
+int gemm_partition_size(const gemm_partition_t* partition);
+
+// Get the part with the given index.
+void gemm_partition_part(const gemm_partition_t* partition,
+	int m, int n, int k, int ipart, gemm_part_t* part);
+
+// Get the printable name of split kind.
+const char* gemm_split_name(gemm_split_t split);
+
+#endif // GEMM_PARTITION_H
+
@@ -0,0 +1,292 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Strassen-Winograd GEMM on top of the host GEMM: each level replaces
+ * 8 half-size products with 7 products and 15 additions, recursing
+ * while all dimensions are above the crossover (tuned one, if there is),
+ * where the multithreaded host GEMM takes over. Odd rows, columns and
+ * k are peeled off and computed by host GEMM as well. Temporary sums
+ * and products go to the caller-provided workspace (arena), so no
+ * memory is allocated during recursion. Must be included after
+ * gemm_host.h.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define gemm_host sgemm_host
+#define gemm_strassen sgemm_strassen
+#define gemm_strassen_rec sgemm_strassen_rec
+#define gemm_strassen_add sgemm_strassen_add
+#define gemm_strassen_size sgemm_strassen_size
+#define gemm_strassen_workspace sgemm_strassen_workspace
+#define gemm_strassen_tune sgemm_strassen_tune
+#define generate_data sgenerate_data
+#define GEMM_DTYPE 's'
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define gemm_host dgemm_host
+#define gemm_strassen dgemm_strassen
+#define gemm_strassen_rec dgemm_strassen_rec
+#define gemm_strassen_add dgemm_strassen_add
+#define gemm_strassen_size dgemm_strassen_size
+#define gemm_strassen_workspace dgemm_strassen_workspace
+#define gemm_strassen_tune dgemm_strassen_tune
+#define generate_data dgenerate_data
+#define GEMM_DTYPE 'd'
+#endif
+
+// The number of timed runs of each size in tuning, the best one is taken.
+#ifndef GEMM_TUNE_RUNS
+#define GEMM_TUNE_RUNS 3
+#endif
+
+#ifndef GEMM_STRASSEN_OP
+// Block (i, j) of op(A) with m x k blocks.
+#define GEMM_STRASSEN_OP(A, lda, t, i, j, m, k) \
+	((t) ? (A) + (size_t)(j) * (k) + (size_t)(i) * (m) * (lda) : \
+		(A) + (size_t)(i) * (m) + (size_t)(j) * (k) * (lda))
+#endif
+
+// Compute m x n C = op(A) + s * op(B).
+static void gemm_strassen_add(int m, int n,
+	int ta, const real* A, int lda, int tb, const real* B, int ldb,
+	real s, real* C, int ldc)
+{
+	#pragma omp parallel for
+	for (int j = 0; j < n; j++)
+	{
+		real* c = C + (size_t)j * ldc;
+		if (!ta && !tb)
+		{
+			const real* a = A + (size_t)j * lda;
+			const real* b = B + (size_t)j * ldb;
+			for (int i = 0; i < m; i++)
+				c[i] = a[i] + s * b[i];
+		}
+		else
+			for (int i = 0; i < m; i++)
+				c[i] = (ta ? A[j + (size_t)i * lda] : A[i + (size_t)j * lda]) +
+					s * (tb ? B[j + (size_t)i * ldb] : B[i + (size_t)j * ldb]);
+	}
+}
+
+// Workspace of the recursion in elements.
+static size_t gemm_strassen_size(int m, int n, int k, int crossover)
+{
+	if ((m <= crossover) || (n <= crossover) || (k <= crossover))
+		return 0;
+
+	// X holds sums of A blocks and the product P1,
+	// Y holds sums of B blocks.
+	size_t mh = m / 2, nh = n / 2, kh = k / 2;
+	return mh * (kh > nh ? kh : nh) + kh * nh +
+		gemm_strassen_size(mh, nh, kh, crossover);
+}
+
+// Compute C = alpha * op(A) * op(B) with the Winograd schedule
+// of two temporaries (Boyer et al, 2009), W is the workspace.
+static void gemm_strassen_rec(int ta, int tb, int m, int n, int k,
+	real alpha, const real* A, int lda, const real* B, int ldb,
+	real* C, int ldc, real* W, int crossover)
+{
+	char transa = ta ? 'T' : 'N', transb = tb ? 'T' : 'N';
+	if ((m <= crossover) || (n <= crossover) || (k <= crossover))
+	{
+		gemm_host(transa, transb, m, n, k, alpha, A, lda, B, ldb, 0, C, ldc);
+		return;
+	}
+
+	int mh = m / 2, nh = n / 2, kh = k / 2;
+	const real* A11 = GEMM_STRASSEN_OP(A, lda, ta, 0, 0, mh, kh);
+	const real* A12 = GEMM_STRASSEN_OP(A, lda, ta, 0, 1, mh, kh);
+	const real* A21 = GEMM_STRASSEN_OP(A, lda, ta, 1, 0, mh, kh);
+	const real* A22 = GEMM_STRASSEN_OP(A, lda, ta, 1, 1, mh, kh);
+	const real* B11 = GEMM_STRASSEN_OP(B, ldb, tb, 0, 0, kh, nh);
+	const real* B12 = GEMM_STRASSEN_OP(B, ldb, tb, 0, 1, kh, nh);
+	const real* B21 = GEMM_STRASSEN_OP(B, ldb, tb, 1, 0, kh, nh);
+	const real* B22 = GEMM_STRASSEN_OP(B, ldb, tb, 1, 1, kh, nh);
+	real* C11 = C, *C12 = C + (size_t)nh * ldc;
+	real* C21 = C + mh, *C22 = C + mh + (size_t)nh * ldc;
+
+	// X is mh x kh for sums of A and mh x nh for P1.
+	real* X = W;
+	real* Y = X + (size_t)mh * (kh > nh ? kh : nh);
+	real* V = Y + (size_t)kh * nh;
+
+	gemm_strassen_add(mh, kh, ta, A11, lda, ta, A21, lda, -1, X, mh);	// S3
+	gemm_strassen_add(kh, nh, tb, B22, ldb, tb, B12, ldb, -1, Y, kh);	// T3
+	gemm_strassen_rec(0, 0, mh, nh, kh, alpha, X, mh, Y, kh, C21, ldc, V, crossover);	// P7
+	gemm_strassen_add(mh, kh, ta, A21, lda, ta, A22, lda, 1, X, mh);	// S1
+	gemm_strassen_add(kh, nh, tb, B12, ldb, tb, B11, ldb, -1, Y, kh);	// T1
+	gemm_strassen_rec(0, 0, mh, nh, kh, alpha, X, mh, Y, kh, C22, ldc, V, crossover);	// P5
+	gemm_strassen_add(mh, kh, 0, X, mh, ta, A11, lda, -1, X, mh);	// S2 = S1 - A11
+	gemm_strassen_add(kh, nh, tb, B22, ldb, 0, Y, kh, -1, Y, kh);	// T2 = B22 - T1
+	gemm_strassen_rec(0, 0, mh, nh, kh, alpha, X, mh, Y, kh, C12, ldc, V, crossover);	// P6
+	gemm_strassen_add(mh, kh, ta, A12, lda, 0, X, mh, -1, X, mh);	// S4 = A12 - S2
+	gemm_strassen_rec(0, tb, mh, nh, kh, alpha, X, mh, B22, ldb, C11, ldc, V, crossover);	// P3
+	gemm_strassen_rec(ta, tb, mh, nh, kh, alpha, A11, lda, B11, ldb, X, mh, V, crossover);	// P1
+	gemm_strassen_add(mh, nh, 0, X, mh, 0, C12, ldc, 1, C12, ldc);	// U2 = P1 + P6
+	gemm_strassen_add(mh, nh, 0, C12, ldc, 0, C21, ldc, 1, C21, ldc);	// U3 = U2 + P7
+	gemm_strassen_add(mh, nh, 0, C12, ldc, 0, C22, ldc, 1, C12, ldc);	// U4 = U2 + P5
+	gemm_strassen_add(mh, nh, 0, C21, ldc, 0, C22, ldc, 1, C22, ldc);	// U7 = U3 + P5
+	gemm_strassen_add(mh, nh, 0, C12, ldc, 0, C11, ldc, 1, C12, ldc);	// U5 = U4 + P3
+	gemm_strassen_add(kh, nh, 0, Y, kh, tb, B21, ldb, -1, Y, kh);	// T4 = T2 - B21
+	gemm_strassen_rec(ta, 0, mh, nh, kh, alpha, A22, lda, Y, kh, C11, ldc, V, crossover);	// P4
+	gemm_strassen_add(mh, nh, 0, C21, ldc, 0, C11, ldc, -1, C21, ldc);	// U6 = U3 - P4
+	gemm_strassen_rec(ta, tb, mh, nh, kh, alpha, A12, lda, B21, ldb, C11, ldc, V, crossover);	// P2
+	gemm_strassen_add(mh, nh, 0, X, mh, 0, C11, ldc, 1, C11, ldc);	// U1 = P1 + P2
+
+	// Peel odd k, then odd row and column.
+	int m2 = 2 * mh, n2 = 2 * nh, k2 = 2 * kh;
+	if (k2 < k)
+		gemm_host(transa, transb, m2, n2, 1, alpha,
+			GEMM_STRASSEN_OP(A, lda, ta, 0, k2, 1, 1), lda,
+			GEMM_STRASSEN_OP(B, ldb, tb, k2, 0, 1, 1), ldb, 1, C, ldc);
+	if (m2 < m)
+		gemm_host(transa, transb, 1, n, k, alpha,
+			GEMM_STRASSEN_OP(A, lda, ta, m2, 0, 1, 1), lda, B, ldb, 0, C + m2, ldc);
+	if (n2 < n)
+		gemm_host(transa, transb, m2, 1, k, alpha, A, lda,
+			GEMM_STRASSEN_OP(B, ldb, tb, 0, n2, 1, 1), ldb, 0, C + (size_t)n2 * ldc, ldc);
+}
+
+// Get the workspace size in elements for m x n x k GEMM with the given
+// crossover (0 means tuned one, smaller ones are raised to the minimum).
+size_t gemm_strassen_workspace(int m, int n, int k, int crossover)
+{
+	if (!crossover) crossover = gemm_tune_crossover(GEMM_DTYPE);
+	if (crossover < GEMM_TUNE_CROSSOVER_MIN) crossover = GEMM_TUNE_CROSSOVER_MIN;
+
+	// Product goes to workspace for beta * C.
+	return (size_t)m * n + gemm_strassen_size(m, n, k, crossover);
+}
+
+// Compute C = alpha * op(A) * op(B) + beta * C by Strassen-Winograd
+// algorithm, recursing while all dimensions are above crossover (0 means
+// tuned one, smaller ones are raised to GEMM_TUNE_CROSSOVER_MIN). W is
+// the workspace of gemm_strassen_workspace elements, or NULL to allocate
+// it here. Returns the number of recursion levels.
+int gemm_strassen(char transa, char transb, int m, int n, int k,
+	real alpha, const real* A, int lda, const real* B, int ldb,
+	real beta, real* C, int ldc, real* W, int crossover)
+{
+	if (!crossover) crossover = gemm_tune_crossover(GEMM_DTYPE);
+	if (crossover < GEMM_TUNE_CROSSOVER_MIN) crossover = GEMM_TUNE_CROSSOVER_MIN;
+	int ta = (transa != 'n') && (transa != 'N');
+	int tb = (transb != 'n') && (transb != 'N');
+
+	int levels = 0;
+	for (int mm = m, nn = n, kk = k; (mm > crossover) && (nn > crossover) &&
+		(kk > crossover); mm /= 2, nn /= 2, kk /= 2)
+		levels++;
+	if (!levels)
+	{
+		gemm_host(transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+		return 0;
+	}
+
+	real* workspace = W;
+	if (!W)
+	{
+		workspace = (real*)malloc(gemm_strassen_workspace(m, n, k, crossover) *
+			sizeof(real));
+		assert(workspace);
+	}
+
+	// Without beta * C the product goes right to C.
+	if (beta == 0)
+		gemm_strassen_rec(ta, tb, m, n, k, alpha, A, lda, B, ldb,
+			C, ldc, workspace + (size_t)m * n, crossover);
+	else
+	{
+		real* P = workspace;
+		gemm_strassen_rec(ta, tb, m, n, k, alpha, A, lda, B, ldb,
+			P, m, workspace + (size_t)m * n, crossover);
+		gemm_strassen_add(m, n, 0, P, m, 0, C, ldc, beta, C, ldc);
+	}
+
+	if (!W) free(workspace);
+
+	return levels;
+}
+
+// Find the crossover: the largest of square sizes up to n_max, at
+// which one level of Strassen is not faster than host GEMM, and save
+// it. Returns 0 on success.
+int gemm_strassen_tune(int n_max)
+{
+	const int sizes[] = { 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192 };
+	const int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+
+	// Below the smallest size recursion does not pay off.
+	int crossover = sizes[0] / 2;
+	printf("n\tgemm\t\tstrassen\n");
+	for (int i = 0; (i < nsizes) && (sizes[i] <= n_max); i++)
+	{
+		int n = sizes[i];
+		real* A = (real*)malloc((size_t)n * n * sizeof(real)); assert(A);
+		real* B = (real*)malloc((size_t)n * n * sizeof(real)); assert(B);
+		real* C = (real*)malloc((size_t)n * n * sizeof(real)); assert(C);
+		real* W = (real*)malloc(gemm_strassen_workspace(n, n, n, n / 2) *
+			sizeof(real)); assert(W);
+		generate_data(n, n, n, A);
+		generate_data(n, n, n, B);
+
+		// The first run warms up caches and pages,
+		// the best of the others is taken.
+		double best[2] = { 0, 0 };
+		for (int run = 0; run <= GEMM_TUNE_RUNS; run++)
+			for (int strassen = 0; strassen < 2; strassen++)
+			{
+				double start = omp_get_wtime();
+				if (strassen)
+					gemm_strassen('N', 'N', n, n, n, 1, A, n, B, n, 0, C, n, W, n / 2);
+				else
+					gemm_host('N', 'N', n, n, n, 1, A, n, B, n, 0, C, n);
+				double time = omp_get_wtime() - start;
+				if ((run == 1) || ((run > 1) && (time < best[strassen])))
+					best[strassen] = time;
+			}
+		printf("%d\t%f sec\t%f sec\n", n, best[0], best[1]);
+		fflush(stdout);
+
+		free(A);
+		free(B);
+		free(C);
+		free(W);
+
+		if (best[1] >= best[0]) crossover = n;
+	}
+
+	gemm_tune_t tune;
+	gemm_tune_load(GEMM_DTYPE, &tune);
+	tune.crossover = crossover;
+	int status = gemm_tune_save(&tune);
+
+	printf("best crossover %d for %s saved to %s\n", crossover,
+		gemm_tune_cpu(), gemm_tune_file());
+
+	return status;
+}
+
+#undef real
+#undef gemm_host
+#undef gemm_strassen
+#undef gemm_strassen_rec
+#undef gemm_strassen_add
+#undef gemm_strassen_size
+#undef gemm_strassen_workspace
+#undef gemm_strassen_tune
+#undef generate_data
+#undef GEMM_DTYPE
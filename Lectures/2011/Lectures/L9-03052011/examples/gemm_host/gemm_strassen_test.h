@@ -0,0 +1,125 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Test of Strassen GEMM: the result is checked against the reference
+ * host BLAS, and the classical host GEMM is measured and checked on the
+ * same data, so the error norms of both may be compared. The tolerance
+ * is relaxed for each recursion level, as Strassen error bound grows
+ * with the number of levels.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define blas_gemm sgemm_
+#define gemm_host sgemm_host
+#define gemm_strassen sgemm_strassen
+#define gemm_strassen_workspace sgemm_strassen_workspace
+#define gemm_strassen_test sgemm_strassen_test
+#define generate_data sgenerate_data
+#define check_result scheck_result
+#define check_result_eps scheck_result_eps
+#define tolerance stolerance
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define blas_gemm dgemm_
+#define gemm_host dgemm_host
+#define gemm_strassen dgemm_strassen
+#define gemm_strassen_workspace dgemm_strassen_workspace
+#define gemm_strassen_test dgemm_strassen_test
+#define generate_data dgenerate_data
+#define check_result dcheck_result
+#define check_result_eps dcheck_result_eps
+#define tolerance dtolerance
+#endif
+
+int gemm_strassen_test(char transa, char transb, real alpha, real beta,
+	int m, int n, int k, int lda, int ldb, int ldc)
+{
+	int ta = (transa != 'n') && (transa != 'N');
+	int tb = (transb != 'n') && (transb != 'N');
+	int rows_a = ta ? k : m, cols_a = ta ? m : k;
+	int rows_b = tb ? n : k, cols_b = tb ? k : n;
+	if (!lda) lda = rows_a;
+	if (!ldb) ldb = rows_b;
+	if (!ldc) ldc = m;
+	assert((lda >= rows_a) && (ldb >= rows_b) && (ldc >= m));
+
+	real* A = (real*)malloc((size_t)lda * cols_a * sizeof(real)); assert(A);
+	real* B = (real*)malloc((size_t)ldb * cols_b * sizeof(real)); assert(B);
+	real* C = (real*)malloc((size_t)ldc * n * sizeof(real)); assert(C);
+	real* C0 = (real*)malloc((size_t)ldc * n * sizeof(real)); assert(C0);
+	real* C_ref = (real*)malloc((size_t)ldc * n * sizeof(real)); assert(C_ref);
+
+	// Workspace arena is allocated once, out of timing.
+	real* W = (real*)malloc(gemm_strassen_workspace(m, n, k, 0) * sizeof(real));
+	assert(W);
+
+	generate_data(rows_a, cols_a, lda, A);
+	generate_data(rows_b, cols_b, ldb, B);
+	generate_data(m, n, ldc, C0);
+	memcpy(C, C0, (size_t)ldc * n * sizeof(real));
+	memcpy(C_ref, C0, (size_t)ldc * n * sizeof(real));
+
+	blas_gemm(&transa, &transb, &m, &n, &k,
+		&alpha, A, &lda, B, &ldb, &beta, C_ref, &ldc);
+
+	printf("%d\t%d\t%d\t", m, n, k); fflush(stdout);
+
+	double start = omp_get_wtime();
+
+	int levels = gemm_strassen(transa, transb, m, n, k,
+		alpha, A, lda, B, ldb, beta, C, ldc, W, 0);
+
+	double time = omp_get_wtime() - start;
+	printf("str%d\t%f sec\t%f\t", levels, time,
+		2.0e-9 * m * n * k / time); fflush(stdout);
+
+	real eps = tolerance;
+	for (int i = 0; i < levels; i++)
+		eps *= 4;
+	int status = check_result_eps(m, n, C, ldc, C_ref, ldc, eps);
+
+	// Classical GEMM on the same data.
+	memcpy(C, C0, (size_t)ldc * n * sizeof(real));
+	printf("%d\t%d\t%d\t", m, n, k); fflush(stdout);
+
+	start = omp_get_wtime();
+
+	gemm_host(transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+
+	time = omp_get_wtime() - start;
+	printf("gemm\t%f sec\t%f\t", time, 2.0e-9 * m * n * k / time); fflush(stdout);
+
+	status |= check_result(m, n, C, ldc, C_ref, ldc);
+
+	free(A);
+	free(B);
+	free(C);
+	free(C0);
+	free(C_ref);
+	free(W);
+
+	return status;
+}
+
+#undef real
+#undef blas_gemm
+#undef gemm_host
+#undef gemm_strassen
+#undef gemm_strassen_workspace
+#undef gemm_strassen_test
+#undef generate_data
+#undef check_result
+#undef check_result_eps
+#undef tolerance
@@ -0,0 +1,307 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Level 3 routines on top of the host GEMM: triangular solve (trsm)
+ * and symmetric rank-k update (syrk). Both are recursive: the problem
+ * is halved until it fits the block of GEMM_L3_NB, and the coupling
+ * between halves is the large GEMM, which takes most of the flops and
+ * is threaded by gemm_host. Small diagonal blocks are handled by the
+ * substitution kernels, threaded over the independent dimension.
+ * Must be included after gemm_host.h for the same precision.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define gemm_host sgemm_host
+#define trsm_host strsm_host
+#define trsm_rec strsm_rec
+#define trsm_left_kernel strsm_left_kernel
+#define trsm_right_kernel strsm_right_kernel
+#define syrk_host ssyrk_host
+#define syrk_rec ssyrk_rec
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define gemm_host dgemm_host
+#define trsm_host dtrsm_host
+#define trsm_rec dtrsm_rec
+#define trsm_left_kernel dtrsm_left_kernel
+#define trsm_right_kernel dtrsm_right_kernel
+#define syrk_host dsyrk_host
+#define syrk_rec dsyrk_rec
+#endif
+
+// The size of diagonal block, processed without recursion.
+#ifndef GEMM_L3_NB
+#define GEMM_L3_NB 64
+#endif
+
+// The number of right hand sides, solved together by the left kernel.
+#ifndef GEMM_L3_NRHS
+#define GEMM_L3_NRHS 64
+#endif
+
+// Solve op(A) * X = B for m x n X, where A is m x m triangular.
+// X overwrites B. Chunks of columns are solved in parallel: each one
+// is transposed into the scratch, so that substitution is done by
+// the contiguous rows of X in every variant.
+static void trsm_left_kernel(int lower, int notrans, int unit,
+	int m, int n, const real* A, int lda, real* B, int ldb)
+{
+	// Transposed A is copied as op(A), so that substitution
+	// reads contiguous columns of op(A) in every variant.
+	real At[GEMM_L3_NB * GEMM_L3_NB];
+	if (!notrans)
+	{
+		for (int l = 0; l < m; l++)
+			for (int i = 0; i < m; i++)
+				At[i + l * m] = A[l + (size_t)i * lda];
+		A = At;
+		lda = m;
+		lower = !lower;
+		notrans = 1;
+	}
+
+	// Rows of X go forward, if op(A) is lower triangular.
+	int forward = lower == notrans;
+
+	#pragma omp parallel if ((size_t)m * m * n > (1 << 16))
+	{
+		real T[GEMM_L3_NB][GEMM_L3_NRHS];
+
+		#pragma omp for
+		for (int j0 = 0; j0 < n; j0 += GEMM_L3_NRHS)
+		{
+			int nj = n - j0 < GEMM_L3_NRHS ? n - j0 : GEMM_L3_NRHS;
+			real* b = B + (size_t)j0 * ldb;
+			for (int j = 0; j < nj; j++)
+				for (int i = 0; i < m; i++)
+					T[i][j] = b[i + (size_t)j * ldb];
+
+			for (int ii = 0; ii < m; ii++)
+			{
+				int i = forward ? ii : m - 1 - ii;
+				if (!unit)
+				{
+					real r = 1 / A[i + (size_t)i * lda];
+					for (int j = 0; j < nj; j++)
+						T[i][j] *= r;
+				}
+				int l0 = forward ? i + 1 : 0, l1 = forward ? m : i;
+				for (int l = l0; l < l1; l++)
+				{
+					// op(A)[l, i]
+					real a = notrans ? A[l + (size_t)i * lda] : A[i + (size_t)l * lda];
+					for (int j = 0; j < nj; j++)
+						T[l][j] -= a * T[i][j];
+				}
+			}
+
+			for (int j = 0; j < nj; j++)
+				for (int i = 0; i < m; i++)
+					b[i + (size_t)j * ldb] = T[i][j];
+		}
+	}
+}
+
+// Solve X * op(A) = B for m x n X, where A is n x n triangular.
+// X overwrites B, chunks of rows are solved in parallel.
+static void trsm_right_kernel(int lower, int notrans, int unit,
+	int m, int n, const real* A, int lda, real* B, int ldb)
+{
+	// Columns of X go forward, if op(A) is upper triangular.
+	int forward = lower != notrans;
+
+	#pragma omp parallel if ((size_t)m * n * n > (1 << 16))
+	{
+		int nthreads = omp_get_num_threads(), ithread = omp_get_thread_num();
+		int i0 = (int)((size_t)m * ithread / nthreads);
+		int i1 = (int)((size_t)m * (ithread + 1) / nthreads);
+		for (int kk = 0; kk < n; kk++)
+		{
+			int k = forward ? kk : n - 1 - kk;
+			real* bk = B + (size_t)k * ldb;
+			int p0 = forward ? 0 : k + 1, p1 = forward ? k : n;
+			for (int p = p0; p < p1; p++)
+			{
+				// op(A)[p, k]
+				real a = notrans ? A[p + (size_t)k * lda] : A[k + (size_t)p * lda];
+				const real* bp = B + (size_t)p * ldb;
+				for (int i = i0; i < i1; i++)
+					bk[i] -= bp[i] * a;
+			}
+			if (!unit)
+			{
+				real d = A[k + (size_t)k * lda];
+				for (int i = i0; i < i1; i++)
+					bk[i] /= d;
+			}
+		}
+	}
+}
+
+// Solve recursively by halving the triangle: the first half of unknowns
+// is solved, then eliminated from the rest by GEMM, then the second half
+// is solved. Which half goes first depends on the shape of op(A).
+static void trsm_rec(int left, int lower, int notrans, int unit,
+	int m, int n, const real* A, int lda, real* B, int ldb)
+{
+	int na = left ? m : n;
+	if (na <= GEMM_L3_NB)
+	{
+		if (left)
+			trsm_left_kernel(lower, notrans, unit, m, n, A, lda, B, ldb);
+		else
+			trsm_right_kernel(lower, notrans, unit, m, n, A, lda, B, ldb);
+		return;
+	}
+
+	// Split at the multiple of block size.
+	int n1 = (na / 2 + GEMM_L3_NB - 1) / GEMM_L3_NB * GEMM_L3_NB, n2 = na - n1;
+	const real* A11 = A;
+	const real* A21 = A + n1;
+	const real* A12 = A + (size_t)n1 * lda;
+	const real* A22 = A12 + n1;
+	char ta = notrans ? 'N' : 'T';
+
+	if (left)
+	{
+		real* B1 = B;
+		real* B2 = B + n1;
+
+		// op(A) is lower: X1 = op(A11) \ B1, B2 -= op(A)21 * X1, X2 = op(A22) \ B2.
+		if (lower == notrans)
+		{
+			trsm_rec(1, lower, notrans, unit, n1, n, A11, lda, B1, ldb);
+			gemm_host(ta, 'N', n2, n, n1, -1, notrans ? A21 : A12, lda,
+				B1, ldb, 1, B2, ldb);
+			trsm_rec(1, lower, notrans, unit, n2, n, A22, lda, B2, ldb);
+		}
+		// op(A) is upper: X2 = op(A22) \ B2, B1 -= op(A)12 * X2, X1 = op(A11) \ B1.
+		else
+		{
+			trsm_rec(1, lower, notrans, unit, n2, n, A22, lda, B2, ldb);
+			gemm_host(ta, 'N', n1, n, n2, -1, notrans ? A12 : A21, lda,
+				B2, ldb, 1, B1, ldb);
+			trsm_rec(1, lower, notrans, unit, n1, n, A11, lda, B1, ldb);
+		}
+	}
+	else
+	{
+		real* B1 = B;
+		real* B2 = B + (size_t)n1 * ldb;
+
+		// op(A) is upper: X1 = B1 / op(A11), B2 -= X1 * op(A)12, X2 = B2 / op(A22).
+		if (lower != notrans)
+		{
+			trsm_rec(0, lower, notrans, unit, m, n1, A11, lda, B1, ldb);
+			gemm_host('N', ta, m, n2, n1, -1, B1, ldb,
+				notrans ? A12 : A21, lda, 1, B2, ldb);
+			trsm_rec(0, lower, notrans, unit, m, n2, A22, lda, B2, ldb);
+		}
+		// op(A) is lower: X2 = B2 / op(A22), B1 -= X2 * op(A)21, X1 = B1 / op(A11).
+		else
+		{
+			trsm_rec(0, lower, notrans, unit, m, n2, A22, lda, B2, ldb);
+			gemm_host('N', ta, m, n1, n2, -1, B2, ldb,
+				notrans ? A21 : A12, lda, 1, B1, ldb);
+			trsm_rec(0, lower, notrans, unit, m, n1, A11, lda, B1, ldb);
+		}
+	}
+}
+
+// Solve op(A) * X = alpha * B (side 'L') or X * op(A) = alpha * B
+// (side 'R') for m x n X, where A is triangular (uplo 'L' or 'U'),
+// op is given by trans ('N', 'T' or 'C'), and diag is 'U', if A
+// has the unit diagonal. X overwrites B.
+void trsm_host(char side, char uplo, char trans, char diag,
+	int m, int n, real alpha, const real* A, int lda, real* B, int ldb)
+{
+	if (!m || !n) return;
+
+	if (alpha != 1)
+	{
+		#pragma omp parallel for
+		for (int j = 0; j < n; j++)
+			for (int i = 0; i < m; i++)
+				B[i + (size_t)j * ldb] *= alpha;
+	}
+
+	trsm_rec((side == 'l') || (side == 'L'), (uplo == 'l') || (uplo == 'L'),
+		(trans == 'n') || (trans == 'N'), (diag == 'u') || (diag == 'U'),
+		m, n, A, lda, B, ldb);
+}
+
+// Update the triangle of C recursively: both diagonal halves are
+// updated by recursion, the off-diagonal block is the plain GEMM.
+// Diagonal blocks are computed by GEMM into scratch W and added
+// to the referenced triangle only.
+static void syrk_rec(int lower, int notrans, int n, int k,
+	real alpha, const real* A, int lda, real beta, real* C, int ldc, real* W)
+{
+	char ta = notrans ? 'N' : 'T', tb = notrans ? 'T' : 'N';
+	if (n <= GEMM_L3_NB)
+	{
+		gemm_host(ta, tb, n, n, k, alpha, A, lda, A, lda, 0, W, n);
+		for (int j = 0; j < n; j++)
+		{
+			int i0 = lower ? j : 0, i1 = lower ? n : j + 1;
+			real* c = C + (size_t)j * ldc;
+			const real* w = W + (size_t)j * n;
+			for (int i = i0; i < i1; i++)
+				c[i] = (beta == 0) ? w[i] : w[i] + beta * c[i];
+		}
+		return;
+	}
+
+	int n1 = (n / 2 + GEMM_L3_NB - 1) / GEMM_L3_NB * GEMM_L3_NB, n2 = n - n1;
+
+	// Rows of op(A) for the second half.
+	const real* A2 = notrans ? A + n1 : A + (size_t)n1 * lda;
+
+	syrk_rec(lower, notrans, n1, k, alpha, A, lda, beta, C, ldc, W);
+	if (lower)
+		gemm_host(ta, tb, n2, n1, k, alpha, A2, lda, A, lda,
+			beta, C + n1, ldc);
+	else
+		gemm_host(ta, tb, n1, n2, k, alpha, A, lda, A2, lda,
+			beta, C + (size_t)n1 * ldc, ldc);
+	syrk_rec(lower, notrans, n2, k, alpha, A2, lda, beta,
+		C + n1 + (size_t)n1 * ldc, ldc, W);
+}
+
+// Compute C = alpha * op(A) * op(A)^T + beta * C, where op(A) is n x k
+// (A for trans 'N', A^T for trans 'T' or 'C'), updating only the uplo
+// triangle of n x n C.
+void syrk_host(char uplo, char trans, int n, int k,
+	real alpha, const real* A, int lda, real beta, real* C, int ldc)
+{
+	if (!n) return;
+
+	real* W = (real*)malloc((size_t)GEMM_L3_NB * GEMM_L3_NB * sizeof(real));
+	assert(W);
+
+	syrk_rec((uplo == 'l') || (uplo == 'L'), (trans == 'n') || (trans == 'N'),
+		n, k, alpha, A, lda, beta, C, ldc, W);
+
+	free(W);
+}
+
+#undef real
+#undef gemm_host
+#undef trsm_host
+#undef trsm_rec
+#undef trsm_left_kernel
+#undef trsm_right_kernel
+#undef syrk_host
+#undef syrk_rec
@@ -0,0 +1,151 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Test of level 3 routines on top of the host GEMM: every variant
+ * of trsm and syrk is checked against the reference host BLAS.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define blas_trsm strsm_
+#define blas_syrk ssyrk_
+#define trsm_host strsm_host
+#define syrk_host ssyrk_host
+#define trsm_host_test strsm_host_test
+#define syrk_host_test ssyrk_host_test
+#define generate_data sgenerate_data
+#define check_result scheck_result
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define blas_trsm dtrsm_
+#define blas_syrk dsyrk_
+#define trsm_host dtrsm_host
+#define syrk_host dsyrk_host
+#define trsm_host_test dtrsm_host_test
+#define syrk_host_test dsyrk_host_test
+#define generate_data dgenerate_data
+#define check_result dcheck_result
+#endif
+
+void blas_trsm(char* side, char* uplo, char* transa, char* diag,
+	int* m, int* n, real* alpha, real* A, int* lda, real* B, int* ldb);
+void blas_syrk(char* uplo, char* trans, int* n, int* k,
+	real* alpha, real* A, int* lda, real* beta, real* C, int* ldc);
+
+// Solve with all combinations of side, uplo, trans and diag,
+// for the well-conditioned triangle with small off-diagonal elements.
+int trsm_host_test(real alpha, int m, int n, int lda, int ldb)
+{
+	const char sides[] = "LR", uplos[] = "LU", transs[] = "NT", diags[] = "NU";
+	int status = EXIT_SUCCESS;
+	for (int iside = 0; iside < 2; iside++)
+	for (int iuplo = 0; iuplo < 2; iuplo++)
+	for (int itrans = 0; itrans < 2; itrans++)
+	for (int idiag = 0; idiag < 2; idiag++)
+	{
+		char side = sides[iside], uplo = uplos[iuplo];
+		char trans = transs[itrans], diag = diags[idiag];
+		int na = (side == 'L') ? m : n;
+		int ldA = lda ? lda : na, ldB = ldb ? ldb : m;
+		assert((ldA >= na) && (ldB >= m));
+
+		real* A = (real*)malloc((size_t)ldA * na * sizeof(real)); assert(A);
+		real* B = (real*)malloc((size_t)ldB * n * sizeof(real)); assert(B);
+		real* B_ref = (real*)malloc((size_t)ldB * n * sizeof(real)); assert(B_ref);
+
+		generate_data(na, na, ldA, A);
+		for (int j = 0; j < na; j++)
+			for (int i = 0; i < na; i++)
+				A[i + (size_t)j * ldA] = (i == j) ? 1 + A[i + (size_t)j * ldA] :
+					A[i + (size_t)j * ldA] / na;
+		generate_data(m, n, ldB, B);
+		memcpy(B_ref, B, (size_t)ldB * n * sizeof(real));
+
+		printf("%d\t%d\t%d\t%c%c%c%c\t", m, n, na, side, uplo, trans, diag);
+		fflush(stdout);
+
+		double start = omp_get_wtime();
+
+		trsm_host(side, uplo, trans, diag, m, n, alpha, A, ldA, B, ldB);
+
+		double time = omp_get_wtime() - start;
+		printf("%f sec\t%f\t", time, 1.0e-9 * m * n * na / time); fflush(stdout);
+
+		blas_trsm(&side, &uplo, &trans, &diag, &m, &n,
+			&alpha, A, &ldA, B_ref, &ldB);
+
+		status |= check_result(m, n, B, ldB, B_ref, ldB);
+
+		free(A);
+		free(B);
+		free(B_ref);
+	}
+
+	return status;
+}
+
+// Update both triangles, for the given trans.
+int syrk_host_test(char trans, real alpha, real beta, int n, int k, int lda, int ldc)
+{
+	int notrans = (trans == 'n') || (trans == 'N');
+	int rows_a = notrans ? n : k, cols_a = notrans ? k : n;
+	if (!lda) lda = rows_a;
+	if (!ldc) ldc = n;
+	assert((lda >= rows_a) && (ldc >= n));
+
+	real* A = (real*)malloc((size_t)lda * cols_a * sizeof(real)); assert(A);
+	real* C = (real*)malloc((size_t)ldc * n * sizeof(real)); assert(C);
+	real* C_ref = (real*)malloc((size_t)ldc * n * sizeof(real)); assert(C_ref);
+
+	int status = EXIT_SUCCESS;
+	const char uplos[] = "LU";
+	for (int iuplo = 0; iuplo < 2; iuplo++)
+	{
+		char uplo = uplos[iuplo];
+
+		generate_data(rows_a, cols_a, lda, A);
+		generate_data(n, n, ldc, C);
+		memcpy(C_ref, C, (size_t)ldc * n * sizeof(real));
+
+		printf("%d\t%d\t%d\tsyrk%c%c\t", n, n, k, uplo, trans); fflush(stdout);
+
+		double start = omp_get_wtime();
+
+		syrk_host(uplo, trans, n, k, alpha, A, lda, beta, C, ldc);
+
+		double time = omp_get_wtime() - start;
+		printf("%f sec\t%f\t", time, 1.0e-9 * n * n * k / time); fflush(stdout);
+
+		blas_syrk(&uplo, &trans, &n, &k, &alpha, A, &lda, &beta, C_ref, &ldc);
+
+		// The other triangle must be left intact, so whole C is compared.
+		status |= check_result(n, n, C, ldc, C_ref, ldc);
+	}
+
+	free(A);
+	free(C);
+	free(C_ref);
+
+	return status;
+}
+
+#undef real
+#undef blas_trsm
+#undef blas_syrk
+#undef trsm_host
+#undef syrk_host
+#undef trsm_host_test
+#undef syrk_host_test
+#undef generate_data
+#undef check_result
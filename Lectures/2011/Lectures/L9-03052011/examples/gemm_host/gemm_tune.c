@@ -0,0 +1,265 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ */
+
+#include "gemm_tune.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The maximum length of line in the file with tuned parameters.
+#define GEMM_TUNE_LINE 1024
+
+// The separator of fields in line: CPU model may contain spaces.
+#define GEMM_TUNE_SEP '|'
+
+const char* gemm_tune_cpu(void)
+{
+	static char model[256] = "";
+	if (model[0]) return model;
+
+	strcpy(model, "unknown");
+	FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
+	if (!cpuinfo) return model;
+
+	char line[GEMM_TUNE_LINE];
+	while (fgets(line, sizeof(line), cpuinfo))
+	{
+		if (strncmp(line, "model name", 10)) continue;
+		const char* value = strchr(line, ':');
+		if (!value) break;
+		for (value++; *value == ' '; value++);
+
+		// Keep the name without line end and the separator.
+		size_t length = strcspn(value, "\n|");
+		if (length >= sizeof(model)) length = sizeof(model) - 1;
+		if (!length) break;
+		memcpy(model, value, length);
+		model[length] = '\0';
+		break;
+	}
+	fclose(cpuinfo);
+	return model;
+}
+
+const char* gemm_tune_file(void)
+{
+	static char path[1024] = "";
+	if (path[0]) return path;
+
+	const char* file = getenv("GEMM_TUNE_FILE");
+	if (file && file[0])
+		snprintf(path, sizeof(path), "%s", file);
+	else
+	{
+		const char* home = getenv("HOME");
+		snprintf(path, sizeof(path), "%s/%s", home ? home : ".",
+			GEMM_TUNE_FILE_DEFAULT);
+	}
+	return path;
+}
+
+// Parse the line "cpu|dtype|mc kc nc mv nr|size:nstreams ...|crossover",
+// the last field is optional. Returns 0, if it is not for the current
+// CPU and the data type.
+static int gemm_tune_parse(const char* line, char dtype, gemm_tune_t* tune)
+{
+	const char* cpu = gemm_tune_cpu();
+	size_t length = strlen(cpu);
+	if (strncmp(line, cpu, length) || (line[length] != GEMM_TUNE_SEP))
+		return 0;
+	line += length + 1;
+	if ((line[0] != dtype) || (line[1] != GEMM_TUNE_SEP))
+		return 0;
+	line += 2;
+
+	memset(tune, 0, sizeof(gemm_tune_t));
+	tune->dtype = dtype;
+	gemm_blocking_t* b = &tune->blocking;
+	if ((sscanf(line, "%d %d %d %d %d", &b->mc, &b->kc, &b->nc, &b->mv, &b->nr) != 5) ||
+		(b->mc <= 0) || (b->kc <= 0) || (b->nc <= 0) || (b->mv <= 0) || (b->nr <= 0))
+		memset(b, 0, sizeof(gemm_blocking_t));
+
+	line = strchr(line, GEMM_TUNE_SEP);
+	if (!line) return 1;
+	for (line++; tune->nsizes < GEMM_TUNE_MAX_SIZES; )
+	{
+		int size, nstreams, nchars;
+		if (sscanf(line, "%d:%d%n", &size, &nstreams, &nchars) != 2) break;
+		line += nchars;
+
+		// Skip broken pairs, keeping the rest.
+		if ((size <= 0) || (nstreams < 1)) continue;
+		tune->size[tune->nsizes] = size;
+		tune->nstreams[tune->nsizes] = nstreams;
+		tune->nsizes++;
+	}
+
+	line = strchr(line, GEMM_TUNE_SEP);
+	if (line && ((sscanf(line + 1, "%d", &tune->crossover) != 1) ||
+		(tune->crossover <= 0)))
+		tune->crossover = 0;
+	return 1;
+}
+
+int gemm_tune_load(char dtype, gemm_tune_t* tune)
+{
+	memset(tune, 0, sizeof(gemm_tune_t));
+	tune->dtype = dtype;
+
+	FILE* file = fopen(gemm_tune_file(), "r");
+	if (!file) return 0;
+
+	int found = 0;
+	char line[GEMM_TUNE_LINE];
+	while (!found && fgets(line, sizeof(line), file))
+		found = gemm_tune_parse(line, dtype, tune);
+	fclose(file);
+	return found;
+}
+
+int gemm_tune_save(const gemm_tune_t* tune)
+{
+	// Keep lines of other CPUs and data types.
+	char* kept = NULL;
+	size_t size = 0;
+	FILE* file = fopen(gemm_tune_file(), "r");
+	if (file)
+	{
+		char line[GEMM_TUNE_LINE];
+		gemm_tune_t other;
+		while (fgets(line, sizeof(line), file))
+		{
+			if (gemm_tune_parse(line, tune->dtype, &other)) continue;
+			size_t length = strlen(line);
+			kept = (char*)realloc(kept, size + length + 1); assert(kept);
+			memcpy(kept + size, line, length + 1);
+			size += length;
+		}
+		fclose(file);
+	}
+
+	file = fopen(gemm_tune_file(), "w");
+	if (!file)
+	{
+		fprintf(stderr, "Cannot write tuned parameters to %s\n", gemm_tune_file());
+		if (kept) free(kept);
+		return -1;
+	}
+	if (kept)
+	{
+		fputs(kept, file);
+		free(kept);
+	}
+
+	const gemm_blocking_t* b = &tune->blocking;
+	fprintf(file, "%s%c%c%c%d %d %d %d %d%c", gemm_tune_cpu(), GEMM_TUNE_SEP,
+		tune->dtype, GEMM_TUNE_SEP, b->mc, b->kc, b->nc, b->mv, b->nr, GEMM_TUNE_SEP);
+	for (int i = 0; i < tune->nsizes; i++)
+		fprintf(file, "%s%d:%d", i ? " " : "", tune->size[i], tune->nstreams[i]);
+	if (tune->crossover)
+		fprintf(file, "%c%d", GEMM_TUNE_SEP, tune->crossover);
+	fprintf(file, "\n");
+	fclose(file);
+	return 0;
+}
+
+// Blockings of host data types: s and d.
+static gemm_blocking_t gemm_tune_blockings[2];
+static int gemm_tune_loaded[2];
+
+const gemm_blocking_t* gemm_tune_blocking(char dtype, const gemm_blocking_t* defaults,
+	const int (*tiles)[2], int ntiles)
+{
+	assert((dtype == 's') || (dtype == 'd'));
+	int i = (dtype == 'd');
+
+	// GEMM may be called from several threads at once.
+	#pragma omp critical (gemm_tune)
+	if (!gemm_tune_loaded[i])
+	{
+		gemm_tune_t tune;
+		int valid = gemm_tune_load(dtype, &tune) && tune.blocking.mc;
+
+		// The micro-tile must be one of compiled in this binary.
+		int tile = 0;
+		while (valid && (tile < ntiles) && ((tiles[tile][0] != tune.blocking.mv) ||
+			(tiles[tile][1] != tune.blocking.nr))) tile++;
+		if (valid && (tile == ntiles))
+		{
+			fprintf(stderr, "Ignoring tuned blocking with unsupported %dx%d micro-tile in %s\n",
+				tune.blocking.mv, tune.blocking.nr, gemm_tune_file());
+			valid = 0;
+		}
+
+		if (valid)
+			gemm_tune_blockings[i] = tune.blocking;
+		else
+			gemm_tune_blockings[i] = *defaults;
+		gemm_tune_loaded[i] = 1;
+	}
+	return &gemm_tune_blockings[i];
+}
+
+void gemm_tune_set_blocking(char dtype, const gemm_blocking_t* blocking)
+{
+	assert((dtype == 's') || (dtype == 'd'));
+	int i = (dtype == 'd');
+	gemm_tune_blockings[i] = *blocking;
+	gemm_tune_loaded[i] = 1;
+}
+
+void gemm_tune_add_streams(gemm_tune_t* tune, int m, int n, int k, int nstreams)
+{
+	int size = (int)(cbrt((double)m * n * k) + 0.5);
+
+	// Replace the same size, or insert in order.
+	int i = 0;
+	while ((i < tune->nsizes) && (tune->size[i] < size)) i++;
+	if ((i == tune->nsizes) || (tune->size[i] != size))
+	{
+		if (tune->nsizes == GEMM_TUNE_MAX_SIZES) return;
+		memmove(&tune->size[i + 1], &tune->size[i], (tune->nsizes - i) * sizeof(int));
+		memmove(&tune->nstreams[i + 1], &tune->nstreams[i], (tune->nsizes - i) * sizeof(int));
+		tune->nsizes++;
+	}
+	tune->size[i] = size;
+	tune->nstreams[i] = nstreams;
+}
+
+int gemm_tune_streams(char dtype, int m, int n, int k)
+{
+	gemm_tune_t tune;
+	if (!gemm_tune_load(dtype, &tune) || !tune.nsizes)
+		return GEMM_TUNE_STREAMS_DEFAULT;
+
+	// The nearest size in log scale.
+	double size = cbrt((double)m * n * k);
+	int best = 0;
+	for (int i = 1; i < tune.nsizes; i++)
+		if (fabs(log(tune.size[i] / size)) < fabs(log(tune.size[best] / size)))
+			best = i;
+	return tune.nstreams[best];
+}
+
+int gemm_tune_crossover(char dtype)
+{
+	gemm_tune_t tune;
+	if (!gemm_tune_load(dtype, &tune) || !tune.crossover)
+		return GEMM_TUNE_CROSSOVER_DEFAULT;
+	if (tune.crossover < GEMM_TUNE_CROSSOVER_MIN)
+		return GEMM_TUNE_CROSSOVER_MIN;
+	return tune.crossover;
+}
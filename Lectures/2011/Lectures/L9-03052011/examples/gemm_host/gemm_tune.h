@@ -0,0 +1,109 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Tuned GEMM parameters: host blocking (cache block sizes and the
+ * micro-tile), the number of streams for the given problem size and
+ * the crossover of Strassen GEMM. Parameters are found by the tune
+ * modes of gemm_host and gemm_streamed samples, and kept in the text
+ * file, one line per CPU model and data type (BLAS letter s, d, c or z).
+ * GEMM entry points load them on the first call, falling back to
+ * compiled-in defaults.
+ */
+
+#ifndef GEMM_TUNE_H
+#define GEMM_TUNE_H
+
+// The file with tuned parameters, if GEMM_TUNE_FILE
+// environment variable is not set. Relative to $HOME.
+#define GEMM_TUNE_FILE_DEFAULT ".gemm_tune"
+
+// The maximum number of problem sizes with tuned stream count.
+#define GEMM_TUNE_MAX_SIZES 16
+
+// The number of streams used for untuned sizes.
+#define GEMM_TUNE_STREAMS_DEFAULT 16
+
+// The Strassen GEMM crossover used until tuned.
+#define GEMM_TUNE_CROSSOVER_DEFAULT 2048
+
+// The smallest Strassen GEMM crossover: below it the recursion
+// would only add overhead (and would not end for zero).
+#define GEMM_TUNE_CROSSOVER_MIN 64
+
+// The host GEMM blocking: the block of op(A) is mc x kc, the block
+// of op(B) is kc x nc, and the micro-tile is mv vectors high and
+// nr columns wide.
+typedef struct
+{
+	int mc, kc, nc;
+	int mv, nr;
+}
+gemm_blocking_t;
+
+// Tuned parameters of one data type.
+typedef struct
+{
+	char dtype;
+
+	// Host blocking, valid if mc is not zero. Blocks with
+	// non-positive sizes are dropped on load.
+	gemm_blocking_t blocking;
+
+	// The best number of streams for cube roots of m * n * k,
+	// in increasing order.
+	int nsizes;
+	int size[GEMM_TUNE_MAX_SIZES];
+	int nstreams[GEMM_TUNE_MAX_SIZES];
+
+	// Strassen GEMM recurses while all dimensions are
+	// above the crossover, valid if not zero.
+	int crossover;
+}
+gemm_tune_t;
+
+// Get the CPU model name, which is the key of tuned parameters.
+const char* gemm_tune_cpu(void);
+
+// Get the path to the file with tuned parameters.
+const char* gemm_tune_file(void);
+
+// Load tuned parameters of data type for the current CPU.
+// Returns 0, if there are none (tune is then empty).
+int gemm_tune_load(char dtype, gemm_tune_t* tune);
+
+// Save tuned parameters for the current CPU, replacing
+// the previous ones of the same data type. Returns 0 on success.
+int gemm_tune_save(const gemm_tune_t* tune);
+
+// Get the host blocking of data type: tuned one, if there is and its
+// micro-tile is among ntiles (mv, nr) pairs of tiles, otherwise the
+// given defaults. Loaded once, further calls return the same (possibly
+// modified with gemm_tune_set_blocking) blocking.
+const gemm_blocking_t* gemm_tune_blocking(char dtype, const gemm_blocking_t* defaults,
+	const int (*tiles)[2], int ntiles);
+
+// Replace the host blocking of data type for the further
+// GEMM calls (not saved to file).
+void gemm_tune_set_blocking(char dtype, const gemm_blocking_t* blocking);
+
+// Record the best number of streams for m x n x k problem.
+void gemm_tune_add_streams(gemm_tune_t* tune, int m, int n, int k, int nstreams);
+
+// Get the number of streams for m x n x k problem of data type:
+// tuned for the nearest size, or the default one.
+int gemm_tune_streams(char dtype, int m, int n, int k);
+
+// Get the Strassen GEMM crossover of data type: tuned one,
+// or the default, not less than GEMM_TUNE_CROSSOVER_MIN.
+int gemm_tune_crossover(char dtype);
+
+#endif // GEMM_TUNE_H
@@ -14,6 +14,8 @@
  */
 
 #include <assert.h>
+#include <float.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,6 +23,12 @@
 #include <cublas.h>
 #include <cuda_runtime.h>
 
+#include "gemm_partition.h"
+#include "gemm_tune.h"
+
+// The maximum number of streams tried by the tune mode.
+#define GEMM_TUNE_MAX_STREAMS 32
+
 #define CUBLAS_ERR_CHECK(message) \
 if (cublasGetError() != CUBLAS_STATUS_SUCCESS) \
 { \
@@ -42,64 +50,173 @@ if (cublasGetError() != CUBLAS_STATUS_SUCCESS) \
 }
 
 #define HAVE_SINGLE
+#include "gemm_check.h"
 #include "gemm_streamed.h"
 #undef HAVE_SINGLE
 
 #define HAVE_DOUBLE
+#include "gemm_check.h"
 #include "gemm_streamed.h"
 #undef HAVE_DOUBLE
 
+// Complex instances reuse real data generation and check.
+void cgemm_(char* transa, char* transb, int* m, int* n, int* k,
+	cuComplex* alpha, cuComplex* A, int* lda, cuComplex* B, int* ldb,
+	cuComplex* beta, cuComplex* C, int* ldc);
+void zgemm_(char* transa, char* transb, int* m, int* n, int* k,
+	cuDoubleComplex* alpha, cuDoubleComplex* A, int* lda,
+	cuDoubleComplex* B, int* ldb, cuDoubleComplex* beta,
+	cuDoubleComplex* C, int* ldc);
+
+#define HAVE_SINGLE_COMPLEX
+#include "gemm_streamed.h"
+#undef HAVE_SINGLE_COMPLEX
+
+#define HAVE_DOUBLE_COMPLEX
+#include "gemm_streamed.h"
+#undef HAVE_DOUBLE_COMPLEX
+
 int main(int argc, char* argv[])
 {
-	if (argc != 10)
+	if ((argc != 10) && (argc != 13))
 	{
 		printf("Usage: %s <precision> %s %s\n", argv[0],
 			"<n_min> <n_max> <n_step> <transa> <transb>",
 			"<alpha> <beta> <n_streams>");
+		printf("       %s <precision> %s %s\n", argv[0],
+			"<m> <n> <k> <lda> <ldb> <ldc> <transa> <transb>",
+			"<alpha> <beta> <n_streams>");
+		printf("where precision is s (or 4), d (or 8), c or z, %s\n",
+			"and complex alpha and beta are given as re,im");
+		printf("n_streams 0 uses the tuned count for the size, %s\n",
+			"tune finds the best counts and saves them");
 		return 0;
 	}
 
-	int precision = atoi(argv[1]);
-	assert((precision == 4) || (precision == 8));
+	// Precision is BLAS letter, or the size of real type.
+	char precision = argv[1][0];
+	if (precision == '4') precision = 's';
+	if (precision == '8') precision = 'd';
+	assert((precision == 's') || (precision == 'd') ||
+		(precision == 'c') || (precision == 'z'));
+	int is_complex = (precision == 'c') || (precision == 'z');
+
+	// Either sweep square sizes, or run single rectangular
+	// shape. Zero leading dimensions mean tight storage.
+	int m = 0, k = 0, lda = 0, ldb = 0, ldc = 0;
+	int n_min, n_max, n_step = 1, iarg = 5;
+	if (argc == 10)
+	{
+		n_min = atoi(argv[2]); assert(n_min > 0);
+		n_max = atoi(argv[3]);
+		n_step = atoi(argv[4]); assert(n_step > 0);
+	}
+	else
+	{
+		m = atoi(argv[2]); assert(m > 0);
+		n_min = atoi(argv[3]); assert(n_min > 0);
+		n_max = n_min + 1;
+		k = atoi(argv[4]); assert(k > 0);
+		lda = atoi(argv[5]); ldb = atoi(argv[6]); ldc = atoi(argv[7]);
+		iarg = 8;
+	}
 
-	int n_min = atoi(argv[2]); assert(n_min > 0);
-	int n_max = atoi(argv[3]);
-	int n_step = atoi(argv[4]); assert(n_step > 0);
-	
-	char transa = argv[5][0];
+	char transa = argv[iarg][0];
 	assert((transa == 'n') || (transa == 'N') ||
-		(transa == 't') || (transa == 'T'));
-	char transb = argv[6][0];
+		(transa == 't') || (transa == 'T') ||
+		(transa == 'c') || (transa == 'C'));
+	char transb = argv[iarg + 1][0];
 	assert((transb == 'n') || (transb == 'N') ||
-		(transb == 't') || (transb == 'T'));
-
-	int n_streams = atoi(argv[9]); assert(n_streams > 0);
-
-	printf("n\ttime\t\tgflops\t\ttest\tenorm\t\trnorm\n");
-
-	if (precision == 4)
+		(transb == 't') || (transb == 'T') ||
+		(transb == 'c') || (transb == 'C'));
+
+	// Tune mode measures streamed GEMM with all stream counts
+	// and saves the best ones for the further runs with 0.
+	int tune_streams = !strcmp(argv[iarg + 4], "tune");
+	int n_streams = atoi(argv[iarg + 4]);
+	assert(tune_streams || (n_streams >= 0));
+	gemm_tune_t tune;
+	if (tune_streams)
+		gemm_tune_load(precision, &tune);
+
+	// Complex results also show the error bound of method used.
+	printf("m\tn\tk\tsplit\ttime\t\tgflops\t\t%stest\tenorm\t\trnorm\n",
+		is_complex ? "bound\t\t" : "");
+
+	if (precision == 's')
 	{
-		float alpha = (float)atof(argv[7]);
-		float beta = (float)atof(argv[8]);
+		float alpha = (float)atof(argv[iarg + 2]);
+		float beta = (float)atof(argv[iarg + 3]);
 
 		for (int n = n_min; n < n_max; n += n_step)
 		{
-			sgemm_serial(transa, transb, alpha, beta, n);
-			sgemm_streamed(transa, transb, alpha, beta, n, n_streams);
+			int mm = m ? m : n, kk = k ? k : n;
+			if (tune_streams)
+			{
+				sgemm_streamed_tune(transa, transb, alpha, beta, mm, n, kk, lda, ldb, ldc, &tune);
+				continue;
+			}
+			sgemm_serial(transa, transb, alpha, beta, mm, n, kk, lda, ldb, ldc);
+			sgemm_streamed(transa, transb, alpha, beta, mm, n, kk, lda, ldb, ldc, n_streams, NULL);
 		}
 	}
 	
-	if (precision == 8)
+	if (precision == 'd')
 	{
 
-		double alpha = atof(argv[7]);
-		double beta = atof(argv[8]);
+		double alpha = atof(argv[iarg + 2]);
+		double beta = atof(argv[iarg + 3]);
 
 		for (int n = n_min; n < n_max; n += n_step)
 		{
-			dgemm_serial(transa, transb, alpha, beta, n);
-			dgemm_streamed(transa, transb, alpha, beta, n, n_streams);
+			int mm = m ? m : n, kk = k ? k : n;
+			if (tune_streams)
+			{
+				dgemm_streamed_tune(transa, transb, alpha, beta, mm, n, kk, lda, ldb, ldc, &tune);
+				continue;
+			}
+			dgemm_serial(transa, transb, alpha, beta, mm, n, kk, lda, ldb, ldc);
+			dgemm_streamed(transa, transb, alpha, beta, mm, n, kk, lda, ldb, ldc, n_streams, NULL);
 		}
 	}
-}
 
+	if (is_complex)
+	{
+		// Parse complex alpha and beta.
+		double alpha[2] = { 0, 0 }, beta[2] = { 0, 0 };
+		sscanf(argv[iarg + 2], "%lf,%lf", &alpha[0], &alpha[1]);
+		sscanf(argv[iarg + 3], "%lf,%lf", &beta[0], &beta[1]);
+
+		for (int n = n_min; n < n_max; n += n_step)
+		{
+			int mm = m ? m : n, kk = k ? k : n;
+			if (precision == 'c')
+			{
+				cuComplex a = make_cuComplex(alpha[0], alpha[1]);
+				cuComplex b = make_cuComplex(beta[0], beta[1]);
+				if (tune_streams)
+				{
+					cgemm_streamed_tune(transa, transb, a, b, mm, n, kk, lda, ldb, ldc, &tune);
+					continue;
+				}
+				cgemm_serial(transa, transb, a, b, mm, n, kk, lda, ldb, ldc);
+				cgemm_streamed(transa, transb, a, b, mm, n, kk, lda, ldb, ldc, n_streams, NULL);
+			}
+			else
+			{
+				cuDoubleComplex a = make_cuDoubleComplex(alpha[0], alpha[1]);
+				cuDoubleComplex b = make_cuDoubleComplex(beta[0], beta[1]);
+				if (tune_streams)
+				{
+					zgemm_streamed_tune(transa, transb, a, b, mm, n, kk, lda, ldb, ldc, &tune);
+					continue;
+				}
+				zgemm_serial(transa, transb, a, b, mm, n, kk, lda, ldb, ldc);
+				zgemm_streamed(transa, transb, a, b, mm, n, kk, lda, ldb, ldc, n_streams, NULL);
+			}
+		}
+	}
+
+	if (tune_streams && !gemm_tune_save(&tune))
+		printf("n_streams for %s saved to %s\n", gemm_tune_cpu(), gemm_tune_file());
+}
@@ -4,99 +4,334 @@
  * Copyright (c) 2011 Dmitry Mikushin
  *
  * This software is provided 'as-is', without any express or implied warranty.
- * In no event will the authors be held liable for any damages arising 
+ * In no event will the authors be held liable for any damages arising
  * from the use of this software.
- * Permission is granted to anyone to use this software for any purpose, 
+ * Permission is granted to anyone to use this software for any purpose,
  * including commercial applications, and to alter it and redistribute it freely,
  * without any restrictons.
  *
  * Based on original sample by Everett Philips.
+ *
+ * For complex instances real is the matrix element type, and scalar
+ * is the type of its real and imaginary parts.
  */
 
 #ifdef HAVE_SINGLE
 #define real float
+#define scalar float
+#define make_real(x) (x)
+#define is_zero(x) ((x) == 0)
+#define gemm_flops 2.0
 #define blas_gemm sgemm_
 #define cublas_gemm cublasSgemm
+#define cublas_axpy cublasSaxpy
 #define gemm_serial sgemm_serial
 #define gemm_streamed sgemm_streamed
+#define gemm_dtype 's'
+#define gemm_streamed_tune sgemm_streamed_tune
+#define gemm_device sgemm_device
+#define gemm_3m_size sgemm_3m_size
 #define generate_data sgenerate_data
-#define tolerance stolerance
+#define check_result scheck_result
 #endif
 
 #ifdef HAVE_DOUBLE
 #define real double
+#define scalar double
+#define make_real(x) (x)
+#define is_zero(x) ((x) == 0)
+#define gemm_flops 2.0
 #define blas_gemm dgemm_
 #define cublas_gemm cublasDgemm
+#define cublas_axpy cublasDaxpy
 #define gemm_serial dgemm_serial
 #define gemm_streamed dgemm_streamed
+#define gemm_dtype 'd'
+#define gemm_streamed_tune dgemm_streamed_tune
+#define gemm_device dgemm_device
+#define gemm_3m_size dgemm_3m_size
 #define generate_data dgenerate_data
-#define tolerance dtolerance
+#define check_result dcheck_result
+#endif
+
+#ifdef HAVE_SINGLE_COMPLEX
+#define GEMM_COMPLEX
+#define real cuComplex
+#define scalar float
+#define scalar_eps FLT_EPSILON
+#define make_real(x) make_cuComplex(x, 0)
+#define blas_gemm cgemm_
+#define cublas_gemm cublasCgemm
+#define cublas_axpy cublasCaxpy
+#define cublas_copy cublasCcopy
+#define cublas_scal cublasCscal
+#define cublas_rgemm cublasSgemm
+#define cublas_raxpy cublasSaxpy
+#define cublas_rcopy cublasScopy
+#define cublas_rscal cublasSscal
+#define gemm_serial cgemm_serial
+#define gemm_streamed cgemm_streamed
+#define gemm_dtype 'c'
+#define gemm_streamed_tune cgemm_streamed_tune
+#define gemm_device cgemm_device
+#define gemm_3m_size cgemm_3m_size
+#define gemm_3m_split cgemm_3m_split
+#define gemm_error_bound cgemm_error_bound
+#define generate_data sgenerate_data
+#define check_result scheck_result
 #endif
 
-void blas_gemm(char* transa, char* transb, int* m, int* n, int* k,
-	real* alpha, real* A, int* lda, real* B, int* ldb,
-	real* beta, real* C, int* ldc);
+#ifdef HAVE_DOUBLE_COMPLEX
+#define GEMM_COMPLEX
+#define real cuDoubleComplex
+#define scalar double
+#define scalar_eps DBL_EPSILON
+#define make_real(x) make_cuDoubleComplex(x, 0)
+#define blas_gemm zgemm_
+#define cublas_gemm cublasZgemm
+#define cublas_axpy cublasZaxpy
+#define cublas_copy cublasZcopy
+#define cublas_scal cublasZscal
+#define cublas_rgemm cublasDgemm
+#define cublas_raxpy cublasDaxpy
+#define cublas_rcopy cublasDcopy
+#define cublas_rscal cublasDscal
+#define gemm_serial zgemm_serial
+#define gemm_streamed zgemm_streamed
+#define gemm_dtype 'z'
+#define gemm_streamed_tune zgemm_streamed_tune
+#define gemm_device zgemm_device
+#define gemm_3m_size zgemm_3m_size
+#define gemm_3m_split zgemm_3m_split
+#define gemm_error_bound zgemm_error_bound
+#define generate_data dgenerate_data
+#define check_result dcheck_result
+#endif
 
-// The control and production results maximum
-// allowed difference.
-const real tolerance = 1e-6;
+#ifdef GEMM_COMPLEX
+#define is_zero(z) (((z).x == 0) && ((z).y == 0))
+#define gemm_flops 8.0
+#define gemm_method(d_T) ((d_T) ? "/3m" : "/4m")
+
+// Parts smaller than GEMM_3M_MIN fall back to 4M method,
+// so streamed GEMM may use both methods.
+#define gemm_method_parts(n3m, nparts) \
+	((n3m) == (nparts) ? "/3m" : ((n3m) ? "/3m+4m" : "/4m"))
+
+// Complex matrices are generated and checked as real
+// matrices of twice more rows.
+#define GEMM_ROWS 2
+#else
+#define GEMM_ROWS 1
+#define gemm_method(d_T) ""
+#define gemm_method_parts(n3m, nparts) ""
+#endif
+
+// The minimal size of complex GEMM in each dimension,
+// which is computed by 3M method.
+#ifndef GEMM_3M_MIN
+#define GEMM_3M_MIN 256
+#endif
+
+// Get the device workspace size (in scalars) needed
+// for GEMM, or 0, if workspace is not needed.
+static size_t gemm_3m_size(int m, int n, int k)
+{
+#ifdef GEMM_COMPLEX
+	if ((m >= GEMM_3M_MIN) && (n >= GEMM_3M_MIN) && (k >= GEMM_3M_MIN))
+		return 3 * ((size_t)m * k + (size_t)k * n) + 5 * (size_t)m * n;
+#endif
+	return 0;
+}
 
-int generate_data(int n, real* A, real* B, real* C)
+#ifdef GEMM_COMPLEX
+// Copy rows x cols complex matrix X with leading dimension ld into
+// the tight real planes of its real parts Xr, imaginary parts Xi
+// (negated, if conj is set) and their sums Xs.
+static void gemm_3m_split(int rows, int cols, const real* X, int ld,
+	int conj, scalar* Xr, scalar* Xi, scalar* Xs)
 {
-	// Fill the matrices with test data
-	real invrandmax = 1.0 / (real)RAND_MAX;
-	for (int i = 0; i < n; i++)
+	int size = rows * cols;
+	if (rows == ld)
 	{
-		A[i] = rand() * invrandmax;
-		B[i] = rand() * invrandmax;
+		cublas_rcopy(size, (const scalar*)X, 2, Xr, 1);
+		cublas_rcopy(size, (const scalar*)X + 1, 2, Xi, 1);
 	}
+	else
+		for (int j = 0; j < cols; j++)
+		{
+			const scalar* x = (const scalar*)(X + (size_t)j * ld);
+			cublas_rcopy(rows, x, 2, Xr + (size_t)j * rows, 1);
+			cublas_rcopy(rows, x + 1, 2, Xi + (size_t)j * rows, 1);
+		}
+	if (conj) cublas_rscal(size, -1, Xi, 1);
+	cublas_rcopy(size, Xr, 1, Xs, 1);
+	cublas_raxpy(size, 1, Xi, 1, Xs, 1);
 }
 
-int gemm_serial(char transa, char transb, real alpha, real beta, int n)
+// Estimate the normwise error bound of alpha * op(A) * op(B):
+// u (k + c) |alpha| || |A| ||_F || |B| ||_F, where for 3M method
+// magnitudes are |re| + |im| and c = 4, and for 4M method they
+// are moduli and c = 2. The former may be noticeably larger
+// for the imaginary part, when the real one dominates.
+static double gemm_error_bound(int m, int n, int k, real alpha,
+	int rows_a, int cols_a, const real* A, int lda,
+	int rows_b, int cols_b, const real* B, int ldb, int use3m)
 {
-	printf("%d\t", n); fflush(stdout);
+	double norm_a = 0, norm_b = 0;
+	for (int j = 0; j < cols_a; j++)
+		for (int i = 0; i < rows_a; i++)
+		{
+			real a = A[i + (size_t)j * lda];
+			norm_a += use3m ? (fabs(a.x) + fabs(a.y)) * (fabs(a.x) + fabs(a.y)) :
+				a.x * a.x + a.y * a.y;
+		}
+	for (int j = 0; j < cols_b; j++)
+		for (int i = 0; i < rows_b; i++)
+		{
+			real b = B[i + (size_t)j * ldb];
+			norm_b += use3m ? (fabs(b.x) + fabs(b.y)) * (fabs(b.x) + fabs(b.y)) :
+				b.x * b.x + b.y * b.y;
+		}
+	double u = 0.5 * scalar_eps;
+	return u * (k + (use3m ? 4 : 2)) * sqrt(alpha.x * alpha.x + alpha.y * alpha.y) *
+		sqrt(norm_a) * sqrt(norm_b);
+}
+#endif
 
-	int n2 = n * n;
+// Perform C = alpha * op(A) * op(B) + beta * C on device using
+// CUBLAS. If the workspace d_T is given, complex GEMM is computed
+// by 3M method: three real GEMMs of real parts, imaginary parts and
+// their sums, instead of four real multiplications per element.
+static void gemm_device(char transa, char transb, int m, int n, int k,
+	real alpha, const real* d_A, int lda, const real* d_B, int ldb,
+	real beta, real* d_C, int ldc, scalar* d_T)
+{
+#ifdef GEMM_COMPLEX
+	if (d_T)
+	{
+		int ta = (transa != 'n') && (transa != 'N');
+		int tb = (transb != 'n') && (transb != 'N');
+		int conja = (transa == 'c') || (transa == 'C');
+		int conjb = (transb == 'c') || (transb == 'C');
+		int rows_a = ta ? k : m, cols_a = ta ? m : k;
+		int rows_b = tb ? n : k, cols_b = tb ? k : n;
+		int mn = m * n, mk = m * k, kn = k * n;
+
+		// The workspace is: complex product T, then
+		// planes of A, B and three real products.
+		real* T = (real*)d_T;
+		scalar *Ar = d_T + 2 * (size_t)mn, *Ai = Ar + mk, *As = Ai + mk;
+		scalar *Br = As + mk, *Bi = Br + kn, *Bs = Bi + kn;
+		scalar *P1 = Bs + kn, *P2 = P1 + mn, *P3 = P2 + mn;
+
+		gemm_3m_split(rows_a, cols_a, d_A, lda, conja, Ar, Ai, As);
+		gemm_3m_split(rows_b, cols_b, d_B, ldb, conjb, Br, Bi, Bs);
+
+		char opa = ta ? 'T' : 'N', opb = tb ? 'T' : 'N';
+		cublas_rgemm(opa, opb, m, n, k, 1, Ar, rows_a, Br, rows_b, 0, P1, m);
+		cublas_rgemm(opa, opb, m, n, k, 1, Ai, rows_a, Bi, rows_b, 0, P2, m);
+		cublas_rgemm(opa, opb, m, n, k, 1, As, rows_a, Bs, rows_b, 0, P3, m);
+
+		// Real part is P1 - P2, imaginary part is P3 - P1 - P2.
+		cublas_raxpy(mn, -1, P1, 1, P3, 1);
+		cublas_raxpy(mn, -1, P2, 1, P3, 1);
+		cublas_raxpy(mn, -1, P2, 1, P1, 1);
+		cublas_rcopy(mn, P1, 1, (scalar*)T, 2);
+		cublas_rcopy(mn, P3, 1, (scalar*)T + 1, 2);
+
+		// C = alpha * T + beta * C, column by column,
+		// unless C is stored tight.
+		int len = (m == ldc) ? mn : m, ncols = (m == ldc) ? 1 : n;
+		for (int j = 0; j < ncols; j++)
+		{
+			real* c = d_C + (size_t)j * ldc;
+			const real* t = T + (size_t)j * m;
+			if (is_zero(beta))
+			{
+				cublas_copy(len, t, 1, c, 1);
+				cublas_scal(len, alpha, c, 1);
+			}
+			else
+			{
+				cublas_scal(len, beta, c, 1);
+				cublas_axpy(len, alpha, t, 1, c, 1);
+			}
+		}
+		return;
+	}
+#endif
+	cublas_gemm(transa, transb, m, n, k,
+		alpha, d_A, lda, d_B, ldb, beta, d_C, ldc);
+}
+
+int gemm_serial(char transa, char transb, real alpha, real beta,
+	int m, int n, int k, int lda, int ldb, int ldc)
+{
+	printf("%d\t%d\t%d\t", m, n, k); fflush(stdout);
+
+	// Stored shapes of A and B depend on transposition.
+	int ta = (transa != 'n') && (transa != 'N');
+	int tb = (transb != 'n') && (transb != 'N');
+	int rows_a = ta ? k : m, cols_a = ta ? m : k;
+	int rows_b = tb ? n : k, cols_b = tb ? k : n;
+	if (!lda) lda = rows_a;
+	if (!ldb) ldb = rows_b;
+	if (!ldc) ldc = m;
+	assert((lda >= rows_a) && (ldb >= rows_b) && (ldc >= m));
 
 	// Initialize CUBLAS
 	cublasStatus status = cublasInit();
 	assert(status == CUBLAS_STATUS_SUCCESS);
 
 	// Allocate host memory for the matrices
-	real* h_A = (real*)malloc(n2 * sizeof(real)); assert(h_A);
-	real* h_B = (real*)malloc(n2 * sizeof(real)); assert(h_B);
-	real* h_C = (real*)malloc(n2 * sizeof(real)); assert(h_C);
-	real* h_C_ref = (real*)malloc(n2 * sizeof(real)); assert(h_C_ref);
-
-	generate_data(n2, h_A, h_B, h_C);
-
-	// Allocate device memory for the matrices.
-	real* d_A; status = cublasAlloc(n2, sizeof(real), (void**)&d_A);
+	real* h_A = (real*)malloc((size_t)lda * cols_a * sizeof(real)); assert(h_A);
+	real* h_B = (real*)malloc((size_t)ldb * cols_b * sizeof(real)); assert(h_B);
+	real* h_C = (real*)malloc((size_t)ldc * n * sizeof(real)); assert(h_C);
+	real* h_C_ref = (real*)malloc((size_t)ldc * n * sizeof(real)); assert(h_C_ref);
+
+	generate_data(GEMM_ROWS * rows_a, cols_a, GEMM_ROWS * lda, (scalar*)h_A);
+	generate_data(GEMM_ROWS * rows_b, cols_b, GEMM_ROWS * ldb, (scalar*)h_B);
+	generate_data(GEMM_ROWS * m, n, GEMM_ROWS * ldc, (scalar*)h_C);
+	memcpy(h_C_ref, h_C, (size_t)ldc * n * sizeof(real));
+
+	// Allocate device memory for the matrices,
+	// device copies are stored without padding.
+	real* d_A; status = cublasAlloc(rows_a * cols_a, sizeof(real), (void**)&d_A);
 	assert(status == CUBLAS_STATUS_SUCCESS);
-	real* d_B; status = cublasAlloc(n2, sizeof(real), (void**)&d_B);
+	real* d_B; status = cublasAlloc(rows_b * cols_b, sizeof(real), (void**)&d_B);
 	assert(status == CUBLAS_STATUS_SUCCESS);
-	real* d_C; status = cublasAlloc(n2, sizeof(real), (void**)&d_C);
+	real* d_C; status = cublasAlloc(m * n, sizeof(real), (void**)&d_C);
 	assert(status == CUBLAS_STATUS_SUCCESS);
 
-	cudaEvent_t start; cudaEventCreate(&start); 
+	// Allocate device workspace for 3M method, if needed.
+	scalar* d_T = NULL;
+	size_t size_t3m = gemm_3m_size(m, n, k);
+	if (size_t3m)
+	{
+		status = cublasAlloc(size_t3m, sizeof(scalar), (void**)&d_T);
+		assert(status == CUBLAS_STATUS_SUCCESS);
+	}
+
+	cudaEvent_t start; cudaEventCreate(&start);
 	cudaEventRecord(start, 0);
-	
+
 	// Initialize the device matrices with the host matrices
-	status = cublasSetVector(n2, sizeof(real), h_A, 1, d_A, 1);
+	status = cublasSetMatrix(rows_a, cols_a, sizeof(real), h_A, lda, d_A, rows_a);
 	assert(status == CUBLAS_STATUS_SUCCESS);
-	status = cublasSetVector(n2, sizeof(real), h_B, 1, d_B, 1);
+	status = cublasSetMatrix(rows_b, cols_b, sizeof(real), h_B, ldb, d_B, rows_b);
 	assert(status == CUBLAS_STATUS_SUCCESS);
-	status = cublasSetVector(n2, sizeof(real), h_C, 1, d_C, 1);
+	status = cublasSetMatrix(m, n, sizeof(real), h_C, ldc, d_C, m);
 	assert(status == CUBLAS_STATUS_SUCCESS);
 
 	// Perform matmul using CUBLAS
-	cublas_gemm(transa, transb, n, n, n, 
-		alpha, d_A, n, d_B, n, beta, d_C, n);
+	gemm_device(transa, transb, m, n, k,
+		alpha, d_A, rows_a, d_B, rows_b, beta, d_C, m, d_T);
 	status = cublasGetError();
 	assert(status == CUBLAS_STATUS_SUCCESS);
-	
+
 	// Read the result back
-	status = cublasGetVector(n2, sizeof(real), d_C, 1, h_C, 1);
+	status = cublasGetMatrix(m, n, sizeof(real), d_C, m, h_C, ldc);
 	assert(status == CUBLAS_STATUS_SUCCESS);
 
 	cudaEvent_t stop; cudaEventCreate(&stop);
@@ -105,21 +340,21 @@ int gemm_serial(char transa, char transb, real alpha, real beta, int n)
 	cudaEventSynchronize(stop);
 
 	float timer_ev; cudaEventElapsedTime(&timer_ev, start, stop);
-	double dn = (double)n, gflops = 2.0e-6 * dn * dn * dn / (double)timer_ev;
-	printf("%f sec\t%f\t", timer_ev / 1000.0, gflops); fflush(stdout);
+	double gflops = gemm_flops * 1.0e-6 * m * n * k / (double)timer_ev;
+	printf("%s%s\t%f sec\t%f\t", "none", gemm_method(d_T),
+		timer_ev / 1000.0, gflops); fflush(stdout);
+#ifdef GEMM_COMPLEX
+	printf("%e\t", gemm_error_bound(m, n, k, alpha, rows_a, cols_a, h_A, lda,
+		rows_b, cols_b, h_B, ldb, d_T != NULL)); fflush(stdout);
+#endif
 
 	// Perform matmul using host BLAS
-	blas_gemm(&transa, &transb, &n, &n, &n, 
-		&alpha, h_A, &n, h_B, &n, &beta, h_C_ref, &n);
-	
+	blas_gemm(&transa, &transb, &m, &n, &k,
+		&alpha, h_A, &lda, h_B, &ldb, &beta, h_C_ref, &ldc);
+
 	// Check result against reference
-	real error_norm = 0, ref_norm = 0;
-	for (int i = 0; i < n2; i++)
-	{
-		real diff = h_C_ref[i] - h_C[i];
-		error_norm += diff * diff;
-		ref_norm += h_C_ref[i] * h_C_ref[i];
-	}
+	int result = check_result(GEMM_ROWS * m, n, (scalar*)h_C, GEMM_ROWS * ldc,
+		(scalar*)h_C_ref, GEMM_ROWS * ldc);
 
 	// Release host memory
 	if (h_A) free(h_A);
@@ -131,29 +366,48 @@ int gemm_serial(char transa, char transb, real alpha, real beta, int n)
 	status = cublasFree(d_A); assert(status == CUBLAS_STATUS_SUCCESS);
 	status = cublasFree(d_B); assert(status == CUBLAS_STATUS_SUCCESS);
 	status = cublasFree(d_C); assert(status == CUBLAS_STATUS_SUCCESS);
+	if (d_T)
+	{
+		status = cublasFree(d_T);
+		assert(status == CUBLAS_STATUS_SUCCESS);
+	}
+
+	cudaEventDestroy(start);
+	cudaEventDestroy(stop);
 
 	status = cublasShutdown();
 	assert(status == CUBLAS_STATUS_SUCCESS);
 
-	error_norm = (real)sqrt((double)error_norm);
-	ref_norm = (float) sqrt((double) ref_norm);
-	if (fabs(ref_norm) < tolerance)
-	{
-		printf("Reference norm is 0\n");
-		return EXIT_FAILURE;
-	}
-	printf("%s\t%f\t%f\n", (error_norm / ref_norm < tolerance) ?
-		"PASSED" : "FAILED", error_norm, ref_norm);
-	fflush(stdout);
-
-	return EXIT_SUCCESS;
+	return result;
 }
 
-int gemm_streamed(char transa, char transb, real alpha, real beta, int n, int nstreams)
+// Measure GEMM, streamed with nstreams streams (0 means the tuned
+// number for this size). The elapsed time is returned in time,
+// if it is not NULL.
+int gemm_streamed(char transa, char transb, real alpha, real beta,
+	int m, int n, int k, int lda, int ldb, int ldc, int nstreams, double* time)
 {
-	printf("%d\t", n); fflush(stdout);
-
-	int n2 = n * n;
+	printf("%d\t%d\t%d\t", m, n, k); fflush(stdout);
+
+	// Stored shapes of A and B depend on transposition.
+	int ta = (transa != 'n') && (transa != 'N');
+	int tb = (transb != 'n') && (transb != 'N');
+	int rows_a = ta ? k : m, cols_a = ta ? m : k;
+	int rows_b = tb ? n : k, cols_b = tb ? k : n;
+	if (!lda) lda = rows_a;
+	if (!ldb) ldb = rows_b;
+	if (!ldc) ldc = m;
+	assert((lda >= rows_a) && (ldb >= rows_b) && (ldc >= m));
+
+	if (!nstreams)
+		nstreams = gemm_tune_streams(gemm_dtype, m, n, k);
+
+	// Choose how to cut the iteration space between streams:
+	// skinny shapes are better cut along their long dimension
+	// than along columns of B.
+	gemm_partition_t partition;
+	gemm_partition(m, n, k, nstreams, GEMM_PARTITION_STREAM_COST, 1, &partition);
+	int nparts = gemm_partition_size(&partition);
 
 	// Initialize CUBLAS
 	cublasStatus status = cublasInit();
@@ -162,177 +416,296 @@ int gemm_streamed(char transa, char transb, real alpha, real beta, int n, int ns
 	// Allocate host memory for the matrices using the
 	// cudaHostAlloc functions needed by the Async Interface
 	cudaError_t cudaerr;
-	real* h_A; cudaerr = cudaMallocHost((void **)&h_A, n2 * sizeof(real));
+	real* h_A; cudaerr = cudaMallocHost((void **)&h_A, (size_t)lda * cols_a * sizeof(real));
 	assert(cudaerr == cudaSuccess);
-	real* h_B; cudaerr = cudaMallocHost((void **)&h_B, n2 * sizeof(real));
+	real* h_B; cudaerr = cudaMallocHost((void **)&h_B, (size_t)ldb * cols_b * sizeof(real));
 	assert(cudaerr == cudaSuccess);
-	real* h_C; cudaerr = cudaMallocHost((void **)&h_C, n2 * sizeof(real));
+	real* h_C; cudaerr = cudaMallocHost((void **)&h_C, (size_t)ldc * n * sizeof(real));
 	assert(cudaerr == cudaSuccess);
-	real* h_C_ref = (real*)malloc(n2 * sizeof(real)); assert(h_C_ref);
+	real* h_C_ref = (real*)malloc((size_t)ldc * n * sizeof(real)); assert(h_C_ref);
 
-	generate_data(n2, h_A, h_B, h_C);
+	generate_data(GEMM_ROWS * rows_a, cols_a, GEMM_ROWS * lda, (scalar*)h_A);
+	generate_data(GEMM_ROWS * rows_b, cols_b, GEMM_ROWS * ldb, (scalar*)h_B);
+	generate_data(GEMM_ROWS * m, n, GEMM_ROWS * ldc, (scalar*)h_C);
+	memcpy(h_C_ref, h_C, (size_t)ldc * n * sizeof(real));
 
 	// Allocate data structures
 	cudaStream_t* stream = (cudaStream_t*)malloc(
-		nstreams * sizeof(cudaStream_t));
+		nparts * sizeof(cudaStream_t));
 	assert(stream);
 
-	cudaEvent_t* event_start = (cudaEvent_t*)malloc(
-		nstreams * sizeof(cudaEvent_t));
-	assert(event_start);
-
-	cudaEvent_t* event_end = (cudaEvent_t*)malloc(
-		nstreams * sizeof(cudaEvent_t));
-  	assert(event_end);
-
-	real** d_B = (real**)malloc(nstreams * sizeof(real*)); assert(d_B);
-	real** d_C = (real**)malloc(nstreams * sizeof(real*)); assert(d_C);
+	// Blocks of A and B shared by several parts are uploaded
+	// once, by the first part that needs them. Others wait for
+	// the upload event of the owner stream.
+	int nblocks_a = partition.pm * partition.pk;
+	int nblocks_b = partition.pk * partition.pn;
+	cudaEvent_t* event_a = (cudaEvent_t*)malloc(
+		nblocks_a * sizeof(cudaEvent_t));
+	assert(event_a);
+	cudaEvent_t* event_b = (cudaEvent_t*)malloc(
+		nblocks_b * sizeof(cudaEvent_t));
+	assert(event_b);
+	int* loaded_a = (int*)calloc(nblocks_a, sizeof(int)); assert(loaded_a);
+	int* loaded_b = (int*)calloc(nblocks_b, sizeof(int)); assert(loaded_b);
+
+	cudaEvent_t event_start, event_end;
+	cudaerr = cudaEventCreate(&event_start);
+	assert(cudaerr == cudaSuccess);
+	cudaerr = cudaEventCreate(&event_end);
+	assert(cudaerr == cudaSuccess);
 
-	// Create a start and end event for each stream
-	for (int i = 0; i < nstreams; i++)
+	for (int i = 0; i < nparts; i++)
 	{
 		cudaerr = cudaStreamCreate(&stream[i]);
 		assert(cudaerr == cudaSuccess);
-		cudaerr = cudaEventCreate(&event_start[i]);
+	}
+	for (int i = 0; i < nblocks_a; i++)
+	{
+		cudaerr = cudaEventCreate(&event_a[i]);
 		assert(cudaerr == cudaSuccess);
-		cudaerr = cudaEventCreate(&event_end[i]);
+	}
+	for (int i = 0; i < nblocks_b; i++)
+	{
+		cudaerr = cudaEventCreate(&event_b[i]);
 		assert(cudaerr == cudaSuccess);
 	}
-	
-	// Allocate device memory for the matrices
-	real* d_A; cudaerr = cublasAlloc(n2, sizeof(real), (void**)&d_A);
-	assert(cudaerr == cudaSuccess);
-
-	// Allocate host memory for reading back the result
-	// from device memory
-	cudaerr = cudaMallocHost((void**)&h_C, n2 * sizeof(real));
-	assert(cudaerr == cudaSuccess);
 
-	for (int istream = 0; istream < nstreams; istream++)
+	// Allocate device memory for the matrices. For K split
+	// partial products of all parts except the first go to
+	// the separate workspace and are reduced at the end.
+	real* d_A; status = cublasAlloc(rows_a * cols_a, sizeof(real), (void**)&d_A);
+	assert(status == CUBLAS_STATUS_SUCCESS);
+	real* d_B; status = cublasAlloc(rows_b * cols_b, sizeof(real), (void**)&d_B);
+	assert(status == CUBLAS_STATUS_SUCCESS);
+	real* d_C; status = cublasAlloc(m * n, sizeof(real), (void**)&d_C);
+	assert(status == CUBLAS_STATUS_SUCCESS);
+	real* d_W = NULL;
+	if (partition.pk > 1)
 	{
-		int szpart = n / nstreams;
-		size_t shift = szpart * istream;
-		if (istream == nstreams - 1)
-			szpart += n % nstreams;
-		
-		status = cublasAlloc(n * szpart, sizeof(real), (void**)&d_B[istream]);
-		assert(status == CUBLAS_STATUS_SUCCESS);		
-		status = cublasAlloc(n * szpart, sizeof(real), (void**)&d_C[istream]);
+		status = cublasAlloc((partition.pk - 1) * m * n, sizeof(real), (void**)&d_W);
 		assert(status == CUBLAS_STATUS_SUCCESS);
 	}
 
-	cudaEventRecord(event_start[0], 0);
-	
-	// Initialize the device matrices with the
-	// host matrices using the async interface
-	status = cublasSetVector(n2, sizeof(real),
-		h_A, 1, d_A, 1);
-	assert(status == CUBLAS_STATUS_SUCCESS);
-
-	for (int istream = 0; istream < nstreams; istream++)
+	// Allocate device workspaces for 3M method, if needed by parts.
+	scalar** d_T = (scalar**)calloc(nparts, sizeof(scalar*)); assert(d_T);
+	int n3m = 0;
+	for (int ipart = 0; ipart < nparts; ipart++)
 	{
-		int szpart = n / nstreams;
-		size_t shift = n * szpart * istream;
-		if (istream == nstreams - 1)
-			szpart += n % nstreams;
-		
-		status = cublasSetVectorAsync(n * szpart, sizeof(real),
-			h_B + shift, 1, d_B[istream], 1, stream[istream]);
-		assert(status == CUBLAS_STATUS_SUCCESS);
-		status = cublasSetVectorAsync(n * szpart, sizeof(real),
-			h_C + shift, 1, d_C[istream], 1, stream[istream]);
+		gemm_part_t part;
+		gemm_partition_part(&partition, m, n, k, ipart, &part);
+		size_t size_t3m = gemm_3m_size(part.m, part.n, part.k);
+		if (!size_t3m) continue;
+		status = cublasAlloc(size_t3m, sizeof(scalar), (void**)&d_T[ipart]);
 		assert(status == CUBLAS_STATUS_SUCCESS);
+		n3m++;
 	}
-	
-	for (int istream = 0; istream < nstreams; istream++)
+
+	cudaEventRecord(event_start, 0);
+
+	for (int ipart = 0; ipart < nparts; ipart++)
 	{
-		int szpart = n / nstreams;
-		if (istream == nstreams - 1)
-			szpart += n % nstreams;
-		
+		gemm_part_t part;
+		gemm_partition_part(&partition, m, n, k, ipart, &part);
+
+		// Offsets of op(A) and op(B) blocks in stored matrices.
+		size_t shift_a = ta ? part.k0 + (size_t)part.m0 * lda :
+			part.m0 + (size_t)part.k0 * lda;
+		size_t dshift_a = ta ? part.k0 + (size_t)part.m0 * rows_a :
+			part.m0 + (size_t)part.k0 * rows_a;
+		size_t shift_b = tb ? part.n0 + (size_t)part.k0 * ldb :
+			part.k0 + (size_t)part.n0 * ldb;
+		size_t dshift_b = tb ? part.n0 + (size_t)part.k0 * rows_b :
+			part.k0 + (size_t)part.n0 * rows_b;
+
+		// Initialize the device matrices with the
+		// host matrices using the async interface
+		int iblock_a = part.im + part.ik * partition.pm;
+		if (!loaded_a[iblock_a])
+		{
+			status = cublasSetMatrixAsync(ta ? part.k : part.m, ta ? part.m : part.k,
+				sizeof(real), h_A + shift_a, lda, d_A + dshift_a, rows_a, stream[ipart]);
+			assert(status == CUBLAS_STATUS_SUCCESS);
+			cudaEventRecord(event_a[iblock_a], stream[ipart]);
+			loaded_a[iblock_a] = 1;
+		}
+		else
+			cudaStreamWaitEvent(stream[ipart], event_a[iblock_a], 0);
+
+		int iblock_b = part.ik + part.in * partition.pk;
+		if (!loaded_b[iblock_b])
+		{
+			status = cublasSetMatrixAsync(tb ? part.n : part.k, tb ? part.k : part.n,
+				sizeof(real), h_B + shift_b, ldb, d_B + dshift_b, rows_b, stream[ipart]);
+			assert(status == CUBLAS_STATUS_SUCCESS);
+			cudaEventRecord(event_b[iblock_b], stream[ipart]);
+			loaded_b[iblock_b] = 1;
+		}
+		else
+			cudaStreamWaitEvent(stream[ipart], event_b[iblock_b], 0);
+
+		real* d_Cpart = d_C + part.m0 + (size_t)part.n0 * m;
+		if (part.ik == 0)
+		{
+			status = cublasSetMatrixAsync(part.m, part.n, sizeof(real),
+				h_C + part.m0 + (size_t)part.n0 * ldc, ldc, d_Cpart, m, stream[ipart]);
+			assert(status == CUBLAS_STATUS_SUCCESS);
+		}
+		else
+			d_Cpart = d_W + (size_t)(part.ik - 1) * m * n + part.m0 + (size_t)part.n0 * m;
+
 		// Setup async operations
-		status = cublasSetKernelStream(stream[istream]);
+		status = cublasSetKernelStream(stream[ipart]);
 		assert(status == CUBLAS_STATUS_SUCCESS);
 
 		// Perform matmul using CUBLAS
-		cublas_gemm(transa, transb, n, szpart, n,
-			alpha, d_A, n, d_B[istream], n, beta, d_C[istream], n);
+		gemm_device(transa, transb, part.m, part.n, part.k,
+			alpha, d_A + dshift_a, rows_a, d_B + dshift_b, rows_b,
+			part.ik ? make_real(0) : beta, d_Cpart, m, d_T[ipart]);
 		status = cublasGetError();
 		assert(status == CUBLAS_STATUS_SUCCESS);
+
+		// Read the result back, unless it has
+		// to be reduced first.
+		if (partition.pk == 1)
+		{
+			status = cublasGetMatrixAsync(part.m, part.n, sizeof(real),
+				d_Cpart, m, h_C + part.m0 + (size_t)part.n0 * ldc, ldc, stream[ipart]);
+			assert(status == CUBLAS_STATUS_SUCCESS);
+		}
 	}
 
-	// Sync all
-	for (int istream = 0; istream < nstreams; istream++)
+	// Reduce partial products of K split in the default
+	// stream, which waits for all others.
+	if (partition.pk > 1)
 	{
-		int szpart = n / nstreams;
-		size_t shift = n * szpart * istream;
-		if (istream == nstreams - 1)
-			szpart += n % nstreams;
-
-		// Read the result back
-		status = cublasGetVectorAsync(n * szpart, sizeof(real),
-			d_C[istream], 1, h_C + shift, 1, stream[istream]);
+		status = cublasSetKernelStream(0);
+		assert(status == CUBLAS_STATUS_SUCCESS);
+		for (int ik = 1; ik < partition.pk; ik++)
+			cublas_axpy(m * n, make_real(1), d_W + (size_t)(ik - 1) * m * n, 1, d_C, 1);
+		status = cublasGetError();
+		assert(status == CUBLAS_STATUS_SUCCESS);
+
+		status = cublasGetMatrix(m, n, sizeof(real), d_C, m, h_C, ldc);
 		assert(status == CUBLAS_STATUS_SUCCESS);
 	}
 
-	cudaEventRecord(event_end[0], 0);
-	cudaEventSynchronize(event_end[0]);
-	
-	float timer_ev; cudaEventElapsedTime(&timer_ev, event_start[0], event_end[0]);
-	double dn = (double)n, gflops = 2.0e-6 * dn * dn * dn / (double)timer_ev;
-	printf("%f sec\t%f\t", timer_ev / 1000.0, gflops); fflush(stdout);
+	cudaEventRecord(event_end, 0);
+	cudaEventSynchronize(event_end);
+
+	float timer_ev; cudaEventElapsedTime(&timer_ev, event_start, event_end);
+	double gflops = gemm_flops * 1.0e-6 * m * n * k / (double)timer_ev;
+	if (time) *time = timer_ev / 1000.0;
+	printf("%s%s\t%f sec\t%f\t", gemm_split_name(partition.split),
+		gemm_method_parts(n3m, nparts), timer_ev / 1000.0, gflops); fflush(stdout);
+#ifdef GEMM_COMPLEX
+	// The bound of 3M method is the larger one, so it holds for
+	// all parts, if any of them is computed by 3M method.
+	printf("%e\t", gemm_error_bound(m, n, k, alpha, rows_a, cols_a, h_A, lda,
+		rows_b, cols_b, h_B, ldb, n3m > 0)); fflush(stdout);
+#endif
 
 	// Perform matmul using host BLAS
-	blas_gemm(&transa, &transb, &n, &n, &n, 
-		&alpha, h_A, &n, h_B, &n, &beta, h_C_ref, &n);
+	blas_gemm(&transa, &transb, &m, &n, &k,
+		&alpha, h_A, &lda, h_B, &ldb, &beta, h_C_ref, &ldc);
 
 	// Check result against reference
-	real error_norm = 0, ref_norm = 0;
-	for (int i = 0; i < n2; i++)
-	{
-		real diff = h_C_ref[i] - h_C[i];
-		error_norm += diff * diff;
-		ref_norm += h_C_ref[i] * h_C_ref[i];
-	}
+	int result = check_result(GEMM_ROWS * m, n, (scalar*)h_C, GEMM_ROWS * ldc,
+		(scalar*)h_C_ref, GEMM_ROWS * ldc);
 
 	cudaerr = cudaFreeHost(h_A); assert(cudaerr == cudaSuccess);
 	cudaerr = cudaFreeHost(h_B); assert(cudaerr == cudaSuccess);
 	cudaerr = cudaFreeHost(h_C); assert(cudaerr == cudaSuccess);
 	if (h_C_ref) free(h_C_ref);
 
-	cudaerr = cublasFree(d_A); assert(cudaerr == cudaSuccess);
+	status = cublasFree(d_A); assert(status == CUBLAS_STATUS_SUCCESS);
+	status = cublasFree(d_B); assert(status == CUBLAS_STATUS_SUCCESS);
+	status = cublasFree(d_C); assert(status == CUBLAS_STATUS_SUCCESS);
+	if (d_W)
+	{
+		status = cublasFree(d_W);
+		assert(status == CUBLAS_STATUS_SUCCESS);
+	}
+	for (int i = 0; i < nparts; i++)
+	{
+		if (!d_T[i]) continue;
+		status = cublasFree(d_T[i]);
+		assert(status == CUBLAS_STATUS_SUCCESS);
+	}
+	free(d_T);
 
-	for (int istream = 0; istream < nstreams; istream++)
+	for (int i = 0; i < nparts; i++)
 	{
-		cudaerr = cudaStreamDestroy(stream[istream]);
-		assert(cudaerr == cudaSuccess);
-		cudaerr = cublasFree(d_B[istream]);
-		assert(cudaerr == cudaSuccess);
-		cublasFree(d_C[istream]);
+		cudaerr = cudaStreamDestroy(stream[i]);
 		assert(cudaerr == cudaSuccess);
 	}
-		
+	for (int i = 0; i < nblocks_a; i++)
+		cudaEventDestroy(event_a[i]);
+	for (int i = 0; i < nblocks_b; i++)
+		cudaEventDestroy(event_b[i]);
+	cudaEventDestroy(event_start);
+	cudaEventDestroy(event_end);
+
+	free(stream);
+	free(event_a); free(event_b);
+	free(loaded_a); free(loaded_b);
+
 	status = cublasShutdown();
 	assert(status == CUBLAS_STATUS_SUCCESS);
 
-	error_norm = (real)sqrt((double)error_norm);
-	ref_norm = (real)sqrt((double)ref_norm);
-	if (fabs(ref_norm) < tolerance)
+	return result;
+}
+
+// Find the best number of streams for m x n x k GEMM among
+// powers of two up to GEMM_TUNE_MAX_STREAMS, and record it in tune.
+int gemm_streamed_tune(char transa, char transb, real alpha, real beta,
+	int m, int n, int k, int lda, int ldb, int ldc, gemm_tune_t* tune)
+{
+	int status = EXIT_SUCCESS, best = 1;
+	double best_time = 0;
+	for (int nstreams = 1; nstreams <= GEMM_TUNE_MAX_STREAMS; nstreams *= 2)
 	{
-		printf("Reference norm is 0\n");
-		return EXIT_FAILURE;
+		double time = 0;
+		status |= gemm_streamed(transa, transb, alpha, beta,
+			m, n, k, lda, ldb, ldc, nstreams, &time);
+		if ((nstreams == 1) || (time < best_time))
+		{
+			best_time = time;
+			best = nstreams;
+		}
 	}
-	printf("%s\t%f\t%f\n", (error_norm / ref_norm < tolerance) ?
-		"PASSED" : "FAILED", error_norm, ref_norm);
-	fflush(stdout);
 
-	return EXIT_SUCCESS;
+	printf("best n_streams %d for %d x %d x %d\n", best, m, n, k);
+	gemm_tune_add_streams(tune, m, n, k, best);
+
+	return status;
 }
 
 #undef real
+#undef scalar
+#undef scalar_eps
+#undef make_real
+#undef is_zero
+#undef gemm_flops
+#undef gemm_method
+#undef gemm_method_parts
 #undef blas_gemm
 #undef cublas_gemm
+#undef cublas_axpy
+#undef cublas_copy
+#undef cublas_scal
+#undef cublas_rgemm
+#undef cublas_raxpy
+#undef cublas_rcopy
+#undef cublas_rscal
 #undef gemm_serial
 #undef gemm_streamed
+#undef gemm_dtype
+#undef gemm_streamed_tune
+#undef gemm_device
+#undef gemm_3m_size
+#undef gemm_3m_split
+#undef gemm_error_bound
 #undef generate_data
-#undef tolerance
+#undef check_result
+#undef GEMM_ROWS
+#undef GEMM_COMPLEX
@@ -0,0 +1,346 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Krylov solvers of sparse systems: CG and BiCGSTAB with Jacobi
+ * preconditioner. The preconditioner is applied by scaling the matrix
+ * once, A' = D^-1/2 A D^-1/2 (D is the absolute value of the diagonal),
+ * which is the same as preconditioned CG in exact arithmetic, but costs
+ * no vector pass per iteration. Vector updates of each iteration are
+ * fused together with the dot products, that use the updated vectors,
+ * and the products, that use SpMV result, are fused into SpMV. All
+ * dot products are summed by blocks of SPARSE_BLOCK rows, then blocks
+ * are summed in order, so the result does not depend on the number
+ * of threads.
+ */
+
+#ifndef KRYLOV_SOLVERS_H
+#define KRYLOV_SOLVERS_H
+
+// Sum partial sums of nblocks blocks in order.
+static double krylov_sum(const double* partials, int nblocks)
+{
+	double sum = 0;
+	for (int b = 0; b < nblocks; b++)
+		sum += partials[b];
+	return sum;
+}
+
+#endif // KRYLOV_SOLVERS_H
+
+#ifdef HAVE_SINGLE
+#define real float
+#define sparse_t ssparse_t
+#define sparse_copy ssparse_copy
+#define sparse_convert ssparse_convert
+#define sparse_spmv_dot ssparse_spmv_dot
+#define sparse_diagonal ssparse_diagonal
+#define sparse_scale ssparse_scale
+#define sparse_free ssparse_free
+#define krylov_setup skrylov_setup
+#define krylov_cg skrylov_cg
+#define krylov_bicgstab skrylov_bicgstab
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define sparse_t dsparse_t
+#define sparse_copy dsparse_copy
+#define sparse_convert dsparse_convert
+#define sparse_spmv_dot dsparse_spmv_dot
+#define sparse_diagonal dsparse_diagonal
+#define sparse_scale dsparse_scale
+#define sparse_free dsparse_free
+#define krylov_setup dkrylov_setup
+#define krylov_cg dkrylov_cg
+#define krylov_bicgstab dkrylov_bicgstab
+#endif
+
+// Make the scaled copy S = D^-1/2 A D^-1/2 of square CSR matrix A
+// in the format, and the scaling s = D^-1/2 (1 for zero diagonal).
+static void krylov_setup(const sparse_t* A, sparse_format_t format,
+	sparse_t* S, real* s)
+{
+	assert(A->m == A->n);
+	sparse_diagonal(A, s);
+	for (int i = 0; i < A->m; i++)
+		s[i] = s[i] ? 1 / sqrt(fabs(s[i])) : 1;
+	sparse_copy(A, S);
+	sparse_scale(S, s, s);
+	sparse_convert(S, format);
+}
+
+// Solve A x = b for symmetric definite CSR matrix A by CG with Jacobi
+// preconditioner, SpMV running in the format. x is the initial guess
+// on input. Iterations stop, when the norm of the preconditioned
+// residual drops below tol times its norm for x = 0. If residual
+// or time is not NULL, it gets the relative residual norm and the time
+// since start after each of the iterations done (maxiter + 1 elements,
+// the first is for the initial guess). Returns 0, if converged in
+// maxiter iterations, -1 otherwise.
+int krylov_cg(const sparse_t* A, sparse_format_t format, const real* b, real* x,
+	double tol, int maxiter, int* iterations, double* residual, double* time)
+{
+	double start = omp_get_wtime();
+
+	int n = A->n, nblocks = (n + SPARSE_BLOCK - 1) / SPARSE_BLOCK;
+	sparse_t S;
+	real* s = (real*)malloc(n * sizeof(real)); assert(s);
+	krylov_setup(A, format, &S, s);
+
+	// Vectors of the scaled system S x' = b', x' = D^1/2 x, b' = D^-1/2 b.
+	real* r = (real*)malloc(n * sizeof(real)); assert(r);
+	real* p = (real*)malloc(n * sizeof(real)); assert(p);
+	real* q = (real*)malloc(n * sizeof(real)); assert(q);
+	double* partials = (double*)malloc(2 * nblocks * sizeof(double));
+	assert(partials);
+
+	#pragma omp parallel for
+	for (int i = 0; i < n; i++)
+		x[i] /= s[i];
+	sparse_spmv_dot(&S, x, q, NULL, NULL, NULL);
+
+	// r = p = b' - S x', with norms of r and b'.
+	#pragma omp parallel for
+	for (int ib = 0; ib < nblocks; ib++)
+	{
+		int i0 = ib * SPARSE_BLOCK, i1 = n - i0 < SPARSE_BLOCK ? n : i0 + SPARSE_BLOCK;
+		double rr = 0, bb = 0;
+		#pragma omp simd reduction(+:rr, bb)
+		for (int i = i0; i < i1; i++)
+		{
+			real bi = s[i] * b[i];
+			r[i] = bi - q[i];
+			p[i] = r[i];
+			rr += (double)r[i] * r[i];
+			bb += (double)bi * bi;
+		}
+		partials[ib] = rr;
+		partials[ib + nblocks] = bb;
+	}
+	double rr = krylov_sum(partials, nblocks);
+	double bnorm = sqrt(krylov_sum(partials + nblocks, nblocks));
+	if (bnorm == 0) bnorm = 1;
+
+	int k = 0, converged = 0;
+	for ( ; ; k++)
+	{
+		double norm = sqrt(rr) / bnorm;
+		if (residual) residual[k] = norm;
+		if (time) time[k] = omp_get_wtime() - start;
+		converged = norm <= tol;
+		if (converged || (k == maxiter)) break;
+
+		// q = S p and (p, q) in one pass.
+		sparse_spmv_dot(&S, p, q, p, partials, NULL);
+		double alpha = rr / krylov_sum(partials, nblocks);
+
+		// x' += alpha p, r -= alpha q and (r, r) in one pass.
+		#pragma omp parallel for
+		for (int ib = 0; ib < nblocks; ib++)
+		{
+			int i0 = ib * SPARSE_BLOCK, i1 = n - i0 < SPARSE_BLOCK ? n : i0 + SPARSE_BLOCK;
+			double sum = 0;
+			#pragma omp simd reduction(+:sum)
+			for (int i = i0; i < i1; i++)
+			{
+				x[i] += (real)alpha * p[i];
+				r[i] -= (real)alpha * q[i];
+				sum += (double)r[i] * r[i];
+			}
+			partials[ib] = sum;
+		}
+		double rr_next = krylov_sum(partials, nblocks);
+		double beta = rr_next / rr;
+		rr = rr_next;
+
+		// The direction is not needed after the last iteration.
+		if (sqrt(rr) / bnorm <= tol) continue;
+
+		#pragma omp parallel for
+		for (int i = 0; i < n; i++)
+			p[i] = r[i] + (real)beta * p[i];
+	}
+
+	// x = D^-1/2 x'.
+	#pragma omp parallel for
+	for (int i = 0; i < n; i++)
+		x[i] *= s[i];
+
+	sparse_free(&S);
+	free(s);
+	free(r);
+	free(p);
+	free(q);
+	free(partials);
+
+	*iterations = k;
+	return converged ? 0 : -1;
+}
+
+// Solve A x = b for square CSR matrix A by BiCGSTAB with Jacobi
+// preconditioner. Arguments and result are the same, as for krylov_cg,
+// -1 is returned on breakdown as well.
+int krylov_bicgstab(const sparse_t* A, sparse_format_t format, const real* b, real* x,
+	double tol, int maxiter, int* iterations, double* residual, double* time)
+{
+	double start = omp_get_wtime();
+
+	int n = A->n, nblocks = (n + SPARSE_BLOCK - 1) / SPARSE_BLOCK;
+	sparse_t S;
+	real* s = (real*)malloc(n * sizeof(real)); assert(s);
+	krylov_setup(A, format, &S, s);
+
+	// r is overwritten by the intermediate residual at each iteration.
+	real* r = (real*)malloc(n * sizeof(real)); assert(r);
+	real* r0 = (real*)malloc(n * sizeof(real)); assert(r0);
+	real* p = (real*)malloc(n * sizeof(real)); assert(p);
+	real* v = (real*)malloc(n * sizeof(real)); assert(v);
+	real* t = (real*)malloc(n * sizeof(real)); assert(t);
+	double* partials = (double*)malloc(2 * nblocks * sizeof(double));
+	assert(partials);
+
+	#pragma omp parallel for
+	for (int i = 0; i < n; i++)
+		x[i] /= s[i];
+	sparse_spmv_dot(&S, x, v, NULL, NULL, NULL);
+
+	// r = r0 = p = b' - S x', with norms of r and b'.
+	#pragma omp parallel for
+	for (int ib = 0; ib < nblocks; ib++)
+	{
+		int i0 = ib * SPARSE_BLOCK, i1 = n - i0 < SPARSE_BLOCK ? n : i0 + SPARSE_BLOCK;
+		double rr = 0, bb = 0;
+		#pragma omp simd reduction(+:rr, bb)
+		for (int i = i0; i < i1; i++)
+		{
+			real bi = s[i] * b[i];
+			r[i] = bi - v[i];
+			r0[i] = r[i];
+			p[i] = r[i];
+			rr += (double)r[i] * r[i];
+			bb += (double)bi * bi;
+		}
+		partials[ib] = rr;
+		partials[ib + nblocks] = bb;
+	}
+	double rr = krylov_sum(partials, nblocks);
+	double rho = rr;
+	double bnorm = sqrt(krylov_sum(partials + nblocks, nblocks));
+	if (bnorm == 0) bnorm = 1;
+
+	int k = 0, converged = 0;
+	for ( ; ; k++)
+	{
+		double norm = sqrt(rr) / bnorm;
+		if (residual) residual[k] = norm;
+		if (time) time[k] = omp_get_wtime() - start;
+		converged = norm <= tol;
+		if (converged || (k == maxiter) || (rho == 0)) break;
+
+		// v = S p and (r0, v) in one pass.
+		sparse_spmv_dot(&S, p, v, r0, partials, NULL);
+		double r0v = krylov_sum(partials, nblocks);
+		if (r0v == 0) break;
+		double alpha = rho / r0v;
+
+		// s = r - alpha v and (s, s) in one pass, s is kept in r.
+		#pragma omp parallel for
+		for (int ib = 0; ib < nblocks; ib++)
+		{
+			int i0 = ib * SPARSE_BLOCK, i1 = n - i0 < SPARSE_BLOCK ? n : i0 + SPARSE_BLOCK;
+			double sum = 0;
+			#pragma omp simd reduction(+:sum)
+			for (int i = i0; i < i1; i++)
+			{
+				r[i] -= (real)alpha * v[i];
+				sum += (double)r[i] * r[i];
+			}
+			partials[ib] = sum;
+		}
+		double ss = krylov_sum(partials, nblocks);
+		if (sqrt(ss) / bnorm <= tol)
+		{
+			// Converged at half step: x' += alpha p.
+			#pragma omp parallel for
+			for (int i = 0; i < n; i++)
+				x[i] += (real)alpha * p[i];
+			rr = ss;
+			continue;
+		}
+
+		// t = S s, (s, t) and (t, t) in one pass.
+		sparse_spmv_dot(&S, r, t, r, partials, partials + nblocks);
+		double st = krylov_sum(partials, nblocks);
+		double tt = krylov_sum(partials + nblocks, nblocks);
+		if (tt == 0) break;
+		double omega = st / tt;
+
+		// x' += alpha p + omega s, r = s - omega t,
+		// (r0, r) and (r, r) in one pass.
+		#pragma omp parallel for
+		for (int ib = 0; ib < nblocks; ib++)
+		{
+			int i0 = ib * SPARSE_BLOCK, i1 = n - i0 < SPARSE_BLOCK ? n : i0 + SPARSE_BLOCK;
+			double r0r = 0, sum = 0;
+			#pragma omp simd reduction(+:r0r, sum)
+			for (int i = i0; i < i1; i++)
+			{
+				x[i] += (real)alpha * p[i] + (real)omega * r[i];
+				r[i] -= (real)omega * t[i];
+				r0r += (double)r0[i] * r[i];
+				sum += (double)r[i] * r[i];
+			}
+			partials[ib] = r0r;
+			partials[ib + nblocks] = sum;
+		}
+		double rho_next = krylov_sum(partials, nblocks);
+		rr = krylov_sum(partials + nblocks, nblocks);
+		if (sqrt(rr) / bnorm <= tol) continue;
+		if (omega == 0) break;
+		double beta = (rho_next / rho) * (alpha / omega);
+		rho = rho_next;
+
+		// p = r + beta (p - omega v).
+		#pragma omp parallel for
+		for (int i = 0; i < n; i++)
+			p[i] = r[i] + (real)beta * (p[i] - (real)omega * v[i]);
+	}
+
+	// x = D^-1/2 x'.
+	#pragma omp parallel for
+	for (int i = 0; i < n; i++)
+		x[i] *= s[i];
+
+	sparse_free(&S);
+	free(s);
+	free(r);
+	free(r0);
+	free(p);
+	free(v);
+	free(t);
+	free(partials);
+
+	*iterations = k;
+	return converged ? 0 : -1;
+}
+
+#undef real
+#undef sparse_t
+#undef sparse_copy
+#undef sparse_convert
+#undef sparse_spmv_dot
+#undef sparse_diagonal
+#undef sparse_scale
+#undef sparse_free
+#undef krylov_setup
+#undef krylov_cg
+#undef krylov_bicgstab
@@ -0,0 +1,119 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Test of Krylov solvers: the system with random solution is solved
+ * from zero initial guess, the residual history is printed, and the
+ * true residual and error of the result are computed in double.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define sparse_t ssparse_t
+#define sparse_select ssparse_select
+#define krylov_cg skrylov_cg
+#define krylov_bicgstab skrylov_bicgstab
+#define krylov_test skrylov_test
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define sparse_t dsparse_t
+#define sparse_select dsparse_select
+#define krylov_cg dkrylov_cg
+#define krylov_bicgstab dkrylov_bicgstab
+#define krylov_test dkrylov_test
+#endif
+
+// Solve the system with square CSR matrix A by the solver (cg or
+// bicgstab) with SpMV in the format, to relative residual tol
+// in at most maxiter iterations. The test passes, if the solver has
+// converged, and the true relative residual is at most
+// KRYLOV_TOLERANCE_FACTOR times tol.
+int krylov_test(const sparse_t* A, sparse_format_t format, const char* solver,
+	double tol, int maxiter)
+{
+	int n = A->n;
+	assert(A->m == n);
+	if (format == SPARSE_AUTO)
+		format = sparse_select(A, NULL);
+
+	real* x = (real*)calloc(n, sizeof(real)); assert(x);
+	real* b = (real*)malloc(n * sizeof(real)); assert(b);
+	real* x_ref = (real*)malloc(n * sizeof(real)); assert(x_ref);
+	double* residual = (double*)malloc((maxiter + 1) * sizeof(double));
+	double* time = (double*)malloc((maxiter + 1) * sizeof(double));
+	assert(residual && time);
+
+	for (int i = 0; i < n; i++)
+		x_ref[i] = rand() / (real)RAND_MAX - (real)0.5;
+	for (int i = 0; i < n; i++)
+	{
+		double s = 0;
+		for (int p = A->rowptr[i]; p < A->rowptr[i + 1]; p++)
+			s += (double)A->val[p] * x_ref[A->colind[p]];
+		b[i] = s;
+	}
+
+	int iterations, status;
+	if (!strcmp(solver, "cg"))
+		status = krylov_cg(A, format, b, x, tol, maxiter, &iterations, residual, time);
+	else if (!strcmp(solver, "bicgstab"))
+		status = krylov_bicgstab(A, format, b, x, tol, maxiter, &iterations, residual, time);
+	else
+		assert(0 && "Unknown solver");
+
+	// Residual history at powers of two and at the last iteration.
+	printf("iter\ttime\t\titer time\tresidual\n");
+	for (int k = 0; k <= iterations; k++)
+		if (!(k & (k - 1)) || (k == iterations))
+			printf("%d\t%f sec\t%f sec\t%e\n", k, time[k],
+				k ? time[k] - time[k - 1] : time[k], residual[k]);
+
+	double rnorm = 0, bnorm = 0, enorm = 0, xnorm = 0;
+	for (int i = 0; i < n; i++)
+	{
+		double s = b[i];
+		for (int p = A->rowptr[i]; p < A->rowptr[i + 1]; p++)
+			s -= (double)A->val[p] * x[A->colind[p]];
+		rnorm += s * s;
+		bnorm += (double)b[i] * b[i];
+		enorm += ((double)x[i] - x_ref[i]) * ((double)x[i] - x_ref[i]);
+		xnorm += (double)x_ref[i] * x_ref[i];
+	}
+	rnorm = sqrt(rnorm / bnorm);
+	enorm = sqrt(enorm / xnorm);
+	int passed = !status && (rnorm <= KRYLOV_TOLERANCE_FACTOR * tol);
+
+	// Time of iteration 0 is the setup: scaling and conversion.
+	double iteration = iterations ?
+		(time[iterations] - time[0]) / iterations : 0;
+	printf("n\tnnz\tformat\tsolver\titers\ttime\t\titer time\ttest\tresidual\terror\n");
+	printf("%d\t%zu\t%s\t%s\t%d\t%f sec\t%f sec\t%s\t%e\t%e\n", n, A->nnz,
+		sparse_format_names[format], solver, iterations, time[iterations],
+		iteration, passed ? "PASSED" : "FAILED", rnorm, enorm);
+	fflush(stdout);
+
+	free(x);
+	free(b);
+	free(x_ref);
+	free(residual);
+	free(time);
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#undef real
+#undef sparse_t
+#undef sparse_select
+#undef krylov_cg
+#undef krylov_bicgstab
+#undef krylov_test
@@ -0,0 +1,133 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * This sample converts the matrix, read from file in the format of
+ * Assignments/1/matrix.txt or generated, to CSR, ELL and DIA sparse
+ * formats, and measures the multithreaded SpMV in each of them,
+ * or solves the system with it by CG or BiCGSTAB.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The number of timed runs, the best one is taken.
+#define SPARSE_RUNS 10
+
+// The maximum relative norm of difference from the reference.
+#define SPARSE_TOLERANCE 1e-6
+
+// Formats storing more than SPARSE_MAX_FILL times nonzeros are not
+// tested, matrices larger than SPARSE_MAX_DENSE are not tested as dense.
+#define SPARSE_MAX_FILL 20
+#define SPARSE_MAX_DENSE (1 << 26)
+
+// The maximum row length of generated power-law matrix.
+#define SPARSE_MAX_ROW 1000
+
+// The maximum true residual of solution, relative to solver tolerance,
+// and the default tolerance and number of iterations.
+#define KRYLOV_TOLERANCE_FACTOR 10
+#define KRYLOV_TOLERANCE_SINGLE 1e-5
+#define KRYLOV_TOLERANCE_DOUBLE 1e-10
+#define KRYLOV_MAXITER 10000
+
+#define HAVE_SINGLE
+#include "sparse.h"
+#include "sparse_test.h"
+#include "krylov.h"
+#include "krylov_test.h"
+#undef HAVE_SINGLE
+
+#define HAVE_DOUBLE
+#include "sparse.h"
+#include "sparse_test.h"
+#include "krylov.h"
+#include "krylov_test.h"
+#undef HAVE_DOUBLE
+
+int main(int argc, char* argv[])
+{
+	if ((argc < 3) || (argc > 8))
+	{
+		printf("Usage: %s <precision> <matrix_file> [<format> [<solver> [<tol> [<maxiter>]]]]\n", argv[0]);
+		printf("       %s <precision> <generator> <n> [<format> [<solver> [<tol> [<maxiter>]]]]\n", argv[0]);
+		printf("where generator is laplace, laplace2d or convdiff2d (n x n grid), uniform or powerlaw,\n");
+		printf("format is csr, ell, dia or auto (all formats, the chosen one marked),\n");
+		printf("and solver is spmv (the default), cg or bicgstab\n");
+		return 0;
+	}
+
+	int precision = atoi(argv[1]);
+	assert((precision == 4) || (precision == 8));
+
+	// Argument is either the matrix file,
+	// or the generator with the size.
+	ssparse_t sA;
+	dsparse_t dA;
+	int iarg = 3;
+	FILE* file = fopen(argv[2], "r");
+	if (file)
+	{
+		fclose(file);
+		int status = (precision == 4) ? ssparse_read(argv[2], &sA) :
+			dsparse_read(argv[2], &dA);
+		if (status) return EXIT_FAILURE;
+	}
+	else
+	{
+		assert(argc >= 4);
+		int n = atoi(argv[3]);
+		assert(n > 0);
+		int status = (precision == 4) ? ssparse_generate(argv[2], n, &sA) :
+			dsparse_generate(argv[2], n, &dA);
+		assert(!status && "Unknown generator");
+		iarg = 4;
+	}
+
+	int format = SPARSE_AUTO;
+	if (argc > iarg)
+	{
+		format = sparse_format_parse(argv[iarg]);
+		assert(format >= 0);
+	}
+
+	const char* solver = (argc > iarg + 1) ? argv[iarg + 1] : "spmv";
+	double tol = (argc > iarg + 2) ? atof(argv[iarg + 2]) :
+		(precision == 4) ? KRYLOV_TOLERANCE_SINGLE : KRYLOV_TOLERANCE_DOUBLE;
+	int maxiter = (argc > iarg + 3) ? atoi(argv[iarg + 3]) : KRYLOV_MAXITER;
+	assert((tol > 0) && (maxiter >= 0));
+
+	printf("%d OpenMP threads used\n", omp_get_max_threads());
+
+	int status;
+	if (strcmp(solver, "spmv"))
+	{
+		status = (precision == 4) ?
+			skrylov_test(&sA, format, solver, tol, maxiter) :
+			dkrylov_test(&dA, format, solver, tol, maxiter);
+	}
+	else
+	{
+		printf("n\tnnz\tformat\tstored\ttime\t\tGB/s\t\tgflops\t\ttest\terror\n");
+		status = (precision == 4) ? ssparse_test(&sA, format) :
+			dsparse_test(&dA, format);
+	}
+
+	if (precision == 4) ssparse_free(&sA);
+	else dsparse_free(&dA);
+
+	return status;
+}
@@ -0,0 +1,536 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Sparse matrices in CSR, ELL and DIA formats and the multithreaded
+ * sparse matrix-vector product for each of them. Matrices are built in
+ * CSR (from dense array or from the text file in the format of
+ * Assignments/1/matrix.txt), then converted to the format, chosen by
+ * band structure and variance of row lengths. Rows are split between
+ * threads once, at conversion: CSR rows are balanced by the number of
+ * nonzeros, ELL and DIA rows are of equal work anyway.
+ */
+
+#ifndef SPARSE_FORMATS_H
+#define SPARSE_FORMATS_H
+
+typedef enum
+{
+	SPARSE_CSR = 0,
+	SPARSE_ELL,
+	SPARSE_DIA,
+	SPARSE_AUTO
+}
+sparse_format_t;
+
+static const char* sparse_format_names[] = { "csr", "ell", "dia", "auto" };
+
+// DIA is chosen, if padded diagonals take at most
+// SPARSE_DIA_FILL times the number of nonzeros.
+#ifndef SPARSE_DIA_FILL
+#define SPARSE_DIA_FILL 1.5
+#endif
+
+// ELL is chosen, if padded rows take at most SPARSE_ELL_FILL times
+// the number of nonzeros, and the standard deviation of row length
+// is at most SPARSE_ELL_CV of its mean.
+#ifndef SPARSE_ELL_FILL
+#define SPARSE_ELL_FILL 1.5
+#endif
+#ifndef SPARSE_ELL_CV
+#define SPARSE_ELL_CV 0.5
+#endif
+
+// The number of rows, processed at once in ELL and DIA products:
+// partial sums are kept in cache while diagonals or columns are added.
+#ifndef SPARSE_BLOCK
+#define SPARSE_BLOCK 512
+#endif
+
+// The minimal CSR row length, summed with SIMD gather.
+#ifndef SPARSE_SIMD_ROW
+#define SPARSE_SIMD_ROW 32
+#endif
+
+// Get the format by name, or -1 if there is no such.
+static int sparse_format_parse(const char* name)
+{
+	for (int i = 0; i <= SPARSE_AUTO; i++)
+		if (!strcmp(name, sparse_format_names[i]))
+			return i;
+	return -1;
+}
+
+#endif // SPARSE_FORMATS_H
+
+#ifdef HAVE_SINGLE
+#define real float
+#define sparse_t ssparse_t
+#define sparse_from_dense ssparse_from_dense
+#define sparse_read ssparse_read
+#define sparse_append ssparse_append
+#define sparse_select ssparse_select
+#define sparse_partition ssparse_partition
+#define sparse_convert ssparse_convert
+#define sparse_spmv ssparse_spmv
+#define sparse_spmv_dot ssparse_spmv_dot
+#define sparse_diagonal ssparse_diagonal
+#define sparse_scale ssparse_scale
+#define sparse_bytes ssparse_bytes
+#define sparse_free ssparse_free
+#define sparse_copy ssparse_copy
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define sparse_t dsparse_t
+#define sparse_from_dense dsparse_from_dense
+#define sparse_read dsparse_read
+#define sparse_append dsparse_append
+#define sparse_select dsparse_select
+#define sparse_partition dsparse_partition
+#define sparse_convert dsparse_convert
+#define sparse_spmv dsparse_spmv
+#define sparse_spmv_dot dsparse_spmv_dot
+#define sparse_diagonal dsparse_diagonal
+#define sparse_scale dsparse_scale
+#define sparse_bytes dsparse_bytes
+#define sparse_free dsparse_free
+#define sparse_copy dsparse_copy
+#endif
+
+// Sparse m x n matrix. Arrays of the formats:
+// CSR - rowptr[m + 1], colind[nnz] and val[nnz];
+// ELL - colind[m * width] and val[m * width], column-major,
+//	padding has zero values and the last column index of row;
+// DIA - offsets[ndiags] and val[m * ndiags], column-major,
+//	A(i, i + offsets[d]) = val[i + d * m], padding is zero.
+typedef struct
+{
+	sparse_format_t format;
+	int m, n;
+	size_t nnz;
+
+	int* rowptr;
+	int* colind;
+	int width, ndiags;
+	int* offsets;
+	real* val;
+
+	// Rows of part t are parts[t] .. parts[t + 1] - 1.
+	int nparts;
+	int* parts;
+}
+sparse_t;
+
+// Release arrays of the matrix.
+void sparse_free(sparse_t* A)
+{
+	if (A->rowptr) free(A->rowptr);
+	if (A->colind) free(A->colind);
+	if (A->offsets) free(A->offsets);
+	if (A->val) free(A->val);
+	if (A->parts) free(A->parts);
+	memset(A, 0, sizeof(sparse_t));
+}
+
+// Copy CSR matrix A into B.
+void sparse_copy(const sparse_t* A, sparse_t* B)
+{
+	assert(A->format == SPARSE_CSR);
+	memset(B, 0, sizeof(sparse_t));
+	B->format = SPARSE_CSR;
+	B->m = A->m; B->n = A->n; B->nnz = A->nnz;
+	B->rowptr = (int*)malloc((A->m + 1) * sizeof(int)); assert(B->rowptr);
+	B->colind = (int*)malloc(A->nnz * sizeof(int)); assert(B->colind);
+	B->val = (real*)malloc(A->nnz * sizeof(real)); assert(B->val);
+	memcpy(B->rowptr, A->rowptr, (A->m + 1) * sizeof(int));
+	memcpy(B->colind, A->colind, A->nnz * sizeof(int));
+	memcpy(B->val, A->val, A->nnz * sizeof(real));
+}
+
+// Append element to CSR matrix being built row by row,
+// capacity is the allocated length of colind and val.
+static void sparse_append(sparse_t* A, size_t* capacity, int j, real a)
+{
+	if (A->nnz == *capacity)
+	{
+		*capacity = *capacity ? 2 * *capacity : 1024;
+		A->colind = (int*)realloc(A->colind, *capacity * sizeof(int));
+		A->val = (real*)realloc(A->val, *capacity * sizeof(real));
+		assert(A->colind && A->val);
+	}
+	A->colind[A->nnz] = j;
+	A->val[A->nnz] = a;
+	A->nnz++;
+}
+
+// Build CSR matrix from m x n dense one.
+void sparse_from_dense(int m, int n, const real* D, int ldd, sparse_t* A)
+{
+	memset(A, 0, sizeof(sparse_t));
+	A->format = SPARSE_CSR;
+	A->m = m; A->n = n;
+	A->rowptr = (int*)malloc((m + 1) * sizeof(int)); assert(A->rowptr);
+
+	size_t capacity = 0;
+	for (int i = 0; i < m; i++)
+	{
+		A->rowptr[i] = A->nnz;
+		for (int j = 0; j < n; j++)
+			if (D[i + (size_t)j * ldd] != 0)
+				sparse_append(A, &capacity, j, D[i + (size_t)j * ldd]);
+	}
+	A->rowptr[m] = A->nnz;
+}
+
+// Read CSR matrix from the text file: the number of rows and columns,
+// followed by elements row by row. Dense matrix is never stored, so
+// the file size is the only limit. Returns 0 on success.
+int sparse_read(const char* filename, sparse_t* A)
+{
+	memset(A, 0, sizeof(sparse_t));
+	FILE* file = fopen(filename, "r");
+	if (!file) return -1;
+
+	int m = 0, n = 0;
+	if ((fscanf(file, "%d %d", &m, &n) != 2) || (m <= 0) || (n <= 0))
+	{
+		fprintf(stderr, "%s: expected matrix dimensions\n", filename);
+		fclose(file);
+		return -1;
+	}
+
+	A->format = SPARSE_CSR;
+	A->m = m; A->n = n;
+	A->rowptr = (int*)malloc((m + 1) * sizeof(int)); assert(A->rowptr);
+
+	size_t capacity = 0;
+	for (int i = 0; i < m; i++)
+	{
+		A->rowptr[i] = A->nnz;
+		for (int j = 0; j < n; j++)
+		{
+			double a;
+			if (fscanf(file, "%lf", &a) != 1)
+			{
+				fprintf(stderr, "%s: expected %d x %d elements\n", filename, m, n);
+				fclose(file);
+				sparse_free(A);
+				return -1;
+			}
+			if (a != 0) sparse_append(A, &capacity, j, (real)a);
+		}
+	}
+	A->rowptr[m] = A->nnz;
+
+	fclose(file);
+	return 0;
+}
+
+// Choose the format of CSR matrix: DIA for few dense diagonals, ELL for
+// rows of about the same length, CSR otherwise. Returns the format and
+// the number of stored elements in it.
+sparse_format_t sparse_select(const sparse_t* A, size_t* stored)
+{
+	assert(A->format == SPARSE_CSR);
+	int m = A->m, n = A->n;
+	size_t nnz = A->nnz;
+
+	// Count distinct diagonals.
+	char* used = (char*)calloc((size_t)m + n, 1); assert(used);
+	int ndiags = 0, width = 0;
+	double sum2 = 0;
+	for (int i = 0; i < m; i++)
+	{
+		int length = A->rowptr[i + 1] - A->rowptr[i];
+		if (length > width) width = length;
+		sum2 += (double)length * length;
+		for (int p = A->rowptr[i]; p < A->rowptr[i + 1]; p++)
+		{
+			size_t d = (size_t)A->colind[p] - i + m - 1;
+			if (!used[d]) { used[d] = 1; ndiags++; }
+		}
+	}
+	free(used);
+
+	double mean = (double)nnz / m;
+	double sigma = sqrt(fmax(sum2 / m - mean * mean, 0));
+
+	if ((double)ndiags * m <= SPARSE_DIA_FILL * nnz)
+	{
+		if (stored) *stored = (size_t)ndiags * m;
+		return SPARSE_DIA;
+	}
+	if (((double)width * m <= SPARSE_ELL_FILL * nnz) && (sigma <= SPARSE_ELL_CV * mean))
+	{
+		if (stored) *stored = (size_t)width * m;
+		return SPARSE_ELL;
+	}
+	if (stored) *stored = nnz;
+	return SPARSE_CSR;
+}
+
+// Split rows into nparts parts of equal work: the number of nonzeros
+// plus one per row for CSR, or the number of rows for other formats.
+// Parts are made of whole blocks of SPARSE_BLOCK rows, so per-block
+// partial sums do not depend on the number of parts.
+void sparse_partition(sparse_t* A, int nparts)
+{
+	if (A->parts) free(A->parts);
+	A->nparts = nparts;
+	A->parts = (int*)malloc((nparts + 1) * sizeof(int)); assert(A->parts);
+
+	int m = A->m;
+	A->parts[0] = 0;
+	for (int t = 1; t < nparts; t++)
+	{
+		size_t rows;
+		if (A->format == SPARSE_CSR)
+		{
+			// The first row, where the work reaches t-th share.
+			double work = (double)t * (A->nnz + m) / nparts;
+			int lo = A->parts[t - 1], hi = m;
+			while (lo < hi)
+			{
+				int mid = lo + (hi - lo) / 2;
+				if ((double)A->rowptr[mid] + mid < work) lo = mid + 1;
+				else hi = mid;
+			}
+			rows = ((size_t)lo + SPARSE_BLOCK / 2) / SPARSE_BLOCK * SPARSE_BLOCK;
+		}
+		else
+			rows = (size_t)t * m / nparts / SPARSE_BLOCK * SPARSE_BLOCK;
+		if (rows < (size_t)A->parts[t - 1]) rows = A->parts[t - 1];
+		if (rows > (size_t)m) rows = m;
+		A->parts[t] = (int)rows;
+	}
+	A->parts[nparts] = m;
+}
+
+// Convert CSR matrix to the format (SPARSE_AUTO means sparse_select)
+// and split it between OpenMP threads.
+void sparse_convert(sparse_t* A, sparse_format_t format)
+{
+	assert(A->format == SPARSE_CSR);
+	if (format == SPARSE_AUTO)
+		format = sparse_select(A, NULL);
+
+	int m = A->m, n = A->n;
+	if (format == SPARSE_ELL)
+	{
+		int width = 0;
+		for (int i = 0; i < m; i++)
+			if (A->rowptr[i + 1] - A->rowptr[i] > width)
+				width = A->rowptr[i + 1] - A->rowptr[i];
+
+		int* colind = (int*)malloc((size_t)m * width * sizeof(int)); assert(colind);
+		real* val = (real*)malloc((size_t)m * width * sizeof(real)); assert(val);
+
+		#pragma omp parallel for
+		for (int i = 0; i < m; i++)
+		{
+			int start = A->rowptr[i], length = A->rowptr[i + 1] - start;
+			int last = length ? A->colind[start + length - 1] : (i < n ? i : n - 1);
+			for (int p = 0; p < width; p++)
+			{
+				colind[i + (size_t)p * m] = (p < length) ? A->colind[start + p] : last;
+				val[i + (size_t)p * m] = (p < length) ? A->val[start + p] : 0;
+			}
+		}
+
+		free(A->rowptr); A->rowptr = NULL;
+		free(A->colind); A->colind = colind;
+		free(A->val); A->val = val;
+		A->width = width;
+	}
+	if (format == SPARSE_DIA)
+	{
+		// Diagonal index of offset d is index[d + m - 1].
+		int* index = (int*)malloc(((size_t)m + n) * sizeof(int)); assert(index);
+		for (size_t d = 0; d < (size_t)m + n; d++)
+			index[d] = -1;
+		for (int i = 0; i < m; i++)
+			for (int p = A->rowptr[i]; p < A->rowptr[i + 1]; p++)
+				index[(size_t)A->colind[p] - i + m - 1] = 0;
+
+		int ndiags = 0;
+		for (size_t d = 0; d < (size_t)m + n; d++)
+			if (!index[d]) index[d] = ndiags++;
+		int* offsets = (int*)malloc(ndiags * sizeof(int)); assert(offsets);
+		for (size_t d = 0; d < (size_t)m + n; d++)
+			if (index[d] >= 0) offsets[index[d]] = (int)((long)d - m + 1);
+
+		real* val = (real*)calloc((size_t)m * ndiags, sizeof(real)); assert(val);
+		#pragma omp parallel for
+		for (int i = 0; i < m; i++)
+			for (int p = A->rowptr[i]; p < A->rowptr[i + 1]; p++)
+				val[i + (size_t)index[(size_t)A->colind[p] - i + m - 1] * m] = A->val[p];
+		free(index);
+
+		free(A->rowptr); A->rowptr = NULL;
+		free(A->colind); A->colind = NULL;
+		free(A->val); A->val = val;
+		A->offsets = offsets;
+		A->ndiags = ndiags;
+	}
+
+	A->format = format;
+	sparse_partition(A, omp_get_max_threads());
+}
+
+// Compute y = A * x, each thread taking its part of rows. If wy or yy
+// is not NULL, the sums of w[i] * y[i] or y[i] * y[i] over each block
+// of SPARSE_BLOCK rows are written into it, one per block, while
+// the block of y is in cache (A must be square).
+void sparse_spmv_dot(const sparse_t* A, const real* x, real* y,
+	const real* w, double* wy, double* yy)
+{
+	int m = A->m, n = A->n;
+	assert(!(wy || yy) || (m == n));
+	#pragma omp parallel
+	for (int t = omp_get_thread_num(); t < A->nparts; t += omp_get_num_threads())
+	{
+		int r0 = A->parts[t], r1 = A->parts[t + 1];
+		real s[SPARSE_BLOCK];
+		for (int i0 = r0; i0 < r1; i0 += SPARSE_BLOCK)
+		{
+			int i1 = r1 - i0 < SPARSE_BLOCK ? r1 : i0 + SPARSE_BLOCK;
+			if (A->format == SPARSE_CSR)
+			{
+				const int* rowptr = A->rowptr;
+				const int* colind = A->colind;
+				const real* val = A->val;
+				for (int i = i0; i < i1; i++)
+				{
+					// Short rows are not worth vector reduction.
+					int start = rowptr[i], end = rowptr[i + 1];
+					real si = 0;
+					if (end - start >= SPARSE_SIMD_ROW)
+					{
+						#pragma omp simd reduction(+:si)
+						for (int p = start; p < end; p++)
+							si += val[p] * x[colind[p]];
+					}
+					else
+						for (int p = start; p < end; p++)
+							si += val[p] * x[colind[p]];
+					y[i] = si;
+				}
+			}
+			else
+			{
+				// ELL and DIA add columns to the block of partial sums.
+				for (int i = 0; i < i1 - i0; i++)
+					s[i] = 0;
+
+				if (A->format == SPARSE_ELL)
+					for (int p = 0; p < A->width; p++)
+					{
+						const int* c = A->colind + (size_t)p * m;
+						const real* v = A->val + (size_t)p * m;
+						#pragma omp simd
+						for (int i = i0; i < i1; i++)
+							s[i - i0] += v[i] * x[c[i]];
+					}
+				else
+					for (int d = 0; d < A->ndiags; d++)
+					{
+						int offset = A->offsets[d];
+						int lo = i0 > -offset ? i0 : -offset;
+						int hi = i1 < n - offset ? i1 : n - offset;
+						const real* v = A->val + (size_t)d * m;
+						const real* xd = x + offset;
+						#pragma omp simd
+						for (int i = lo; i < hi; i++)
+							s[i - i0] += v[i] * xd[i];
+					}
+
+				for (int i = i0; i < i1; i++)
+					y[i] = s[i - i0];
+			}
+
+			if (wy)
+			{
+				double sum = 0;
+				#pragma omp simd reduction(+:sum)
+				for (int i = i0; i < i1; i++)
+					sum += (double)w[i] * y[i];
+				wy[i0 / SPARSE_BLOCK] = sum;
+			}
+			if (yy)
+			{
+				double sum = 0;
+				#pragma omp simd reduction(+:sum)
+				for (int i = i0; i < i1; i++)
+					sum += (double)y[i] * y[i];
+				yy[i0 / SPARSE_BLOCK] = sum;
+			}
+		}
+	}
+}
+
+// Compute y = A * x.
+void sparse_spmv(const sparse_t* A, const real* x, real* y)
+{
+	sparse_spmv_dot(A, x, y, NULL, NULL, NULL);
+}
+
+// Get the diagonal of square CSR matrix.
+void sparse_diagonal(const sparse_t* A, real* d)
+{
+	assert((A->format == SPARSE_CSR) && (A->m == A->n));
+	#pragma omp parallel for
+	for (int i = 0; i < A->m; i++)
+	{
+		d[i] = 0;
+		for (int p = A->rowptr[i]; p < A->rowptr[i + 1]; p++)
+			if (A->colind[p] == i) d[i] += A->val[p];
+	}
+}
+
+// Scale CSR matrix rows by dl and columns by dr: A = diag(dl) A diag(dr).
+void sparse_scale(sparse_t* A, const real* dl, const real* dr)
+{
+	assert(A->format == SPARSE_CSR);
+	#pragma omp parallel for
+	for (int i = 0; i < A->m; i++)
+		for (int p = A->rowptr[i]; p < A->rowptr[i + 1]; p++)
+			A->val[p] *= dl[i] * dr[A->colind[p]];
+}
+
+// Get the number of bytes, read and written by SpMV.
+size_t sparse_bytes(const sparse_t* A)
+{
+	size_t vectors = ((size_t)A->m + A->n) * sizeof(real);
+	if (A->format == SPARSE_CSR)
+		return vectors + A->nnz * (sizeof(real) + sizeof(int)) +
+			((size_t)A->m + 1) * sizeof(int);
+	if (A->format == SPARSE_ELL)
+		return vectors + (size_t)A->m * A->width * (sizeof(real) + sizeof(int));
+	return vectors + (size_t)A->m * A->ndiags * sizeof(real);
+}
+
+#undef real
+#undef sparse_t
+#undef sparse_from_dense
+#undef sparse_read
+#undef sparse_append
+#undef sparse_select
+#undef sparse_partition
+#undef sparse_convert
+#undef sparse_spmv
+#undef sparse_spmv_dot
+#undef sparse_diagonal
+#undef sparse_scale
+#undef sparse_bytes
+#undef sparse_free
+#undef sparse_copy
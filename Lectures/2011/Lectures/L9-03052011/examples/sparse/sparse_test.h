@@ -0,0 +1,260 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Test matrices and test of SpMV: the product in each format is
+ * checked against the serial CSR product with double precision sums.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define sparse_t ssparse_t
+#define sparse_generate ssparse_generate
+#define sparse_select ssparse_select
+#define sparse_convert ssparse_convert
+#define sparse_spmv ssparse_spmv
+#define sparse_bytes ssparse_bytes
+#define sparse_free ssparse_free
+#define sparse_copy ssparse_copy
+#define sparse_append ssparse_append
+#define sparse_test ssparse_test
+#define sparse_report ssparse_report
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define sparse_t dsparse_t
+#define sparse_generate dsparse_generate
+#define sparse_select dsparse_select
+#define sparse_convert dsparse_convert
+#define sparse_spmv dsparse_spmv
+#define sparse_bytes dsparse_bytes
+#define sparse_free dsparse_free
+#define sparse_copy dsparse_copy
+#define sparse_append dsparse_append
+#define sparse_test dsparse_test
+#define sparse_report dsparse_report
+#endif
+
+// Generate CSR matrix of n rows. Returns 0 on success, if there is
+// such generator:
+// laplace - the tridiagonal matrix of the assignment at scale,
+//	-2 on the diagonal and 1 off the diagonal;
+// laplace2d - 5-point Laplacian on n x n grid (n^2 rows);
+// convdiff2d - 5-point upwind convection-diffusion on n x n grid,
+//	nonsymmetric, with the convection growing along the grid rows;
+// uniform - 8 random columns in each row;
+// powerlaw - random columns, row lengths of power-law distribution
+//	(mean 6.7, at most SPARSE_MAX_ROW).
+int sparse_generate(const char* name, int n, sparse_t* A)
+{
+	memset(A, 0, sizeof(sparse_t));
+	int m = n;
+	if (!strcmp(name, "laplace2d") || !strcmp(name, "convdiff2d")) m = n * n;
+	else if (strcmp(name, "laplace") && strcmp(name, "uniform") &&
+		strcmp(name, "powerlaw"))
+		return -1;
+
+	A->format = SPARSE_CSR;
+	A->m = m; A->n = m;
+	A->rowptr = (int*)malloc((m + 1) * sizeof(int)); assert(A->rowptr);
+
+	size_t capacity = 0;
+	for (int i = 0; i < m; i++)
+	{
+		A->rowptr[i] = A->nnz;
+		if (!strcmp(name, "laplace"))
+		{
+			if (i > 0) sparse_append(A, &capacity, i - 1, 1);
+			sparse_append(A, &capacity, i, -2);
+			if (i < m - 1) sparse_append(A, &capacity, i + 1, 1);
+		}
+		else if (!strcmp(name, "laplace2d"))
+		{
+			if (i >= n) sparse_append(A, &capacity, i - n, -1);
+			if (i % n) sparse_append(A, &capacity, i - 1, -1);
+			sparse_append(A, &capacity, i, 4);
+			if ((i + 1) % n) sparse_append(A, &capacity, i + 1, -1);
+			if (i + n < m) sparse_append(A, &capacity, i + n, -1);
+		}
+		else if (!strcmp(name, "convdiff2d"))
+		{
+			real c = (real)10 * (i % n) / n;
+			if (i >= n) sparse_append(A, &capacity, i - n, -1);
+			if (i % n) sparse_append(A, &capacity, i - 1, -1 - c);
+			sparse_append(A, &capacity, i, 4 + c);
+			if ((i + 1) % n) sparse_append(A, &capacity, i + 1, -1);
+			if (i + n < m) sparse_append(A, &capacity, i + n, -1);
+		}
+		else
+		{
+			int length = 8;
+			if (!strcmp(name, "powerlaw"))
+			{
+				double u = (rand() + 1.0) / ((double)RAND_MAX + 1);
+				double l = 2 / pow(u, 0.7);
+				length = l < SPARSE_MAX_ROW ? (int)l : SPARSE_MAX_ROW;
+				if (length > m) length = m;
+			}
+			for (int p = 0; p < length; p++)
+				sparse_append(A, &capacity, rand() % m,
+					rand() / (real)RAND_MAX - (real)0.5);
+		}
+	}
+	A->rowptr[m] = A->nnz;
+	return 0;
+}
+
+// Time SpMV of A in the format and check it against the reference.
+static int sparse_report(const sparse_t* A, sparse_format_t format, int selected,
+	const real* x, real* y, const double* y_ref)
+{
+	sparse_t B;
+	sparse_copy(A, &B);
+	sparse_convert(&B, format);
+	size_t stored = (format == SPARSE_CSR) ? B.nnz : (format == SPARSE_ELL) ?
+		(size_t)B.m * B.width : (size_t)B.m * B.ndiags;
+
+	printf("%d\t%zu\t%s%s\t%zu\t", A->m, A->nnz, sparse_format_names[format],
+		selected ? "*" : "", stored); fflush(stdout);
+
+	// The first run warms up caches and pages.
+	double best = 0;
+	for (int run = 0; run <= SPARSE_RUNS; run++)
+	{
+		double start = omp_get_wtime();
+		sparse_spmv(&B, x, y);
+		double time = omp_get_wtime() - start;
+		if ((run == 1) || ((run > 1) && (time < best))) best = time;
+	}
+
+	double error_norm = 0, ref_norm = 0;
+	for (int i = 0; i < A->m; i++)
+	{
+		error_norm += (y[i] - y_ref[i]) * (y[i] - y_ref[i]);
+		ref_norm += y_ref[i] * y_ref[i];
+	}
+	error_norm = sqrt(error_norm);
+	ref_norm = sqrt(ref_norm);
+	int passed = error_norm <= SPARSE_TOLERANCE * ref_norm;
+
+	printf("%f sec\t%f\t%f\t%s\t%e\n", best, 1.0e-9 * sparse_bytes(&B) / best,
+		2.0e-9 * A->nnz / best, passed ? "PASSED" : "FAILED", error_norm / ref_norm);
+	fflush(stdout);
+
+	sparse_free(&B);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Test SpMV of CSR matrix A in the given format, or in all formats
+// with the automatically selected one marked, if format is SPARSE_AUTO.
+// Formats, which would store more than SPARSE_MAX_FILL times nonzeros,
+// are skipped. Small matrices are multiplied as dense for comparison.
+int sparse_test(const sparse_t* A, sparse_format_t format)
+{
+	int m = A->m, n = A->n;
+	real* x = (real*)malloc(n * sizeof(real)); assert(x);
+	real* y = (real*)malloc(m * sizeof(real)); assert(y);
+	double* y_ref = (double*)malloc(m * sizeof(double)); assert(y_ref);
+	for (int j = 0; j < n; j++)
+		x[j] = rand() / (real)RAND_MAX;
+	for (int i = 0; i < m; i++)
+	{
+		double s = 0;
+		for (int p = A->rowptr[i]; p < A->rowptr[i + 1]; p++)
+			s += (double)A->val[p] * x[A->colind[p]];
+		y_ref[i] = s;
+	}
+
+	int status = EXIT_SUCCESS;
+	sparse_format_t selected = sparse_select(A, NULL);
+	if (format != SPARSE_AUTO)
+		status = sparse_report(A, format, format == selected, x, y, y_ref);
+	else
+	{
+		// Sizes of padded formats.
+		int width = 0;
+		for (int i = 0; i < m; i++)
+			if (A->rowptr[i + 1] - A->rowptr[i] > width)
+				width = A->rowptr[i + 1] - A->rowptr[i];
+		char* used = (char*)calloc((size_t)m + n, 1); assert(used);
+		size_t ndiags = 0;
+		for (int i = 0; i < m; i++)
+			for (int p = A->rowptr[i]; p < A->rowptr[i + 1]; p++)
+			{
+				size_t d = (size_t)A->colind[p] - i + m - 1;
+				if (!used[d]) { used[d] = 1; ndiags++; }
+			}
+		free(used);
+
+		status |= sparse_report(A, SPARSE_CSR, selected == SPARSE_CSR, x, y, y_ref);
+		if ((double)width * m <= SPARSE_MAX_FILL * A->nnz)
+			status |= sparse_report(A, SPARSE_ELL, selected == SPARSE_ELL, x, y, y_ref);
+		if ((double)ndiags * m <= SPARSE_MAX_FILL * A->nnz)
+			status |= sparse_report(A, SPARSE_DIA, selected == SPARSE_DIA, x, y, y_ref);
+	}
+
+	// Dense product for comparison.
+	if ((size_t)m * n <= SPARSE_MAX_DENSE)
+	{
+		real* D = (real*)calloc((size_t)m * n, sizeof(real)); assert(D);
+		for (int i = 0; i < m; i++)
+			for (int p = A->rowptr[i]; p < A->rowptr[i + 1]; p++)
+				D[i + (size_t)A->colind[p] * m] += A->val[p];
+
+		printf("%d\t%zu\tdense\t%zu\t", m, A->nnz, (size_t)m * n); fflush(stdout);
+
+		double best = 0;
+		for (int run = 0; run <= SPARSE_RUNS; run++)
+		{
+			double start = omp_get_wtime();
+			#pragma omp parallel for
+			for (int i0 = 0; i0 < m; i0 += SPARSE_BLOCK)
+			{
+				int i1 = m - i0 < SPARSE_BLOCK ? m : i0 + SPARSE_BLOCK;
+				for (int i = i0; i < i1; i++)
+					y[i] = 0;
+				for (int j = 0; j < n; j++)
+				{
+					const real* d = D + (size_t)j * m;
+					#pragma omp simd
+					for (int i = i0; i < i1; i++)
+						y[i] += d[i] * x[j];
+				}
+			}
+			double time = omp_get_wtime() - start;
+			if ((run == 1) || ((run > 1) && (time < best))) best = time;
+		}
+		printf("%f sec\t%f\t%f\n", best,
+			1.0e-9 * (m + n + (size_t)m * n) * sizeof(real) / best,
+			2.0e-9 * m * n / best);
+		free(D);
+	}
+
+	free(x);
+	free(y);
+	free(y_ref);
+
+	return status;
+}
+
+#undef real
+#undef sparse_t
+#undef sparse_generate
+#undef sparse_select
+#undef sparse_convert
+#undef sparse_spmv
+#undef sparse_bytes
+#undef sparse_free
+#undef sparse_copy
+#undef sparse_append
+#undef sparse_test
+#undef sparse_report
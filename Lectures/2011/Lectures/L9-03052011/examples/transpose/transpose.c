@@ -0,0 +1,65 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * This sample transposes the matrix out of place and in place, and
+ * converts it between column-major, row-major and tiled layouts,
+ * comparing the bandwidth to the naive loop and memcpy.
+ */
+
+#include <assert.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The number of timed runs, the best one is taken.
+#define TRANSPOSE_RUNS 3
+
+#define HAVE_SINGLE
+#include "transpose.h"
+#include "transpose_test.h"
+#undef HAVE_SINGLE
+
+#define HAVE_DOUBLE
+#include "transpose.h"
+#include "transpose_test.h"
+#undef HAVE_DOUBLE
+
+int main(int argc, char* argv[])
+{
+	if ((argc != 4) && (argc != 6))
+	{
+		printf("Usage: %s <precision> <m> <n> [<mb> <nb>]\n", argv[0]);
+		printf("where mb x nb is the tile size of tiled layout (64 x 64 by default)\n");
+		return 0;
+	}
+
+	int precision = atoi(argv[1]);
+	assert((precision == 4) || (precision == 8));
+
+	int m = atoi(argv[2]), n = atoi(argv[3]);
+	assert((m > 0) && (n > 0));
+
+	int mb = 64, nb = 64;
+	if (argc == 6)
+	{
+		mb = atoi(argv[4]);
+		nb = atoi(argv[5]);
+		assert((mb > 0) && (nb > 0));
+	}
+
+	printf("%d OpenMP threads used\n", omp_get_max_threads());
+	printf("m\tn\tmode\ttime\t\tGB/s\t\ttest\n");
+
+	return (precision == 4) ? stranspose_test(m, n, mb, nb) :
+		dtranspose_test(m, n, mb, nb);
+}
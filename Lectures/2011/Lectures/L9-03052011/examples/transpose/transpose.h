@@ -0,0 +1,514 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Matrix transpose and layout conversion. Small square tiles are
+ * transposed in SIMD registers (16 x 16 floats or 8 x 8 doubles with
+ * AVX-512, 8 x 8 floats or 4 x 4 doubles with AVX). Large matrices are
+ * halved recursively along the longer side, until blocks fit in cache
+ * whatever its size is (cache-oblivious), and halves go to OpenMP tasks.
+ * All matrices are column-major with the given leading dimension, unless
+ * the layout says otherwise.
+ */
+
+#ifndef TRANSPOSE_KERNELS_H
+#define TRANSPOSE_KERNELS_H
+
+#include <immintrin.h>
+
+// Matrix storage layouts. Tiled matrix is the grid of mb x nb tiles,
+// each stored column-major without padding (edge tiles are partially
+// filled), tiles go in column-major order as well.
+typedef enum
+{
+	LAYOUT_COL_MAJOR = 0,
+	LAYOUT_ROW_MAJOR,
+	LAYOUT_TILED
+}
+layout_t;
+
+// The block size, transposed without further recursion.
+#ifndef TRANSPOSE_LEAF
+#define TRANSPOSE_LEAF 128
+#endif
+
+// The minimal number of elements in block, worth the separate task.
+#ifndef TRANSPOSE_TASK
+#define TRANSPOSE_TASK (1 << 16)
+#endif
+
+// The minimal size of destination in bytes, written with streaming
+// stores: larger one would not stay in cache anyway. Otherwise each
+// strided store misses cache and waits for the line to be read.
+#ifndef TRANSPOSE_STREAM
+#define TRANSPOSE_STREAM (1 << 24)
+#endif
+
+// Cache line size in bytes.
+#define TRANSPOSE_LINE 64
+
+// Transpose TB x TB tile: B[j + i * ldb] = A[i + j * lda].
+// Columns of A are loaded into registers, transposed
+// with unpack and shuffle stages and stored as columns of B,
+// with streaming stores, if stream is set (B and ldb must be
+// aligned to TRANSPOSE_VECTOR bytes then).
+#if defined(__AVX512F__)
+#define STRANSPOSE_TB 16
+#define DTRANSPOSE_TB 8
+#define TRANSPOSE_VECTOR 64
+
+// Streaming stores bypass caches, and do not read lines of destination
+// before writing them. Pointer must be aligned to the vector size.
+static inline void transpose_store512_ps(float* p, __m512 v, int stream)
+{
+	if (stream) _mm512_stream_ps(p, v); else _mm512_storeu_ps(p, v);
+}
+
+static inline void transpose_store512_pd(double* p, __m512d v, int stream)
+{
+	if (stream) _mm512_stream_pd(p, v); else _mm512_storeu_pd(p, v);
+}
+
+static inline void stranspose_tile(const float* A, int lda, float* B, int ldb, int stream)
+{
+	__m512 r[16], t[16];
+	for (int j = 0; j < 16; j++)
+		r[j] = _mm512_loadu_ps(A + (size_t)j * lda);
+
+	// Interleave pairs of columns.
+	for (int j = 0; j < 16; j += 2)
+	{
+		t[j] = _mm512_unpacklo_ps(r[j], r[j + 1]);
+		t[j + 1] = _mm512_unpackhi_ps(r[j], r[j + 1]);
+	}
+
+	// Gather quads: each 128-bit lane of r[4g + c] has
+	// element 4 * lane + c of columns 4g .. 4g + 3.
+	for (int g = 0; g < 16; g += 4)
+	{
+		r[g] = _mm512_shuffle_ps(t[g], t[g + 2], 0x44);
+		r[g + 1] = _mm512_shuffle_ps(t[g], t[g + 2], 0xee);
+		r[g + 2] = _mm512_shuffle_ps(t[g + 1], t[g + 3], 0x44);
+		r[g + 3] = _mm512_shuffle_ps(t[g + 1], t[g + 3], 0xee);
+	}
+
+	// Gather lanes in two stages.
+	for (int c = 0; c < 4; c++)
+	{
+		t[c] = _mm512_shuffle_f32x4(r[c], r[4 + c], 0x88);
+		t[4 + c] = _mm512_shuffle_f32x4(r[c], r[4 + c], 0xdd);
+		t[8 + c] = _mm512_shuffle_f32x4(r[8 + c], r[12 + c], 0x88);
+		t[12 + c] = _mm512_shuffle_f32x4(r[8 + c], r[12 + c], 0xdd);
+	}
+	for (int c = 0; c < 4; c++)
+	{
+		transpose_store512_ps(B + (size_t)c * ldb,
+			_mm512_shuffle_f32x4(t[c], t[8 + c], 0x88), stream);
+		transpose_store512_ps(B + (size_t)(8 + c) * ldb,
+			_mm512_shuffle_f32x4(t[c], t[8 + c], 0xdd), stream);
+		transpose_store512_ps(B + (size_t)(4 + c) * ldb,
+			_mm512_shuffle_f32x4(t[4 + c], t[12 + c], 0x88), stream);
+		transpose_store512_ps(B + (size_t)(12 + c) * ldb,
+			_mm512_shuffle_f32x4(t[4 + c], t[12 + c], 0xdd), stream);
+	}
+}
+
+static inline void dtranspose_tile(const double* A, int lda, double* B, int ldb, int stream)
+{
+	__m512d r[8], t[8];
+	for (int j = 0; j < 8; j++)
+		r[j] = _mm512_loadu_pd(A + (size_t)j * lda);
+
+	for (int j = 0; j < 8; j += 2)
+	{
+		t[j] = _mm512_unpacklo_pd(r[j], r[j + 1]);
+		t[j + 1] = _mm512_unpackhi_pd(r[j], r[j + 1]);
+	}
+	for (int g = 0; g < 8; g += 4)
+	{
+		r[g] = _mm512_shuffle_f64x2(t[g], t[g + 2], 0x88);
+		r[g + 1] = _mm512_shuffle_f64x2(t[g + 1], t[g + 3], 0x88);
+		r[g + 2] = _mm512_shuffle_f64x2(t[g], t[g + 2], 0xdd);
+		r[g + 3] = _mm512_shuffle_f64x2(t[g + 1], t[g + 3], 0xdd);
+	}
+	for (int c = 0; c < 4; c++)
+	{
+		transpose_store512_pd(B + (size_t)c * ldb,
+			_mm512_shuffle_f64x2(r[c], r[4 + c], 0x88), stream);
+		transpose_store512_pd(B + (size_t)(4 + c) * ldb,
+			_mm512_shuffle_f64x2(r[c], r[4 + c], 0xdd), stream);
+	}
+}
+#elif defined(__AVX__)
+#define STRANSPOSE_TB 8
+#define DTRANSPOSE_TB 4
+#define TRANSPOSE_VECTOR 32
+
+static inline void transpose_store256_ps(float* p, __m256 v, int stream)
+{
+	if (stream) _mm256_stream_ps(p, v); else _mm256_storeu_ps(p, v);
+}
+
+static inline void transpose_store256_pd(double* p, __m256d v, int stream)
+{
+	if (stream) _mm256_stream_pd(p, v); else _mm256_storeu_pd(p, v);
+}
+
+static inline void stranspose_tile(const float* A, int lda, float* B, int ldb, int stream)
+{
+	__m256 r[8], t[8];
+	for (int j = 0; j < 8; j++)
+		r[j] = _mm256_loadu_ps(A + (size_t)j * lda);
+
+	for (int j = 0; j < 8; j += 2)
+	{
+		t[j] = _mm256_unpacklo_ps(r[j], r[j + 1]);
+		t[j + 1] = _mm256_unpackhi_ps(r[j], r[j + 1]);
+	}
+	for (int g = 0; g < 8; g += 4)
+	{
+		r[g] = _mm256_shuffle_ps(t[g], t[g + 2], 0x44);
+		r[g + 1] = _mm256_shuffle_ps(t[g], t[g + 2], 0xee);
+		r[g + 2] = _mm256_shuffle_ps(t[g + 1], t[g + 3], 0x44);
+		r[g + 3] = _mm256_shuffle_ps(t[g + 1], t[g + 3], 0xee);
+	}
+	for (int c = 0; c < 4; c++)
+	{
+		transpose_store256_ps(B + (size_t)c * ldb,
+			_mm256_permute2f128_ps(r[c], r[4 + c], 0x20), stream);
+		transpose_store256_ps(B + (size_t)(4 + c) * ldb,
+			_mm256_permute2f128_ps(r[c], r[4 + c], 0x31), stream);
+	}
+}
+
+static inline void dtranspose_tile(const double* A, int lda, double* B, int ldb, int stream)
+{
+	__m256d r[4], t[4];
+	for (int j = 0; j < 4; j++)
+		r[j] = _mm256_loadu_pd(A + (size_t)j * lda);
+
+	t[0] = _mm256_unpacklo_pd(r[0], r[1]);
+	t[1] = _mm256_unpackhi_pd(r[0], r[1]);
+	t[2] = _mm256_unpacklo_pd(r[2], r[3]);
+	t[3] = _mm256_unpackhi_pd(r[2], r[3]);
+
+	transpose_store256_pd(B, _mm256_permute2f128_pd(t[0], t[2], 0x20), stream);
+	transpose_store256_pd(B + (size_t)ldb, _mm256_permute2f128_pd(t[1], t[3], 0x20), stream);
+	transpose_store256_pd(B + (size_t)2 * ldb, _mm256_permute2f128_pd(t[0], t[2], 0x31), stream);
+	transpose_store256_pd(B + (size_t)3 * ldb, _mm256_permute2f128_pd(t[1], t[3], 0x31), stream);
+}
+#else
+#define STRANSPOSE_TB 4
+#define DTRANSPOSE_TB 4
+#define TRANSPOSE_VECTOR 0
+
+// Without AVX the tile is transposed by scalar code,
+// which compiler may still vectorize. Stores are regular.
+static inline void stranspose_tile(const float* A, int lda, float* B, int ldb, int stream)
+{
+	for (int j = 0; j < 4; j++)
+		for (int i = 0; i < 4; i++)
+			B[j + (size_t)i * ldb] = A[i + (size_t)j * lda];
+}
+
+static inline void dtranspose_tile(const double* A, int lda, double* B, int ldb, int stream)
+{
+	for (int j = 0; j < 4; j++)
+		for (int i = 0; i < 4; i++)
+			B[j + (size_t)i * ldb] = A[i + (size_t)j * lda];
+}
+#endif
+
+#endif // TRANSPOSE_KERNELS_H
+
+#ifdef HAVE_SINGLE
+#define real float
+#define TB STRANSPOSE_TB
+#define transpose_tile stranspose_tile
+#define transpose_leaf stranspose_leaf
+#define transpose_rec stranspose_rec
+#define transpose stranspose
+#define transpose_swap_leaf stranspose_swap_leaf
+#define transpose_swap_rec stranspose_swap_rec
+#define transpose_square_rec stranspose_square_rec
+#define transpose_square stranspose_square
+#define layout_convert slayout_convert
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define TB DTRANSPOSE_TB
+#define transpose_tile dtranspose_tile
+#define transpose_leaf dtranspose_leaf
+#define transpose_rec dtranspose_rec
+#define transpose dtranspose
+#define transpose_swap_leaf dtranspose_swap_leaf
+#define transpose_swap_rec dtranspose_swap_rec
+#define transpose_square_rec dtranspose_square_rec
+#define transpose_square dtranspose_square
+#define layout_convert dlayout_convert
+#endif
+
+// Transpose m x n block A into n x m block B by tiles,
+// the edges are transposed element by element. Tiles go
+// along columns of B, so that it is written sequentially.
+static void transpose_leaf(int m, int n, const real* A, int lda, real* B, int ldb, int stream)
+{
+	int mt = m / TB * TB, nt = n / TB * TB;
+	for (int i = 0; i < mt; i += TB)
+		for (int j = 0; j < nt; j += TB)
+		{
+			// Regular stores would wait for lines of B, request
+			// them for writing one band of tiles ahead.
+			if (!stream && (i + TB < mt))
+				for (int l = 0; l < TB; l++)
+					__builtin_prefetch(B + j + (size_t)(i + TB + l) * ldb, 1, 3);
+			transpose_tile(A + i + (size_t)j * lda, lda, B + j + (size_t)i * ldb, ldb, stream);
+		}
+
+	for (int j = 0; j < n; j++)
+	{
+		const real* a = A + (size_t)j * lda;
+		for (int i = (j < nt) ? mt : 0; i < m; i++)
+			B[j + (size_t)i * ldb] = a[i];
+	}
+}
+
+// Halve the longer side at the multiple of tile size,
+// until the block is small enough.
+static void transpose_rec(int m, int n, const real* A, int lda, real* B, int ldb, int stream)
+{
+	if ((m <= TRANSPOSE_LEAF) && (n <= TRANSPOSE_LEAF))
+	{
+		transpose_leaf(m, n, A, lda, B, ldb, stream);
+		return;
+	}
+
+	if (m >= n)
+	{
+		int m1 = (m / 2 + TB - 1) / TB * TB;
+		#pragma omp task if ((size_t)m * n > TRANSPOSE_TASK)
+		transpose_rec(m1, n, A, lda, B, ldb, stream);
+		transpose_rec(m - m1, n, A + m1, lda, B + (size_t)m1 * ldb, ldb, stream);
+	}
+	else
+	{
+		int n1 = (n / 2 + TB - 1) / TB * TB;
+		#pragma omp task if ((size_t)m * n > TRANSPOSE_TASK)
+		transpose_rec(m, n1, A, lda, B, ldb, stream);
+		transpose_rec(m, n - n1, A + (size_t)n1 * lda, lda, B + n1, ldb, stream);
+	}
+	#pragma omp taskwait
+}
+
+// Transpose m x n A into n x m B out of place.
+void transpose(int m, int n, const real* A, int lda, real* B, int ldb)
+{
+	// Large B is written with streaming stores from the first aligned
+	// row: splits are multiples of tile size, so all tiles are aligned,
+	// if ldb is. The leading rows are written with regular stores.
+	// Tile column must fill the whole cache line, otherwise partially
+	// written lines are flushed from write combining buffers.
+	int stream = 0, n0 = 0;
+#if TRANSPOSE_VECTOR
+	if ((TB * sizeof(real) % TRANSPOSE_LINE == 0) &&
+		((size_t)m * n * sizeof(real) >= TRANSPOSE_STREAM) &&
+		!(ldb * sizeof(real) % TRANSPOSE_VECTOR) && !((size_t)B % sizeof(real)))
+	{
+		stream = 1;
+		n0 = (TRANSPOSE_VECTOR - (size_t)B % TRANSPOSE_VECTOR) % TRANSPOSE_VECTOR / sizeof(real);
+		if (n0 > n) n0 = n;
+	}
+#endif
+
+	#pragma omp parallel if ((size_t)m * n > TRANSPOSE_TASK)
+	{
+		#pragma omp single
+		{
+			if (n0) transpose_rec(m, n0, A, lda, B, ldb, 0);
+			transpose_rec(m, n - n0, A + (size_t)n0 * lda, lda, B + n0, ldb, stream);
+		}
+
+		// Streaming stores are weakly ordered.
+		if (stream) _mm_sfence();
+	}
+}
+
+// Exchange m x n block A with the transpose of n x m block B
+// (A := B^T, B := A^T), tile by tile through the scratch tile.
+static void transpose_swap_leaf(int m, int n, real* A, int lda, real* B, int ldb)
+{
+	real T[TB * TB];
+	int mt = m / TB * TB, nt = n / TB * TB;
+	for (int j = 0; j < nt; j += TB)
+		for (int i = 0; i < mt; i += TB)
+		{
+			real* a = A + i + (size_t)j * lda;
+			real* b = B + j + (size_t)i * ldb;
+			transpose_tile(a, lda, T, TB, 0);
+			transpose_tile(b, ldb, a, lda, 0);
+			for (int l = 0; l < TB; l++)
+				memcpy(b + (size_t)l * ldb, T + l * TB, TB * sizeof(real));
+		}
+
+	for (int j = 0; j < n; j++)
+		for (int i = (j < nt) ? mt : 0; i < m; i++)
+		{
+			real t = A[i + (size_t)j * lda];
+			A[i + (size_t)j * lda] = B[j + (size_t)i * ldb];
+			B[j + (size_t)i * ldb] = t;
+		}
+}
+
+static void transpose_swap_rec(int m, int n, real* A, int lda, real* B, int ldb)
+{
+	if ((m <= TRANSPOSE_LEAF) && (n <= TRANSPOSE_LEAF))
+	{
+		transpose_swap_leaf(m, n, A, lda, B, ldb);
+		return;
+	}
+
+	if (m >= n)
+	{
+		int m1 = (m / 2 + TB - 1) / TB * TB;
+		#pragma omp task if ((size_t)m * n > TRANSPOSE_TASK)
+		transpose_swap_rec(m1, n, A, lda, B, ldb);
+		transpose_swap_rec(m - m1, n, A + m1, lda, B + (size_t)m1 * ldb, ldb);
+	}
+	else
+	{
+		int n1 = (n / 2 + TB - 1) / TB * TB;
+		#pragma omp task if ((size_t)m * n > TRANSPOSE_TASK)
+		transpose_swap_rec(m, n1, A, lda, B, ldb);
+		transpose_swap_rec(m, n - n1, A + (size_t)n1 * lda, lda, B + n1, ldb);
+	}
+	#pragma omp taskwait
+}
+
+// Diagonal blocks are transposed in place recursively,
+// off-diagonal blocks are exchanged with transposition.
+static void transpose_square_rec(int n, real* A, int lda)
+{
+	if (n <= TB)
+	{
+		for (int j = 0; j < n; j++)
+			for (int i = j + 1; i < n; i++)
+			{
+				real t = A[i + (size_t)j * lda];
+				A[i + (size_t)j * lda] = A[j + (size_t)i * lda];
+				A[j + (size_t)i * lda] = t;
+			}
+		return;
+	}
+
+	int n1 = (n / 2 + TB - 1) / TB * TB, n2 = n - n1;
+	#pragma omp task if ((size_t)n * n > TRANSPOSE_TASK)
+	transpose_square_rec(n1, A, lda);
+	#pragma omp task if ((size_t)n * n > TRANSPOSE_TASK)
+	transpose_square_rec(n2, A + n1 + (size_t)n1 * lda, lda);
+	transpose_swap_rec(n2, n1, A + n1, lda, A + (size_t)n1 * lda, lda);
+	#pragma omp taskwait
+}
+
+// Transpose n x n A in place.
+void transpose_square(int n, real* A, int lda)
+{
+	#pragma omp parallel if ((size_t)n * n > TRANSPOSE_TASK)
+	#pragma omp single
+	transpose_square_rec(n, A, lda);
+}
+
+// Convert m x n matrix A in layout from into B in layout to. Leading
+// dimensions are the column length for column-major layout, the row
+// length for row-major one, and are not used for tiled one. mb and nb
+// are the tile sizes of tiled layout.
+void layout_convert(layout_t from, layout_t to, int m, int n,
+	const real* A, int lda, real* B, int ldb, int mb, int nb)
+{
+	// Row-major m x n matrix is the column-major n x m one.
+	if ((from != LAYOUT_TILED) && (to != LAYOUT_TILED))
+	{
+		if (from == to)
+		{
+			int rows = (from == LAYOUT_COL_MAJOR) ? m : n;
+			int cols = (from == LAYOUT_COL_MAJOR) ? n : m;
+			#pragma omp parallel for if ((size_t)m * n > TRANSPOSE_TASK)
+			for (int j = 0; j < cols; j++)
+				memcpy(B + (size_t)j * ldb, A + (size_t)j * lda, rows * sizeof(real));
+		}
+		else if (from == LAYOUT_COL_MAJOR)
+			transpose(m, n, A, lda, B, ldb);
+		else
+			transpose(n, m, A, lda, B, ldb);
+		return;
+	}
+
+	// Tiles are converted in parallel, each by the single thread.
+	int mt = (m + mb - 1) / mb, nt = (n + nb - 1) / nb;
+	#pragma omp parallel for collapse(2) if ((size_t)m * n > TRANSPOSE_TASK)
+	for (int J = 0; J < nt; J++)
+		for (int I = 0; I < mt; I++)
+		{
+			int i0 = I * mb, j0 = J * nb;
+			int mi = m - i0 < mb ? m - i0 : mb, nj = n - j0 < nb ? n - j0 : nb;
+			size_t tile = ((size_t)I + (size_t)J * mt) * mb * nb;
+
+			// Find the block in source and destination: (pointer, ld),
+			// and whether it is transposed (stored row-major).
+			const real* a = A + tile;
+			int ld_a = mb, row_a = 0;
+			if (from == LAYOUT_COL_MAJOR)
+			{
+				a = A + i0 + (size_t)j0 * lda;
+				ld_a = lda;
+			}
+			if (from == LAYOUT_ROW_MAJOR)
+			{
+				a = A + j0 + (size_t)i0 * lda;
+				ld_a = lda; row_a = 1;
+			}
+			real* b = B + tile;
+			int ld_b = mb, row_b = 0;
+			if (to == LAYOUT_COL_MAJOR)
+			{
+				b = B + i0 + (size_t)j0 * ldb;
+				ld_b = ldb;
+			}
+			if (to == LAYOUT_ROW_MAJOR)
+			{
+				b = B + j0 + (size_t)i0 * ldb;
+				ld_b = ldb; row_b = 1;
+			}
+
+			if (row_a == row_b)
+			{
+				int rows = row_a ? nj : mi, cols = row_a ? mi : nj;
+				for (int j = 0; j < cols; j++)
+					memcpy(b + (size_t)j * ld_b, a + (size_t)j * ld_a, rows * sizeof(real));
+			}
+			else if (row_a)
+				transpose_rec(nj, mi, a, ld_a, b, ld_b, 0);
+			else
+				transpose_rec(mi, nj, a, ld_a, b, ld_b, 0);
+		}
+}
+
+#undef real
+#undef TB
+#undef transpose_tile
+#undef transpose_leaf
+#undef transpose_rec
+#undef transpose
+#undef transpose_swap_leaf
+#undef transpose_swap_rec
+#undef transpose_square_rec
+#undef transpose_square
+#undef layout_convert
@@ -0,0 +1,155 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Test of transpose and layout conversion: each one is timed and its
+ * result is compared to the naive double loop transpose. The bandwidth
+ * counts both reading and writing, so memcpy of the same size is the
+ * upper bound.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define transpose stranspose
+#define transpose_square stranspose_square
+#define layout_convert slayout_convert
+#define transpose_test stranspose_test
+#define transpose_report stranspose_report
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define transpose dtranspose
+#define transpose_square dtranspose_square
+#define layout_convert dlayout_convert
+#define transpose_test dtranspose_test
+#define transpose_report dtranspose_report
+#endif
+
+// Print the time and bandwidth of m x n matrix copy, and compare
+// the result to the reference one, if it is given.
+// Returns the number of mismatching elements.
+static size_t transpose_report(int m, int n, const char* mode, double time,
+	const real* B, const real* Bref)
+{
+	printf("%d\t%d\t%s\t%f sec\t%f", m, n, mode, time,
+		1.0e-9 * 2 * m * n * sizeof(real) / time);
+
+	size_t nerrors = 0;
+	if (Bref)
+	{
+		for (size_t i = 0; i < (size_t)m * n; i++)
+			nerrors += (B[i] != Bref[i]);
+		printf("\t%s", nerrors ? "FAILED" : "PASSED");
+	}
+	printf("\n");
+	fflush(stdout);
+
+	return nerrors;
+}
+
+// Test transpose of m x n matrix and conversions
+// to and from tiled layout with mb x nb tiles.
+int transpose_test(int m, int n, int mb, int nb)
+{
+	int mt = (m + mb - 1) / mb, nt = (n + nb - 1) / nb;
+	size_t size = (size_t)m * n;
+	real* A = (real*)malloc(size * sizeof(real)); assert(A);
+	real* B = (real*)malloc(size * sizeof(real)); assert(B);
+	real* Bref = (real*)malloc(size * sizeof(real)); assert(Bref);
+	real* T = (real*)malloc((size_t)mt * nt * mb * nb * sizeof(real)); assert(T);
+	for (size_t i = 0; i < size; i++)
+		A[i] = (real)i;
+
+	// Touch all pages before timing.
+	memset(B, 0, size * sizeof(real));
+	memset(Bref, 0, size * sizeof(real));
+	memset(T, 0, (size_t)mt * nt * mb * nb * sizeof(real));
+
+	size_t nerrors = 0;
+	double start, best;
+
+	// Take the best of several runs, if they are fast.
+	#define TIMED(code) \
+		best = 0; \
+		for (int run = 0; run < TRANSPOSE_RUNS; run++) \
+		{ \
+			start = omp_get_wtime(); \
+			code; \
+			double time = omp_get_wtime() - start; \
+			if (!run || (time < best)) best = time; \
+			if (best > 1) break; \
+		}
+
+	TIMED(memcpy(B, A, size * sizeof(real)));
+	transpose_report(m, n, "memcpy", best, B, NULL);
+
+	TIMED(
+		for (int i = 0; i < m; i++)
+			for (int j = 0; j < n; j++)
+				Bref[j + (size_t)i * n] = A[i + (size_t)j * m]);
+	transpose_report(m, n, "naive", best, Bref, NULL);
+
+	memset(B, 0, size * sizeof(real));
+	TIMED(transpose(m, n, A, m, B, n));
+	nerrors += transpose_report(m, n, "oop", best, B, Bref);
+
+	// In place transpose of square matrix runs on the copy,
+	// which is then checked after the single run.
+	if (m == n)
+	{
+		memcpy(B, A, size * sizeof(real));
+		TIMED(transpose_square(n, B, n));
+		memcpy(B, A, size * sizeof(real));
+		transpose_square(n, B, n);
+		nerrors += transpose_report(m, n, "inplace", best, B, Bref);
+	}
+
+	// Column-major to tiled and back.
+	TIMED(layout_convert(LAYOUT_COL_MAJOR, LAYOUT_TILED, m, n, A, m, T, 0, mb, nb));
+	transpose_report(m, n, "col2tile", best, NULL, NULL);
+	memset(B, 0, size * sizeof(real));
+	TIMED(layout_convert(LAYOUT_TILED, LAYOUT_COL_MAJOR, m, n, T, 0, B, m, mb, nb));
+	nerrors += transpose_report(m, n, "tile2col", best, B, A);
+
+	// Tiled to row-major is the transpose of column-major one.
+	memset(B, 0, size * sizeof(real));
+	TIMED(layout_convert(LAYOUT_TILED, LAYOUT_ROW_MAJOR, m, n, T, 0, B, n, mb, nb));
+	nerrors += transpose_report(m, n, "tile2row", best, B, Bref);
+
+	// Row-major back to tiled and column-major.
+	memset(T, 0, (size_t)mt * nt * mb * nb * sizeof(real));
+	TIMED(layout_convert(LAYOUT_ROW_MAJOR, LAYOUT_TILED, m, n, Bref, n, T, 0, mb, nb));
+	// Checked in column-major layout.
+	memset(B, 0, size * sizeof(real));
+	layout_convert(LAYOUT_TILED, LAYOUT_COL_MAJOR, m, n, T, 0, B, m, mb, nb);
+	nerrors += transpose_report(m, n, "row2tile", best, B, A);
+
+	memset(B, 0, size * sizeof(real));
+	TIMED(layout_convert(LAYOUT_ROW_MAJOR, LAYOUT_COL_MAJOR, m, n, Bref, n, B, m, mb, nb));
+	nerrors += transpose_report(m, n, "row2col", best, B, A);
+
+	#undef TIMED
+
+	free(A);
+	free(B);
+	free(Bref);
+	free(T);
+
+	return nerrors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#undef real
+#undef transpose
+#undef transpose_square
+#undef layout_convert
+#undef transpose_test
+#undef transpose_report
@@ -0,0 +1,205 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * This sample solves batches of independent tridiagonal systems
+ * by Thomas elimination in SIMD lanes, and long single systems by
+ * cyclic reduction. The matrix is either read from file in the format
+ * of Assignments/1/matrix.txt, or generated. Eigenvalues and
+ * eigenvectors of symmetric tridiagonal matrix are found by bisection
+ * and inverse iteration.
+ */
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The number of timed runs, the best one is taken.
+#define TRIDIAG_RUNS 10
+
+// The maximum scaled residual.
+#define TRIDIAG_TOLERANCE 100
+
+// The maximum number of eigenvectors, checked for orthogonality
+// in all pairs, rather than in neighbouring ones.
+#define TRIDIAG_MAX_ORTHO 256
+
+#define HAVE_SINGLE
+#include "tridiag.h"
+#include "tridiag_test.h"
+#include "tridiag_eigen.h"
+#include "tridiag_eigen_test.h"
+#undef HAVE_SINGLE
+
+#define HAVE_DOUBLE
+#include "tridiag.h"
+#include "tridiag_test.h"
+#include "tridiag_eigen.h"
+#include "tridiag_eigen_test.h"
+#undef HAVE_DOUBLE
+
+// Read the matrix file: the number of rows and columns, followed
+// by elements row by row. Returns the diagonals of tridiagonal matrix.
+static int read_matrix(const char* filename, int* n, double** a, double** b, double** c)
+{
+	FILE* file = fopen(filename, "r");
+	if (!file) return -1;
+
+	int rows = 0, cols = 0;
+	if ((fscanf(file, "%d %d", &rows, &cols) != 2) || (rows <= 0) || (rows != cols))
+	{
+		fprintf(stderr, "%s: expected square matrix dimensions\n", filename);
+		fclose(file);
+		return -1;
+	}
+
+	*a = (double*)calloc(rows, sizeof(double)); assert(*a);
+	*b = (double*)calloc(rows, sizeof(double)); assert(*b);
+	*c = (double*)calloc(rows, sizeof(double)); assert(*c);
+	for (int i = 0; i < rows; i++)
+		for (int j = 0; j < cols; j++)
+		{
+			double value;
+			if (fscanf(file, "%lf", &value) != 1)
+			{
+				fprintf(stderr, "%s: expected %d x %d elements\n", filename, rows, cols);
+				fclose(file);
+				return -1;
+			}
+			if (j == i - 1) (*a)[i] = value;
+			else if (j == i) (*b)[i] = value;
+			else if (j == i + 1) (*c)[i] = value;
+			else if (value != 0)
+			{
+				fprintf(stderr, "%s: element (%d, %d) is out of tridiagonal band\n",
+					filename, i, j);
+				fclose(file);
+				return -1;
+			}
+		}
+
+	fclose(file);
+	*n = rows;
+	return 0;
+}
+
+// Get diagonals of the matrix from file or generate n x n matrix:
+// laplace one, if laplace is set, or random diagonally dominant
+// (for solvers) or random symmetric (for eigensolver) otherwise.
+// Returns 0 on success.
+static int load_matrix(const char* arg, int laplace, int symmetric,
+	int* n, double** a, double** b, double** c)
+{
+	*a = NULL; *b = NULL; *c = NULL;
+	FILE* file = fopen(arg, "r");
+	if (file)
+	{
+		fclose(file);
+		return read_matrix(arg, n, a, b, c);
+	}
+
+	*n = atoi(arg);
+	assert(*n > 0);
+	if (!laplace && !symmetric) return 0;
+
+	*a = (double*)malloc(*n * sizeof(double)); assert(*a);
+	*b = (double*)malloc(*n * sizeof(double)); assert(*b);
+	*c = (double*)malloc(*n * sizeof(double)); assert(*c);
+	for (int i = 0; i < *n; i++)
+	{
+		(*b)[i] = laplace ? -2 : 2 * (rand() / (double)RAND_MAX) - 1;
+		(*c)[i] = (i == *n - 1) ? 0 : laplace ? 1 : 2 * (rand() / (double)RAND_MAX) - 1;
+		(*a)[i] = i ? (*c)[i - 1] : 0;
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if ((argc < 4) || ((argc > 5) && strcmp(argv[2], "eigen")))
+	{
+		printf("Usage: %s <precision> <n | matrix_file> <count> [laplace]\n", argv[0]);
+		printf("       %s <precision> eigen <n | matrix_file> [laplace] "
+			"[index <il> <iu> | value <vl> <vu>] [tol <tol>] [vectors]\n", argv[0]);
+		printf("where count is the number of systems in batch (single system\n");
+		printf("is solved by Thomas elimination and cyclic reduction), random\n");
+		printf("diagonally dominant (symmetric for eigen) matrices are generated,\n");
+		printf("or laplace ones of the same kind as Assignments/1/matrix.txt;\n");
+		printf("eigen finds eigenvalues il .. iu (0-based, all by default)\n");
+		printf("or in [vl, vu) and optionally eigenvectors\n");
+		return 0;
+	}
+
+	int precision = atoi(argv[1]);
+	assert((precision == 4) || (precision == 8));
+
+	int n = 0, status;
+	double *a = NULL, *b = NULL, *c = NULL;
+	printf("%d OpenMP threads used\n", omp_get_max_threads());
+	if (!strcmp(argv[2], "eigen"))
+	{
+		int laplace = 0, by_value = 0, vectors = 0;
+		double lo = 0, hi = -1, tol = 0;
+		for (int i = 4; i < argc; i++)
+		{
+			if (!strcmp(argv[i], "laplace")) laplace = 1;
+			else if (!strcmp(argv[i], "vectors")) vectors = 1;
+			else if (!strcmp(argv[i], "tol") && (i + 1 < argc)) tol = atof(argv[++i]);
+			else if ((!strcmp(argv[i], "index") || !strcmp(argv[i], "value")) &&
+				(i + 2 < argc))
+			{
+				by_value = !strcmp(argv[i], "value");
+				lo = atof(argv[i + 1]);
+				hi = atof(argv[i + 2]);
+				i += 2;
+			}
+			else
+			{
+				fprintf(stderr, "Unknown argument %s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+		}
+		if (load_matrix(argv[3], laplace, 1, &n, &a, &b, &c)) return EXIT_FAILURE;
+		for (int i = 0; i < n - 1; i++)
+			if (a[i + 1] != c[i])
+			{
+				fprintf(stderr, "%s: matrix is not symmetric\n", argv[3]);
+				return EXIT_FAILURE;
+			}
+		if (!by_value && (hi < lo)) hi = n - 1;
+
+		printf("n\tfound\tmethod\ttime\t\ttest\terror\n");
+		status = (precision == 4) ?
+			stridiag_eigen_test(n, b, c, by_value, lo, hi, tol, vectors) :
+			dtridiag_eigen_test(n, b, c, by_value, lo, hi, tol, vectors);
+	}
+	else
+	{
+		int count = atoi(argv[3]);
+		assert(count > 0);
+		if (argc == 5) assert(!strcmp(argv[4], "laplace"));
+		if (load_matrix(argv[2], argc == 5, 0, &n, &a, &b, &c)) return EXIT_FAILURE;
+
+		printf("n\tcount\tmethod\ttime\t\tsystems/s\tGB/s\t\ttest\tresidual\n");
+		status = (precision == 4) ? stridiag_test(n, count, a, b, c) :
+			dtridiag_test(n, count, a, b, c);
+	}
+
+	if (a) free(a);
+	if (b) free(b);
+	if (c) free(c);
+
+	return status;
+}
@@ -0,0 +1,264 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Tridiagonal solvers. Batch of independent systems of the same size
+ * is interleaved by groups of TRIDIAG_LANES systems, so that the same
+ * row of all systems in the group is contiguous, and Thomas elimination
+ * runs over the group in SIMD lanes, groups going to OpenMP threads.
+ * Single long system is solved by cyclic reduction: each level halves
+ * the system by parallel loop over its rows, until it is short enough
+ * for Thomas elimination.
+ *
+ * System i-th row is a[i] x[i - 1] + b[i] x[i] + c[i] x[i + 1] = d[i],
+ * a[0] and c[n - 1] must be zero. No pivoting is done, so the matrix
+ * should be diagonally dominant, or symmetric definite.
+ */
+
+#ifndef TRIDIAG_SOLVERS_H
+#define TRIDIAG_SOLVERS_H
+
+// SIMD vector size in bytes.
+#if defined(__AVX512F__)
+#define TRIDIAG_VECTOR 64
+#elif defined(__AVX__)
+#define TRIDIAG_VECTOR 32
+#else
+#define TRIDIAG_VECTOR 16
+#endif
+
+// The system size, solved by Thomas elimination in cyclic reduction.
+#ifndef TRIDIAG_CR_STOP
+#define TRIDIAG_CR_STOP 4096
+#endif
+
+// The minimal size of single system, solved by cyclic reduction,
+// when there is more than one thread.
+#ifndef TRIDIAG_CR_MIN
+#define TRIDIAG_CR_MIN (1 << 18)
+#endif
+
+#endif // TRIDIAG_SOLVERS_H
+
+#ifdef HAVE_SINGLE
+#define real float
+#define tridiag_thomas stridiag_thomas
+#define tridiag_interleave stridiag_interleave
+#define tridiag_deinterleave stridiag_deinterleave
+#define tridiag_batch stridiag_batch
+#define tridiag_cr stridiag_cr
+#define tridiag_solve stridiag_solve
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define tridiag_thomas dtridiag_thomas
+#define tridiag_interleave dtridiag_interleave
+#define tridiag_deinterleave dtridiag_deinterleave
+#define tridiag_batch dtridiag_batch
+#define tridiag_cr dtridiag_cr
+#define tridiag_solve dtridiag_solve
+#endif
+
+// The number of systems in interleaved group.
+#define TRIDIAG_LANES ((int)(TRIDIAG_VECTOR / sizeof(real)))
+
+// Solve the system of size n by Thomas elimination,
+// w is the workspace of n elements.
+void tridiag_thomas(int n, const real* a, const real* b, const real* c,
+	const real* d, real* x, real* w)
+{
+	real m = 1 / b[0];
+	w[0] = c[0] * m;
+	x[0] = d[0] * m;
+	for (int i = 1; i < n; i++)
+	{
+		m = 1 / (b[i] - a[i] * w[i - 1]);
+		w[i] = c[i] * m;
+		x[i] = (d[i] - a[i] * x[i - 1]) * m;
+	}
+	for (int i = n - 2; i >= 0; i--)
+		x[i] -= w[i] * x[i + 1];
+}
+
+// Interleave count systems of size n, stored one after another in src:
+// element i of system s goes to dst[s % L + i * L + s / L * n * L],
+// L = TRIDIAG_LANES. The last group is padded with value pad.
+void tridiag_interleave(int n, int count, const real* src, real* dst, real pad)
+{
+	const int L = TRIDIAG_LANES;
+	int ngroups = (count + L - 1) / L;
+	#pragma omp parallel for
+	for (int g = 0; g < ngroups; g++)
+	{
+		real* group = dst + (size_t)g * n * L;
+		for (int l = 0; l < L; l++)
+		{
+			size_t s = (size_t)g * L + l;
+			if (s < count)
+			{
+				const real* sys = src + s * n;
+				for (int i = 0; i < n; i++)
+					group[l + i * L] = sys[i];
+			}
+			else
+				for (int i = 0; i < n; i++)
+					group[l + i * L] = pad;
+		}
+	}
+}
+
+// Put interleaved systems back one after another.
+void tridiag_deinterleave(int n, int count, const real* src, real* dst)
+{
+	const int L = TRIDIAG_LANES;
+	int ngroups = (count + L - 1) / L;
+	#pragma omp parallel for
+	for (int g = 0; g < ngroups; g++)
+	{
+		const real* group = src + (size_t)g * n * L;
+		for (int l = 0; l < L; l++)
+		{
+			size_t s = (size_t)g * L + l;
+			if (s >= count) break;
+			real* sys = dst + s * n;
+			for (int i = 0; i < n; i++)
+				sys[i] = group[l + i * L];
+		}
+	}
+}
+
+// Solve count interleaved systems of size n by Thomas elimination
+// in SIMD lanes. Padding systems of the last group must be solvable
+// (e.g. padded by tridiag_interleave with 1 for b and 0 for others).
+void tridiag_batch(int n, int count, const real* a, const real* b, const real* c,
+	const real* d, real* x)
+{
+	const int L = TRIDIAG_LANES;
+	int ngroups = (count + L - 1) / L;
+	#pragma omp parallel
+	{
+		// Workspace of the thread.
+		real* w = (real*)malloc((size_t)n * L * sizeof(real)); assert(w);
+
+		#pragma omp for
+		for (int g = 0; g < ngroups; g++)
+		{
+			size_t offset = (size_t)g * n * L;
+			const real* ag = a + offset;
+			const real* bg = b + offset;
+			const real* cg = c + offset;
+			const real* dg = d + offset;
+			real* xg = x + offset;
+
+			#pragma omp simd
+			for (int l = 0; l < L; l++)
+			{
+				real m = 1 / bg[l];
+				w[l] = cg[l] * m;
+				xg[l] = dg[l] * m;
+			}
+			for (int i = 1; i < n; i++)
+			{
+				#pragma omp simd
+				for (int l = i * L; l < i * L + L; l++)
+				{
+					real m = 1 / (bg[l] - ag[l] * w[l - L]);
+					w[l] = cg[l] * m;
+					xg[l] = (dg[l] - ag[l] * xg[l - L]) * m;
+				}
+			}
+			for (int i = n - 2; i >= 0; i--)
+			{
+				#pragma omp simd
+				for (int l = i * L; l < i * L + L; l++)
+					xg[l] -= w[l] * xg[l + L];
+			}
+		}
+
+		free(w);
+	}
+}
+
+// Solve the system of size n by cyclic reduction. Odd rows form the
+// system of size n / 2 for odd unknowns, which is solved recursively,
+// then even unknowns are found from their rows. Each level is the
+// parallel loop. w is the workspace of 6 n elements.
+void tridiag_cr(int n, const real* a, const real* b, const real* c,
+	const real* d, real* x, real* w)
+{
+	if (n <= TRIDIAG_CR_STOP)
+	{
+		tridiag_thomas(n, a, b, c, d, x, w);
+		return;
+	}
+
+	// The reduced system is kept in the workspace.
+	int m = n / 2;
+	real* a1 = w;
+	real* b1 = w + m;
+	real* c1 = w + 2 * m;
+	real* d1 = w + 3 * m;
+	real* x1 = w + 4 * m;
+
+	// Row 2 j + 1 minus its neighbours, multiplied to eliminate
+	// unknowns 2 j and 2 j + 2 (the last row may have no lower one).
+	#pragma omp parallel for simd
+	for (int j = 0; j < m; j++)
+	{
+		int i = 2 * j + 1;
+		real k1 = a[i] / b[i - 1];
+		real k2 = (i + 1 < n) ? c[i] / b[i + 1] : 0;
+		real an = (i + 1 < n) ? a[i + 1] : 0;
+		real cn = (i + 1 < n) ? c[i + 1] : 0;
+		real dn = (i + 1 < n) ? d[i + 1] : 0;
+		a1[j] = -a[i - 1] * k1;
+		b1[j] = b[i] - c[i - 1] * k1 - an * k2;
+		c1[j] = -cn * k2;
+		d1[j] = d[i] - d[i - 1] * k1 - dn * k2;
+	}
+
+	tridiag_cr(m, a1, b1, c1, d1, x1, w + 5 * m);
+
+	// Even unknowns from their rows.
+	#pragma omp parallel for simd
+	for (int j = 0; j < n - m; j++)
+	{
+		int i = 2 * j;
+		real xl = j ? x1[j - 1] : 0;
+		real xu = (j < m) ? x1[j] : 0;
+		x[i] = (d[i] - a[i] * xl - c[i] * xu) / b[i];
+		if (j < m) x[i + 1] = xu;
+	}
+}
+
+// Solve the system of size n by cyclic reduction, if it is long
+// enough and there is more than one thread, or by Thomas elimination.
+void tridiag_solve(int n, const real* a, const real* b, const real* c,
+	const real* d, real* x)
+{
+	int cr = (n >= TRIDIAG_CR_MIN) && (omp_get_max_threads() > 1);
+	real* w = (real*)malloc((size_t)(cr ? 6 : 1) * n * sizeof(real)); assert(w);
+	if (cr)
+		tridiag_cr(n, a, b, c, d, x, w);
+	else
+		tridiag_thomas(n, a, b, c, d, x, w);
+	free(w);
+}
+
+#undef real
+#undef tridiag_thomas
+#undef tridiag_interleave
+#undef tridiag_deinterleave
+#undef tridiag_batch
+#undef tridiag_cr
+#undef tridiag_solve
+#undef TRIDIAG_LANES
@@ -0,0 +1,435 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Eigenvalues of symmetric tridiagonal matrix by Sturm sequence
+ * bisection, and eigenvectors by inverse iteration. The matrix has
+ * diagonal d[n] and off-diagonal e[n - 1]. All intervals, containing
+ * wanted eigenvalues, are split at once in rounds: Sturm counts at their
+ * split points are evaluated in SIMD lanes, TRIDIAG_BISECT points at
+ * a time, and the groups of points go to OpenMP threads. While there
+ * are fewer intervals than points, each interval is split into more
+ * than two parts (multisection).
+ */
+
+#ifndef TRIDIAG_EIGEN_H
+#define TRIDIAG_EIGEN_H
+
+// Neighbouring eigenvalues closer than TRIDIAG_CLUSTER times their
+// magnitude (but not less than TRIDIAG_CLUSTER_FLOOR times the matrix
+// norm) are the cluster: their eigenvectors are orthogonalized.
+#ifndef TRIDIAG_CLUSTER
+#define TRIDIAG_CLUSTER 1e-3
+#endif
+#ifndef TRIDIAG_CLUSTER_FLOOR
+#define TRIDIAG_CLUSTER_FLOOR 1e-6
+#endif
+
+// The maximum size of cluster: longer chains of close eigenvalues
+// are split, so that they go to different OpenMP threads.
+#ifndef TRIDIAG_CLUSTER_MAX
+#define TRIDIAG_CLUSTER_MAX 512
+#endif
+
+// The number of nearest previous vectors of the cluster, each
+// eigenvector is orthogonalized to.
+#ifndef TRIDIAG_ORTHO_WINDOW
+#define TRIDIAG_ORTHO_WINDOW 16
+#endif
+
+// The number of rows, orthogonalized at once in inverse iteration.
+#ifndef TRIDIAG_ORTHO_BLOCK
+#define TRIDIAG_ORTHO_BLOCK 1024
+#endif
+
+// The number of inverse iteration steps.
+#ifndef TRIDIAG_INVIT
+#define TRIDIAG_INVIT 2
+#endif
+
+#endif // TRIDIAG_EIGEN_H
+
+#ifdef HAVE_SINGLE
+#define real float
+#define eps FLT_EPSILON
+#define safmin FLT_MIN
+#define tridiag_interval_t stridiag_interval_t
+#define tridiag_sturm stridiag_sturm
+#define tridiag_bounds stridiag_bounds
+#define tridiag_eigen_range stridiag_eigen_range
+#define tridiag_eigenvalues stridiag_eigenvalues
+#define tridiag_invit stridiag_invit
+#define tridiag_eigenvectors stridiag_eigenvectors
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define eps DBL_EPSILON
+#define safmin DBL_MIN
+#define tridiag_interval_t dtridiag_interval_t
+#define tridiag_sturm dtridiag_sturm
+#define tridiag_bounds dtridiag_bounds
+#define tridiag_eigen_range dtridiag_eigen_range
+#define tridiag_eigenvalues dtridiag_eigenvalues
+#define tridiag_invit dtridiag_invit
+#define tridiag_eigenvectors dtridiag_eigenvectors
+#endif
+
+// The number of Sturm counts, evaluated at once: several SIMD vectors,
+// so that the chains of divisions overlap.
+#define TRIDIAG_BISECT ((int)(4 * TRIDIAG_VECTOR / sizeof(real)))
+
+// Interval [lo, hi) of eigenvalues nlo .. nhi - 1.
+typedef struct
+{
+	real lo, hi;
+	int nlo, nhi;
+}
+tridiag_interval_t;
+
+// Get the number of eigenvalues less than x[l] into count[l]
+// for TRIDIAG_BISECT points. e2 are squares of off-diagonal,
+// pivots smaller than pivmin are replaced with -pivmin.
+static void tridiag_sturm(int n, const real* d, const real* e2, real pivmin,
+	const real* x, int* count)
+{
+	real q[TRIDIAG_BISECT];
+	int c[TRIDIAG_BISECT];
+
+	#pragma omp simd
+	for (int l = 0; l < TRIDIAG_BISECT; l++)
+	{
+		q[l] = d[0] - x[l];
+		if (fabs(q[l]) < pivmin) q[l] = -pivmin;
+		c[l] = q[l] < 0;
+	}
+	for (int i = 1; i < n; i++)
+	{
+		real di = d[i], ei = e2[i - 1];
+		#pragma omp simd
+		for (int l = 0; l < TRIDIAG_BISECT; l++)
+		{
+			q[l] = di - x[l] - ei / q[l];
+			if (fabs(q[l]) < pivmin) q[l] = -pivmin;
+			c[l] += q[l] < 0;
+		}
+	}
+	for (int l = 0; l < TRIDIAG_BISECT; l++)
+		count[l] = c[l];
+}
+
+// Get squares of off-diagonal, the minimal pivot, Gershgorin
+// bounds of the spectrum and the matrix norm.
+static void tridiag_bounds(int n, const real* d, const real* e, real* e2,
+	real* pivmin, real* gl, real* gu, real* norm)
+{
+	real emax = 1;
+	*gl = d[0]; *gu = d[0];
+	for (int i = 0; i < n; i++)
+	{
+		real r = ((i > 0) ? fabs(e[i - 1]) : 0) + ((i < n - 1) ? fabs(e[i]) : 0);
+		if (d[i] - r < *gl) *gl = d[i] - r;
+		if (d[i] + r > *gu) *gu = d[i] + r;
+		if (i < n - 1)
+		{
+			e2[i] = e[i] * e[i];
+			if (e2[i] > emax) emax = e2[i];
+		}
+	}
+	*pivmin = safmin * emax;
+	*norm = fabs(*gl) > fabs(*gu) ? fabs(*gl) : fabs(*gu);
+
+	// Widen bounds, so that counts at them are exactly 0 and n.
+	real pad = 2 * eps * n * *norm + 2 * *pivmin;
+	*gl -= pad; *gu += pad;
+}
+
+// Get indices il .. iu of eigenvalues in [vl, vu).
+void tridiag_eigen_range(int n, const real* d, const real* e,
+	real vl, real vu, int* il, int* iu)
+{
+	real* e2 = (real*)malloc(n * sizeof(real)); assert(e2);
+	real pivmin, gl, gu, norm;
+	tridiag_bounds(n, d, e, e2, &pivmin, &gl, &gu, &norm);
+
+	real x[TRIDIAG_BISECT];
+	int count[TRIDIAG_BISECT];
+	for (int l = 0; l < TRIDIAG_BISECT; l++)
+		x[l] = l ? vu : vl;
+	tridiag_sturm(n, d, e2, pivmin, x, count);
+	*il = count[0];
+	*iu = count[1] - 1;
+
+	free(e2);
+}
+
+// Find eigenvalues il .. iu (0-based, ascending) to absolute tolerance
+// tol (or about machine precision, if it is smaller) into w[iu - il + 1].
+void tridiag_eigenvalues(int n, const real* d, const real* e,
+	int il, int iu, real tol, real* w)
+{
+	assert((il >= 0) && (iu < n));
+	if (iu < il) return;
+
+	real* e2 = (real*)malloc(n * sizeof(real)); assert(e2);
+	real pivmin, gl, gu, norm;
+	tridiag_bounds(n, d, e, e2, &pivmin, &gl, &gu, &norm);
+
+	// Intervals never overlap and each contains at least one wanted
+	// eigenvalue, so there are at most iu - il + 1 of them.
+	int m = iu - il + 1;
+	int capacity = TRIDIAG_BISECT * omp_get_max_threads();
+	tridiag_interval_t* intervals = (tridiag_interval_t*)malloc(
+		m * sizeof(tridiag_interval_t)); assert(intervals);
+	tridiag_interval_t* next = (tridiag_interval_t*)malloc(
+		m * sizeof(tridiag_interval_t)); assert(next);
+	int npoints = (m > capacity ? m : capacity) + TRIDIAG_BISECT;
+	real* x = (real*)malloc(npoints * sizeof(real)); assert(x);
+	int* count = (int*)malloc(npoints * sizeof(int)); assert(count);
+
+	intervals[0].lo = gl; intervals[0].hi = gu;
+	intervals[0].nlo = 0; intervals[0].nhi = n;
+	int nintervals = 1;
+
+	while (nintervals)
+	{
+		// Split points: intervals get equal share of SIMD lanes
+		// of all threads, but at least one point each.
+		int k = capacity / nintervals;
+		if (k < 1) k = 1;
+		int total = k * nintervals;
+		for (int j = 0; j < nintervals; j++)
+		{
+			real lo = intervals[j].lo, hi = intervals[j].hi;
+			for (int p = 0; p < k; p++)
+				x[p + j * k] = lo + (hi - lo) * (p + 1) / (k + 1);
+		}
+		for (int p = total; p < npoints; p++)
+			x[p] = gu;
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int p = 0; p < total; p += TRIDIAG_BISECT)
+			tridiag_sturm(n, d, e2, pivmin, x + p, count + p);
+
+		// Keep the parts with wanted eigenvalues; the converged ones
+		// give their midpoint to all eigenvalues in them.
+		int nnext = 0;
+		for (int j = 0; j < nintervals; j++)
+			for (int p = 0; p <= k; p++)
+			{
+				tridiag_interval_t part;
+				part.lo = p ? x[p - 1 + j * k] : intervals[j].lo;
+				part.hi = (p < k) ? x[p + j * k] : intervals[j].hi;
+				part.nlo = p ? count[p - 1 + j * k] : intervals[j].nlo;
+				part.nhi = (p < k) ? count[p + j * k] : intervals[j].nhi;
+				int first = part.nlo > il ? part.nlo : il;
+				int last = part.nhi <= iu ? part.nhi - 1 : iu;
+				if (first > last) continue;
+
+				real mid = part.lo + (part.hi - part.lo) / 2;
+				real scale = fabs(part.lo) > fabs(part.hi) ? fabs(part.lo) : fabs(part.hi);
+				if ((part.hi - part.lo <= tol) || (part.hi - part.lo <= 2 * eps * scale) ||
+					(mid == part.lo) || (mid == part.hi))
+				{
+					for (int i = first; i <= last; i++)
+						w[i - il] = mid;
+					continue;
+				}
+				next[nnext++] = part;
+			}
+
+		tridiag_interval_t* swap = intervals;
+		intervals = next; next = swap;
+		nintervals = nnext;
+	}
+
+	free(e2);
+	free(intervals);
+	free(next);
+	free(x);
+	free(count);
+}
+
+// Find eigenvector z of eigenvalue lambda by inverse iteration,
+// orthogonal to nprev previous vectors of its cluster (columns of Z
+// before z, with leading dimension ldz). w is the workspace of 6 n,
+// dots is the workspace of nprev.
+static void tridiag_invit(int n, const real* d, const real* e, real lambda,
+	real norm, real* z, int nprev, int ldz, real* w, double* dots)
+{
+	real* dl = w;
+	real* dd = w + n;
+	real* du = w + 2 * n;
+	real* du2 = w + 3 * n;
+	char* swapped = (char*)(w + 4 * n);
+
+	// LU factorization of T - lambda I with partial pivoting,
+	// zero pivots are replaced with small ones.
+	real tiny = eps * norm;
+	for (int i = 0; i < n; i++)
+	{
+		dd[i] = d[i] - lambda;
+		if (i < n - 1) { dl[i] = e[i]; du[i] = e[i]; du2[i] = 0; }
+	}
+	for (int i = 0; i < n - 1; i++)
+	{
+		if (fabs(dd[i]) >= fabs(dl[i]))
+		{
+			swapped[i] = 0;
+			if (dd[i] == 0) dd[i] = tiny;
+			real f = dl[i] / dd[i];
+			dl[i] = f;
+			dd[i + 1] -= f * du[i];
+		}
+		else
+		{
+			swapped[i] = 1;
+			real f = dd[i] / dl[i];
+			dd[i] = dl[i];
+			dl[i] = f;
+			real t = du[i];
+			du[i] = dd[i + 1];
+			dd[i + 1] = t - f * dd[i + 1];
+			if (i < n - 2)
+			{
+				du2[i] = du[i + 1];
+				du[i + 1] = -f * du[i + 1];
+			}
+		}
+	}
+	if (dd[n - 1] == 0) dd[n - 1] = tiny;
+
+	// Start from pseudo-random vector, different for each eigenvalue.
+	unsigned int seed = 1 + nprev;
+	for (int i = 0; i < n; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		z[i] = (real)((seed >> 16) & 0x7fff) / 0x7fff - (real)0.5;
+	}
+
+	for (int it = 0; it < TRIDIAG_INVIT; it++)
+	{
+		// Solve (T - lambda I) y = z in place.
+		for (int i = 0; i < n - 1; i++)
+			if (!swapped[i])
+				z[i + 1] -= dl[i] * z[i];
+			else
+			{
+				real t = z[i];
+				z[i] = z[i + 1];
+				z[i + 1] = t - dl[i] * z[i];
+			}
+		z[n - 1] /= dd[n - 1];
+		if (n > 1) z[n - 2] = (z[n - 2] - du[n - 2] * z[n - 1]) / dd[n - 2];
+		for (int i = n - 3; i >= 0; i--)
+			z[i] = (z[i] - du[i] * z[i + 1] - du2[i] * z[i + 2]) / dd[i];
+
+		// Orthogonalize to the cluster by classical Gram-Schmidt twice:
+		// dot products with all previous vectors are accumulated by blocks
+		// of rows, then all of them are subtracted, so the block of z
+		// stays in cache, and each previous vector is read once per sweep.
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (int j = 0; j < nprev; j++)
+				dots[j] = 0;
+			for (int i0 = 0; i0 < n; i0 += TRIDIAG_ORTHO_BLOCK)
+			{
+				int i1 = n - i0 < TRIDIAG_ORTHO_BLOCK ? n : i0 + TRIDIAG_ORTHO_BLOCK;
+				for (int j = 0; j < nprev; j++)
+				{
+					const real* v = z - (size_t)(nprev - j) * ldz;
+					double dot = 0;
+					#pragma omp simd reduction(+:dot)
+					for (int i = i0; i < i1; i++)
+						dot += (double)v[i] * z[i];
+					dots[j] += dot;
+				}
+			}
+			for (int i0 = 0; i0 < n; i0 += TRIDIAG_ORTHO_BLOCK)
+			{
+				int i1 = n - i0 < TRIDIAG_ORTHO_BLOCK ? n : i0 + TRIDIAG_ORTHO_BLOCK;
+				for (int j = 0; j < nprev; j++)
+				{
+					const real* v = z - (size_t)(nprev - j) * ldz;
+					real dot = (real)dots[j];
+					#pragma omp simd
+					for (int i = i0; i < i1; i++)
+						z[i] -= dot * v[i];
+				}
+			}
+		}
+
+		double sum = 0;
+		#pragma omp simd reduction(+:sum)
+		for (int i = 0; i < n; i++)
+			sum += (double)z[i] * z[i];
+		real scale = (real)(1 / sqrt(sum));
+		for (int i = 0; i < n; i++)
+			z[i] *= scale;
+	}
+}
+
+// Find eigenvectors of m eigenvalues w (ascending) by inverse iteration
+// into columns of n x m matrix Z. Each vector is orthogonalized to the
+// nearest previous ones of its cluster. Clusters go to OpenMP threads.
+void tridiag_eigenvectors(int n, const real* d, const real* e,
+	int m, const real* w, real* Z, int ldz)
+{
+	real* e2 = (real*)malloc(n * sizeof(real)); assert(e2);
+	real pivmin, gl, gu, norm;
+	tridiag_bounds(n, d, e, e2, &pivmin, &gl, &gu, &norm);
+	free(e2);
+
+	// Cluster starts: the gap is relative to the eigenvalues, as the
+	// error of inverse iteration vector is about eps ||T|| / gap.
+	int* starts = (int*)malloc((m + 1) * sizeof(int)); assert(starts);
+	int nclusters = 0;
+	for (int k = 0; k < m; k++)
+	{
+		real gap = k ? fmax(fabs(w[k]), fabs(w[k - 1])) * TRIDIAG_CLUSTER : 0;
+		if (gap < TRIDIAG_CLUSTER_FLOOR * norm) gap = TRIDIAG_CLUSTER_FLOOR * norm;
+		if (!k || (w[k] - w[k - 1] > gap) ||
+			(k - starts[nclusters - 1] == TRIDIAG_CLUSTER_MAX))
+			starts[nclusters++] = k;
+	}
+	starts[nclusters] = m;
+
+	#pragma omp parallel
+	{
+		real* work = (real*)malloc((size_t)6 * n * sizeof(real)); assert(work);
+		double* dots = (double*)malloc(TRIDIAG_ORTHO_WINDOW * sizeof(double)); assert(dots);
+		#pragma omp for schedule(dynamic)
+		for (int c = 0; c < nclusters; c++)
+			for (int k = starts[c]; k < starts[c + 1]; k++)
+			{
+				int nprev = k - starts[c];
+				if (nprev > TRIDIAG_ORTHO_WINDOW) nprev = TRIDIAG_ORTHO_WINDOW;
+				tridiag_invit(n, d, e, w[k], norm, Z + (size_t)k * ldz,
+					nprev, ldz, work, dots);
+			}
+		free(work);
+		free(dots);
+	}
+
+	free(starts);
+}
+
+#undef real
+#undef eps
+#undef safmin
+#undef tridiag_interval_t
+#undef tridiag_sturm
+#undef tridiag_bounds
+#undef tridiag_eigen_range
+#undef tridiag_eigenvalues
+#undef tridiag_invit
+#undef tridiag_eigenvectors
+#undef TRIDIAG_BISECT
@@ -0,0 +1,180 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, without any restrictons.
+ *
+ * Test of tridiagonal eigensolver: each eigenvalue k must be bracketed
+ * by serial Sturm counts in double precision at its distance of the
+ * tolerance plus TRIDIAG_TOLERANCE eps ||T||, eigenvalues of the laplace
+ * matrix are compared to the exact ones, 2 (cos(pi k / (n + 1)) - 1).
+ * Eigenvectors are checked by scaled residual ||T z - lambda z|| /
+ * (n ||T|| eps) and orthogonality |Z^T Z - I| / (n eps).
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define eps FLT_EPSILON
+#define tridiag_eigen_range stridiag_eigen_range
+#define tridiag_eigenvalues stridiag_eigenvalues
+#define tridiag_eigenvectors stridiag_eigenvectors
+#define tridiag_eigen_test stridiag_eigen_test
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define eps DBL_EPSILON
+#define tridiag_eigen_range dtridiag_eigen_range
+#define tridiag_eigenvalues dtridiag_eigenvalues
+#define tridiag_eigenvectors dtridiag_eigenvectors
+#define tridiag_eigen_test dtridiag_eigen_test
+#endif
+
+#ifndef TRIDIAG_EIGEN_TEST_H
+#define TRIDIAG_EIGEN_TEST_H
+
+// Get the number of eigenvalues less than x, serially in double.
+static int tridiag_count(int n, const double* d, const double* e, double x)
+{
+	int count = 0;
+	double q = 1;
+	for (int i = 0; i < n; i++)
+	{
+		q = d[i] - x - (i ? e[i - 1] * e[i - 1] / q : 0);
+		if (q == 0) q = -DBL_MIN;
+		count += q < 0;
+	}
+	return count;
+}
+
+#endif // TRIDIAG_EIGEN_TEST_H
+
+// Find eigenvalues of the matrix with diagonal d0 and off-diagonal e0
+// with indices il .. iu, or in interval [vl, vu) if by_value is set,
+// to tolerance tol, and eigenvectors, if vectors is set.
+int tridiag_eigen_test(int n, const double* d0, const double* e0,
+	int by_value, double lo, double hi, double tol, int vectors)
+{
+	real* d = (real*)malloc(n * sizeof(real)); assert(d);
+	real* e = (real*)malloc(n * sizeof(real)); assert(e);
+	double* dr = (double*)malloc(n * sizeof(double)); assert(dr);
+	double* er = (double*)malloc(n * sizeof(double)); assert(er);
+	int laplace = 1;
+	double norm = 0;
+	for (int i = 0; i < n; i++)
+	{
+		d[i] = d0[i]; dr[i] = d[i];
+		e[i] = (i < n - 1) ? e0[i] : 0; er[i] = e[i];
+		if ((d[i] != -2) || ((i < n - 1) && (e[i] != 1))) laplace = 0;
+		double r = fabs(dr[i]) + fabs(er[i]) + (i ? fabs(er[i - 1]) : 0);
+		if (r > norm) norm = r;
+	}
+
+	int il = (int)lo, iu = (int)hi;
+	if (by_value) tridiag_eigen_range(n, d, e, (real)lo, (real)hi, &il, &iu);
+	if (il < 0) il = 0;
+	if (iu > n - 1) iu = n - 1;
+	int m = iu >= il ? iu - il + 1 : 0;
+	real* w = (real*)malloc((m + 1) * sizeof(real)); assert(w);
+
+	double start = omp_get_wtime();
+
+	tridiag_eigenvalues(n, d, e, il, iu, (real)tol, w);
+
+	double time = omp_get_wtime() - start;
+	printf("%d\t%d\tbisect\t%f sec\t", n, m, time); fflush(stdout);
+
+	// Bracketing by Sturm counts, exact values of laplace matrix.
+	double delta = tol + TRIDIAG_TOLERANCE * eps * norm;
+	int nerrors = 0;
+	double error = 0;
+	#pragma omp parallel for reduction(+:nerrors) reduction(max:error)
+	for (int k = 0; k < m; k++)
+	{
+		if ((tridiag_count(n, dr, er, w[k] - delta) > il + k) ||
+			(tridiag_count(n, dr, er, w[k] + delta) <= il + k) ||
+			((k > 0) && (w[k] < w[k - 1])))
+			nerrors++;
+		if (laplace)
+		{
+			double exact = 2 * (cos(M_PI * (n - il - k) / (n + 1)) - 1);
+			double diff = fabs(w[k] - exact) / (eps * norm);
+			if (diff > error) error = diff;
+			if (fabs(w[k] - exact) > delta) nerrors++;
+		}
+	}
+	printf("%s", nerrors ? "FAILED" : "PASSED");
+	if (laplace) printf("\t%f", error);
+	printf("\n");
+	fflush(stdout);
+	int status = nerrors ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	if (vectors && m)
+	{
+		real* Z = (real*)malloc((size_t)n * m * sizeof(real)); assert(Z);
+
+		start = omp_get_wtime();
+
+		tridiag_eigenvectors(n, d, e, m, w, Z, n);
+
+		time = omp_get_wtime() - start;
+		printf("%d\t%d\tinvit\t%f sec\t", n, m, time); fflush(stdout);
+
+		// Residual of each vector, orthogonality of all pairs,
+		// or of neighbours only for many vectors.
+		double residual = 0, orthogonality = 0;
+		#pragma omp parallel for reduction(max:residual, orthogonality) schedule(dynamic)
+		for (int k = 0; k < m; k++)
+		{
+			const real* z = Z + (size_t)k * n;
+			double sum = 0;
+			for (int i = 0; i < n; i++)
+			{
+				double r = (dr[i] - w[k]) * z[i];
+				if (i > 0) r += er[i - 1] * z[i - 1];
+				if (i < n - 1) r += er[i] * z[i + 1];
+				sum += r * r;
+			}
+			if (sqrt(sum) > residual) residual = sqrt(sum);
+
+			for (int j = (m <= TRIDIAG_MAX_ORTHO) ? 0 : k; (j <= k + 1) && (j < m); j++)
+			{
+				const real* v = Z + (size_t)j * n;
+				double dot = 0;
+				for (int i = 0; i < n; i++)
+					dot += (double)v[i] * z[i];
+				if (j == k) dot -= 1;
+				if (fabs(dot) > orthogonality) orthogonality = fabs(dot);
+			}
+		}
+		residual /= n * norm * eps;
+		orthogonality /= n * eps;
+		int passed = (residual <= TRIDIAG_TOLERANCE) && (orthogonality <= TRIDIAG_TOLERANCE);
+		printf("%s\t%f\t%f\n", passed ? "PASSED" : "FAILED", residual, orthogonality);
+		fflush(stdout);
+		if (!passed) status = EXIT_FAILURE;
+
+		free(Z);
+	}
+
+	free(d);
+	free(e);
+	free(dr);
+	free(er);
+	free(w);
+
+	return status;
+}
+
+#undef real
+#undef eps
+#undef tridiag_eigen_range
+#undef tridiag_eigenvalues
+#undef tridiag_eigenvectors
+#undef tridiag_eigen_test
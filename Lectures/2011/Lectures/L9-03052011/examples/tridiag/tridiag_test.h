@@ -0,0 +1,222 @@
+/*
+ * MSU CUDA Course Examples and Exercises.
+ *
+ * Copyright (c) 2011 Dmitry Mikushin
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising
+ * from the use of this software.
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it freely,
+ * without any restrictons.
+ *
+ * Test of tridiagonal solvers: batch of systems is solved by Thomas
+ * elimination one system per thread at a time, then interleaved and
+ * solved in SIMD lanes; single system is solved by Thomas elimination
+ * and by cyclic reduction. Each result is checked by the scaled
+ * residual ||d - A x|| / (||A|| ||x|| eps) of the worst system.
+ */
+
+#ifdef HAVE_SINGLE
+#define real float
+#define eps FLT_EPSILON
+#define tridiag_thomas stridiag_thomas
+#define tridiag_interleave stridiag_interleave
+#define tridiag_deinterleave stridiag_deinterleave
+#define tridiag_batch stridiag_batch
+#define tridiag_cr stridiag_cr
+#define tridiag_test stridiag_test
+#define tridiag_report stridiag_report
+#define tridiag_each stridiag_each
+#endif
+
+#ifdef HAVE_DOUBLE
+#define real double
+#define eps DBL_EPSILON
+#define tridiag_thomas dtridiag_thomas
+#define tridiag_interleave dtridiag_interleave
+#define tridiag_deinterleave dtridiag_deinterleave
+#define tridiag_batch dtridiag_batch
+#define tridiag_cr dtridiag_cr
+#define tridiag_test dtridiag_test
+#define tridiag_report dtridiag_report
+#define tridiag_each dtridiag_each
+#endif
+
+// Print the time and throughput of processing count systems of size n,
+// reading and writing the given number of arrays, and check
+// the solution, if it is given. Returns 0, if it is correct.
+static int tridiag_report(int n, int count, const char* method, double time,
+	int arrays, const real* a, const real* b, const real* c, const real* d,
+	const real* x)
+{
+	printf("%d\t%d\t%s\t%f sec\t%e\t%f", n, count, method, time,
+		count / time, 1.0e-9 * arrays * n * (double)count * sizeof(real) / time);
+	if (!x)
+	{
+		printf("\n");
+		fflush(stdout);
+		return 0;
+	}
+
+	double worst = 0;
+	#pragma omp parallel for reduction(max:worst)
+	for (int s = 0; s < count; s++)
+	{
+		size_t offset = (size_t)s * n;
+		const real *as = a + offset, *bs = b + offset, *cs = c + offset;
+		const real *ds = d + offset, *xs = x + offset;
+		double rnorm = 0, anorm = 0, xnorm = 0;
+		for (int i = 0; i < n; i++)
+		{
+			double r = ds[i] - (double)bs[i] * xs[i];
+			if (i > 0) r -= (double)as[i] * xs[i - 1];
+			if (i < n - 1) r -= (double)cs[i] * xs[i + 1];
+			double arow = fabs(as[i]) + fabs(bs[i]) + fabs(cs[i]);
+			if (fabs(r) > rnorm) rnorm = fabs(r);
+			if (arow > anorm) anorm = arow;
+			if (fabs(xs[i]) > xnorm) xnorm = fabs(xs[i]);
+		}
+		double residual = rnorm / (anorm * xnorm * eps);
+		if (!(residual <= worst)) worst = residual;
+	}
+
+	int passed = worst <= TRIDIAG_TOLERANCE;
+	printf("\t%s\t%f\n", passed ? "PASSED" : "FAILED", worst);
+	fflush(stdout);
+	return passed ? 0 : 1;
+}
+
+// Solve count systems, stored one after another,
+// by Thomas elimination, one system at a time in each thread.
+static void tridiag_each(int n, int count, const real* a, const real* b,
+	const real* c, const real* d, real* x)
+{
+	#pragma omp parallel
+	{
+		real* w = (real*)malloc(n * sizeof(real)); assert(w);
+		#pragma omp for
+		for (int s = 0; s < count; s++)
+		{
+			size_t k = (size_t)s * n;
+			tridiag_thomas(n, a + k, b + k, c + k, d + k, x + k, w);
+		}
+		free(w);
+	}
+}
+
+// Test solvers on count systems of size n. All systems have matrix
+// (a0, b0, c0), if it is given, or random diagonally dominant ones.
+// Right hand sides are random.
+int tridiag_test(int n, int count, const double* a0, const double* b0, const double* c0)
+{
+	const int L = TRIDIAG_VECTOR / sizeof(real);
+	size_t size = (size_t)n * count;
+	size_t padded = (size_t)n * ((count + L - 1) / L) * L;
+	real* a = (real*)malloc(size * sizeof(real)); assert(a);
+	real* b = (real*)malloc(size * sizeof(real)); assert(b);
+	real* c = (real*)malloc(size * sizeof(real)); assert(c);
+	real* d = (real*)malloc(size * sizeof(real)); assert(d);
+	real* x = (real*)malloc(size * sizeof(real)); assert(x);
+
+	for (size_t s = 0; s < count; s++)
+		for (int i = 0; i < n; i++)
+		{
+			size_t k = i + s * n;
+			if (a0)
+			{
+				a[k] = a0[i]; b[k] = b0[i]; c[k] = c0[i];
+			}
+			else
+			{
+				a[k] = i ? 2 * (rand() / (real)RAND_MAX) - 1 : 0;
+				c[k] = (i < n - 1) ? 2 * (rand() / (real)RAND_MAX) - 1 : 0;
+				b[k] = fabs(a[k]) + fabs(c[k]) + (real)0.1 + rand() / (real)RAND_MAX;
+				if (rand() % 2) b[k] = -b[k];
+			}
+			d[k] = 2 * (rand() / (real)RAND_MAX) - 1;
+		}
+
+	int status = 0;
+	double start, best;
+
+	// The first run warms up caches and pages.
+	#define TIMED(code) \
+		best = 0; \
+		for (int run = 0; run <= TRIDIAG_RUNS; run++) \
+		{ \
+			start = omp_get_wtime(); \
+			code; \
+			double time = omp_get_wtime() - start; \
+			if ((run == 1) || ((run > 1) && (time < best))) best = time; \
+		}
+
+	if (count == 1)
+	{
+		real* w = (real*)malloc((size_t)6 * n * sizeof(real)); assert(w);
+
+		memset(x, 0, size * sizeof(real));
+		TIMED(tridiag_thomas(n, a, b, c, d, x, w));
+		status |= tridiag_report(n, count, "thomas", best, 5, a, b, c, d, x);
+
+		memset(x, 0, size * sizeof(real));
+		TIMED(tridiag_cr(n, a, b, c, d, x, w));
+		status |= tridiag_report(n, count, "cr", best, 5, a, b, c, d, x);
+
+		free(w);
+	}
+	else
+	{
+		memset(x, 0, size * sizeof(real));
+		TIMED(tridiag_each(n, count, a, b, c, d, x));
+		status |= tridiag_report(n, count, "thomas", best, 5, a, b, c, d, x);
+
+		real* ai = (real*)malloc(padded * sizeof(real)); assert(ai);
+		real* bi = (real*)malloc(padded * sizeof(real)); assert(bi);
+		real* ci = (real*)malloc(padded * sizeof(real)); assert(ci);
+		real* di = (real*)malloc(padded * sizeof(real)); assert(di);
+		real* xi = (real*)malloc(padded * sizeof(real)); assert(xi);
+		memset(xi, 0, padded * sizeof(real));
+
+		// Interleaving is timed separately: the batch may be
+		// built in interleaved layout from the start.
+		TIMED(
+			tridiag_interleave(n, count, a, ai, 0);
+			tridiag_interleave(n, count, b, bi, 1);
+			tridiag_interleave(n, count, c, ci, 0);
+			tridiag_interleave(n, count, d, di, 0));
+		tridiag_report(n, count, "interleave", best, 8, NULL, NULL, NULL, NULL, NULL);
+
+		TIMED(tridiag_batch(n, count, ai, bi, ci, di, xi));
+		memset(x, 0, size * sizeof(real));
+		tridiag_deinterleave(n, count, xi, x);
+		status |= tridiag_report(n, count, "batch", best, 5, a, b, c, d, x);
+
+		free(ai);
+		free(bi);
+		free(ci);
+		free(di);
+		free(xi);
+	}
+
+	#undef TIMED
+
+	free(a);
+	free(b);
+	free(c);
+	free(d);
+	free(x);
+
+	return status ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#undef real
+#undef eps
+#undef tridiag_thomas
+#undef tridiag_interleave
+#undef tridiag_deinterleave
+#undef tridiag_batch
+#undef tridiag_cr
+#undef tridiag_test
+#undef tridiag_report
+#undef tridiag_each